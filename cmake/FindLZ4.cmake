@@ -0,0 +1,20 @@
+# Copyright (c) 2017-2018, The Fonero Project.
+#
+# - Try to find liblz4
+# Once done this will define
+#
+#  LZ4_FOUND - system has liblz4
+#  LZ4_INCLUDE_DIR - the liblz4 include directory
+#  LZ4_LIBRARIES - Link these to use liblz4
+
+find_path(LZ4_INCLUDE_DIR lz4.h
+  /usr/include
+  /usr/local/include
+)
+
+find_library(LZ4_LIBRARIES NAMES lz4)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 "Could not find liblz4" LZ4_INCLUDE_DIR LZ4_LIBRARIES)
+# show the LZ4_INCLUDE_DIR and LZ4_LIBRARIES variables only in the advanced view
+mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARIES)
@@ -0,0 +1,226 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "syncobj.h"
+
+namespace epee
+{
+namespace metrics
+{
+  //! Number of shards a counter or histogram is split into, each thread updates one of them
+  static constexpr size_t shard_count = 8;
+
+  //! The shard the calling thread records into, threads are spread round robin.
+  size_t get_thread_shard();
+
+  enum metric_type
+  {
+    metric_counter,
+    metric_gauge,
+    metric_histogram
+  };
+
+  //! Name, help and the optional label which identify a metric
+  struct metric_info
+  {
+    std::string name;
+    std::string help;
+    std::string label_name;
+    std::string label_value;
+    metric_type type;
+  };
+
+  //! Monotonic count, e.g. of received messages
+  class counter
+  {
+  public:
+    counter();
+
+    void inc(uint64_t n = 1)
+    {
+      m_shards[get_thread_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const;
+
+  private:
+    struct shard
+    {
+      std::atomic<uint64_t> value;
+      char padding[64 - sizeof(std::atomic<uint64_t>)]; // one cache line per shard
+    };
+    shard m_shards[shard_count];
+  };
+
+  //! Current value of something which goes up and down, e.g. the pool size
+  class gauge
+  {
+  public:
+    gauge(): m_value(0) {}
+
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> m_value;
+  };
+
+  /*! Latency histogram in nanoseconds. Buckets are log-linear like HDR
+  histograms: each power of two is split in `1 << sub_bucket_bits` buckets,
+  so a bucket's bounds are within 25% of any value it holds. */
+  class histogram
+  {
+  public:
+    static constexpr unsigned sub_bucket_bits = 2;
+    static constexpr unsigned min_exponent = 10; //!< values under 1024 ns share the first bucket
+    static constexpr unsigned max_exponent = 37; //!< values over ~137 s share the last bucket
+    static constexpr size_t bucket_count = ((max_exponent - min_exponent) << sub_bucket_bits) + 2;
+
+    struct snapshot
+    {
+      std::vector<uint64_t> buckets;
+      uint64_t count;
+      uint64_t sum_ns;
+
+      //! Upper bound of the bucket holding the `q` quantile, 0 if empty
+      uint64_t quantile(double q) const;
+    };
+
+    histogram();
+
+    void record(uint64_t ns)
+    {
+      shard &s = m_shards[get_thread_shard()];
+      s.buckets[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+      s.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    snapshot get() const;
+
+    static size_t get_bucket(uint64_t ns)
+    {
+      if (ns < (uint64_t(1) << min_exponent))
+        return 0;
+      unsigned exponent = 63 - __builtin_clzll(ns);
+      if (exponent >= max_exponent)
+        return bucket_count - 1;
+      const size_t sub_bucket = (ns >> (exponent - sub_bucket_bits)) & ((1 << sub_bucket_bits) - 1);
+      return 1 + ((exponent - min_exponent) << sub_bucket_bits) + sub_bucket;
+    }
+
+    //! Exclusive upper bound of a bucket, UINT64_MAX for the last one
+    static uint64_t get_bucket_upper_bound(size_t bucket);
+
+  private:
+    struct shard
+    {
+      std::atomic<uint64_t> buckets[bucket_count];
+      std::atomic<uint64_t> sum_ns;
+      char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    std::unique_ptr<shard[]> m_shards;
+  };
+
+  //! Records the lifetime of the object in a histogram
+  class scoped_timer
+  {
+  public:
+    explicit scoped_timer(histogram &h): m_histogram(h), m_start(misc_utils::get_ns_count()) {}
+    ~scoped_timer() { m_histogram.record(misc_utils::get_ns_count() - m_start); }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+  private:
+    histogram &m_histogram;
+    uint64_t m_start;
+  };
+
+  struct metrics_visitor
+  {
+    virtual ~metrics_visitor() {}
+    virtual void on_counter(const metric_info &info, uint64_t value) = 0;
+    virtual void on_gauge(const metric_info &info, int64_t value) = 0;
+    virtual void on_histogram(const metric_info &info, const histogram::snapshot &value) = 0;
+  };
+
+  /*! All the metrics of the process. Looking a metric up takes a lock, so
+  call sites keep the returned reference (which stays valid for the life of
+  the process) and only update it afterwards, which is lock free. */
+  class registry
+  {
+  public:
+    static registry& instance();
+
+    //! Names get a "fonero_" prefix when exported. The same name and label always give the same metric.
+    counter& get_counter(const std::string &name, const std::string &help, const std::string &label_name = std::string(), const std::string &label_value = std::string());
+    gauge& get_gauge(const std::string &name, const std::string &help, const std::string &label_name = std::string(), const std::string &label_value = std::string());
+    histogram& get_histogram(const std::string &name, const std::string &help, const std::string &label_name = std::string(), const std::string &label_value = std::string());
+
+    //! Calls the visitor for every metric, ordered by name then label
+    void visit(metrics_visitor &visitor) const;
+
+    //! Prometheus text exposition format (version 0.0.4), histograms in seconds
+    std::string get_prometheus_text() const;
+
+  private:
+    struct entry
+    {
+      metric_info info;
+      std::unique_ptr<counter> c;
+      std::unique_ptr<gauge> g;
+      std::unique_ptr<histogram> h;
+    };
+
+    registry() {}
+    entry& get_entry(const std::string &name, const std::string &help, const std::string &label_name, const std::string &label_value, metric_type type);
+
+    mutable critical_section m_lock;
+    std::map<std::string, entry> m_entries;
+  };
+}
+}
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+
+//! Times the rest of the scope into histogram `name`{`label_name`=`label_value`}, the histogram is looked up once per call site
+#define METRICS_SCOPED_TIMER(name, help, label_name, label_value) \
+  static epee::metrics::histogram &METRICS_CONCAT(metrics_histogram_, __LINE__) = epee::metrics::registry::instance().get_histogram(name, help, label_name, label_value); \
+  epee::metrics::scoped_timer METRICS_CONCAT(metrics_timer_, __LINE__)(METRICS_CONCAT(metrics_histogram_, __LINE__))
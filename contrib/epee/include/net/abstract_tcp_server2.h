@@ -51,6 +51,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/interprocess/detail/atomic.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/thread.hpp>
 #include "net_utils_base.h"
 #include "syncobj.h"
@@ -125,6 +126,7 @@ namespace net_utils
     virtual boost::asio::io_service& get_io_service();
     virtual bool add_ref();
     virtual bool release();
+    virtual bool wait_send_que(size_t max_bytes, uint64_t timeout_ms);
     //------------------------------------------------------
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
@@ -135,6 +137,15 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Write the front of the send queue, now or after the upload limit allows it.
+    void start_write_que_front();
+
+    /// Handle expiry of the timers deferring traffic over the rate limits.
+    void handle_send_timer(const boost::system::error_code& e);
+    void handle_read_timer(const boost::system::error_code& e);
+    /// Cancel both timers, on the strand unless the connection is being destroyed.
+    void cancel_timers();
+
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
     //boost::array<char, 1024> buffer_;
@@ -158,6 +169,13 @@ namespace net_utils
     boost::mutex m_throttle_speed_in_mutex;
     boost::mutex m_throttle_speed_out_mutex;
 
+    // defer traffic over the rate limits, instead of sleeping in io threads
+    boost::asio::deadline_timer m_send_timer;
+    boost::asio::deadline_timer m_read_timer;
+
+    // signalled with m_send_que_lock held when the send queue shrinks or the connection shuts down
+    boost::condition_variable_any m_send_que_cond;
+
 	public:
 			void setRpcStation();
   };
@@ -80,7 +80,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_pfilter( pfilter ),
 		m_connection_type( connection_type ),
 		m_throttle_speed_in("speed_in", "throttle_speed_in"),
-		m_throttle_speed_out("speed_out", "throttle_speed_out")
+		m_throttle_speed_out("speed_out", "throttle_speed_out"),
+		m_send_timer(io_service),
+		m_read_timer(io_service)
   {
     MINFO("test, connection constructor set m_connection_type="<<m_connection_type);
   }
@@ -286,30 +288,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			context.m_current_speed_down = m_throttle_speed_in.get_current_speed();
 		}
 
-    {
-			CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_in );
-			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred * 1024);
-		}
+		// obey the download limit by reading the next data later, not by sleeping here
+		const double delay = speed_limit_is_enabled() ? get_recv_delay(bytes_transferred) : 0;
 
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
-
-
-		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-					CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred ); // decission from global throttle
-				}
-				
-				delay *= 0.5;
-				if (delay > 0) {
-					long int ms = (long int)(delay * 100);
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
-				}
-			} while(delay > 0);
-		} // any form of sleeping
-		
       //_info("[sock " << socket_.native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
       context.m_last_recv = time(NULL);
@@ -328,6 +309,13 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         CRITICAL_REGION_END();
         if(do_shutdown)
           shutdown();
+      }else if (delay > 0)
+      {
+        m_read_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(delay * 1000000)));
+        m_read_timer.async_wait(
+          strand_.wrap(
+            boost::bind(&connection<t_protocol_handler>::handle_read_timer, connection<t_protocol_handler>::shared_from_this(),
+              boost::asio::placeholders::error)));
       }else
       {
         socket_.async_read_some(boost::asio::buffer(buffer_),
@@ -484,10 +472,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     //some data should be wrote to stream
     //request complete
 
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
-
     m_send_que_lock.lock(); // *** critical ***
     epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){m_send_que_lock.unlock();});
 
@@ -538,15 +522,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
         auto size_now = m_send_que.front().size();
         MDEBUG("do_send() NOW SENSD: packet="<<size_now<<" B");
-        if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
-
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 //strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 //)
-                                 );
+        start_write_que_front();
         //_dbg3("(chunk): " << size_now);
         //logger_handle_net_write(size_now);
         //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
@@ -566,6 +542,15 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     boost::system::error_code ignored_ec;
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     m_was_shutdown = true;
+    // the timer handlers run on the strand, so cancel the timers there too
+    auto self = safe_shared_from_this();
+    if (self)
+      strand_.post(boost::bind(&connection<t_protocol_handler>::cancel_timers, self));
+    else
+      cancel_timers();
+    CRITICAL_REGION_BEGIN(m_send_que_lock);
+    m_send_que_cond.notify_all();
+    CRITICAL_REGION_END();
     m_protocol_handler.release_protocol();
     return true;
   }
@@ -609,10 +594,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     logger_handle_net_write(cb);
 
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
-
     bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
@@ -622,6 +603,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
 
     m_send_que.pop_front();
+    m_send_que_cond.notify_all();
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -633,14 +615,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       //have more data to send
 		auto size_now = m_send_que.front().size();
 		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
-		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) ,
-        // strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-				// )
-        );
+		start_write_que_front();
       //_dbg3("(normal)" << size_now);
     }
     CRITICAL_REGION_END();
@@ -651,6 +626,92 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write", void());
   }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::wait_send_que(size_t max_bytes, uint64_t timeout_ms)
+  {
+    TRY_ENTRY();
+    // never called from io threads: they are the ones draining the queue
+    auto self = safe_shared_from_this();
+    if(!self)
+      return false;
+    const boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(timeout_ms);
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    const auto queued_bytes = [this]() {
+      size_t bytes = 0;
+      for(const auto& buffer: m_send_que)
+        bytes += buffer.size();
+      return bytes;
+    };
+    size_t queued;
+    while(!m_was_shutdown && (queued = queued_bytes()) > max_bytes)
+    {
+      if(m_send_que_cond.wait_until(m_send_que_lock, deadline) == boost::cv_status::timeout)
+      {
+        MWARNING("Timed out waiting for the peer to take queued data, " << queued << " bytes pending");
+        return false;
+      }
+    }
+    return !m_was_shutdown;
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::wait_send_que", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write_que_front()
+  {
+    // m_send_que_lock must be held; a pending timer counts as the active write operation
+    const size_t size_now = m_send_que.front().size();
+    const double delay = speed_limit_is_enabled() ? get_send_delay(size_now) : 0;
+    if (delay > 0)
+    {
+      m_send_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(delay * 1000000)));
+      m_send_timer.async_wait(strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_send_timer, connection<t_protocol_handler>::shared_from_this(), _1)));
+      return;
+    }
+    boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) ,
+      boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_send_timer(const boost::system::error_code& e)
+  {
+    TRY_ENTRY();
+    if (e || m_was_shutdown)
+      return;
+    // the packet was already accounted for when the timer was set
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    CHECK_AND_ASSERT_MES(!m_send_que.empty(), void(), "[sock " << socket_.native_handle() << "] m_send_que.size() == 0 at handle_send_timer!");
+    boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), m_send_que.front().size()) ,
+      boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_send_timer", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::cancel_timers()
+  {
+    boost::system::error_code ignored_ec;
+    {
+      // the send timer is armed with the queue lock held
+      CRITICAL_REGION_LOCAL(m_send_que_lock);
+      m_send_timer.cancel(ignored_ec);
+    }
+    m_read_timer.cancel(ignored_ec);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_read_timer(const boost::system::error_code& e)
+  {
+    TRY_ENTRY();
+    if (e || m_was_shutdown)
+      return;
+    socket_.async_read_some(boost::asio::buffer(buffer_),
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
+          boost::asio::placeholders::error,
+          boost::asio::placeholders::bytes_transferred)));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_read_timer", void());
+  }
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
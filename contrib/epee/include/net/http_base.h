@@ -30,6 +30,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -180,6 +181,9 @@ namespace net_utils
 		};
 
 
+		//! Appends a piece of a streamed body, returns false once the body can not be delivered anymore
+		typedef std::function<bool(const void* data, size_t size)> body_writer;
+
 		struct http_response_info
 		{
 			int					m_response_code;
@@ -190,6 +194,8 @@ namespace net_utils
 			http_header_info    m_header_info;
 			int                 m_http_ver_hi;// OUT paramter only
 			int                 m_http_ver_lo;// OUT paramter only
+			std::function<bool(const body_writer&)> m_body_stream; //!< if set, produces the body while it is being sent (chunked), instead of m_body
+			std::string         m_rpc_status; //!< status field of the RPC response object, when it has one
 
 			void clear()
 			{
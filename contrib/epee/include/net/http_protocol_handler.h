@@ -31,11 +31,13 @@
 #define _HTTP_SERVER_H_
 
 #include <boost/optional/optional.hpp>
+#include <atomic>
 #include <string>
 #include "net_utils_base.h"
 #include "to_nonconst_iterator.h"
 #include "http_auth.h"
 #include "http_base.h"
+#include "http_server_worker_pool.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "net.http"
@@ -56,6 +58,7 @@ namespace net_utils
 			std::string m_folder;
 			boost::optional<login> m_user;
 			critical_section m_lock;
+			http_worker_pool* m_pworker_pool = nullptr; //!< requests are handled on the io threads if not set
 		};
 
 		/************************************************************************/
@@ -73,6 +76,7 @@ namespace net_utils
 
 			bool release_protocol()
 			{
+				m_released = true;
 				return true;
 			}
 
@@ -91,12 +95,15 @@ namespace net_utils
 			}
 			virtual bool handle_recv(const void* ptr, size_t cb);
 			virtual bool handle_request(const http::http_request_info& query_info, http_response_info& response);
+			virtual http_request_priority get_request_priority(const http::http_request_info& query_info) { return http_request_priority_normal; }
+			virtual std::string get_request_client() { return std::string(); }
 
 		private:
 			enum machine_state{
 				http_state_retriving_comand_line,
 				http_state_retriving_header,
 				http_state_retriving_body,
+				http_state_waiting_response,
 				http_state_connection_close,
 				http_state_error
 			};
@@ -127,6 +134,9 @@ namespace net_utils
 
 			//major function
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
+			inline bool send_response(const http::http_request_info& query_info, http_response_info& response, bool on_worker);
+			inline void handle_request_async(bool cancelled);
+			void finish_request(bool res);
 
 
 			std::string get_not_found_response_body(const std::string& URI);
@@ -139,7 +149,9 @@ namespace net_utils
 			http::http_request_info m_query_info;
 			size_t m_len_summary, m_len_remain;
 			config_type& m_config;
-			bool m_want_close;
+			std::atomic<bool> m_want_close;
+			std::atomic<bool> m_released;
+			critical_section m_handler_lock; //!< the request may be finished on a worker thread
 		protected:
 			i_service_endpoint* m_psnd_hndlr;
 		};
@@ -151,6 +163,7 @@ namespace net_utils
 			virtual bool handle_http_request(const http_request_info& query_info,
 																						 http_response_info& response,
 																						 t_connection_context& m_conn_context) = 0;
+			virtual http_request_priority get_http_request_priority(const http_request_info& query_info){return http_request_priority_normal;}
 			virtual bool init_server_thread(){return true;}
 			virtual bool deinit_server_thread(){return true;}
 		};
@@ -196,6 +209,16 @@ namespace net_utils
 				return m_config.m_phandler->handle_http_request(query_info, response, m_conn_context);
 			}
 
+			virtual http_request_priority get_request_priority(const http_request_info& query_info)
+			{
+				return m_config.m_phandler->get_http_request_priority(query_info);
+			}
+
+			virtual std::string get_request_client()
+			{
+				return m_conn_context.m_remote_address.host_str();
+			}
+
 			virtual bool thread_init()
 			{
 				return m_config.m_phandler->init_server_thread();;
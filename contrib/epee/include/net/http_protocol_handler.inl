@@ -28,6 +28,7 @@
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
 #include "http_protocol_handler.h"
+#include "http_request_parser.h"
 #include "reg_exp_definer.h"
 #include "string_tools.h"
 #include "file_io_utils.h"
@@ -38,6 +39,9 @@
 
 #define HTTP_MAX_URI_LEN		 9000
 #define HTTP_MAX_HEADER_LEN		 100000
+#define HTTP_STREAM_CHUNK_SIZE		 (64 * 1024)
+#define HTTP_STREAM_MAX_QUEUED_BYTES	 (1024 * 1024)
+#define HTTP_STREAM_SEND_TIMEOUT	 (60 * 1000)
 
 namespace epee
 {
@@ -193,6 +197,67 @@ namespace net_utils
 
 
 
+		//--------------------------------------------------------------------------------------------
+		//! Buffers a streamed body and sends it with the chunked transfer coding, in chunks of at most HTTP_STREAM_CHUNK_SIZE.
+		//! It waits for the peer to take the queued bytes, so it may only run on a worker thread.
+		class chunked_body_writer
+		{
+		public:
+			chunked_body_writer(i_service_endpoint* psnd_hndlr): m_psnd_hndlr(psnd_hndlr), m_ok(true)
+			{
+				m_buffer.reserve(HTTP_STREAM_CHUNK_SIZE + 32);
+			}
+
+			bool write(const void* data, size_t size)
+			{
+				const char* p = (const char*)data;
+				while(m_ok && size)
+				{
+					const size_t n = std::min(size, HTTP_STREAM_CHUNK_SIZE - m_buffer.size());
+					m_buffer.append(p, n);
+					p += n;
+					size -= n;
+					if(m_buffer.size() >= HTTP_STREAM_CHUNK_SIZE)
+						flush();
+				}
+				return m_ok;
+			}
+
+			//! Sends the last chunk, or closes the connection if the body is incomplete
+			bool finish(bool complete)
+			{
+				if(complete)
+					flush();
+				if(complete && m_ok)
+					m_ok = m_psnd_hndlr->do_send("0\r\n\r\n", 5);
+				if(!complete || !m_ok)
+				{
+					m_psnd_hndlr->close();
+					return false;
+				}
+				return true;
+			}
+
+		private:
+			void flush()
+			{
+				if(!m_ok || m_buffer.empty())
+					return;
+				char size_line[24];
+				const int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", m_buffer.size());
+				m_buffer.insert(0, size_line, size_len);
+				m_buffer += "\r\n";
+				//produce no more of the body until a slow peer catches up
+				m_ok = m_psnd_hndlr->wait_send_que(HTTP_STREAM_MAX_QUEUED_BYTES, HTTP_STREAM_SEND_TIMEOUT) &&
+					m_psnd_hndlr->do_send((void*)m_buffer.data(), m_buffer.size());
+				m_buffer.clear();
+			}
+
+			i_service_endpoint* m_psnd_hndlr;
+			std::string m_buffer;
+			bool m_ok;
+		};
+
 		//--------------------------------------------------------------------------------------------
 		template<class t_connection_context>
 		simple_http_connection_handler<t_connection_context>::simple_http_connection_handler(i_service_endpoint* psnd_hndlr, config_type& config):
@@ -203,6 +268,7 @@ namespace net_utils
 		m_len_remain(0),
 		m_config(config),
 		m_want_close(false),
+		m_released(false),
         m_psnd_hndlr(psnd_hndlr)
 	{
 
@@ -226,6 +292,7 @@ namespace net_utils
 		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << buf);
 		//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
 
+		CRITICAL_REGION_LOCAL(m_handler_lock);
 		bool res = handle_buff_in(buf);
 		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/)
 			return false;
@@ -294,6 +361,10 @@ namespace net_utils
 				}
 			case http_state_retriving_body:
 				return handle_retriving_query_body();
+			case http_state_waiting_response:
+				//keep pipelined requests in m_cache until the current response is sent
+				m_is_stop_handling = true;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -310,55 +381,24 @@ namespace net_utils
 
 		return true;
 	}
-	//--------------------------------------------------------------------------------------------
-	inline bool analize_http_method(const boost::smatch& result, http::http_method& method, int& http_ver_major, int& http_ver_minor)
-	{
-		CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-		http_ver_major = boost::lexical_cast<int>(result[11]);
-		http_ver_minor = boost::lexical_cast<int>(result[12]);
-		if(result[4].matched)
-			method = http::http_method_get;
-		else if(result[5].matched)
-			method = http::http_method_head;
-		else if(result[6].matched)
-			method = http::http_method_post;
-		else if(result[7].matched)
-			method = http::http_method_put;
-		else
-			method = http::http_method_etc;
-
-		return true;
-	}
-
   //--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
 	{
-		STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+).(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-		//											    123         4     5      6      7     8        9        10          11     12
-		//size_t match_len = 0;
-		boost::smatch result;	
-		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
-		{
-			analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi);
-			m_query_info.m_URI = result[10];
-      parse_uri(m_query_info.m_URI, m_query_info.m_uri_content);
-			m_query_info.m_http_method_str = result[2];
-			m_query_info.m_full_request_str = result[0];
-
-			m_cache.erase(m_cache.begin(),  to_nonsonst_iterator(m_cache, result[0].second));
-
-			m_state = http_state_retriving_header;
-
-			return true;
-		}else
+		const std::string::size_type eol = m_cache.find('\n');
+		CHECK_AND_ASSERT_MES(eol != std::string::npos, false, "simple_http_connection_handler::handle_invoke_query_line() called without a full line");
+		if(!parse_request_line(boost::string_ref(m_cache.data(), eol), m_query_info))
 		{
 			m_state = http_state_error;
-			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << m_cache);
+			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << m_cache.substr(0, eol));
 			return false;
 		}
 
-		return false;
+		parse_uri(m_query_info.m_URI, m_query_info.m_uri_content);
+		m_query_info.m_full_request_str.assign(m_cache, 0, eol + 1);
+		m_cache.erase(0, eol + 1);
+		m_state = http_state_retriving_header;
+		return true;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
@@ -407,16 +447,13 @@ namespace net_utils
 			}
 			if(0 == m_len_summary)
 			{	//current query finished, next will be next query
-				if(handle_request_and_send_response(m_query_info))
-					set_ready_state();
-				else
-					m_state = http_state_error;
+				finish_request(handle_request_and_send_response(m_query_info));
 			}
 			m_len_remain = m_len_summary;
 		}else
 		{//current query finished, next will be next query
 			handle_request_and_send_response(m_query_info);
-			set_ready_state();
+			finish_request(true);
 		}
 
 		return true;
@@ -459,97 +496,125 @@ namespace net_utils
 		}
 
 		if(!m_len_remain)
-		{
-			if(handle_request_and_send_response(m_query_info))
-				set_ready_state();
-			else
-				m_state = http_state_error;
-		}
+			finish_request(handle_request_and_send_response(m_query_info));
 		return true;
 	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::finish_request(bool res)
+	{
+		if(m_state == http_state_waiting_response)
+			return; //a worker thread will get back to this connection
+		if(!res)
+			m_state = http_state_error;
+		else if(m_want_close)
+			m_state = http_state_connection_close; //no more pipelined requests on this connection
+		else
+			set_ready_state();
+	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field,
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)"
-			//  12            3         4                5              6                   7                  8      9        10
-			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//11             1213   14
-			boost::regex::icase | boost::regex::normal);
-
-		boost::smatch		result;
-		std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-		std::string::const_iterator it_end_bound = m_cache_to_process.begin()+pos;
-
-		body_info.clear();
-
-		//lookup all fields and fill well-known fields
-		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched)
-		{
-			const size_t field_val = 13;
-			const size_t field_etc_name = 11;
-
-			int i = 2; //start position = 2
-			if(result[i++].matched)//"Connection"
-				body_info.m_connection = result[field_val];
-			else if(result[i++].matched)//"Referer"
-				body_info.m_referer = result[field_val];
-			else if(result[i++].matched)//"Content-Length"
-				body_info.m_content_length = result[field_val];
-			else if(result[i++].matched)//"Content-Type"
-				body_info.m_content_type = result[field_val];
-			else if(result[i++].matched)//"Transfer-Encoding"
-				body_info.m_transfer_encoding = result[field_val];
-			else if(result[i++].matched)//"Content-Encoding"
-				body_info.m_content_encoding = result[field_val];
-			else if(result[i++].matched)//"Host"
-				body_info.m_host = result[field_val];
-			else if(result[i++].matched)//"Cookie"
-				body_info.m_cookie = result[field_val];
-			else if(result[i++].matched)//"User-Agent"
-				body_info.m_user_agent = result[field_val];
-			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-			else
-			{
-				LOG_ERROR("simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:"<<m_cache_to_process);
-			}
-
-			it_current_bound = result[(int)result.size()-1]. first;
-		}
-		return  true;
+		return parse_header_fields(boost::string_ref(m_cache_to_process.data(), pos), body_info);
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string& str, size_t& OUT len)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-		std::string res;
-		boost::smatch result;
-		if(!(boost::regex_search( str, result, rexp_mach_field, boost::match_default) && result[0].matched))
-			return false;
-
-		len = boost::lexical_cast<size_t>(result[0]);
-		return true;
+		return parse_content_length(str, len);
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_request_and_send_response(const http::http_request_info& query_info)
 	{
+		http_worker_pool* pworker_pool = m_config.m_pworker_pool;
+		if(pworker_pool && m_psnd_hndlr->add_ref())
+		{
+			//the query stays in m_query_info, nothing is parsed until the response is sent
+			const machine_state state = m_state;
+			m_state = http_state_waiting_response;
+			if(pworker_pool->dispatch(get_request_priority(query_info), get_request_client(),
+				[this](bool cancelled){ handle_request_async(cancelled); }))
+				return true;
+			m_state = state;
+			m_psnd_hndlr->release();
+		}
+
 		http_response_info response;
 		bool res = handle_request(query_info, response);
 		//CHECK_AND_ASSERT_MES(res, res, "handle_request(query_info, response) returned false" );
 
+		return send_response(query_info, response, false) && res;
+	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_response(const http::http_request_info& query_info, http_response_info& response, bool on_worker)
+	{
+		const bool head_only = query_info.m_http_method == http::http_method_head;
+		const bool chunked = query_info.m_http_ver_hi > 1 || (query_info.m_http_ver_hi == 1 && query_info.m_http_ver_lo >= 1);
+		if(response.m_body_stream && (head_only || !chunked || !on_worker))
+		{
+			//the client can't take a chunked body, and HEAD needs the length anyway;
+			//an io thread can't wait for the peer to drain the chunks, so it sends the body whole
+			response.m_body.clear();
+			const bool res = response.m_body_stream([&response](const void* data, size_t size){ response.m_body.append((const char*)data, size); return true; });
+			response.m_body_stream = nullptr;
+			CHECK_AND_ASSERT_MES(res, false, "Failed to produce response body");
+		}
+
 		std::string response_data = get_response_header(response);
 		
 		//LOG_PRINT_L0("HTTP_SEND: << \r\n" << response_data + response.m_body);
     LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 		
-		m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
-		if(response.m_body.size() && (query_info.m_http_method != http::http_method_head))
-			m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
-		return res;
+		if(!m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size()))
+			return false;
+		if(head_only)
+			return true;
+		if(response.m_body_stream)
+		{
+			//the body is sent in chunks as it gets produced, so it never sits in memory as a whole
+			chunked_body_writer writer(m_psnd_hndlr);
+			const bool res = response.m_body_stream([&writer](const void* data, size_t size){ return writer.write(data, size); });
+			//a failed stream can't be reported anymore after the header, only by dropping the connection
+			return writer.finish(res);
+		}
+		if(response.m_body.size())
+			return m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::handle_request_async(bool cancelled)
+	{
+		//runs on a worker thread; the connection is kept alive by the reference taken at dispatch
+		bool close = cancelled || m_released;
+		if(!close)
+		{
+			http_response_info response;
+			bool res = handle_request(m_query_info, response);
+			//the io threads only buffer input while a response is pending, so a long
+			//streamed response doesn't need to hold the lock
+			res = send_response(m_query_info, response, true) && res;
+
+			CRITICAL_REGION_LOCAL(m_handler_lock);
+			if(res && !m_want_close)
+			{
+				//go on with the requests pipelined meanwhile
+				set_ready_state();
+				std::string empty;
+				close = !handle_buff_in(empty) || m_want_close;
+			}
+			else
+			{
+				m_state = res ? http_state_connection_close : http_state_error;
+				close = true;
+			}
+		}
+		if(close)
+			m_psnd_hndlr->close();
+		m_psnd_hndlr->release();
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
@@ -588,9 +653,11 @@ namespace net_utils
 	{
 		std::string buf = "HTTP/1.1 ";
 		buf += boost::lexical_cast<std::string>(response.m_response_code) + " " + response.m_response_comment + "\r\n" +
-			"Server: Epee-based\r\n"
-			"Content-Length: ";
-		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
+			"Server: Epee-based\r\n";
+		if(response.m_body_stream)
+			buf += "Transfer-Encoding: chunked\r\n";
+		else
+			buf += "Content-Length: " + boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
 		buf += "Content-Type: ";
 		buf += response.m_mime_tipe + "\r\n";
 
@@ -601,16 +668,15 @@ namespace net_utils
 		buf += "Accept-Ranges: bytes\r\n";
 		//Wed, 01 Dec 2010 03:27:41 GMT"
 
-		string_tools::trim(m_query_info.m_header_info.m_connection);
-		if(m_query_info.m_header_info.m_connection.size())
+		if(!is_keep_alive(m_query_info))
 		{
-			if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-			{
-        //closing connection after sending
-				buf += "Connection: close\r\n";
-				m_state = http_state_connection_close;
-				m_want_close = true;
-			}
+			//closing connection after sending
+			buf += "Connection: close\r\n";
+			m_want_close = true;
+		}
+		else if(m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0)
+		{
+			buf += "Connection: keep-alive\r\n";
 		}
 		//add additional fields, if it is
 		for(fields_list::const_iterator it = response.m_additional_fields.begin(); it!=response.m_additional_fields.end(); it++)
@@ -0,0 +1,250 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cctype>
+#include <limits>
+#include <string>
+
+#include "http_base.h"
+
+namespace epee
+{
+namespace net_utils
+{
+  namespace http
+  {
+    namespace parser
+    {
+      inline bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+      //! RFC 7230 tchar
+      inline bool is_token_char(char c)
+      {
+        return std::isalnum(static_cast<unsigned char>(c)) || (c && std::string("!#$%&'*+-.^_`|~").find(c) != std::string::npos);
+      }
+
+      inline bool iequals(const boost::string_ref a, const boost::string_ref b)
+      {
+        if (a.size() != b.size())
+          return false;
+        for (size_t n = 0; n < a.size(); ++n)
+          if (std::tolower(static_cast<unsigned char>(a[n])) != std::tolower(static_cast<unsigned char>(b[n])))
+            return false;
+        return true;
+      }
+
+      inline boost::string_ref trim(boost::string_ref str)
+      {
+        while (!str.empty() && is_space(str.front()))
+          str.remove_prefix(1);
+        while (!str.empty() && (is_space(str.back()) || str.back() == '\r'))
+          str.remove_suffix(1);
+        return str;
+      }
+
+      //! Reads an unsigned decimal, fails on empty input, trailing garbage or overflow
+      template<typename T>
+      inline bool read_number(const boost::string_ref str, T& out)
+      {
+        if (str.empty())
+          return false;
+        T value = 0;
+        for (const char c: str)
+        {
+          if (c < '0' || c > '9')
+            return false;
+          const T digit = c - '0';
+          if (value > (std::numeric_limits<T>::max() - digit) / 10)
+            return false;
+          value = value * 10 + digit;
+        }
+        out = value;
+        return true;
+      }
+    }
+
+    //! Parses a request line ("METHOD SP request-target SP HTTP/x.y"), `line` must not contain the line break
+    inline bool parse_request_line(boost::string_ref line, http_request_info& info)
+    {
+      line = parser::trim(line);
+
+      const size_t method_end = line.find(' ');
+      if (method_end == boost::string_ref::npos || method_end == 0)
+        return false;
+      const boost::string_ref method = line.substr(0, method_end);
+      for (const char c: method)
+        if (!parser::is_token_char(c))
+          return false;
+      line.remove_prefix(method_end + 1);
+
+      const size_t uri_end = line.find(' ');
+      if (uri_end == boost::string_ref::npos || uri_end == 0)
+        return false;
+      const boost::string_ref uri = line.substr(0, uri_end);
+      for (const char c: uri)
+        if (c <= ' ' || c == 0x7f)
+          return false;
+      line.remove_prefix(uri_end + 1);
+
+      static const char http_prefix[] = "HTTP/";
+      if (!line.starts_with(http_prefix))
+        return false;
+      line.remove_prefix(sizeof(http_prefix) - 1);
+      const size_t dot = line.find('.');
+      if (dot == boost::string_ref::npos)
+        return false;
+      int ver_hi = 0, ver_lo = 0;
+      if (!parser::read_number(line.substr(0, dot), ver_hi) || !parser::read_number(line.substr(dot + 1), ver_lo))
+        return false;
+
+      if (parser::iequals(method, "GET"))
+        info.m_http_method = http_method_get;
+      else if (parser::iequals(method, "HEAD"))
+        info.m_http_method = http_method_head;
+      else if (parser::iequals(method, "POST"))
+        info.m_http_method = http_method_post;
+      else if (parser::iequals(method, "PUT"))
+        info.m_http_method = http_method_put;
+      else if (parser::iequals(method, "OPTIONS") || parser::iequals(method, "DELETE") || parser::iequals(method, "TRACE"))
+        info.m_http_method = http_method_etc;
+      else
+        return false;
+
+      info.m_http_method_str = std::string(method.data(), method.size());
+      info.m_URI = std::string(uri.data(), uri.size());
+      info.m_http_ver_hi = ver_hi;
+      info.m_http_ver_lo = ver_lo;
+      return true;
+    }
+
+    //! Parses the header fields following the request line, up to and including the empty line if present
+    /*! Field names are matched case-insensitively, values are trimmed, obsolete line
+    folding is joined with a single space. */
+    inline bool parse_header_fields(boost::string_ref head, http_header_info& info)
+    {
+      info.clear();
+      std::string* last_value = nullptr;
+      while (!head.empty())
+      {
+        size_t eol = head.find('\n');
+        boost::string_ref line = head.substr(0, eol);
+        head.remove_prefix(eol == boost::string_ref::npos ? head.size() : eol + 1);
+        if (!line.empty() && line.back() == '\r')
+          line.remove_suffix(1);
+        if (line.empty())
+          break;
+
+        if (parser::is_space(line.front()))
+        {
+          if (!last_value)
+            return false;
+          const boost::string_ref folded = parser::trim(line);
+          if (!folded.empty())
+          {
+            if (!last_value->empty())
+              last_value->push_back(' ');
+            last_value->append(folded.data(), folded.size());
+          }
+          continue;
+        }
+
+        const size_t colon = line.find(':');
+        if (colon == boost::string_ref::npos)
+          return false;
+        boost::string_ref name = line.substr(0, colon);
+        while (!name.empty() && parser::is_space(name.back()))
+          name.remove_suffix(1);
+        if (name.empty())
+          return false;
+        for (const char c: name)
+          if (!parser::is_token_char(c))
+            return false;
+        const boost::string_ref value = parser::trim(line.substr(colon + 1));
+
+        if (parser::iequals(name, "Connection"))
+          last_value = &info.m_connection;
+        else if (parser::iequals(name, "Referer"))
+          last_value = &info.m_referer;
+        else if (parser::iequals(name, "Content-Length"))
+        {
+          // differing lengths would let the request be framed two different ways
+          if (!info.m_content_length.empty() && value != boost::string_ref(info.m_content_length))
+            return false;
+          last_value = &info.m_content_length;
+        }
+        else if (parser::iequals(name, "Content-Type"))
+          last_value = &info.m_content_type;
+        else if (parser::iequals(name, "Transfer-Encoding"))
+          last_value = &info.m_transfer_encoding;
+        else if (parser::iequals(name, "Content-Encoding"))
+          last_value = &info.m_content_encoding;
+        else if (parser::iequals(name, "Host"))
+          last_value = &info.m_host;
+        else if (parser::iequals(name, "Cookie"))
+          last_value = &info.m_cookie;
+        else if (parser::iequals(name, "User-Agent"))
+          last_value = &info.m_user_agent;
+        else
+        {
+          info.m_etc_fields.emplace_back(std::string(name.data(), name.size()), std::string());
+          last_value = &info.m_etc_fields.back().second;
+        }
+        last_value->assign(value.data(), value.size());
+      }
+      return true;
+    }
+
+    //! \return false if `str` is not a valid Content-Length value
+    inline bool parse_content_length(const boost::string_ref str, size_t& len)
+    {
+      return parser::read_number(parser::trim(str), len);
+    }
+
+    //! \return true if the connection is to be kept open after the response, per the request's version and Connection header
+    inline bool is_keep_alive(const http_request_info& info)
+    {
+      boost::string_ref connection = parser::trim(info.m_header_info.m_connection);
+      bool close = info.m_http_ver_hi < 1 || (info.m_http_ver_hi == 1 && info.m_http_ver_lo < 1);
+      while (!connection.empty())
+      {
+        const size_t comma = connection.find(',');
+        const boost::string_ref option = parser::trim(connection.substr(0, comma));
+        if (parser::iequals(option, "close"))
+          return false;
+        if (parser::iequals(option, "keep-alive"))
+          close = false;
+        connection.remove_prefix(comma == boost::string_ref::npos ? connection.size() : comma + 1);
+      }
+      return !close;
+    }
+  }
+}
+}
@@ -30,10 +30,33 @@
 #include "jsonrpc_structs.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_template_helper.h"
+#include "metrics.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "net.http"
 
+namespace epee
+{
+namespace net_utils
+{
+namespace http
+{
+  //! the status field of an RPC response, empty for responses without one
+  template<typename t_response>
+  auto get_rpc_status(const t_response& resp, int) -> decltype(std::string(resp.status))
+  {
+    return resp.status;
+  }
+
+  template<typename t_response>
+  std::string get_rpc_status(const t_response& resp, long)
+  {
+    return std::string();
+  }
+}
+}
+}
+
 
 #define CHAIN_HTTP_TO_MAP2(context_type) bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, \
               epee::net_utils::http::http_response_info& response, \
@@ -58,10 +81,13 @@
 
 #define MAP_URI_AUTO_XML2(s_pattern, callback_f, command_type) //TODO: don't think i ever again will use xml - ambiguous and "overtagged" format
 
+#define RPC_METRICS_TIMER(endpoint) METRICS_SCOPED_TIMER("rpc_request_seconds", "Time spent handling RPC requests", "endpoint", endpoint)
+
 #define MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, cond) \
     else if((query_info.m_URI == s_pattern) && (cond)) \
     { \
       handled = true; \
+      RPC_METRICS_TIMER(s_pattern); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request&>(req), query_info.m_body); \
@@ -76,6 +102,7 @@
         return true; \
       } \
       uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+      response_info.m_rpc_status = epee::net_utils::http::get_rpc_status(static_cast<command_type::response&>(resp), 0); \
       epee::serialization::store_t_to_json(static_cast<command_type::response&>(resp), response_info.m_body); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_mime_tipe = "application/json"; \
@@ -89,6 +116,7 @@
     else if(query_info.m_URI == s_pattern) \
     { \
       handled = true; \
+      RPC_METRICS_TIMER(s_pattern); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), query_info.m_body); \
@@ -103,11 +131,41 @@
         return true; \
       } \
       uint64_t ticks2 = misc_utils::get_tick_count(); \
-      epee::serialization::store_t_to_binary(static_cast<command_type::response&>(resp), response_info.m_body); \
-      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      response_info.m_rpc_status = epee::net_utils::http::get_rpc_status(static_cast<command_type::response&>(resp), 0); \
+      const std::function<bool(const epee::net_utils::http::body_writer&)> stream = epee::serialization::store_t_to_binary_stream(static_cast<command_type::response&>(resp)); \
+      uint64_t store_ticks = epee::misc_utils::get_tick_count() - ticks2; \
+      /* the rest of the serialization happens as the body is sent, time it there, less the sending */ \
+      response_info.m_body_stream = [=](const epee::net_utils::http::body_writer& writer) \
+      { \
+        uint64_t write_ticks = 0; \
+        const uint64_t stream_ticks = epee::misc_utils::get_tick_count(); \
+        const bool r = stream([&writer, &write_ticks](const void* data, size_t size) \
+        { \
+          const uint64_t t = epee::misc_utils::get_tick_count(); \
+          const bool written = writer(data, size); \
+          write_ticks += epee::misc_utils::get_tick_count() - t; \
+          return written; \
+        }); \
+        uint64_t ticks3 = ticks2 + store_ticks + (epee::misc_utils::get_tick_count() - stream_ticks - write_ticks); \
+        MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
+        return r; \
+      }; \
       response_info.m_mime_tipe = " application/octet-stream"; \
       response_info.m_header_info.m_content_type = " application/octet-stream"; \
-      MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
+    }
+
+#define MAP_URI_TEXT2_IF(s_pattern, callback_f, cond) \
+    else if((query_info.m_URI == s_pattern) && (cond)) \
+    { \
+      handled = true; \
+      if(!callback_f(response_info.m_body)) \
+      { \
+        LOG_ERROR("Failed to " << #callback_f << "()"); \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      response_info.m_mime_tipe = "text/plain; version=0.0.4"; \
     }
 
 #define CHAIN_URI_MAP2(callback) else {callback(query_info, response_info, m_conn_context);handled = true;}
@@ -165,6 +223,7 @@
 
 #define FINALIZE_OBJECTS_TO_JSON(method_name) \
   uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+  response_info.m_rpc_status = epee::net_utils::http::get_rpc_status(resp.result, 0); \
   epee::serialization::store_t_to_json(resp, response_info.m_body); \
   uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
   response_info.m_mime_tipe = "application/json"; \
@@ -174,6 +233,7 @@
 #define MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, cond) \
     else if((callback_name == method_name) && (cond)) \
 { \
+  RPC_METRICS_TIMER(method_name); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
@@ -192,6 +252,7 @@
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
+  RPC_METRICS_TIMER(method_name); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
@@ -208,6 +269,7 @@
 #define MAP_JON_RPC(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
+  RPC_METRICS_TIMER(method_name); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   if(!callback_f(req.params, resp.result)) \
   { \
@@ -67,6 +67,8 @@ namespace epee
 
       m_net_server.get_config_object().m_user = std::move(user);
 
+      m_net_server.get_config_object().m_pworker_pool = &m_worker_pool;
+
       MGINFO("Binding on " << bind_ip << ":" << bind_port);
       bool res = m_net_server.init_server(bind_port, bind_ip);
       if(!res)
@@ -91,8 +93,17 @@ namespace epee
       return true;
     }
 
+    //! Handle requests on `threads_count` worker threads instead of the io threads
+    bool run_workers(size_t threads_count, size_t max_requests_per_client)
+    {
+      if(!threads_count)
+        return true;
+      return m_worker_pool.start(threads_count, max_requests_per_client);
+    }
+
     bool deinit()
     {
+      m_worker_pool.stop();
       return m_net_server.deinit_server();
     }
 
@@ -104,6 +115,7 @@ namespace epee
     bool send_stop_signal()
     {
       m_net_server.send_stop_signal();
+      m_worker_pool.stop();
       return true;
     }
 
@@ -114,5 +126,6 @@ namespace epee
 
   protected:
     net_utils::boosted_tcp_server<net_utils::http::http_custom_handler<t_connection_context> > m_net_server;
+    net_utils::http::http_worker_pool m_worker_pool; //!< after m_net_server, so queued requests are dropped before the connections go
   };
 }
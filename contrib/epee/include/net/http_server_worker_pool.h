@@ -0,0 +1,228 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "misc_log_ex.h"
+
+#undef FONERO_DEFAULT_LOG_CATEGORY
+#define FONERO_DEFAULT_LOG_CATEGORY "net.http"
+
+namespace epee
+{
+namespace net_utils
+{
+	namespace http
+	{
+		//! Expected cost of a request, cheaper requests are executed first
+		enum http_request_priority
+		{
+			http_request_priority_high = 0,   //!< cheap requests, e.g. current height
+			http_request_priority_normal,
+			http_request_priority_low,        //!< heavy requests, e.g. block downloads
+			http_request_priority_count
+		};
+
+		/************************************************************************/
+		/*                                                                      */
+		/************************************************************************/
+		//! Executes http requests outside of the io threads, by priority.
+		/*! Low priority requests never occupy all the workers, so cheap requests
+		are not stuck behind heavy ones. A client may only have a limited number of
+		requests in execution at once; its other requests wait in the queue. The
+		queue is bounded, requests over it are left to the io threads. */
+		class http_worker_pool
+		{
+		public:
+			//! `cancelled` is true if the job is dropped without running (e.g. at stop)
+			typedef std::function<void(bool cancelled)> job_t;
+
+			http_worker_pool(): m_max_per_client(0), m_max_queued(0), m_queued(0), m_running_low(0), m_stop(true)
+			{}
+
+			~http_worker_pool()
+			{
+				stop();
+			}
+
+			http_worker_pool(const http_worker_pool&) = delete;
+			http_worker_pool& operator=(const http_worker_pool&) = delete;
+
+			//! 0 `max_per_client` means unlimited, `max_queued` is the most requests waiting for a worker
+			bool start(size_t threads_count, size_t max_per_client, size_t max_queued = 256)
+			{
+				boost::unique_lock<boost::mutex> lock(m_lock);
+				CHECK_AND_ASSERT_MES(m_threads.empty(), false, "http worker pool already started");
+				m_max_per_client = max_per_client;
+				m_max_queued = max_queued;
+				m_stop = false;
+				for (size_t n = 0; n < threads_count; ++n)
+					m_threads.push_back(boost::thread(&http_worker_pool::run, this));
+				MINFO("Started " << threads_count << " http worker threads");
+				return true;
+			}
+
+			//! Joins the workers, cancelling any queued job.
+			void stop()
+			{
+				std::vector<boost::thread> threads;
+				std::deque<request> cancelled;
+				{
+					boost::unique_lock<boost::mutex> lock(m_lock);
+					m_stop = true;
+					threads.swap(m_threads);
+					for (auto &queue: m_queues)
+					{
+						cancelled.insert(cancelled.end(), queue.begin(), queue.end());
+						queue.clear();
+					}
+					m_queued = 0;
+				}
+				m_has_work.notify_all();
+				for (auto &thread: threads)
+					thread.join();
+				for (auto &r: cancelled)
+					r.job(true);
+			}
+
+			size_t threads_count() const
+			{
+				boost::unique_lock<boost::mutex> lock(m_lock);
+				return m_threads.size();
+			}
+
+			//! \return false if the pool is not running or its queue is full, the caller should then handle the request itself
+			/*! Handling it on an io thread stops that thread from reading more requests meanwhile. */
+			bool dispatch(http_request_priority priority, const std::string& client, job_t job)
+			{
+				{
+					boost::unique_lock<boost::mutex> lock(m_lock);
+					if (m_stop || m_threads.empty() || m_queued >= m_max_queued)
+						return false;
+					m_queues[priority].push_back(request{client, std::move(job)});
+					++m_queued;
+				}
+				m_has_work.notify_one();
+				return true;
+			}
+
+		private:
+			struct request
+			{
+				std::string client;
+				job_t job;
+			};
+
+			//! Requires lock on `m_lock`.
+			bool can_run(const request& r, http_request_priority priority) const
+			{
+				if (priority == http_request_priority_low && m_threads.size() > 1 && m_running_low + 1 >= m_threads.size())
+					return false;
+				if (m_max_per_client)
+				{
+					const auto i = m_running_per_client.find(r.client);
+					if (i != m_running_per_client.end() && i->second >= m_max_per_client)
+						return false;
+				}
+				return true;
+			}
+
+			//! Requires lock on `m_lock`.
+			bool get_next(request& next, http_request_priority& next_priority)
+			{
+				for (size_t p = 0; p < http_request_priority_count; ++p)
+				{
+					std::deque<request> &queue = m_queues[p];
+					for (auto i = queue.begin(); i != queue.end(); ++i)
+					{
+						if (!can_run(*i, (http_request_priority)p))
+							continue;
+						next = std::move(*i);
+						next_priority = (http_request_priority)p;
+						queue.erase(i);
+						--m_queued;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			void run()
+			{
+				boost::unique_lock<boost::mutex> lock(m_lock);
+				while (true)
+				{
+					request next;
+					http_request_priority priority = http_request_priority_normal;
+					m_has_work.wait(lock, [&]{ return m_stop || get_next(next, priority); });
+					if (m_stop)
+						return;
+
+					++m_running_per_client[next.client];
+					if (priority == http_request_priority_low)
+						++m_running_low;
+					lock.unlock();
+
+					try { next.job(false); }
+					catch (const std::exception &e) { MERROR("Exception in http worker: " << e.what()); }
+					catch (...) { MERROR("Exception in http worker"); }
+
+					lock.lock();
+					if (priority == http_request_priority_low)
+						--m_running_low;
+					auto i = m_running_per_client.find(next.client);
+					if (--i->second == 0)
+						m_running_per_client.erase(i);
+					// a job held back by the limits above may be runnable now
+					m_has_work.notify_all();
+				}
+			}
+
+			mutable boost::mutex m_lock;
+			boost::condition_variable m_has_work;
+			std::vector<boost::thread> m_threads;
+			std::deque<request> m_queues[http_request_priority_count];
+			std::map<std::string, size_t> m_running_per_client;
+			size_t m_max_per_client;
+			size_t m_max_queued;
+			size_t m_queued;
+			size_t m_running_low;
+			bool m_stop;
+		};
+	}
+}
+}
@@ -220,6 +220,8 @@ namespace net_utils
     //protect from deletion connection object(with protocol instance) during external call "invoke"
     virtual bool add_ref()=0;
     virtual bool release()=0;
+    //wait until no more than max_bytes are queued to send, false if the connection is gone or the time is out
+    virtual bool wait_send_que(size_t max_bytes, uint64_t timeout_ms) { return true; }
   protected:
     virtual ~i_service_endpoint() noexcept(false) {}
 	};
@@ -29,6 +29,7 @@
 #include "portable_storage_template_helper.h"
 #include <boost/utility/value_init.hpp>
 #include "net/levin_base.h"
+#include "metrics.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "net"
@@ -248,9 +249,11 @@ namespace epee
   if(!is_notify && command_id == command) \
   {handled=true;return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, type_name_in, typename_out>(this, command, in_buff, buff_out, boost::bind(func, this, _1, _2, _3, _4), context);}
 
+#define P2P_METRICS_TIMER(command_name) METRICS_SCOPED_TIMER("p2p_command_seconds", "Time spent handling p2p commands", "command", command_name)
+
 #define HANDLE_INVOKE_T2(COMMAND, func) \
   if(!is_notify && COMMAND::ID == command) \
-  {handled=true;return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename COMMAND::request, typename COMMAND::response>(command, in_buff, buff_out, boost::bind(func, this, _1, _2, _3, _4), context);}
+  {handled=true;P2P_METRICS_TIMER(#COMMAND);return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename COMMAND::request, typename COMMAND::response>(command, in_buff, buff_out, boost::bind(func, this, _1, _2, _3, _4), context);}
 
 
 #define HANDLE_NOTIFY2(command_id, func, type_name_in) \
@@ -259,7 +262,7 @@ namespace epee
 
 #define HANDLE_NOTIFY_T2(NOTIFY, func) \
   if(is_notify && NOTIFY::ID == command) \
-  {handled=true;return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename NOTIFY::request>(this, command, in_buff, boost::bind(func, this, _1, _2, _3), context);}
+  {handled=true;P2P_METRICS_TIMER(#NOTIFY);return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename NOTIFY::request>(this, command, in_buff, boost::bind(func, this, _1, _2, _3), context);}
 
 
 #define CHAIN_INVOKE_MAP2(func) \
@@ -80,6 +80,8 @@ namespace epee
 
       //-------------------------------------------------------------------------------
       bool		store_to_binary(binarybuffer& target);
+      template<class t_stream>
+      bool		store_to_stream(t_stream& strm);
       bool		load_from_binary(const binarybuffer& target);
       template<class trace_policy>
       bool		  dump_as_xml(std::string& targetObj, const std::string& root_name = "");
@@ -132,17 +134,24 @@ namespace epee
     inline
     bool portable_storage::store_to_binary(binarybuffer& target)
     {
-      TRY_ENTRY();
       std::stringstream ss;
+      if(!store_to_stream(ss))
+        return false;
+      target = ss.str();
+      return true;
+    }
+    template<class t_stream>
+    bool portable_storage::store_to_stream(t_stream& strm)
+    {
+      TRY_ENTRY();
       storage_block_header sbh = AUTO_VAL_INIT(sbh);
       sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
       sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
       sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
-      ss.write((const char*)&sbh, sizeof(storage_block_header));
-      pack_entry_to_buff(ss, m_root);
-      target = ss.str();
+      strm.write((const char*)&sbh, sizeof(storage_block_header));
+      pack_entry_to_buff(strm, m_root);
       return true;
-      CATCH_ENTRY("portable_storage::store_to_binary", false)
+      CATCH_ENTRY("portable_storage::store_to_stream", false)
     }
     inline
     bool portable_storage::load_from_binary(const binarybuffer& source)
@@ -26,6 +26,9 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <stdexcept>
 #include <string>
 
 #include "parserse_base_utils.h"
@@ -119,5 +122,29 @@ namespace epee
       store_t_to_binary(str_in, binary_buff, indent);
       return binary_buff;
     }
+    //-----------------------------------------------------------------------------------------------------------
+    typedef std::function<bool(const void* data, size_t size)> binary_writer;
+    //! Collects `str_in` now, the returned function then produces the binary piece by piece into a writer
+    /*! This avoids materializing large responses as one buffer before sending them. */
+    template<class t_struct>
+    std::function<bool(const binary_writer&)> store_t_to_binary_stream(t_struct& str_in)
+    {
+      struct stream_adapter
+      {
+        const binary_writer& writer;
+        void write(const char* data, size_t size)
+        {
+          if(!writer(data, size))
+            throw std::runtime_error("binary stream writer failed");
+        }
+      };
+      std::shared_ptr<portable_storage> ps = std::make_shared<portable_storage>();
+      str_in.store(*ps);
+      return [ps](const binary_writer& writer)
+      {
+        stream_adapter adapter{writer};
+        return ps->store_to_stream(adapter);
+      };
+    }
   }
 }
@@ -0,0 +1,285 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+namespace epee
+{
+namespace metrics
+{
+  namespace
+  {
+    std::atomic<unsigned> next_thread_shard(0);
+    __thread size_t thread_shard = std::numeric_limits<size_t>::max();
+
+    // label values are free text, names are not
+    std::string escape_label_value(const std::string &s)
+    {
+      std::string out;
+      out.reserve(s.size());
+      for (char c: s)
+      {
+        if (c == '\\' || c == '"')
+          out += '\\';
+        if (c == '\n')
+          out += "\\n";
+        else
+          out += c;
+      }
+      return out;
+    }
+
+    std::string format_seconds(uint64_t ns)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.9g", ns / 1e9);
+      return buf;
+    }
+
+    class prometheus_writer: public metrics_visitor
+    {
+    public:
+      virtual void on_counter(const metric_info &info, uint64_t value)
+      {
+        write_header(info, "counter");
+        ss << full_name(info) << labels(info) << " " << value << "\n";
+      }
+
+      virtual void on_gauge(const metric_info &info, int64_t value)
+      {
+        write_header(info, "gauge");
+        ss << full_name(info) << labels(info) << " " << value << "\n";
+      }
+
+      virtual void on_histogram(const metric_info &info, const histogram::snapshot &value)
+      {
+        write_header(info, "histogram");
+        const std::string name = full_name(info);
+        // one exported bucket per power of two, the finer buckets would make scrapes large
+        uint64_t cumulative = value.buckets[0];
+        size_t bucket = 1;
+        for (unsigned exponent = histogram::min_exponent; exponent <= histogram::max_exponent; ++exponent)
+        {
+          const uint64_t le = uint64_t(1) << exponent;
+          if (exponent > histogram::min_exponent)
+          {
+            for (; bucket < histogram::bucket_count - 1 && histogram::get_bucket_upper_bound(bucket) <= le; ++bucket)
+              cumulative += value.buckets[bucket];
+          }
+          ss << name << "_bucket" << labels(info, format_seconds(le)) << " " << cumulative << "\n";
+        }
+        ss << name << "_bucket" << labels(info, "+Inf") << " " << value.count << "\n";
+        ss << name << "_sum" << labels(info) << " " << format_seconds(value.sum_ns) << "\n";
+        ss << name << "_count" << labels(info) << " " << value.count << "\n";
+      }
+
+      std::string str() const { return ss.str(); }
+
+    private:
+      static std::string full_name(const metric_info &info)
+      {
+        return "fonero_" + info.name;
+      }
+
+      static std::string labels(const metric_info &info, const std::string &le = std::string())
+      {
+        std::string out;
+        if (!info.label_name.empty())
+          out += info.label_name + "=\"" + escape_label_value(info.label_value) + "\"";
+        if (!le.empty())
+          out += (out.empty() ? "" : ",") + std::string("le=\"") + le + "\"";
+        return out.empty() ? out : "{" + out + "}";
+      }
+
+      void write_header(const metric_info &info, const char *type)
+      {
+        // metrics are visited by name, so all the labels of a family follow each other
+        if (info.name == last_name)
+          return;
+        last_name = info.name;
+        ss << "# HELP " << full_name(info) << " " << info.help << "\n";
+        ss << "# TYPE " << full_name(info) << " " << type << "\n";
+      }
+
+      std::stringstream ss;
+      std::string last_name;
+    };
+  }
+
+  size_t get_thread_shard()
+  {
+    if (thread_shard == std::numeric_limits<size_t>::max())
+      thread_shard = next_thread_shard++ % shard_count;
+    return thread_shard;
+  }
+
+  counter::counter()
+  {
+    for (shard &s: m_shards)
+      s.value.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t counter::get() const
+  {
+    uint64_t value = 0;
+    for (const shard &s: m_shards)
+      value += s.value.load(std::memory_order_relaxed);
+    return value;
+  }
+
+  histogram::histogram(): m_shards(new shard[shard_count])
+  {
+    for (size_t n = 0; n < shard_count; ++n)
+    {
+      for (auto &b: m_shards[n].buckets)
+        b.store(0, std::memory_order_relaxed);
+      m_shards[n].sum_ns.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  histogram::snapshot histogram::get() const
+  {
+    snapshot res;
+    res.buckets.resize(bucket_count, 0);
+    res.count = 0;
+    res.sum_ns = 0;
+    for (size_t n = 0; n < shard_count; ++n)
+    {
+      for (size_t b = 0; b < bucket_count; ++b)
+      {
+        const uint64_t count = m_shards[n].buckets[b].load(std::memory_order_relaxed);
+        res.buckets[b] += count;
+        res.count += count;
+      }
+      res.sum_ns += m_shards[n].sum_ns.load(std::memory_order_relaxed);
+    }
+    return res;
+  }
+
+  uint64_t histogram::get_bucket_upper_bound(size_t bucket)
+  {
+    if (bucket == 0)
+      return uint64_t(1) << min_exponent;
+    if (bucket >= bucket_count - 1)
+      return std::numeric_limits<uint64_t>::max();
+    const unsigned exponent = min_exponent + ((bucket - 1) >> sub_bucket_bits);
+    const uint64_t sub_bucket = (bucket - 1) & ((1 << sub_bucket_bits) - 1);
+    const uint64_t width = uint64_t(1) << (exponent - sub_bucket_bits);
+    return (uint64_t(1) << exponent) + (sub_bucket + 1) * width;
+  }
+
+  uint64_t histogram::snapshot::quantile(double q) const
+  {
+    if (count == 0)
+      return 0;
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * count));
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < buckets.size(); ++b)
+    {
+      cumulative += buckets[b];
+      if (cumulative >= rank)
+        return get_bucket_upper_bound(b);
+    }
+    return get_bucket_upper_bound(buckets.size() - 1);
+  }
+
+  registry& registry::instance()
+  {
+    static registry r;
+    return r;
+  }
+
+  registry::entry& registry::get_entry(const std::string &name, const std::string &help, const std::string &label_name, const std::string &label_value, metric_type type)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const std::string key = name + '\0' + label_name + '\0' + label_value;
+    auto i = m_entries.find(key);
+    if (i != m_entries.end())
+    {
+      CHECK_AND_ASSERT_THROW_MES(i->second.info.type == type, "Metric " << name << " registered with different types");
+      return i->second;
+    }
+    entry &e = m_entries[key];
+    e.info.name = name;
+    e.info.help = help;
+    e.info.label_name = label_name;
+    e.info.label_value = label_value;
+    e.info.type = type;
+    switch (type)
+    {
+      case metric_counter: e.c.reset(new counter()); break;
+      case metric_gauge: e.g.reset(new gauge()); break;
+      case metric_histogram: e.h.reset(new histogram()); break;
+    }
+    return e;
+  }
+
+  counter& registry::get_counter(const std::string &name, const std::string &help, const std::string &label_name, const std::string &label_value)
+  {
+    return *get_entry(name, help, label_name, label_value, metric_counter).c;
+  }
+
+  gauge& registry::get_gauge(const std::string &name, const std::string &help, const std::string &label_name, const std::string &label_value)
+  {
+    return *get_entry(name, help, label_name, label_value, metric_gauge).g;
+  }
+
+  histogram& registry::get_histogram(const std::string &name, const std::string &help, const std::string &label_name, const std::string &label_value)
+  {
+    return *get_entry(name, help, label_name, label_value, metric_histogram).h;
+  }
+
+  void registry::visit(metrics_visitor &visitor) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for (const auto &i: m_entries)
+    {
+      const entry &e = i.second;
+      switch (e.info.type)
+      {
+        case metric_counter: visitor.on_counter(e.info, e.c->get()); break;
+        case metric_gauge: visitor.on_gauge(e.info, e.g->get()); break;
+        case metric_histogram: visitor.on_histogram(e.info, e.h->get()); break;
+      }
+    }
+  }
+
+  std::string registry::get_prometheus_text() const
+  {
+    prometheus_writer writer;
+    visit(writer);
+    return writer.str();
+  }
+}
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "blob_codec.h"
+
+#include <cstring>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace
+{
+  // the raw size is needed to decompress, it follows the codec byte
+  const size_t LZ4_HEADER_SIZE = 1 + sizeof(uint32_t);
+  // far above any block or tx, a bigger one means a corrupt blob
+  const uint32_t MAX_DECODED_SIZE = 256 * 1024 * 1024;
+
+  void encode_raw(const char *data, size_t size, std::string &encoded)
+  {
+    encoded.resize(1 + size);
+    encoded[0] = (char)cryptonote::blob_codec_none;
+    if (size)
+      memcpy(&encoded[1], data, size);
+  }
+}
+
+namespace cryptonote
+{
+
+const char *blob_codec_name(blob_codec_t codec)
+{
+  switch (codec)
+  {
+    case blob_codec_none: return "none";
+    case blob_codec_lz4: return "lz4";
+    default: return "unknown";
+  }
+}
+
+bool blob_codec_from_name(const std::string &name, blob_codec_t &codec)
+{
+  if (name == "none")
+    codec = blob_codec_none;
+  else if (name == "lz4")
+    codec = blob_codec_lz4;
+  else
+    return false;
+  return true;
+}
+
+bool blob_codec_supported(blob_codec_t codec)
+{
+  switch (codec)
+  {
+    case blob_codec_none: return true;
+#ifdef HAVE_LZ4
+    case blob_codec_lz4: return true;
+#endif
+    default: return false;
+  }
+}
+
+void blob_encode(blob_codec_t codec, const char *data, size_t size, std::string &encoded)
+{
+#ifdef HAVE_LZ4
+  if (codec == blob_codec_lz4 && size > 0 && size < MAX_DECODED_SIZE)
+  {
+    const int bound = LZ4_compressBound(size);
+    encoded.resize(LZ4_HEADER_SIZE + bound);
+    const int compressed_size = LZ4_compress_default(data, &encoded[LZ4_HEADER_SIZE], size, bound);
+    if (compressed_size > 0 && LZ4_HEADER_SIZE + compressed_size < 1 + size)
+    {
+      const uint32_t raw_size = size;
+      encoded[0] = (char)blob_codec_lz4;
+      for (size_t n = 0; n < sizeof(raw_size); ++n)
+        encoded[1 + n] = (char)(raw_size >> (8 * n));
+      encoded.resize(LZ4_HEADER_SIZE + compressed_size);
+      return;
+    }
+  }
+#endif
+  encode_raw(data, size, encoded);
+}
+
+bool blob_decode(const char *data, size_t size, std::string &decoded)
+{
+  if (size < 1)
+    return false;
+  switch ((blob_codec_t)data[0])
+  {
+    case blob_codec_none:
+      decoded.assign(data + 1, size - 1);
+      return true;
+#ifdef HAVE_LZ4
+    case blob_codec_lz4:
+    {
+      if (size < LZ4_HEADER_SIZE)
+        return false;
+      uint32_t raw_size = 0;
+      for (size_t n = 0; n < sizeof(raw_size); ++n)
+        raw_size |= (uint32_t)(uint8_t)data[1 + n] << (8 * n);
+      if (raw_size > MAX_DECODED_SIZE)
+        return false;
+      decoded.resize(raw_size);
+      const int result = LZ4_decompress_safe(data + LZ4_HEADER_SIZE, &decoded[0], size - LZ4_HEADER_SIZE, raw_size);
+      return result >= 0 && (uint32_t)result == raw_size;
+    }
+#endif
+    default:
+      return false;
+  }
+}
+
+}  // namespace cryptonote
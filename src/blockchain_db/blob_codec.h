@@ -0,0 +1,90 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cryptonote
+{
+
+/**
+ * @brief compression codecs for the blobs stored in the database
+ *
+ * An encoded blob starts with its codec, so a database may hold blobs
+ * encoded with different codecs. Blobs which don't compress are kept
+ * with blob_codec_none.
+ */
+enum blob_codec_t : uint8_t
+{
+  blob_codec_none = 0,
+  blob_codec_lz4 = 1,
+};
+
+/**
+ * @brief gets the name of a codec, as given on the command line
+ */
+const char *blob_codec_name(blob_codec_t codec);
+
+/**
+ * @brief gets a codec from its name
+ *
+ * @return false if there is no codec with that name
+ */
+bool blob_codec_from_name(const std::string &name, blob_codec_t &codec);
+
+/**
+ * @brief checks whether this build can encode and decode with a codec
+ */
+bool blob_codec_supported(blob_codec_t codec);
+
+/**
+ * @brief encodes a blob with a codec
+ *
+ * @param codec the codec to compress with
+ * @param data the blob
+ * @param size the blob size
+ * @param encoded return-by-reference the encoded blob
+ */
+void blob_encode(blob_codec_t codec, const char *data, size_t size, std::string &encoded);
+
+/**
+ * @brief decodes a blob made by blob_encode
+ *
+ * @param data the encoded blob
+ * @param size the encoded blob size
+ * @param decoded return-by-reference the blob
+ *
+ * @return false if the blob is corrupt or its codec is not supported
+ */
+bool blob_decode(const char *data, size_t size, std::string &decoded);
+
+}  // namespace cryptonote
@@ -738,6 +738,28 @@ public:
   virtual void block_txn_stop() = 0;
   virtual void block_txn_abort() = 0;
 
+  /**
+   * @brief pins a read transaction to the calling thread
+   *
+   * Until the matching end_read_session(), reads from this thread reuse the
+   * same read transaction and cursors instead of setting them up on each
+   * call, and see the same snapshot of the DB. Sessions may be nested.
+   *
+   * Meant for the scope of a request doing many reads, see db_read_session.
+   * Writes should not be made from the thread while a session is open.
+   *
+   * A map resize waits for open sessions to end, so sessions should only be
+   * opened with the blockchain lock held, as the writer that resizes holds it.
+   *
+   * The default is a no-op, for backends without read transactions.
+   */
+  virtual void start_read_session() const {}
+
+  /**
+   * @brief ends a read session started with start_read_session()
+   */
+  virtual void end_read_session() const {}
+
   virtual void set_hard_fork(HardFork* hf);
 
   // adds a block with the given metadata to the top of the blockchain, returns the new height
@@ -1088,6 +1110,22 @@ public:
    */
   virtual bool get_tx(const crypto::hash& h, transaction &tx) const;
 
+  /**
+   * @brief fetches the transaction with the given hash, without its prunable data
+   *
+   * Only the prefix and the base of the ringct signatures are filled in,
+   * which is all that is needed to look at the outputs, unlock time or
+   * extra of a transaction, but not to verify it.
+   *
+   * If the transaction does not exist, the subclass should return false.
+   *
+   * @param h the hash to look for
+   * @param tx return-by-reference the pruned transaction
+   *
+   * @return true iff the transaction was found
+   */
+  virtual bool get_pruned_tx(const crypto::hash& h, transaction &tx) const;
+
   /**
    * @brief fetches the transaction blob with the given hash
    *
@@ -1102,6 +1140,74 @@ public:
    */
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
 
+  /**
+   * @brief fetches the pruned transaction blob with the given hash
+   *
+   * The pruned blob holds the transaction prefix and the base of the ringct
+   * signatures, it can be parsed with parse_and_validate_tx_base_from_blob.
+   * Appending the prunable blob to it gives back the full transaction blob.
+   *
+   * If the transaction does not exist, the subclass should return false.
+   *
+   * @param h the hash to look for
+   * @param tx return-by-reference the pruned blob
+   *
+   * @return true iff the transaction was found
+   */
+  virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
+
+  /**
+   * @brief fetches the prunable part of the transaction blob with the given hash
+   *
+   * The prunable blob holds the signatures and range proofs, which are only
+   * needed to verify the transaction (or to relay it to a peer).
+   *
+   * If the transaction does not exist, the subclass should return false.
+   *
+   * @param h the hash to look for
+   * @param tx return-by-reference the prunable blob
+   *
+   * @return true iff the transaction was found
+   */
+  virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
+
+  /**
+   * @brief fetches the hash of the prunable data of the transaction with the given hash
+   *
+   * This is still available once the prunable data itself has been pruned,
+   * so the transaction hash can be computed from the pruned blob.
+   *
+   * If the transaction does not exist, the subclass should return false.
+   *
+   * @param h the hash to look for
+   * @param prunable_hash return-by-reference the hash of the prunable data
+   *
+   * @return true iff the transaction was found
+   */
+  virtual bool get_prunable_tx_hash(const crypto::hash& h, crypto::hash &prunable_hash) const = 0;
+
+  /**
+   * @brief drops the prunable data of all the transactions below a height
+   *
+   * Outputs, key images and the pruned transaction blobs are kept, as is
+   * the hash of the prunable data. Transactions below the pruned height can
+   * then no longer be fetched in full.
+   *
+   * This must not be called while a batch transaction is active.
+   *
+   * @param height the height of the first block to keep whole
+   *
+   * @return the number of transactions pruned
+   */
+  virtual uint64_t prune(uint64_t height) = 0;
+
+  /**
+   * @brief gets the height below which transactions have been pruned
+   *
+   * @return the pruned height, 0 if the blockchain was never pruned
+   */
+  virtual uint64_t get_pruned_height() const = 0;
+
   /**
    * @brief fetches the total number of transactions ever
    *
@@ -1475,6 +1581,57 @@ public:
    */
   virtual std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff) const = 0;
 
+  /**
+   * @brief gets the cumulative number of outputs of an amount per block
+   *
+   * The nth element of the distribution is the number of outputs of that
+   * amount in the blocks up to and including from_height + n.
+   *
+   * @param amount the output amount, 0 for RCT outputs
+   * @param from_height the first block height
+   * @param to_height the last block height, included
+   * @param distribution return-by-reference the cumulative output counts
+   *
+   * @return false if the range is not in the blockchain, otherwise true
+   */
+  virtual bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution) const = 0;
+
+  /**
+   * @brief looks up the proof-of-work hash of a block in the PoW cache
+   *
+   * The cache keeps the PoW hashes of recent main chain and alternative
+   * blocks, so blocks seen again after a reorg or a restart need not be
+   * hashed again. It is not part of the blockchain proper.
+   *
+   * @param id the block hash
+   * @param hf_version the hard fork version the PoW hash was computed for
+   * @param pow return-by-reference the PoW hash
+   *
+   * @return true if the block was found in the cache, otherwise false
+   */
+  virtual bool get_block_pow_hash(const crypto::hash &id, uint8_t hf_version, crypto::hash &pow) const = 0;
+
+  /**
+   * @brief adds the proof-of-work hash of a block to the PoW cache
+   *
+   * Replaces any previous entry for that block.
+   *
+   * @param id the block hash
+   * @param height the height of the block, used to prune the cache
+   * @param hf_version the hard fork version the PoW hash was computed for
+   * @param pow the PoW hash
+   */
+  virtual void add_block_pow_hash(const crypto::hash &id, uint64_t height, uint8_t hf_version, const crypto::hash &pow) = 0;
+
+  /**
+   * @brief removes the PoW cache entries of blocks below a height
+   *
+   * @param height the lowest block height to keep
+   *
+   * @return the number of entries removed
+   */
+  virtual uint64_t prune_block_pow_hashes(uint64_t height) = 0;
+
   /**
    * @brief is BlockchainDB in read-only mode?
    *
@@ -1497,6 +1654,19 @@ public:
 
 };  // class BlockchainDB
 
+/**
+ * @brief keeps a BlockchainDB read session open for its lifetime
+ */
+class db_read_session
+{
+public:
+  db_read_session(const BlockchainDB &db): m_db(db) { m_db.start_read_session(); }
+  ~db_read_session() { try { m_db.end_read_session(); } catch (...) { /* ignore */ } }
+
+private:
+  const BlockchainDB &m_db;
+};
+
 BlockchainDB *new_db(const std::string& db_type);
 
 }  // namespace cryptonote
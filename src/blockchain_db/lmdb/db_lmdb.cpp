@@ -39,6 +39,8 @@
 #include "crypto/crypto.h"
 #include "profile_tools.h"
 #include "ringct/rctOps.h"
+#include "metrics.h"
+#include "common/trace.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "blockchain.db.lmdb"
@@ -52,7 +54,9 @@ using epee::string_tools::pod_to_hex;
 
 // Increase when the DB changes in a non backward compatible way, and there
 // is no automatic conversion, so that a full resync is needed.
-#define VERSION 1
+#define VERSION 3
+
+#define DB_METRICS_TIMER(op) METRICS_SCOPED_TIMER("db_seconds", "Time spent in blockchain database operations", "op", op)
 
 namespace
 {
@@ -162,18 +166,23 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * block_heights    block hash   block height
  * block_info       block ID     {block metadata}
  *
- * txs              txn ID       txn blob
+ * txs_pruned       txn ID       pruned txn blob
+ * txs_prunable     txn ID       prunable txn blob
+ * txs_prunable_hash txn ID      prunable txn blob hash
  * tx_indices       txn hash     {txn ID, metadata}
  * tx_outputs       txn ID       [txn amount output indices]
  *
  * output_txs       output ID    {txn hash, local index}
  * output_amounts   amount       [{amount output index, metadata}...]
+ * output_amount_counts amount   [{block height, cumulative output count}...]
  *
  * spent_keys       input hash   -
  *
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * pow_cache        block hash   {block height, hf version, PoW hash}
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -181,17 +190,42 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * (DUPFIXED saves 8 bytes per record.)
  *
  * The output_amounts table doesn't use a dummy key, but uses DUPSORT.
+ * Neither does output_amount_counts, which has one record per amount and
+ * block with outputs of that amount, so the number of outputs of an amount
+ * up to a given height is a single lookup. RCT outputs are all amount 0.
+ *
+ * A txn blob is split in two: the pruned blob is the txn prefix and the
+ * base of the ringct signatures, the prunable blob is the rest (MLSAGs and
+ * range proofs). Their concatenation is the full txn blob. Most readers
+ * only need the outputs, unlock time or extra, and don't page in the
+ * prunable data. Before version 2 the whole blob was kept in "txs".
+ * prune() drops the prunable blobs below a height, keeping their hash in
+ * txs_prunable_hash; the "pruned_height" property records that height.
+ *
+ * If the "blob_codec" property is set, the blocks, txs_pruned and
+ * txs_prunable blobs are stored with blob_encode (a codec byte, then the
+ * maybe compressed blob), else raw. set_blob_codec converts them, keeping
+ * its progress in "blob_codec_target" and "blob_codec_progress".
+ *
+ * pow_cache is not part of the blockchain: it keeps the PoW hashes of
+ * recent main chain and alternative blocks, so they are not computed again
+ * after a reorg or a restart. Its user prunes it by height. It is created
+ * on the first read/write open, and considered empty when read-only.
  */
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
 const char* const LMDB_BLOCK_INFO = "block_info";
 
 const char* const LMDB_TXS = "txs";
+const char* const LMDB_TXS_PRUNED = "txs_pruned";
+const char* const LMDB_TXS_PRUNABLE = "txs_prunable";
+const char* const LMDB_TXS_PRUNABLE_HASH = "txs_prunable_hash";
 const char* const LMDB_TX_INDICES = "tx_indices";
 const char* const LMDB_TX_OUTPUTS = "tx_outputs";
 
 const char* const LMDB_OUTPUT_TXS = "output_txs";
 const char* const LMDB_OUTPUT_AMOUNTS = "output_amounts";
+const char* const LMDB_OUTPUT_AMOUNT_COUNTS = "output_amount_counts";
 const char* const LMDB_SPENT_KEYS = "spent_keys";
 
 const char* const LMDB_TXPOOL_META = "txpool_meta";
@@ -200,6 +234,8 @@ const char* const LMDB_TXPOOL_BLOB = "txpool_blob";
 const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 
+const char* const LMDB_POW_CACHE = "pow_cache";
+
 const char* const LMDB_PROPERTIES = "properties";
 
 const char zerokey[8] = {0};
@@ -211,6 +247,25 @@ const std::string lmdb_error(const std::string& error_string, int mdb_res)
   return full_string;
 }
 
+// the pruned blob is what serialize_base reads, the rest of the blob is prunable.
+// A blob we can't parse is kept whole in txs_pruned.
+size_t get_pruned_tx_blob_size(const cryptonote::blobdata &bd)
+{
+  std::stringstream ss;
+  ss << bd;
+  binary_archive<false> ba(ss);
+  cryptonote::transaction tx;
+  if (!tx.serialize_base(ba) || !ss.good())
+  {
+    MWARNING("Failed to parse tx base from blob, not splitting off its prunable data");
+    return bd.size();
+  }
+  const std::streamoff pruned_size = ss.tellg();
+  if (pruned_size < 0 || (uint64_t)pruned_size > bd.size())
+    return bd.size();
+  return pruned_size;
+}
+
 inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi, const std::string& error_string)
 {
   if (auto res = mdb_dbi_open(txn, name, flags, &dbi))
@@ -254,6 +309,13 @@ typedef struct mdb_block_info
   crypto::hash bi_hash;
 } mdb_block_info;
 
+typedef struct pow_cache_entry
+{
+  uint64_t height;
+  uint64_t hf_version; // a uint8_t really, padded for alignment
+  crypto::hash pow;
+} pow_cache_entry;
+
 typedef struct blk_height {
     crypto::hash bh_hash;
     uint64_t bh_height;
@@ -276,6 +338,11 @@ typedef struct outkey {
     output_data_t data;
 } outkey;
 
+typedef struct amount_count {
+    uint64_t height;
+    uint64_t count; // outputs of that amount in the blocks up to and including height
+} amount_count;
+
 typedef struct outtx {
     uint64_t output_id;
     crypto::hash tx_hash;
@@ -385,6 +452,21 @@ void mdb_txn_safe::allow_new_txns()
   creation_gate.clear();
 }
 
+void mdb_txn_safe::increment_txns(int i)
+{
+  if (i > 0)
+  {
+    while (creation_gate.test_and_set());
+    num_active_txns += i;
+    creation_gate.clear();
+  }
+  else
+  {
+    // must not wait on the gate, a resize may be waiting for this
+    num_active_txns -= -i;
+  }
+}
+
 void lmdb_resized(MDB_env *env)
 {
   mdb_txn_safe::prevent_new_txns();
@@ -478,7 +560,8 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   {
     if (m_batch_active)
     {
-      throw0(DB_ERROR("lmdb resizing not yet supported when batch transactions enabled!"));
+      // batch_resize() commits the batch txn before resizing
+      throw0(DB_ERROR("attempting resize with batch transaction in progress, use batch_resize()"));
     }
     else
     {
@@ -581,6 +664,90 @@ void BlockchainLMDB::check_and_resize_for_batch(uint64_t batch_num_blocks)
   }
 }
 
+// threshold_size is the size about to be added to the batch txn
+bool BlockchainLMDB::batch_need_resize(uint64_t threshold_size) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+#if defined(ENABLE_AUTO_RESIZE)
+  // headroom for pages copied on write and the free list, which are not
+  // accounted for in the block size estimates
+  const uint64_t margin = 64 * (1 << 20);
+
+  MDB_envinfo mei;
+
+  mdb_env_info(m_env, &mei);
+
+  MDB_stat mst;
+
+  mdb_env_stat(m_env, &mst);
+
+  // me_last_pgno only covers committed data, so add what the batch txn has
+  // written since its last commit
+  uint64_t size_used = mst.ms_psize * mei.me_last_pgno + m_batch_size;
+  return size_used + threshold_size + margin > mei.me_mapsize;
+#else
+  return false;
+#endif
+}
+
+// The map can't be resized while a write txn is live, and a txn which hit
+// MDB_MAP_FULL can only be aborted. So commit what the batch has written so
+// far, grow the map for the rest of the batch, and carry on in a new batch txn.
+// Blocks added so far are durable from this point, batch_abort() pops them
+// off again so the batch stays all or nothing.
+void BlockchainLMDB::batch_resize()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const uint64_t min_increase_size = 512 * (1 << 20);
+
+  MGINFO("[batch] DB resize needed, committing " << m_batch_blocks << " blocks first");
+  TIME_MEASURE_START(time1);
+  try
+  {
+    m_write_txn->commit();
+  }
+  catch (const std::exception &e)
+  {
+    cleanup_batch();
+    throw;
+  }
+  TIME_MEASURE_FINISH(time1);
+  time_commit1 += time1;
+
+  m_write_txn = nullptr;
+  delete m_write_batch_txn;
+  m_write_batch_txn = nullptr;
+  memset(&m_wcursors, 0, sizeof(m_wcursors));
+  m_batch_committed_blocks += m_batch_blocks;
+
+  uint64_t blocks_left = m_batch_num_blocks > m_batch_blocks ? m_batch_num_blocks - m_batch_blocks : 0;
+  uint64_t increase_size = get_estimated_batch_size(blocks_left);
+  try
+  {
+    do_resize(increase_size > min_increase_size ? increase_size : min_increase_size);
+    batch_txn_begin();
+  }
+  catch (const std::exception &e)
+  {
+    m_batch_active = false;
+    m_batch_committed_blocks = 0;
+    throw;
+  }
+  m_batch_num_blocks = blocks_left;
+  m_batch_blocks = 0;
+}
+
+// estimate of the db size taken by a block, see get_estimated_batch_size()
+uint64_t BlockchainLMDB::get_estimated_block_size(uint64_t block_size) const
+{
+  const float batch_safety_factor = 1.7f;
+  const float db_expand_factor = 4.5f;
+  const uint64_t min_block_size = 4 * 1024;
+  if (block_size < min_block_size)
+    block_size = min_block_size;
+  return block_size * db_expand_factor * batch_safety_factor;
+}
+
 uint64_t BlockchainLMDB::get_estimated_batch_size(uint64_t batch_num_blocks) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -684,7 +851,9 @@ void BlockchainLMDB::add_block(const block& blk, const size_t& block_size, const
   CURSOR(block_info)
 
   // this call to mdb_cursor_put will change height()
-  MDB_val_copy<blobdata> blob(block_to_blob(blk));
+  const blobdata block_blob = block_to_blob(blk);
+  std::string encoded;
+  MDB_val blob = encode_blob(block_blob.data(), block_blob.size(), encoded);
   result = mdb_cursor_put(m_cur_blocks, &key, &blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block blob to db transaction: ", result).c_str()));
@@ -759,7 +928,8 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   int result;
   uint64_t tx_id = get_tx_count();
 
-  CURSOR(txs)
+  CURSOR(txs_pruned)
+  CURSOR(txs_prunable)
   CURSOR(tx_indices)
 
   MDB_val_set(val_tx_id, tx_id);
@@ -785,10 +955,18 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add tx data to db transaction: ", result).c_str()));
 
-  MDB_val_copy<blobdata> blob(tx_to_blob(tx));
-  result = mdb_cursor_put(m_cur_txs, &val_tx_id, &blob, MDB_APPEND);
+  const blobdata blob = tx_to_blob(tx);
+  const size_t pruned_size = get_pruned_tx_blob_size(blob);
+  std::string encoded;
+  MDB_val pruned_blob = encode_blob(blob.data(), pruned_size, encoded);
+  result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
+
+  MDB_val prunable_blob = encode_blob(blob.data() + pruned_size, blob.size() - pruned_size, encoded);
+  result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
-    throw0(DB_ERROR(lmdb_error("Failed to add tx blob to db transaction: ", result).c_str()));
+    throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
 
   return tx_id;
 }
@@ -804,7 +982,9 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
 
   mdb_txn_cursors *m_cursors = &m_wcursors;
   CURSOR(tx_indices)
-  CURSOR(txs)
+  CURSOR(txs_pruned)
+  CURSOR(txs_prunable)
+  CURSOR(txs_prunable_hash)
   CURSOR(tx_outputs)
 
   MDB_val_set(val_h, tx_hash);
@@ -814,11 +994,24 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
 
-  if ((result = mdb_cursor_get(m_cur_txs, &val_tx_id, NULL, MDB_SET)))
-      throw1(DB_ERROR(lmdb_error("Failed to locate tx for removal: ", result).c_str()));
-  result = mdb_cursor_del(m_cur_txs, 0);
+  if ((result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, NULL, MDB_SET)))
+      throw1(DB_ERROR(lmdb_error("Failed to locate pruned tx for removal: ", result).c_str()));
+  result = mdb_cursor_del(m_cur_txs_pruned, 0);
+  if (result)
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of pruned tx to db transaction: ", result).c_str()));
+
+  // a pruned tx only has the hash of its prunable data left
+  MDB_cursor *cur_prunable = m_cur_txs_prunable;
+  if ((result = mdb_cursor_get(cur_prunable, &val_tx_id, NULL, MDB_SET)) == MDB_NOTFOUND)
+  {
+    cur_prunable = m_cur_txs_prunable_hash;
+    result = mdb_cursor_get(cur_prunable, &val_tx_id, NULL, MDB_SET);
+  }
+  if (result)
+      throw1(DB_ERROR(lmdb_error("Failed to locate prunable tx for removal: ", result).c_str()));
+  result = mdb_cursor_del(cur_prunable, 0);
   if (result)
-      throw1(DB_ERROR(lmdb_error("Failed to add removal of tx to db transaction: ", result).c_str()));
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of prunable tx to db transaction: ", result).c_str()));
 
   remove_tx_outputs(tip->data.tx_id, tx);
 
@@ -902,9 +1095,109 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
       throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to db transaction: ", result).c_str()));
 
+  add_output_amount_count(tx_output.amount, m_height, ok.amount_index + 1);
+
   return ok.amount_index;
 }
 
+void BlockchainLMDB::add_output_amount_count(const uint64_t amount, const uint64_t height, const uint64_t count)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(output_amount_counts)
+
+  // outputs are added in chain order, so the record for this height, if any, is the last one
+  MDB_val_copy<uint64_t> val_amount(amount);
+  MDB_val v;
+  int result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_SET);
+  if (!result)
+    result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_LAST_DUP);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to get output amount count: ", result).c_str()));
+
+  amount_count ac = {height, count};
+  MDB_val_set(vac, ac);
+  if (!result && ((const amount_count*)v.mv_data)->height == height)
+    result = mdb_cursor_put(m_cur_output_amount_counts, &val_amount, &vac, MDB_CURRENT);
+  else
+    result = mdb_cursor_put(m_cur_output_amount_counts, &val_amount, &vac, MDB_APPENDDUP);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add output amount count to db transaction: ", result).c_str()));
+}
+
+void BlockchainLMDB::remove_output_amount_count(const uint64_t amount)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(output_amount_counts)
+
+  // outputs are removed in reverse chain order, from the last record
+  MDB_val_copy<uint64_t> val_amount(amount);
+  MDB_val v;
+  int result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_SET);
+  if (!result)
+    result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_LAST_DUP);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get output amount count: ", result).c_str()));
+  amount_count ac = *(const amount_count*)v.mv_data;
+
+  // the record goes away with the last output of its height
+  uint64_t previous_count = 0;
+  result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_PREV_DUP);
+  if (!result)
+  {
+    previous_count = ((const amount_count*)v.mv_data)->count;
+    result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_NEXT_DUP);
+  }
+  else if (result == MDB_NOTFOUND)
+  {
+    result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_SET);
+    if (!result)
+      result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_LAST_DUP);
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get output amount count: ", result).c_str()));
+
+  if (--ac.count == previous_count)
+  {
+    result = mdb_cursor_del(m_cur_output_amount_counts, 0);
+  }
+  else
+  {
+    MDB_val_set(vac, ac);
+    result = mdb_cursor_put(m_cur_output_amount_counts, &val_amount, &vac, MDB_CURRENT);
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to remove output amount count from db transaction: ", result).c_str()));
+}
+
+uint64_t BlockchainLMDB::get_output_amount_count(MDB_cursor *cur_output_amount_counts, const uint64_t amount, const uint64_t height) const
+{
+  // the last record at or below height is wanted, GET_BOTH_RANGE finds the first one at or above it
+  MDB_val_copy<uint64_t> val_amount(amount);
+  amount_count ac = {height, 0};
+  MDB_val_set(v, ac);
+  int result = mdb_cursor_get(cur_output_amount_counts, &val_amount, &v, MDB_GET_BOTH_RANGE);
+  if (result == MDB_NOTFOUND)
+  {
+    // nothing at or above height, the last record (if any) is the one
+    result = mdb_cursor_get(cur_output_amount_counts, &val_amount, &v, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      return 0;
+    if (!result)
+      result = mdb_cursor_get(cur_output_amount_counts, &val_amount, &v, MDB_LAST_DUP);
+  }
+  else if (!result && ((const amount_count*)v.mv_data)->height > height)
+  {
+    result = mdb_cursor_get(cur_output_amount_counts, &val_amount, &v, MDB_PREV_DUP);
+    if (result == MDB_NOTFOUND)
+      return 0;
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get output amount count: ", result).c_str()));
+  return ((const amount_count*)v.mv_data)->count;
+}
+
 void BlockchainLMDB::add_tx_amount_output_indices(const uint64_t tx_id,
     const std::vector<uint64_t>& amount_output_indices)
 {
@@ -986,6 +1279,8 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   result = mdb_cursor_del(m_cur_output_amounts, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting amount for output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
+
+  remove_output_amount_count(amount);
 }
 
 void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
@@ -1078,8 +1373,14 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions)
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_batch_num_blocks = 0;
+  m_batch_blocks = 0;
+  m_batch_committed_blocks = 0;
+  m_batch_size = 0;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_tagged_blobs = false;
+  m_blob_codec = blob_codec_none;
 
   m_hardfork = nullptr;
 }
@@ -1174,11 +1475,15 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_BLOCK_HEIGHTS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_heights, "Failed to open db handle for m_block_heights");
 
   lmdb_db_open(txn, LMDB_TXS, MDB_INTEGERKEY | MDB_CREATE, m_txs, "Failed to open db handle for m_txs");
+  lmdb_db_open(txn, LMDB_TXS_PRUNED, MDB_INTEGERKEY | MDB_CREATE, m_txs_pruned, "Failed to open db handle for m_txs_pruned");
+  lmdb_db_open(txn, LMDB_TXS_PRUNABLE, MDB_INTEGERKEY | MDB_CREATE, m_txs_prunable, "Failed to open db handle for m_txs_prunable");
+  lmdb_db_open(txn, LMDB_TXS_PRUNABLE_HASH, MDB_INTEGERKEY | MDB_CREATE, m_txs_prunable_hash, "Failed to open db handle for m_txs_prunable_hash");
   lmdb_db_open(txn, LMDB_TX_INDICES, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_tx_indices, "Failed to open db handle for m_tx_indices");
   lmdb_db_open(txn, LMDB_TX_OUTPUTS, MDB_INTEGERKEY | MDB_CREATE, m_tx_outputs, "Failed to open db handle for m_tx_outputs");
 
   lmdb_db_open(txn, LMDB_OUTPUT_TXS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_output_txs, "Failed to open db handle for m_output_txs");
   lmdb_db_open(txn, LMDB_OUTPUT_AMOUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_amounts, "Failed to open db handle for m_output_amounts");
+  lmdb_db_open(txn, LMDB_OUTPUT_AMOUNT_COUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_amount_counts, "Failed to open db handle for m_output_amount_counts");
 
   lmdb_db_open(txn, LMDB_SPENT_KEYS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_keys, "Failed to open db handle for m_spent_keys");
 
@@ -1193,17 +1498,24 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   lmdb_db_open(txn, LMDB_HF_VERSIONS, MDB_INTEGERKEY | MDB_CREATE, m_hf_versions, "Failed to open db handle for m_hf_versions");
 
+  // a cache, added after version 3 without a migration, so as above
+  if (!(mdb_flags & MDB_RDONLY))
+    lmdb_db_open(txn, LMDB_POW_CACHE, MDB_CREATE, m_pow_cache, "Failed to open db handle for m_pow_cache");
+
   lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
   mdb_set_dupsort(txn, m_block_heights, compare_hash32);
   mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
   mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
+  mdb_set_dupsort(txn, m_output_amount_counts, compare_uint64);
   mdb_set_dupsort(txn, m_output_txs, compare_uint64);
   mdb_set_dupsort(txn, m_block_info, compare_uint64);
 
   mdb_set_compare(txn, m_txpool_meta, compare_hash32);
   mdb_set_compare(txn, m_txpool_blob, compare_hash32);
+  if (!(mdb_flags & MDB_RDONLY))
+    mdb_set_compare(txn, m_pow_cache, compare_hash32);
   mdb_set_compare(txn, m_properties, compare_string);
 
   if (!(mdb_flags & MDB_RDONLY))
@@ -1283,10 +1595,48 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     }
   }
 
+  // blobs are stored raw unless a codec was set with set_blob_codec
+  m_tagged_blobs = false;
+  m_blob_codec = blob_codec_none;
+  MDB_val_copy<const char*> kc("blob_codec");
+  if (mdb_get(txn, m_properties, &kc, &v) == MDB_SUCCESS)
+  {
+    m_tagged_blobs = true;
+    m_blob_codec = (blob_codec_t)*(const uint8_t*)v.mv_data;
+  }
+  blob_codec_t target_codec = m_blob_codec;
+  MDB_val_copy<const char*> kt("blob_codec_target");
+  bool converting = mdb_get(txn, m_properties, &kt, &v) == MDB_SUCCESS;
+  if (converting)
+    target_codec = (blob_codec_t)*(const uint8_t*)v.mv_data;
+  if (!blob_codec_supported(m_blob_codec) || !blob_codec_supported(target_codec))
+  {
+    txn.abort();
+    mdb_env_close(m_env);
+    m_open = false;
+    MFATAL("Existing lmdb database uses blob codec " << blob_codec_name(blob_codec_supported(m_blob_codec) ? target_codec : m_blob_codec)
+        << ", which this build does not support.");
+    return;
+  }
+  if (converting && (mdb_flags & MDB_RDONLY))
+  {
+    txn.abort();
+    mdb_env_close(m_env);
+    m_open = false;
+    MFATAL("Existing lmdb database is being converted to another blob codec, and cannot be opened read only.");
+    return;
+  }
+
   // commit the transaction
   txn.commit();
 
   m_open = true;
+
+  if (converting)
+  {
+    MGINFO("Resuming interrupted blob codec conversion");
+    convert_blobs();
+  }
   // from here, init should be finished
 }
 
@@ -1341,6 +1691,12 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_block_heights: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_txs, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_txs: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_txs_pruned, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_txs_pruned: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_txs_prunable, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_txs_prunable: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_txs_prunable_hash, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_txs_prunable_hash: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_tx_indices, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_tx_indices: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_tx_outputs, 0))
@@ -1349,11 +1705,15 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amounts: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_output_amount_counts, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amount_counts: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_spent_keys, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_keys: ", result).c_str()));
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_pow_cache, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_pow_cache: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -1362,6 +1722,14 @@ void BlockchainLMDB::reset()
   MDB_val_copy<uint32_t> v(VERSION);
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
+  // the codec is a setting rather than data, keep it
+  if (m_tagged_blobs)
+  {
+    MDB_val_copy<const char*> kc("blob_codec");
+    MDB_val_copy<uint8_t> vc(m_blob_codec);
+    if (auto result = mdb_put(txn, m_properties, &kc, &vc, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to write blob codec to database: ", result).c_str()));
+  }
 
   txn.commit();
   m_cum_size = 0;
@@ -1704,6 +2072,7 @@ bool BlockchainLMDB::block_exists(const crypto::hash& h, uint64_t *height) const
 
 cryptonote::blobdata BlockchainLMDB::get_block_blob(const crypto::hash& h) const
 {
+  DB_METRICS_TIMER("get_block_blob");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
@@ -1742,6 +2111,7 @@ block_header BlockchainLMDB::get_block_header(const crypto::hash& h) const
 
 cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t& height) const
 {
+  DB_METRICS_TIMER("get_block_blob");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
@@ -1759,7 +2129,7 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
     throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
 
   blobdata bd;
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  decode_blob(result, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -1999,12 +2369,12 @@ uint64_t BlockchainLMDB::num_outputs() const
 
 bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
 {
+  DB_METRICS_TIMER("tx_exists");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
-  RCURSOR(txs);
 
   MDB_val_set(key, h);
   bool tx_found = false;
@@ -2017,7 +2387,7 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
     throw0(DB_ERROR(lmdb_error(std::string("DB error attempting to fetch transaction index from hash ") + epee::string_tools::pod_to_hex(h) + ": ", get_result).c_str()));
 
   // This isn't needed as part of the check. we're not checking consistency of db.
-  // get_result = mdb_cursor_get(m_cur_txs, &val_tx_index, &result, MDB_SET);
+  // get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_index, &result, MDB_SET);
   TIME_MEASURE_FINISH(time1);
   time_tx_exists += time1;
 
@@ -2039,6 +2409,7 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
 
 bool BlockchainLMDB::tx_exists(const crypto::hash& h, uint64_t& tx_id) const
 {
+  DB_METRICS_TIMER("tx_exists");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
@@ -2094,151 +2465,368 @@ uint64_t BlockchainLMDB::get_tx_unlock_time(const crypto::hash& h) const
 
 bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
 {
+  DB_METRICS_TIMER("get_tx_blob");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
-  RCURSOR(txs);
+  RCURSOR(txs_pruned);
+  RCURSOR(txs_prunable);
 
   MDB_val_set(v, h);
-  MDB_val result;
+  MDB_val result0, result1;
   auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     txindex *tip = (txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs, &val_tx_id, &result, MDB_SET);
+    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
+    if (get_result == 0)
+      get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result1, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  blobdata prunable;
+  decode_blob(result0, bd);
+  decode_blob(result1, prunable);
+  bd.append(prunable);
 
   TXN_POSTFIX_RDONLY();
 
   return true;
 }
 
-uint64_t BlockchainLMDB::get_tx_count() const
+bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
-  int result;
+  RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
 
-  MDB_stat db_stats;
-  if ((result = mdb_stat(m_txn, m_txs, &db_stats)))
-    throw0(DB_ERROR(lmdb_error("Failed to query m_txs: ", result).c_str()));
+  MDB_val_set(v, h);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == 0)
+  {
+    txindex *tip = (txindex *)v.mv_data;
+    MDB_val_set(val_tx_id, tip->data.tx_id);
+    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
+  }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch pruned tx from hash", get_result).c_str()));
+
+  decode_blob(result, bd);
 
   TXN_POSTFIX_RDONLY();
 
-  return db_stats.ms_entries;
+  return true;
 }
 
-std::vector<transaction> BlockchainLMDB::get_tx_list(const std::vector<crypto::hash>& hlist) const
+bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
-  std::vector<transaction> v;
 
-  for (auto& h : hlist)
+  TXN_PREFIX_RDONLY();
+  RCURSOR(tx_indices);
+  RCURSOR(txs_prunable);
+
+  MDB_val_set(v, h);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == 0)
   {
-    v.push_back(get_tx(h));
+    txindex *tip = (txindex *)v.mv_data;
+    MDB_val_set(val_tx_id, tip->data.tx_id);
+    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
   }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch prunable tx from hash", get_result).c_str()));
 
-  return v;
+  decode_blob(result, bd);
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
 }
 
-uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
+bool BlockchainLMDB::get_prunable_tx_hash(const crypto::hash& h, crypto::hash &prunable_hash) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
+  RCURSOR(txs_prunable);
+  RCURSOR(txs_prunable_hash);
 
   MDB_val_set(v, h);
+  MDB_val result;
   auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
-  {
-    throw1(TX_DNE(std::string("tx_data_t with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
-  }
+    return false;
   else if (get_result)
-    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx height from hash", get_result).c_str()));
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx index from hash", get_result).c_str()));
 
   txindex *tip = (txindex *)v.mv_data;
-  uint64_t ret = tip->data.block_id;
+  MDB_val_set(val_tx_id, tip->data.tx_id);
+  get_result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &result, MDB_SET);
+  if (get_result == 0)
+  {
+    prunable_hash = *(const crypto::hash*)result.mv_data;
+  }
+  else if (get_result == MDB_NOTFOUND)
+  {
+    // not pruned, hash it the way get_transaction_hash does
+    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+    if (get_result)
+      throw0(DB_ERROR(lmdb_error("DB error attempting to fetch prunable tx", get_result).c_str()));
+    blobdata bd;
+    decode_blob(result, bd);
+    prunable_hash = bd.empty() ? null_hash : crypto::cn_fast_hash(bd.data(), bd.size());
+  }
+  else
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch prunable tx hash", get_result).c_str()));
+
   TXN_POSTFIX_RDONLY();
-  return ret;
+
+  return true;
 }
 
-uint64_t BlockchainLMDB::get_num_outputs(const uint64_t& amount) const
+uint64_t BlockchainLMDB::get_pruned_height() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(output_amounts);
 
-  MDB_val_copy<uint64_t> k(amount);
+  MDB_val_copy<const char*> k("pruned_height");
   MDB_val v;
-  mdb_size_t num_elems = 0;
-  auto result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
-  if (result == MDB_SUCCESS)
-  {
-    mdb_cursor_count(m_cur_output_amounts, &num_elems);
-  }
-  else if (result != MDB_NOTFOUND)
-    throw0(DB_ERROR("DB error attempting to get number of outputs of an amount"));
+  uint64_t pruned_height = 0;
+  auto get_result = mdb_get(m_txn, m_properties, &k, &v);
+  if (get_result == 0)
+    pruned_height = *(const uint64_t*)v.mv_data;
+  else if (get_result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to fetch pruned height: ", get_result).c_str()));
 
   TXN_POSTFIX_RDONLY();
 
-  return num_elems;
+  return pruned_height;
 }
 
-// This is a lot harder now that we've removed the output_keys index
-output_data_t BlockchainLMDB::get_output_key(const uint64_t &global_index) const
+uint64_t BlockchainLMDB::prune(uint64_t height)
 {
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__ << " (unused version - does nothing)");
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
-  TXN_PREFIX_RDONLY();
-  RCURSOR(output_txs);
-  RCURSOR(tx_indices);
-  RCURSOR(txs);
+  if (m_batch_active)
+    throw0(DB_ERROR("Cannot prune while a batch transaction is active"));
+  if (height >= this->height())
+    throw0(DB_ERROR("Cannot prune the top block"));
+  if (height <= get_pruned_height())
+    return 0;
 
-  output_data_t od;
-  MDB_val_set(v, global_index);
-  auto get_result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
-  if (get_result == MDB_NOTFOUND)
-    throw1(OUTPUT_DNE("output with given index not in db"));
-  else if (get_result)
-    throw0(DB_ERROR("DB error attempting to fetch output tx hash"));
+  // txs are numbered in chain order, so all the txs below the miner tx of
+  // the block at that height are in the blocks below it
+  uint64_t tx_id_limit;
+  if (!tx_exists(get_transaction_hash(get_block_from_height(height).miner_tx), tx_id_limit))
+    throw0(DB_ERROR("Failed to find the first tx to keep"));
 
-  outtx *ot = (outtx *)v.mv_data;
+  MINFO("Pruning the blockchain below height " << height << ", this may take a while");
+  uint64_t pruned = 0;
+  int result;
+  while (1)
+  {
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
 
-  MDB_val_set(val_h, ot->tx_hash);
-  get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
-  if (get_result)
-    throw0(DB_ERROR(lmdb_error(std::string("DB error attempting to fetch transaction index from hash ") + epee::string_tools::pod_to_hex(ot->tx_hash) + ": ", get_result).c_str()));
+    // in chunks, so that a long prune does not hold the write lock for all its duration
+    mdb_txn_safe txn;
+    if ((result = lmdb_txn_begin(m_env, NULL, 0, txn)))
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_cursor *c_prunable, *c_prunable_hash;
+    if ((result = mdb_cursor_open(txn, m_txs_prunable, &c_prunable)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+    if ((result = mdb_cursor_open(txn, m_txs_prunable_hash, &c_prunable_hash)))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_hash: ", result).c_str()));
+
+    size_t n;
+    for (n = 0; n < 1000; ++n)
+    {
+      MDB_val k, v;
+      result = mdb_cursor_get(c_prunable, &k, &v, MDB_FIRST);
+      if (result == MDB_NOTFOUND)
+        break;
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from txs_prunable: ", result).c_str()));
+      const uint64_t tx_id = *(const uint64_t*)k.mv_data;
+      if (tx_id >= tx_id_limit)
+        break;
+
+      blobdata bd;
+      decode_blob(v, bd);
+      const crypto::hash prunable_hash = bd.empty() ? null_hash : crypto::cn_fast_hash(bd.data(), bd.size());
+      MDB_val_set(val_tx_id, tx_id);
+      MDB_val_set(val_prunable_hash, prunable_hash);
+      result = mdb_cursor_put(c_prunable_hash, &val_tx_id, &val_prunable_hash, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to add prunable tx hash to db transaction: ", result).c_str()));
+      result = mdb_cursor_del(c_prunable, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to add removal of prunable tx to db transaction: ", result).c_str()));
+    }
+    pruned += n;
+
+    if (n < 1000)
+    {
+      MDB_val_copy<const char*> k("pruned_height");
+      MDB_val_copy<uint64_t> v(height);
+      if ((result = mdb_put(txn, m_properties, &k, &v, 0)))
+        throw0(DB_ERROR(lmdb_error("Failed to update pruned height: ", result).c_str()));
+      txn.commit();
+      break;
+    }
+    txn.commit();
+  }
+
+  // the chunks were committed without syncing if the db runs with MDB_NOSYNC,
+  // make the new pruned height durable before reporting it
+  sync();
+
+  MINFO("Pruned " << pruned << " txs, the blockchain is now pruned below height " << height);
+  return pruned;
+}
+
+uint64_t BlockchainLMDB::get_tx_count() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  int result;
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(m_txn, m_txs_pruned, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_txs_pruned: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+
+  return db_stats.ms_entries;
+}
+
+std::vector<transaction> BlockchainLMDB::get_tx_list(const std::vector<crypto::hash>& hlist) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  std::vector<transaction> v;
+
+  for (auto& h : hlist)
+  {
+    v.push_back(get_tx(h));
+  }
+
+  return v;
+}
+
+uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(tx_indices);
+
+  MDB_val_set(v, h);
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw1(TX_DNE(std::string("tx_data_t with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx height from hash", get_result).c_str()));
+
+  txindex *tip = (txindex *)v.mv_data;
+  uint64_t ret = tip->data.block_id;
+  TXN_POSTFIX_RDONLY();
+  return ret;
+}
+
+uint64_t BlockchainLMDB::get_num_outputs(const uint64_t& amount) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(output_amounts);
+
+  MDB_val_copy<uint64_t> k(amount);
+  MDB_val v;
+  mdb_size_t num_elems = 0;
+  auto result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
+  if (result == MDB_SUCCESS)
+  {
+    mdb_cursor_count(m_cur_output_amounts, &num_elems);
+  }
+  else if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR("DB error attempting to get number of outputs of an amount"));
+
+  TXN_POSTFIX_RDONLY();
+
+  return num_elems;
+}
+
+// This is a lot harder now that we've removed the output_keys index
+output_data_t BlockchainLMDB::get_output_key(const uint64_t &global_index) const
+{
+  DB_METRICS_TIMER("get_output_key");
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__ << " (unused version - does nothing)");
+  check_open();
+  TXN_PREFIX_RDONLY();
+  RCURSOR(output_txs);
+  RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
+
+  output_data_t od;
+  MDB_val_set(v, global_index);
+  auto get_result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == MDB_NOTFOUND)
+    throw1(OUTPUT_DNE("output with given index not in db"));
+  else if (get_result)
+    throw0(DB_ERROR("DB error attempting to fetch output tx hash"));
+
+  outtx *ot = (outtx *)v.mv_data;
+
+  MDB_val_set(val_h, ot->tx_hash);
+  get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
+  if (get_result)
+    throw0(DB_ERROR(lmdb_error(std::string("DB error attempting to fetch transaction index from hash ") + epee::string_tools::pod_to_hex(ot->tx_hash) + ": ", get_result).c_str()));
 
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
   MDB_val result;
-  get_result = mdb_cursor_get(m_cur_txs, &val_tx_id, &result, MDB_SET);
+  get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
   if (get_result == MDB_NOTFOUND)
     throw1(TX_DNE(std::string("tx with hash ").append(epee::string_tools::pod_to_hex(ot->tx_hash)).append(" not found in db").c_str()));
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
   blobdata bd;
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  decode_blob(result, bd);
 
   transaction tx;
-  if (!parse_and_validate_tx_from_blob(bd, tx))
+  if (!parse_and_validate_tx_base_from_blob(bd, tx))
     throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
 
   const tx_out tx_output = tx.vout[ot->local_index];
@@ -2252,6 +2840,7 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t &global_index) const
 
 output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint64_t& index)
 {
+  DB_METRICS_TIMER("get_output_key");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
@@ -2358,6 +2947,7 @@ std::vector<uint64_t> BlockchainLMDB::get_tx_amount_output_indices(const uint64_
 
 bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
 {
+  DB_METRICS_TIMER("has_key_image");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
@@ -2437,7 +3027,7 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
       throw0(DB_ERROR("Failed to enumerate blocks"));
     uint64_t height = *(const uint64_t*)k.mv_data;
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    decode_blob(v, bd);
     block b;
     if (!parse_and_validate_block_from_blob(bd, b))
       throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
@@ -2463,7 +3053,8 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(txs);
+  RCURSOR(txs_pruned);
+  RCURSOR(txs_prunable);
   RCURSOR(tx_indices);
 
   MDB_val k;
@@ -2484,16 +3075,31 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     const crypto::hash hash = ti->key;
     k.mv_data = (void *)&ti->data.tx_id;
     k.mv_size = sizeof(ti->data.tx_id);
-    ret = mdb_cursor_get(m_cur_txs, &k, &v, MDB_SET);
+    ret = mdb_cursor_get(m_cur_txs_pruned, &k, &v, MDB_SET);
     if (ret == MDB_NOTFOUND)
       break;
     if (ret)
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    decode_blob(v, bd);
+    ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
+    if (ret && ret != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate prunable transactions: ", ret).c_str()));
     transaction tx;
-    if (!parse_and_validate_tx_from_blob(bd, tx))
-      throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+    if (ret == MDB_NOTFOUND)
+    {
+      // pruned, only the base is left
+      if (!parse_and_validate_tx_base_from_blob(bd, tx))
+        throw0(DB_ERROR("Failed to parse pruned tx from blob retrieved from the db"));
+    }
+    else
+    {
+      blobdata prunable;
+      decode_blob(v, prunable);
+      bd.append(prunable);
+      if (!parse_and_validate_tx_from_blob(bd, tx))
+        throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+    }
     if (!f(hash, tx)) {
       ret = false;
       break;
@@ -2557,6 +3163,18 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks)
   m_writer = boost::this_thread::get_id();
   check_and_resize_for_batch(batch_num_blocks);
 
+  batch_txn_begin();
+  m_batch_active = true;
+  m_batch_num_blocks = batch_num_blocks;
+  m_batch_blocks = 0;
+  m_batch_committed_blocks = 0;
+
+  LOG_PRINT_L3("batch transaction: begin");
+  return true;
+}
+
+void BlockchainLMDB::batch_txn_begin()
+{
   m_write_batch_txn = new mdb_txn_safe();
 
   // NOTE: need to make sure it's destroyed properly when done
@@ -2570,12 +3188,8 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks)
   // active
   m_write_batch_txn->m_batch_txn = true;
   m_write_txn = m_write_batch_txn;
-
-  m_batch_active = true;
+  m_batch_size = 0;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
-
-  LOG_PRINT_L3("batch transaction: begin");
-  return true;
 }
 
 void BlockchainLMDB::batch_commit()
@@ -2612,11 +3226,14 @@ void BlockchainLMDB::cleanup_batch()
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_batch_committed_blocks = 0;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
 }
 
 void BlockchainLMDB::batch_stop()
 {
+  DB_METRICS_TIMER("batch_stop");
+  TRACE_SCOPE("db", "batch_stop");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   if (! m_batch_transactions)
     throw0(DB_ERROR("batch transactions not enabled"));
@@ -2664,6 +3281,26 @@ void BlockchainLMDB::batch_abort()
   m_write_batch_txn = nullptr;
   m_batch_active = false;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+
+  // batch_resize() committed these before growing the map, so the abort
+  // could not undo them. The hard fork state is rolled back with them, and
+  // Blockchain checks its caches against the chain. Their txes do not go back
+  // to the pool: this only happens when the db is closed in the middle of a
+  // batch, and the blocks are synced again with their txes.
+  const uint64_t committed_blocks = m_batch_committed_blocks;
+  m_batch_committed_blocks = 0;
+  if (committed_blocks > 0)
+  {
+    MGINFO("[batch] Removing " << committed_blocks << " blocks committed by the aborted batch");
+    for (uint64_t i = 0; i < committed_blocks; ++i)
+    {
+      block blk;
+      std::vector<transaction> txs;
+      pop_block(blk, txs);
+    }
+    if (m_hardfork)
+      m_hardfork->reorganize_from_chain_height(height());
+  }
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
@@ -2714,10 +3351,58 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
 void BlockchainLMDB::block_rtxn_stop() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  // a read session keeps its txn until it ends
+  if (m_tinfo->m_ti_session)
+    return;
   mdb_txn_reset(m_tinfo->m_ti_rtxn);
   memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
 }
 
+void BlockchainLMDB::start_read_session() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  // the writer reads through its write txn
+  if (m_write_txn && m_writer == boost::this_thread::get_id())
+    return;
+  if (m_tinfo.get() && m_tinfo->m_ti_session)
+  {
+    ++m_tinfo->m_ti_session;
+    return;
+  }
+
+  // the session's txn counts as active until the session ends, so a resize
+  // waits for it rather than moving the map under its cursors
+  MDB_txn *txn;
+  mdb_txn_cursors *cursors;
+  bool started;
+  mdb_txn_safe::increment_txns(1);
+  try
+  {
+    started = block_rtxn_start(&txn, &cursors);
+  }
+  catch (...)
+  {
+    mdb_txn_safe::increment_txns(-1);
+    throw;
+  }
+  m_tinfo->m_ti_session = 1;
+  m_tinfo->m_ti_session_rtxn = started;
+}
+
+void BlockchainLMDB::end_read_session() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (!m_tinfo.get() || !m_tinfo->m_ti_session)
+    return;
+  if (--m_tinfo->m_ti_session)
+    return;
+  // leave a read txn opened before the session to its owner
+  if (m_tinfo->m_ti_session_rtxn)
+    block_rtxn_stop();
+  mdb_txn_safe::increment_txns(-1);
+}
+
 void BlockchainLMDB::block_txn_start(bool readonly)
 {
   if (readonly)
@@ -2774,6 +3459,8 @@ void BlockchainLMDB::block_txn_start(bool readonly)
 
 void BlockchainLMDB::block_txn_stop()
 {
+  DB_METRICS_TIMER("block_txn_stop");
+  TRACE_SCOPE("db", "block_txn_stop");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   if (m_write_txn && m_writer == boost::this_thread::get_id())
   {
@@ -2791,8 +3478,7 @@ void BlockchainLMDB::block_txn_stop()
   }
   else if (m_tinfo->m_ti_rtxn)
   {
-    mdb_txn_reset(m_tinfo->m_ti_rtxn);
-    memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+    block_rtxn_stop();
   }
 }
 
@@ -2810,8 +3496,7 @@ void BlockchainLMDB::block_txn_abort()
   }
   else if (m_tinfo->m_ti_rtxn)
   {
-    mdb_txn_reset(m_tinfo->m_ti_rtxn);
-    memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+    block_rtxn_stop();
   }
   else
   {
@@ -2826,14 +3511,27 @@ void BlockchainLMDB::block_txn_abort()
 uint64_t BlockchainLMDB::add_block(const block& blk, const size_t& block_size, const difficulty_type& cumulative_difficulty, const uint64_t& coins_generated,
     const std::vector<transaction>& txs)
 {
+  DB_METRICS_TIMER("add_block");
+  TRACE_SCOPE("db", "add_block");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   uint64_t m_height = height();
 
-  if (m_height % 1000 == 0)
+  uint64_t estimated_size = 0;
+  if (m_batch_active)
   {
-    // for batch mode, DB resize check is done at start of batch transaction
-    if (! m_batch_active && need_resize())
+    // the estimate made at the start of the batch may be exceeded by larger
+    // blocks or a batch of unknown length, so check again before each block
+    if (m_write_txn && m_writer == boost::this_thread::get_id())
+    {
+      estimated_size = get_estimated_block_size(block_size);
+      if (batch_need_resize(estimated_size))
+        batch_resize();
+    }
+  }
+  else if (m_height % 1000 == 0)
+  {
+    if (need_resize())
     {
       LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
       do_resize();
@@ -2854,6 +3552,9 @@ uint64_t BlockchainLMDB::add_block(const block& blk, const size_t& block_size, c
     throw;
   }
 
+  m_batch_size += estimated_size;
+  ++m_batch_blocks;
+
   return ++m_height;
 }
 
@@ -2906,6 +3607,7 @@ void BlockchainLMDB::get_output_tx_and_index_from_global(const std::vector<uint6
 
 void BlockchainLMDB::get_output_key(const uint64_t &amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial)
 {
+  DB_METRICS_TIMER("get_output_keys");
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   TIME_MEASURE_START(db3);
   check_open();
@@ -3042,34 +3744,30 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
   }
 
   if (unlocked || recent_cutoff > 0) {
+    RCURSOR(output_amount_counts);
+
+    // outputs are unlocked in the blocks below unlocked_height, and recent
+    // in the blocks from recent_height on, whatever their amount
     const uint64_t blockchain_height = height();
+    const uint64_t unlocked_height = blockchain_height >= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE ? blockchain_height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 1 : 0;
+    uint64_t recent_height = unlocked_height;
+    if (recent_cutoff > 0)
+    {
+      while (recent_height > 0 && get_block_timestamp(recent_height - 1) >= recent_cutoff)
+        --recent_height;
+    }
+
     for (std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>::iterator i = histogram.begin(); i != histogram.end(); ++i) {
-      uint64_t amount = i->first;
-      uint64_t num_elems = std::get<0>(i->second);
-      while (num_elems > 0) {
-        const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-        const uint64_t height = get_tx_block_height(toi.first);
-        if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
-          break;
-        --num_elems;
-      }
+      const uint64_t amount = i->first;
+      const uint64_t num_unlocked = unlocked_height > 0 ? get_output_amount_count(m_cur_output_amount_counts, amount, unlocked_height - 1) : 0;
       // modifying second does not invalidate the iterator
-      std::get<1>(i->second) = num_elems;
+      std::get<1>(i->second) = num_unlocked;
 
       if (recent_cutoff > 0)
       {
-        uint64_t recent = 0;
-        while (num_elems > 0) {
-          const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-          const uint64_t height = get_tx_block_height(toi.first);
-          const uint64_t ts = get_block_timestamp(height);
-          if (ts < recent_cutoff)
-            break;
-          --num_elems;
-          ++recent;
-        }
+        const uint64_t num_old = recent_height > 0 ? get_output_amount_count(m_cur_output_amount_counts, amount, recent_height - 1) : 0;
         // modifying second does not invalidate the iterator
-        std::get<2>(i->second) = recent;
+        std::get<2>(i->second) = num_unlocked - num_old;
       }
     }
   }
@@ -3079,6 +3777,120 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
   return histogram;
 }
 
+bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  distribution.clear();
+  if (from_height > to_height || to_height >= height())
+    return false;
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(output_amount_counts);
+
+  distribution.reserve(to_height - from_height + 1);
+  uint64_t count = from_height > 0 ? get_output_amount_count(m_cur_output_amount_counts, amount, from_height - 1) : 0;
+
+  // one record per block with outputs of that amount, the count carries over other blocks
+  MDB_val_copy<uint64_t> val_amount(amount);
+  amount_count ac = {from_height, 0};
+  MDB_val_set(v, ac);
+  int result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_GET_BOTH_RANGE);
+  while (!result)
+  {
+    const amount_count *rec = (const amount_count*)v.mv_data;
+    if (rec->height > to_height)
+      break;
+    distribution.resize(rec->height - from_height, count);
+    count = rec->count;
+    distribution.push_back(count);
+    result = mdb_cursor_get(m_cur_output_amount_counts, &val_amount, &v, MDB_NEXT_DUP);
+  }
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate output amount counts: ", result).c_str()));
+  distribution.resize(to_height - from_height + 1, count);
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
+bool BlockchainLMDB::get_block_pow_hash(const crypto::hash &id, uint8_t hf_version, crypto::hash &pow) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (is_read_only())
+    return false;
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_val k = {sizeof(id), (void *)&id};
+  MDB_val v;
+  auto result = mdb_get(m_txn, m_pow_cache, &k, &v);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a PoW hash from the db: ", result).c_str()));
+
+  const pow_cache_entry *entry = (const pow_cache_entry*)v.mv_data;
+  if (entry->hf_version != hf_version)
+    return false;
+  pow = entry->pow;
+
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
+void BlockchainLMDB::add_block_pow_hash(const crypto::hash &id, uint64_t height, uint8_t hf_version, const crypto::hash &pow)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_BLOCK_PREFIX(0);
+
+  pow_cache_entry entry = {height, hf_version, pow};
+  MDB_val k = {sizeof(id), (void *)&id};
+  MDB_val_set(v, entry);
+  if (auto result = mdb_put(*txn_ptr, m_pow_cache, &k, &v, 0))
+    throw1(DB_ERROR(lmdb_error("Error adding PoW hash to db transaction: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+uint64_t BlockchainLMDB::prune_block_pow_hashes(uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_BLOCK_PREFIX(0);
+
+  // the cache is kept small, so it is just walked whole
+  MDB_cursor *cur;
+  int result = mdb_cursor_open(*txn_ptr, m_pow_cache, &cur);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_pow_cache: ", result).c_str()));
+  uint64_t pruned = 0;
+  MDB_val k, v;
+  MDB_cursor_op op = MDB_FIRST;
+  while (!(result = mdb_cursor_get(cur, &k, &v, op)))
+  {
+    op = MDB_NEXT;
+    if (((const pow_cache_entry*)v.mv_data)->height >= height)
+      continue;
+    if ((result = mdb_cursor_del(cur, 0)))
+      break;
+    ++pruned;
+  }
+  mdb_cursor_close(cur);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to prune m_pow_cache: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+  return pruned;
+}
+
 void BlockchainLMDB::check_hard_fork_info()
 {
 }
@@ -3161,6 +3973,178 @@ bool BlockchainLMDB::is_read_only() const
 
 #define LOGIF(y)    if (ELPP->vRegistry()->allowed(y, FONERO_DEFAULT_LOG_CATEGORY))
 
+MDB_val BlockchainLMDB::encode_blob(const char *data, size_t size, std::string &buffer) const
+{
+  if (!m_tagged_blobs)
+    return MDB_val{size, (void*)data};
+  blob_encode(m_blob_codec, data, size, buffer);
+  return MDB_val{buffer.size(), (void*)buffer.data()};
+}
+
+void BlockchainLMDB::decode_blob(const MDB_val &v, cryptonote::blobdata &bd) const
+{
+  if (!m_tagged_blobs)
+    bd.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+  else if (!blob_decode(reinterpret_cast<const char*>(v.mv_data), v.mv_size, bd))
+    throw0(DB_ERROR("Failed to decode blob retrieved from the db"));
+}
+
+void BlockchainLMDB::set_blob_codec(blob_codec_t codec)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_batch_active || m_write_txn)
+    throw0(DB_ERROR("Cannot change the blob codec while a write transaction is active"));
+  if (!blob_codec_supported(codec))
+    throw0(DB_ERROR((std::string("Blob codec ") + blob_codec_name(codec) + " is not supported by this build").c_str()));
+  if (codec == m_blob_codec && m_tagged_blobs == (codec != blob_codec_none))
+    return;
+
+  mdb_txn_safe txn;
+  if (auto result = mdb_txn_begin(m_env, NULL, 0, txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  MDB_val_copy<const char*> k("blob_codec_target");
+  MDB_val_copy<uint8_t> v(codec);
+  if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to write blob codec target: ", result).c_str()));
+  MDB_val_copy<const char*> kp("blob_codec_progress");
+  auto result = mdb_del(txn, m_properties, &kp, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to reset blob codec progress: ", result).c_str()));
+  txn.commit();
+
+  convert_blobs();
+}
+
+void BlockchainLMDB::convert_blobs()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+
+  struct conversion_progress
+  {
+    uint32_t table;
+    uint64_t next_key;
+  } progress = {0, 0};
+
+  const MDB_dbi tables[] = {m_blocks, m_txs_pruned, m_txs_prunable};
+  const char *table_names[] = {"blocks", "txs_pruned", "txs_prunable"};
+  const size_t n_tables = sizeof(tables) / sizeof(tables[0]);
+
+  MDB_val_copy<const char*> kt("blob_codec_target");
+  MDB_val_copy<const char*> kp("blob_codec_progress");
+  result = mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  if ((result = mdb_get(txn, m_properties, &kt, &v)))
+    throw0(DB_ERROR(lmdb_error("Failed to read blob codec target: ", result).c_str()));
+  const blob_codec_t target = (blob_codec_t)*(const uint8_t*)v.mv_data;
+  result = mdb_get(txn, m_properties, &kp, &v);
+  if (result == 0 && v.mv_size == sizeof(progress))
+    memcpy(&progress, v.mv_data, sizeof(progress));
+  else if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to read blob codec progress: ", result).c_str()));
+  txn.abort();
+
+  // raw blobs are stored untagged, as before any codec was set
+  const bool source_tagged = m_tagged_blobs;
+  const bool target_tagged = target != blob_codec_none;
+  MLOG_YELLOW(el::Level::Info, "Converting stored blobs to codec " << blob_codec_name(target) << " - this may take a while:");
+
+  const uint64_t chunk_records = 1000;
+  uint64_t n_records = 0;
+  std::string decoded, encoded;
+  while (progress.table < n_tables)
+  {
+    if (need_resize())
+    {
+      MINFO("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_cursor *c;
+    result = mdb_cursor_open(txn, tables[progress.table], &c);
+    if (result)
+      throw0(DB_ERROR(lmdb_error(std::string("Failed to open a cursor for ") + table_names[progress.table] + ": ", result).c_str()));
+
+    MDB_val_set(val_key, progress.next_key);
+    k = val_key;
+    result = mdb_cursor_get(c, &k, &v, MDB_SET_RANGE);
+    for (uint64_t n = 0; n < chunk_records && result == 0; ++n)
+    {
+      const char *data = reinterpret_cast<const char*>(v.mv_data);
+      if (!source_tagged)
+        decoded.assign(data, v.mv_size);
+      else if (!blob_decode(data, v.mv_size, decoded))
+        throw0(DB_ERROR(std::string("Failed to decode a blob from ").append(table_names[progress.table]).c_str()));
+      MDB_val nv = {decoded.size(), (void*)decoded.data()};
+      if (target_tagged)
+      {
+        blob_encode(target, decoded.data(), decoded.size(), encoded);
+        nv = MDB_val{encoded.size(), (void*)encoded.data()};
+      }
+      // k points into the page the put rewrites
+      const uint64_t key = *(const uint64_t*)k.mv_data;
+      MDB_val_set(val_current_key, key);
+      if ((result = mdb_cursor_put(c, &val_current_key, &nv, MDB_CURRENT)))
+        throw0(DB_ERROR(lmdb_error(std::string("Failed to update a blob in ") + table_names[progress.table] + ": ", result).c_str()));
+      progress.next_key = key + 1;
+      ++n_records;
+      result = mdb_cursor_get(c, &k, &v, MDB_NEXT);
+    }
+    if (result == MDB_NOTFOUND)
+    {
+      ++progress.table;
+      progress.next_key = 0;
+    }
+    else if (result)
+      throw0(DB_ERROR(lmdb_error(std::string("Failed to enumerate ") + table_names[progress.table] + ": ", result).c_str()));
+
+    // saved with the records, so an interrupted conversion resumes from here
+    MDB_val_set(vp, progress);
+    if ((result = mdb_put(txn, m_properties, &kp, &vp, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to write blob codec progress: ", result).c_str()));
+    txn.commit();
+
+    LOGIF(el::Level::Info) {
+      std::cout << n_records << " blobs  \r" << std::flush;
+    }
+  }
+
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  MDB_val_copy<const char*> kc("blob_codec");
+  if (target_tagged)
+  {
+    MDB_val_copy<uint8_t> vc(target);
+    result = mdb_put(txn, m_properties, &kc, &vc, 0);
+  }
+  else
+  {
+    result = mdb_del(txn, m_properties, &kc, NULL);
+    if (result == MDB_NOTFOUND)
+      result = 0;
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to write blob codec: ", result).c_str()));
+  if ((result = mdb_del(txn, m_properties, &kt, NULL)))
+    throw0(DB_ERROR(lmdb_error("Failed to remove blob codec target: ", result).c_str()));
+  if ((result = mdb_del(txn, m_properties, &kp, NULL)))
+    throw0(DB_ERROR(lmdb_error("Failed to remove blob codec progress: ", result).c_str()));
+  txn.commit();
+
+  m_tagged_blobs = target_tagged;
+  m_blob_codec = target;
+  MINFO("Converted " << n_records << " blobs to codec " << blob_codec_name(target));
+}
+
 void BlockchainLMDB::migrate_0_1()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3614,7 +4598,7 @@ void BlockchainLMDB::migrate_0_1()
           throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs: ", result).c_str()));
         if (!i) {
           MDB_stat ms;
-          mdb_stat(txn, m_txs, &ms);
+          mdb_stat(txn, m_txs_pruned, &ms);
           i = ms.ms_entries;
           if (i) {
             MDB_val_set(pk, "txblk");
@@ -3695,11 +4679,221 @@ void BlockchainLMDB::migrate_0_1()
   txn.commit();
 }
 
+void BlockchainLMDB::migrate_1_2()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i, z;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+
+  MLOG_YELLOW(el::Level::Info, "Migrating blockchain from DB version 1 to 2 - this may take a while:");
+  MINFO("splitting txs into txs_pruned and txs_prunable...");
+
+  // txs are moved (not copied) in chunks, so an interrupted migration
+  // resumes with whatever is left in txs
+  result = mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_txs_pruned, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_txs_pruned: ", result).c_str()));
+  i = db_stats.ms_entries;
+  if ((result = mdb_stat(txn, m_txs, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_txs: ", result).c_str()));
+  z = i + db_stats.ms_entries;
+  txn.abort();
+  MINFO("Total number of txs: " << z);
+
+  blobdata bd;
+  uint64_t chunk_size = 0;
+  while (1)
+  {
+    if (need_resize(std::max<uint64_t>(2 * chunk_size, 64 * 1024 * 1024)))
+    {
+      MINFO("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_cursor *c_txs, *c_pruned, *c_prunable;
+    result = mdb_cursor_open(txn, m_txs, &c_txs);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs: ", result).c_str()));
+    result = mdb_cursor_open(txn, m_txs_pruned, &c_pruned);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+    result = mdb_cursor_open(txn, m_txs_prunable, &c_prunable);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+
+    size_t n;
+    chunk_size = 0;
+    for (n = 0; n < 1000; ++n)
+    {
+      result = mdb_cursor_get(c_txs, &k, &v, MDB_FIRST);
+      if (result == MDB_NOTFOUND)
+        break;
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from txs: ", result).c_str()));
+
+      const uint64_t tx_id = *(const uint64_t*)k.mv_data;
+      MDB_val_set(val_tx_id, tx_id);
+      bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+      const size_t pruned_size = get_pruned_tx_blob_size(bd);
+      chunk_size += bd.size();
+
+      MDB_val pruned_blob = {pruned_size, (void*)bd.data()};
+      result = mdb_cursor_put(c_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_pruned: ", result).c_str()));
+      MDB_val prunable_blob = {bd.size() - pruned_size, (void*)(bd.data() + pruned_size)};
+      result = mdb_cursor_put(c_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_prunable: ", result).c_str()));
+      result = mdb_cursor_del(c_txs, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to delete a record from txs: ", result).c_str()));
+    }
+    txn.commit();
+    i += n;
+    if (n < 1000)
+      break;
+    LOGIF(el::Level::Info) {
+      std::cout << i << " / " << z << "  \r" << std::flush;
+    }
+  }
+
+  uint32_t version = 2;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_copy<const char *> vk("version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::migrate_2_3()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+
+  MLOG_YELLOW(el::Level::Info, "Migrating blockchain from DB version 2 to 3 - this may take a while:");
+  MINFO("counting outputs per amount and height...");
+
+  // start from scratch, an interrupted migration may have left some records
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  if ((result = mdb_drop(txn, m_output_amount_counts, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amount_counts: ", result).c_str()));
+  txn.commit();
+
+  // one write txn per amount, each has at most one record per block
+  uint64_t amount = 0, n_amounts = 0;
+  bool first = true;
+  while (1)
+  {
+    if (need_resize())
+    {
+      MINFO("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_cursor *c_amounts, *c_counts;
+    result = mdb_cursor_open(txn, m_output_amounts, &c_amounts);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+    result = mdb_cursor_open(txn, m_output_amount_counts, &c_counts);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amount_counts: ", result).c_str()));
+
+    if (first)
+    {
+      result = mdb_cursor_get(c_amounts, &k, &v, MDB_FIRST);
+    }
+    else
+    {
+      // move past the amount done in the previous txn
+      MDB_val_set(val_amount, amount);
+      result = mdb_cursor_get(c_amounts, &val_amount, &v, MDB_SET);
+      if (!result)
+        result = mdb_cursor_get(c_amounts, &k, &v, MDB_NEXT_NODUP);
+    }
+    if (result == MDB_NOTFOUND)
+    {
+      txn.abort();
+      break;
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", result).c_str()));
+    amount = *(const uint64_t*)k.mv_data;
+    first = false;
+
+    // the height is at the same offset in pre_rct_outkey and outkey
+    MDB_val_set(val_amount, amount);
+    amount_count ac = {((const pre_rct_outkey*)v.mv_data)->data.height, 0};
+    while (1)
+    {
+      const uint64_t height = ((const pre_rct_outkey*)v.mv_data)->data.height;
+      if (height != ac.height)
+      {
+        MDB_val_set(vac, ac);
+        if ((result = mdb_cursor_put(c_counts, &val_amount, &vac, MDB_APPENDDUP)))
+          throw0(DB_ERROR(lmdb_error("Failed to add output amount count: ", result).c_str()));
+        ac.height = height;
+      }
+      ++ac.count;
+      result = mdb_cursor_get(c_amounts, &k, &v, MDB_NEXT_DUP);
+      if (result == MDB_NOTFOUND)
+        break;
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", result).c_str()));
+    }
+    MDB_val_set(vac, ac);
+    if ((result = mdb_cursor_put(c_counts, &val_amount, &vac, MDB_APPENDDUP)))
+      throw0(DB_ERROR(lmdb_error("Failed to add output amount count: ", result).c_str()));
+    txn.commit();
+
+    ++n_amounts;
+    LOGIF(el::Level::Info) {
+      std::cout << n_amounts << " amounts  \r" << std::flush;
+    }
+  }
+
+  uint32_t version = 3;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_copy<const char *> vk("version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
   switch(oldversion) {
   case 0:
     migrate_0_1(); /* FALLTHRU */
+  case 1:
+    migrate_1_2(); /* FALLTHRU */
+  case 2:
+    migrate_2_3(); /* FALLTHRU */
   default:
     ;
   }
@@ -30,6 +30,7 @@
 #include <atomic>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/blob_codec.h"
 #include "cryptonote_protocol/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
@@ -49,8 +50,11 @@ typedef struct mdb_txn_cursors
 
   MDB_cursor *m_txc_output_txs;
   MDB_cursor *m_txc_output_amounts;
+  MDB_cursor *m_txc_output_amount_counts;
 
-  MDB_cursor *m_txc_txs;
+  MDB_cursor *m_txc_txs_pruned;
+  MDB_cursor *m_txc_txs_prunable;
+  MDB_cursor *m_txc_txs_prunable_hash;
   MDB_cursor *m_txc_tx_indices;
   MDB_cursor *m_txc_tx_outputs;
 
@@ -67,7 +71,10 @@ typedef struct mdb_txn_cursors
 #define m_cur_block_info	m_cursors->m_txc_block_info
 #define m_cur_output_txs	m_cursors->m_txc_output_txs
 #define m_cur_output_amounts	m_cursors->m_txc_output_amounts
-#define m_cur_txs	m_cursors->m_txc_txs
+#define m_cur_output_amount_counts	m_cursors->m_txc_output_amount_counts
+#define m_cur_txs_pruned	m_cursors->m_txc_txs_pruned
+#define m_cur_txs_prunable	m_cursors->m_txc_txs_prunable
+#define m_cur_txs_prunable_hash	m_cursors->m_txc_txs_prunable_hash
 #define m_cur_tx_indices	m_cursors->m_txc_tx_indices
 #define m_cur_tx_outputs	m_cursors->m_txc_tx_outputs
 #define m_cur_spent_keys	m_cursors->m_txc_spent_keys
@@ -83,7 +90,10 @@ typedef struct mdb_rflags
   bool m_rf_block_info;
   bool m_rf_output_txs;
   bool m_rf_output_amounts;
-  bool m_rf_txs;
+  bool m_rf_output_amount_counts;
+  bool m_rf_txs_pruned;
+  bool m_rf_txs_prunable;
+  bool m_rf_txs_prunable_hash;
   bool m_rf_tx_indices;
   bool m_rf_tx_outputs;
   bool m_rf_spent_keys;
@@ -97,7 +107,10 @@ typedef struct mdb_threadinfo
   MDB_txn *m_ti_rtxn;	// per-thread read txn
   mdb_txn_cursors m_ti_rcursors;	// per-thread read cursors
   mdb_rflags m_ti_rflags;	// per-thread read state
+  unsigned m_ti_session;	// depth of read sessions keeping m_ti_rtxn open
+  bool m_ti_session_rtxn;	// whether the outermost read session started m_ti_rtxn
 
+  mdb_threadinfo(): m_ti_rtxn(NULL), m_ti_session(0), m_ti_session_rtxn(false) {}
   ~mdb_threadinfo();
 } mdb_threadinfo;
 
@@ -129,6 +142,7 @@ struct mdb_txn_safe
   static void prevent_new_txns();
   static void wait_no_active_txns();
   static void allow_new_txns();
+  static void increment_txns(int i);
 
   mdb_threadinfo* m_tinfo;
   MDB_txn* m_txn;
@@ -218,6 +232,12 @@ public:
   virtual uint64_t get_tx_unlock_time(const crypto::hash& h) const;
 
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_prunable_tx_hash(const crypto::hash& h, crypto::hash &prunable_hash) const;
+
+  virtual uint64_t prune(uint64_t height);
+  virtual uint64_t get_pruned_height() const;
 
   virtual uint64_t get_tx_count() const;
 
@@ -276,6 +296,9 @@ public:
   virtual bool block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) const;
   virtual void block_rtxn_stop() const;
 
+  virtual void start_read_session() const;
+  virtual void end_read_session() const;
+
   virtual void pop_block(block& blk, std::vector<transaction>& txs);
 
   virtual bool can_thread_bulk_indices() const { return true; }
@@ -291,12 +314,35 @@ public:
    */
   std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff) const;
 
+  bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution) const;
+
+  virtual bool get_block_pow_hash(const crypto::hash &id, uint8_t hf_version, crypto::hash &pow) const;
+  virtual void add_block_pow_hash(const crypto::hash &id, uint64_t height, uint8_t hf_version, const crypto::hash &pow);
+  virtual uint64_t prune_block_pow_hashes(uint64_t height);
+
+  /**
+   * @brief re-encode all stored block and transaction blobs with the given codec
+   *
+   * The codec is recorded in the properties table, and blobs added afterwards
+   * are encoded with it too. The conversion is done in chunks and resumes on
+   * the next open if interrupted.
+   *
+   * @param codec the codec to use, blob_codec_none to store raw blobs again
+   */
+  void set_blob_codec(blob_codec_t codec);
+
+  blob_codec_t get_blob_codec() const { return m_blob_codec; }
+
 private:
   void do_resize(uint64_t size_increase=0);
 
   bool need_resize(uint64_t threshold_size=0) const;
   void check_and_resize_for_batch(uint64_t batch_num_blocks);
   uint64_t get_estimated_batch_size(uint64_t batch_num_blocks) const;
+  uint64_t get_estimated_block_size(uint64_t block_size) const;
+  bool batch_need_resize(uint64_t threshold_size) const;
+  void batch_resize();
+  void batch_txn_begin();
 
   virtual void add_block( const block& blk
                 , const size_t& block_size
@@ -326,6 +372,13 @@ private:
 
   void remove_output(const uint64_t amount, const uint64_t& out_index);
 
+  // maintain output_amount_counts as outputs are added and removed
+  void add_output_amount_count(const uint64_t amount, const uint64_t height, const uint64_t count);
+  void remove_output_amount_count(const uint64_t amount);
+
+  // number of outputs of an amount in the blocks up to and including height
+  uint64_t get_output_amount_count(MDB_cursor *cur_output_amount_counts, const uint64_t amount, const uint64_t height) const;
+
   virtual void add_spent_key(const crypto::key_image& k_image);
 
   virtual void remove_spent_key(const crypto::key_image& k_image);
@@ -366,6 +419,19 @@ private:
   // migrate from DB version 0 to 1
   void migrate_0_1();
 
+  // migrate from DB version 1 to 2
+  void migrate_1_2();
+
+  // migrate from DB version 2 to 3
+  void migrate_2_3();
+
+  // encode and decode the values of the blocks, txs_pruned and txs_prunable tables
+  MDB_val encode_blob(const char *data, size_t size, std::string &buffer) const;
+  void decode_blob(const MDB_val &v, cryptonote::blobdata &bd) const;
+
+  // re-encode all blobs with the codec given to set_blob_codec, resumable
+  void convert_blobs();
+
   void cleanup_batch();
 
 private:
@@ -375,12 +441,16 @@ private:
   MDB_dbi m_block_heights;
   MDB_dbi m_block_info;
 
-  MDB_dbi m_txs;
+  MDB_dbi m_txs; // pre version 2 tx blobs, only used by the migrations
+  MDB_dbi m_txs_pruned;
+  MDB_dbi m_txs_prunable;
+  MDB_dbi m_txs_prunable_hash;
   MDB_dbi m_tx_indices;
   MDB_dbi m_tx_outputs;
 
   MDB_dbi m_output_txs;
   MDB_dbi m_output_amounts;
+  MDB_dbi m_output_amount_counts;
 
   MDB_dbi m_spent_keys;
 
@@ -388,6 +458,7 @@ private:
   MDB_dbi m_txpool_blob;
 
   MDB_dbi m_hf_starting_heights;
+  MDB_dbi m_pow_cache; // only opened read/write, see open()
   MDB_dbi m_hf_versions;
 
   MDB_dbi m_properties;
@@ -400,7 +471,13 @@ private:
   boost::thread::id m_writer;
 
   bool m_batch_transactions; // support for batch transactions
+  bool m_tagged_blobs; // whether blobs are stored with blob_encode, false on older DBs
+  blob_codec_t m_blob_codec; // codec new blobs are encoded with, if m_tagged_blobs
   bool m_batch_active; // whether batch transaction is in progress
+  uint64_t m_batch_num_blocks; // number of blocks the batch was started for, 0 if unknown
+  uint64_t m_batch_blocks; // number of blocks added in the current batch
+  uint64_t m_batch_committed_blocks; // number of blocks of the batch committed by batch_resize()
+  uint64_t m_batch_size; // estimated size of the data not yet committed by the batch txn
 
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
@@ -52,6 +52,7 @@ bool opt_batch   = true;
 bool opt_verify  = true; // use add_new_block, which does verification before calling add_block
 bool opt_resume  = true;
 bool opt_testnet = true;
+bool opt_bulk    = false; // trusted file: parse in parallel and add without verification
 
 // number of blocks per batch transaction
 // adjustable through command-line argument according to available RAM
@@ -509,6 +510,120 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   return 0;
 }
 
+// Imports a trusted bootstrap file without verification. Blocks are decoded
+// and hashed on all other cores while the previous ones are added to the
+// database. Block hashes are still checked against the compiled in block
+// hashes, and each block must follow the previous one.
+int import_bulk(cryptonote::core& core, const std::string& import_file_path, uint64_t block_stop=0)
+{
+  Blockchain& storage = core.get_blockchain_storage();
+  BlockchainDB& db = storage.get_db();
+  db.reset_stats();
+
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(boost::filesystem::path(import_file_path), ec))
+  {
+    MFATAL("bootstrap file not found: " << import_file_path);
+    return 1;
+  }
+
+  BootstrapReader reader;
+  if (!reader.open(import_file_path))
+  {
+    MFATAL("Failed to open bootstrap file " << import_file_path);
+    return 1;
+  }
+  const uint64_t total_source_blocks = reader.count_blocks();
+  MINFO("bootstrap file last block number: " << total_source_blocks-1 << " (zero-based height)  total blocks: " << total_source_blocks);
+
+  uint64_t start_height = 1;
+  if (opt_resume)
+    start_height = db.height();
+  if (! block_stop || block_stop >= total_source_blocks)
+    block_stop = total_source_blocks - 1;
+  MINFO("start block: " << start_height << "  stop block: " << block_stop);
+  if (!storage.is_within_compiled_block_hash_area(block_stop))
+    MWARNING("Blocks above the compiled in block hashes will be added without any verification");
+
+  tools::thread_group threadpool;
+  MINFO("Bulk importing with " << threadpool.count() + 1 << " threads");
+
+  // runs on the decoding threads, so add_block finds the block and miner tx hashes cached
+  auto prepare = [&storage](uint64_t height, bootstrap::block_package& bp) -> bool {
+    const crypto::hash hash = get_block_hash(bp.block);
+    get_transaction_hash(bp.block.miner_tx);
+    crypto::hash expected_hash;
+    if (storage.get_compiled_block_hash(height, expected_hash) && expected_hash != hash)
+    {
+      MERROR("Block hash at height " << height << " does not match the compiled in block hashes");
+      return false;
+    }
+    return true;
+  };
+
+  uint64_t num_imported = 0;
+  crypto::hash prev_hash = db.top_block_hash();
+  auto consume = [&](uint64_t height, bootstrap::block_package& bp) -> bool {
+    if (bp.block.prev_id != prev_hash)
+    {
+      std::cout << refresh_string;
+      MFATAL("Block at height " << height << " does not follow the previous block");
+      return false;
+    }
+    try
+    {
+      db.add_block(bp.block, bp.block_size, bp.cumulative_difficulty, bp.coins_generated, bp.txs);
+    }
+    catch (const std::exception& e)
+    {
+      std::cout << refresh_string;
+      MFATAL("Error adding block to blockchain: " << e.what());
+      return false;
+    }
+    prev_hash = get_block_hash(bp.block);
+    ++num_imported;
+
+    if (height % 100 == 0)
+      std::cout << refresh_string << "block " << height << " / " << block_stop << std::flush;
+    if (opt_batch && height % db_batch_size == 0)
+    {
+      std::cout << refresh_string;
+      std::cout << ENDL << "[- batch commit at height " << height << " -]" << ENDL;
+      db.batch_stop();
+      db.batch_start(db_batch_size);
+      std::cout << ENDL;
+      db.show_stats();
+    }
+    return true;
+  };
+
+  if (opt_batch)
+    db.batch_start(db_batch_size);
+
+  const bool ok = reader.for_each_block_package(start_height, block_stop + 1, threadpool, prepare, consume);
+
+  if (opt_batch)
+  {
+    if (!ok)
+    {
+      // There was an error, so don't commit pending data.
+      // Destructor will abort write txn.
+    }
+    else
+    {
+      db.batch_stop();
+    }
+  }
+
+  std::cout << refresh_string;
+  db.show_stats();
+  MINFO("Number of blocks imported: " << num_imported);
+  MINFO("Finished at block: " << start_height + num_imported - 1 << "  total blocks: " << start_height + num_imported);
+
+  std::cout << ENDL;
+  return ok ? 0 : 2;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -559,6 +674,9 @@ int main(int argc, char* argv[])
     "Batch transactions for faster import", true};
   const command_line::arg_descriptor<bool> arg_resume =  {"resume",
     "Resume from current height if output database already exists", true};
+  const command_line::arg_descriptor<bool> arg_bulk =  {"bulk",
+    "Fast import of a trusted file: parse blocks in parallel and add them without verification, "
+    "only checking the compiled in block hashes", false};
 
   //command_line::add_arg(desc_cmd_sett, command_line::arg_data_dir, default_data_path.string());
   //command_line::add_arg(desc_cmd_sett, command_line::arg_testnet_data_dir, default_testnet_data_path.string());
@@ -568,6 +686,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_database);
   command_line::add_arg(desc_cmd_sett, arg_batch_size);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_bulk);
 
   command_line::add_arg(desc_cmd_only, arg_count_blocks);
   command_line::add_arg(desc_cmd_only, arg_pop_blocks);
@@ -601,6 +720,7 @@ int main(int argc, char* argv[])
   opt_resume    = command_line::get_arg(vm, arg_resume);
   block_stop    = command_line::get_arg(vm, arg_block_stop);
   db_batch_size = command_line::get_arg(vm, arg_batch_size);
+  opt_bulk      = command_line::get_arg(vm, arg_bulk);
 
   if (command_line::get_arg(vm, command_line::arg_help))
   {
@@ -619,6 +739,15 @@ int main(int argc, char* argv[])
     std::cerr << "Error: batch-size must be > 0" << ENDL;
     return 1;
   }
+  if (opt_bulk)
+  {
+    if (! vm["verify"].defaulted() && opt_verify)
+    {
+      std::cerr << "Error: bulk import does not verify blocks, use --verify 0" << ENDL;
+      return 1;
+    }
+    opt_verify = false;
+  }
   if (opt_verify && vm["batch-size"].defaulted())
   {
     // usually want batch size default lower if verify on, so progress can be
@@ -691,6 +820,7 @@ int main(int argc, char* argv[])
     MINFO("batch:   " << std::boolalpha << opt_batch << std::noboolalpha);
   }
   MINFO("resume:  " << std::boolalpha << opt_resume  << std::noboolalpha);
+  MINFO("bulk:    " << std::boolalpha << opt_bulk    << std::noboolalpha);
   MINFO("testnet: " << std::boolalpha << opt_testnet << std::noboolalpha);
 
   MINFO("bootstrap file path: " << import_file_path);
@@ -727,7 +857,10 @@ int main(int argc, char* argv[])
     return 0;
   }
 
-  import_from_file(core, import_file_path, block_stop);
+  if (opt_bulk)
+    import_bulk(core, import_file_path, block_stop);
+  else
+    import_from_file(core, import_file_path, block_stop);
 
   // ensure db closed
   //   - transactions properly checked and handled
@@ -37,4 +37,6 @@
 #define CHUNK_SIZE_WARNING_THRESHOLD 500000
 #define NUM_BLOCKS_PER_CHUNK 1
 #define BLOCKCHAIN_RAW "blockchain.raw"
+// suffix of the chunk index written next to a raw file
+#define BLOCKCHAIN_RAW_INDEX_SUFFIX ".index"
 
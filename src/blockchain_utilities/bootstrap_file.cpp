@@ -31,6 +31,8 @@
 #include "serialization/json_utils.h" // dump_json()
 
 #include "bootstrap_file.h"
+#include "common/task_region.h"
+#include "file_io_utils.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "bcutil"
@@ -45,6 +47,8 @@ namespace
   // This number was picked by taking the leading 4 bytes from this output:
   // echo Fonero bootstrap file | sha1sum
   const uint32_t blockchain_raw_magic = 0x28721586;
+  // echo Fonero bootstrap index | sha1sum
+  const uint32_t chunk_index_magic = 0xd29d1c49;
   const uint32_t header_size = 1024;
 
   std::string refresh_string = "\r                                    \r";
@@ -76,6 +80,9 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
   }
 
   m_raw_data_file = new std::ofstream();
+  m_raw_file_path = file_path.string();
+  m_chunk_offsets.clear();
+  m_store_chunk_index = true;
 
   bool do_initialize_file = false;
   uint64_t num_blocks = 0;
@@ -88,7 +95,17 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
   }
   else
   {
-    num_blocks = count_blocks(file_path.string());
+    BootstrapReader reader;
+    if (reader.open(file_path.string()))
+    {
+      num_blocks = reader.count_blocks();
+      m_chunk_offsets = reader.get_chunk_offsets();
+    }
+    else
+    {
+      num_blocks = count_blocks(file_path.string());
+      m_store_chunk_index = false;
+    }
     MDEBUG("appending to existing file with height: " << num_blocks-1 << "  total blocks: " << num_blocks);
   }
   m_height = num_blocks;
@@ -185,6 +202,7 @@ void BootstrapFile::flush_chunk()
   {
     throw std::runtime_error("Error in serialization of chunk size");
   }
+  m_chunk_offsets.push_back(m_raw_data_file->tellp());
   *m_raw_data_file << blob;
 
   if (m_max_chunk < chunk_size)
@@ -258,6 +276,10 @@ bool BootstrapFile::close()
   m_raw_data_file->flush();
   delete m_output_stream;
   delete m_raw_data_file;
+
+  // an index failing to be written only makes the next reader scan the file
+  if (m_store_chunk_index)
+    store_chunk_index(m_raw_file_path, m_chunk_offsets);
   return true;
 }
 
@@ -384,6 +406,17 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path)
     MFATAL("bootstrap file not found: " << raw_file_path);
     throw std::runtime_error("Aborting");
   }
+
+  {
+    BootstrapReader reader;
+    if (reader.open(import_file_path))
+    {
+      std::cout << "Number of blocks: " << reader.count_blocks() << ENDL;
+      std::cout << ENDL;
+      return reader.count_blocks();
+    }
+  }
+  // the file could not be mapped (e.g. too large for the address space), scan it
   std::ifstream import_file;
   import_file.open(import_file_path, std::ios_base::binary | std::ifstream::in);
 
@@ -476,3 +509,230 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path)
   // one-based height.
   return h;
 }
+
+bool BootstrapFile::store_chunk_index(const std::string& import_file_path, const std::vector<uint64_t>& chunk_offsets)
+{
+  bootstrap::chunk_index index;
+  boost::system::error_code ec;
+  index.file_size = boost::filesystem::file_size(import_file_path, ec);
+  if (ec)
+  {
+    MERROR("Failed to get size of " << import_file_path << ": " << ec.message());
+    return false;
+  }
+  index.chunk_offsets = chunk_offsets;
+
+  std::string blob;
+  if (! ::serialization::dump_binary(chunk_index_magic, blob))
+    throw std::runtime_error("Error in serialization of chunk index magic");
+  blob += t_serializable_object_to_blob(index);
+  if (!epee::file_io_utils::save_string_to_file(import_file_path + BLOCKCHAIN_RAW_INDEX_SUFFIX, blob))
+  {
+    MERROR("Failed to write chunk index for " << import_file_path);
+    return false;
+  }
+  return true;
+}
+
+BootstrapReader::BootstrapReader(): m_data(NULL), m_size(0), m_first_chunk(0), m_has_chunk_index(false)
+{
+}
+
+bool BootstrapReader::open(const std::string& import_file_path)
+{
+  try
+  {
+    boost::interprocess::file_mapping file(import_file_path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+    region.advise(boost::interprocess::mapped_region::advice_sequential);
+    m_file.swap(file);
+    m_region.swap(region);
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Failed to map bootstrap file " << import_file_path << ": " << e.what());
+    return false;
+  }
+  m_data = static_cast<const char*>(m_region.get_address());
+  m_size = m_region.get_size();
+
+  // 4 byte magic, then the header
+  uint32_t file_magic;
+  uint32_t buflen_file_info;
+  bootstrap::file_info bfi;
+  if (m_size < sizeof(file_magic) + sizeof(buflen_file_info)
+      || ! ::serialization::parse_binary(std::string(m_data, sizeof(file_magic)), file_magic)
+      || ! ::serialization::parse_binary(std::string(m_data + sizeof(file_magic), sizeof(buflen_file_info)), buflen_file_info)
+      || m_size < sizeof(file_magic) + sizeof(buflen_file_info) + buflen_file_info
+      || ! ::serialization::parse_binary(std::string(m_data + sizeof(file_magic) + sizeof(buflen_file_info), buflen_file_info), bfi))
+  {
+    MFATAL("Error in deserialization of bootstrap file header");
+    return false;
+  }
+  if (file_magic != blockchain_raw_magic)
+  {
+    MFATAL("bootstrap file not recognized");
+    return false;
+  }
+  m_first_chunk = sizeof(file_magic) + bfi.header_size;
+
+  m_has_chunk_index = load_chunk_index(import_file_path);
+  if (!m_has_chunk_index)
+  {
+    MINFO("No valid chunk index for " << import_file_path << ", scanning it...");
+    if (!scan_chunks())
+      return false;
+  }
+  MINFO("bootstrap file has " << count_blocks() << " blocks");
+  return true;
+}
+
+bool BootstrapReader::load_chunk_index(const std::string& import_file_path)
+{
+  const std::string index_path = import_file_path + BLOCKCHAIN_RAW_INDEX_SUFFIX;
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(index_path, ec))
+    return false;
+
+  std::string blob;
+  uint32_t magic;
+  bootstrap::chunk_index index;
+  if (!epee::file_io_utils::load_file_to_string(index_path, blob)
+      || blob.size() < sizeof(magic)
+      || ! ::serialization::parse_binary(blob.substr(0, sizeof(magic)), magic)
+      || magic != chunk_index_magic
+      || ! ::serialization::parse_binary(blob.substr(sizeof(magic)), index))
+  {
+    MWARNING("Failed to load chunk index " << index_path);
+    return false;
+  }
+  if (index.file_size != m_size)
+  {
+    MINFO("Chunk index " << index_path << " is stale");
+    return false;
+  }
+  // the scan would have found the same chunks if they are in order and in the file
+  uint64_t pos = m_first_chunk;
+  for (uint64_t offset: index.chunk_offsets)
+  {
+    if (offset < pos || offset + sizeof(uint32_t) > m_size)
+    {
+      MWARNING("Invalid chunk index " << index_path);
+      return false;
+    }
+    pos = offset + sizeof(uint32_t);
+  }
+  m_chunk_offsets = std::move(index.chunk_offsets);
+  return true;
+}
+
+bool BootstrapReader::scan_chunks()
+{
+  m_chunk_offsets.clear();
+  uint64_t pos = m_first_chunk;
+  uint32_t chunk_size;
+  while (pos + sizeof(chunk_size) <= m_size)
+  {
+    if (! ::serialization::parse_binary(std::string(m_data + pos, sizeof(chunk_size)), chunk_size))
+    {
+      MFATAL("Error in deserialization of chunk_size at " << pos);
+      return false;
+    }
+    if (chunk_size == 0 || chunk_size > BUFFER_SIZE)
+    {
+      MFATAL("Invalid chunk_size " << chunk_size << "  height: " << m_chunk_offsets.size());
+      return false;
+    }
+    if (pos + sizeof(chunk_size) + chunk_size > m_size)
+    {
+      MWARNING("End of file reached - file was truncated");
+      break;
+    }
+    m_chunk_offsets.push_back(pos);
+    pos += sizeof(chunk_size) + chunk_size;
+  }
+  return true;
+}
+
+bool BootstrapReader::get_chunk(uint64_t index, std::string& chunk) const
+{
+  if (index >= m_chunk_offsets.size())
+    return false;
+  const uint64_t offset = m_chunk_offsets[index];
+  uint32_t chunk_size;
+  if (! ::serialization::parse_binary(std::string(m_data + offset, sizeof(chunk_size)), chunk_size))
+    return false;
+  if (chunk_size > BUFFER_SIZE || offset + sizeof(chunk_size) + chunk_size > m_size)
+    return false;
+  chunk.assign(m_data + offset + sizeof(chunk_size), chunk_size);
+  return true;
+}
+
+bool BootstrapReader::get_block_package(uint64_t height, bootstrap::block_package& bp) const
+{
+  // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
+  std::string chunk;
+  return get_chunk(height / NUM_BLOCKS_PER_CHUNK, chunk) && ::serialization::parse_binary(chunk, bp);
+}
+
+bool BootstrapReader::for_each_block_package(uint64_t start, uint64_t stop, tools::thread_group& threads,
+    const block_handler& prepare, const block_handler& consume) const
+{
+  struct decoded_block
+  {
+    bootstrap::block_package bp;
+    bool ok;
+  };
+  // enough to keep all threads busy while the previous group is consumed
+  const uint64_t group_size = 1000;
+
+  auto decode_group = [&](tools::task_region_handle& region, std::vector<decoded_block>& group, uint64_t first) {
+    for (size_t i = 0; i < group.size(); ++i)
+    {
+      region.run([&, i, first] {
+        decoded_block& d = group[i];
+        try
+        {
+          d.ok = get_block_package(first + i, d.bp) && (!prepare || prepare(first + i, d.bp));
+        }
+        catch (const std::exception& e)
+        {
+          MERROR("Exception while decoding block " << first + i << ": " << e.what());
+          d.ok = false;
+        }
+      });
+    }
+  };
+
+  stop = std::min(stop, count_blocks());
+  if (start >= stop)
+    return true;
+
+  std::vector<decoded_block> group(std::min(group_size, stop - start));
+  tools::task_region(threads, [&] (tools::task_region_handle& region) {
+    decode_group(region, group, start);
+  });
+
+  bool ok = true;
+  for (uint64_t first = start; ok && first < stop; )
+  {
+    const uint64_t next_first = first + group.size();
+    std::vector<decoded_block> next_group(std::min(group_size, stop - next_first));
+    tools::task_region(threads, [&] (tools::task_region_handle& region) {
+      decode_group(region, next_group, next_first);
+      for (size_t i = 0; ok && i < group.size(); ++i)
+      {
+        if (!group[i].ok)
+        {
+          MERROR("Failed to decode block " << first + i << " from bootstrap file");
+          ok = false;
+        }
+        else
+          ok = consume(first + i, group[i].bp);
+      }
+    });
+    group.swap(next_group);
+    first = next_first;
+  }
+  return ok;
+}
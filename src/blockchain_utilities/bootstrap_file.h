@@ -33,6 +33,8 @@
 #include <boost/iostreams/device/back_inserter.hpp>
 
 #include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_core/blockchain.h"
@@ -42,11 +44,14 @@
 #include <fstream>
 #include <boost/iostreams/copy.hpp>
 #include <atomic>
+#include <functional>
 
 #include "common/command_line.h"
+#include "common/thread_group.h"
 #include "version.h"
 
 #include "blockchain_utilities.h"
+#include "bootstrap_serialization.h"
 
 
 using namespace cryptonote;
@@ -62,6 +67,9 @@ public:
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
       boost::filesystem::path& output_file, uint64_t use_block_height=0);
 
+  // writes the chunk index of a raw file, see BootstrapReader
+  static bool store_chunk_index(const std::string& import_file_path, const std::vector<uint64_t>& chunk_offsets);
+
 protected:
 
   Blockchain* m_blockchain_storage;
@@ -84,4 +92,58 @@ private:
   uint64_t m_height;
   uint64_t m_cur_height; // tracks current height during export
   uint32_t m_max_chunk;
+  std::string m_raw_file_path;
+  std::vector<uint64_t> m_chunk_offsets; // for the chunk index
+  bool m_store_chunk_index; // false if the chunks of an appended file are not known
+};
+
+/**
+ * @brief memory mapped reader of a raw bootstrap file
+ *
+ * Chunks are found with the index written by store_blockchain_raw, or by
+ * scanning the chunk sizes if there is no index or it is stale, so counting
+ * blocks and seeking to one is cheap.
+ */
+class BootstrapReader
+{
+public:
+  //! called with the height of a block and its package, returns false to stop
+  typedef std::function<bool(uint64_t height, bootstrap::block_package& bp)> block_handler;
+
+  BootstrapReader();
+
+  bool open(const std::string& import_file_path);
+
+  uint64_t count_blocks() const { return m_chunk_offsets.size() * NUM_BLOCKS_PER_CHUNK; }
+  bool has_chunk_index() const { return m_has_chunk_index; }
+  const std::vector<uint64_t>& get_chunk_offsets() const { return m_chunk_offsets; }
+
+  bool get_chunk(uint64_t index, std::string& chunk) const;
+  bool get_block_package(uint64_t height, bootstrap::block_package& bp) const;
+
+  /**
+   * @brief decodes the blocks from start to stop (excluded) on a thread group
+   *
+   * Blocks are decoded in groups; the next group is decoded while the
+   * previous one is passed to consume.
+   *
+   * @param prepare optional, called on the decoding thread of each block
+   * @param consume called for each block in order, on the calling thread
+   *
+   * @return false if a block could not be decoded or a handler returned false
+   */
+  bool for_each_block_package(uint64_t start, uint64_t stop, tools::thread_group& threads,
+      const block_handler& prepare, const block_handler& consume) const;
+
+private:
+  bool load_chunk_index(const std::string& import_file_path);
+  bool scan_chunks();
+
+  boost::interprocess::file_mapping m_file;
+  boost::interprocess::mapped_region m_region;
+  const char* m_data;
+  uint64_t m_size;
+  uint64_t m_first_chunk;
+  std::vector<uint64_t> m_chunk_offsets;
+  bool m_has_chunk_index;
 };
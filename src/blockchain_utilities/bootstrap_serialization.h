@@ -66,6 +66,22 @@ namespace cryptonote
       END_SERIALIZE()
     };
 
+    // chunk index of a raw file, kept in a separate file so the raw file
+    // format is unchanged
+    struct chunk_index
+    {
+      // size of the raw file when the index was written, a raw file with
+      // another size was appended to and the index is stale
+      uint64_t file_size;
+      // file positions of the chunks, each at its chunk size field
+      std::vector<uint64_t> chunk_offsets;
+
+      BEGIN_SERIALIZE_OBJECT()
+        VARINT_FIELD(file_size);
+        FIELD(chunk_offsets);
+      END_SERIALIZE()
+    };
+
     struct block_package
     {
       cryptonote::block block;
@@ -107,11 +107,21 @@ namespace command_line
   , "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[nblocks_per_sync]."
   , "fast:async:1000"
   };
+  const command_line::arg_descriptor<uint64_t> arg_db_sync_latency = {
+    "db-sync-latency"
+  , "Max time in ms a tx pool db sync may be delayed to group it with others, in safe sync mode. New blocks are synced at once and are on disk before they are relayed"
+  , 100
+  };
   const arg_descriptor<bool> arg_db_salvage  = {
     "db-salvage"
   , "Try to salvage a blockchain database if it seems corrupted"
   , false
   };
+  const arg_descriptor<bool> arg_prune_blockchain  = {
+    "prune-blockchain"
+  , "Drop the signatures and range proofs of transactions deeply buried in the blockchain"
+  , false
+  };
   const command_line::arg_descriptor<uint64_t> arg_fast_block_sync = {
     "fast-block-sync"
   , "Sync up most of the way by using embedded, known block hashes."
@@ -214,7 +214,9 @@ namespace command_line
   extern const arg_descriptor<bool> arg_dns_checkpoints;
   extern const arg_descriptor<std::string> arg_db_type;
   extern const arg_descriptor<std::string> arg_db_sync_mode;
+  extern const arg_descriptor<uint64_t> arg_db_sync_latency;
   extern const arg_descriptor<bool, false> arg_db_salvage;
+  extern const arg_descriptor<bool, false> arg_prune_blockchain;
   extern const arg_descriptor<uint64_t> arg_fast_block_sync;
   extern const arg_descriptor<uint64_t> arg_prep_blocks_threads;
   extern const arg_descriptor<uint64_t> arg_show_time_stats;
@@ -31,6 +31,7 @@
 #include <string>
 #include <stdio.h>
 #include "misc_log_ex.h"
+#include "metrics.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "perf"
@@ -46,7 +47,7 @@ extern __thread std::vector<PerformanceTimer*> *performance_timers;
 class PerformanceTimer
 {
 public:
-  PerformanceTimer(const std::string &s, uint64_t unit, el::Level l = el::Level::Debug): name(s), unit(unit), level(l), started(false)
+  PerformanceTimer(const std::string &s, uint64_t unit, el::Level l = el::Level::Debug, epee::metrics::histogram *metric = NULL): name(s), unit(unit), level(l), metric(metric), started(false)
   {
     ticks = epee::misc_utils::get_ns_count();
     if (!performance_timers)
@@ -70,6 +71,8 @@ public:
   {
     performance_timers->pop_back();
     ticks = epee::misc_utils::get_ns_count() - ticks;
+    if (metric)
+      metric->record(ticks);
     char s[12];
     snprintf(s, sizeof(s), "%8llu  ", (unsigned long long)ticks / (1000000000 / unit));
     MLOG(level, "PERF " << s << std::string(performance_timers->size() * 2, ' ') << "  " << name);
@@ -84,14 +87,17 @@ private:
   std::string name;
   uint64_t unit;
   el::Level level;
+  epee::metrics::histogram *metric;
   uint64_t ticks;
   bool started;
 };
 
 void set_performance_timer_log_level(el::Level level);
 
-#define PERF_TIMER_UNIT(name, unit) tools::PerformanceTimer pt_##name(#name, unit, tools::performance_timer_log_level)
-#define PERF_TIMER_UNIT_L(name, unit, l) tools::PerformanceTimer pt_##name(#name, unit, l)
+// every timer also feeds the perf_timer_seconds{timer="name"} histogram, whatever the log level
+#define PERF_TIMER_METRIC(name) static epee::metrics::histogram &pt_metric_##name = epee::metrics::registry::instance().get_histogram("perf_timer_seconds", "Time spent in sections timed with PERF_TIMER", "timer", #name)
+#define PERF_TIMER_UNIT(name, unit) PERF_TIMER_METRIC(name); tools::PerformanceTimer pt_##name(#name, unit, tools::performance_timer_log_level, &pt_metric_##name)
+#define PERF_TIMER_UNIT_L(name, unit, l) PERF_TIMER_METRIC(name); tools::PerformanceTimer pt_##name(#name, unit, l, &pt_metric_##name)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000, l)
 
@@ -0,0 +1,247 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <vector>
+#include "string_tools.h"
+#include "trace.h"
+
+#undef FONERO_DEFAULT_LOG_CATEGORY
+#define FONERO_DEFAULT_LOG_CATEGORY "trace"
+
+namespace tools
+{
+namespace trace
+{
+  std::atomic<bool> g_enabled(false);
+
+  namespace
+  {
+    static const size_t ring_size = 4096; // power of two
+    static const boost::posix_time::milliseconds flush_period(100);
+
+    //! Single producer (the thread) single consumer (the flusher) ring
+    struct thread_buffer
+    {
+      thread_buffer(uint64_t tid): tid(tid), events(new event[ring_size]), head(0), tail(0), exited(false) {}
+
+      const uint64_t tid;
+      std::unique_ptr<event[]> events;
+      std::atomic<uint64_t> head;
+      std::atomic<uint64_t> tail;
+      std::atomic<bool> exited;
+    };
+
+    //! Owned by the thread, lets the flusher free the buffer of a thread which exited
+    struct thread_buffer_ref
+    {
+      std::shared_ptr<thread_buffer> buffer;
+      ~thread_buffer_ref() { buffer->exited = true; }
+    };
+
+    struct tracer
+    {
+      tracer(): next_tid(1), file(NULL), first_event(true), stopping(false), events(0), dropped(0) {}
+
+      boost::mutex lock; // guards buffers and the flusher's lifetime, not the file
+      std::list<std::shared_ptr<thread_buffer>> buffers;
+      uint64_t next_tid;
+      std::string filename;
+      FILE *file;
+      bool first_event;
+      bool stopping;
+      boost::condition_variable wakeup;
+      boost::thread flusher;
+      std::atomic<uint64_t> events;
+      std::atomic<uint64_t> dropped;
+    };
+
+    tracer &get_tracer()
+    {
+      static tracer t;
+      return t;
+    }
+
+    boost::thread_specific_ptr<thread_buffer_ref> current_buffer;
+
+    thread_buffer *get_thread_buffer()
+    {
+      thread_buffer_ref *ref = current_buffer.get();
+      if (!ref)
+      {
+        tracer &t = get_tracer();
+        ref = new thread_buffer_ref();
+        boost::unique_lock<boost::mutex> lock(t.lock);
+        ref->buffer = std::make_shared<thread_buffer>(t.next_tid++);
+        t.buffers.push_back(ref->buffer);
+        current_buffer.reset(ref);
+      }
+      return ref->buffer.get();
+    }
+
+    void write_event(tracer &t, uint64_t tid, const event &e)
+    {
+      // ids and heights are the args shown when a span is selected
+      std::string args;
+      if (e.has_id)
+        args += "\"id\":\"" + epee::string_tools::pod_to_hex(e.id) + "\"";
+      if (e.has_height)
+        args += std::string(args.empty() ? "" : ",") + "\"height\":" + std::to_string(e.height);
+      fprintf(t.file, "%s{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{%s}}",
+          t.first_event ? "\n" : ",\n", e.category, e.name, (unsigned long long)tid, e.start_ns / 1000.0, e.duration_ns / 1000.0, args.c_str());
+      t.first_event = false;
+      ++t.events;
+    }
+
+    //! Only called from the flusher, which is the only one to touch the file and buffer tails
+    void drain(tracer &t)
+    {
+      std::vector<std::shared_ptr<thread_buffer>> buffers;
+      {
+        boost::unique_lock<boost::mutex> lock(t.lock);
+        buffers.assign(t.buffers.begin(), t.buffers.end());
+      }
+      for (const auto &b: buffers)
+      {
+        const uint64_t head = b->head.load(std::memory_order_acquire);
+        uint64_t tail = b->tail.load(std::memory_order_relaxed);
+        for (; tail != head; ++tail)
+          write_event(t, b->tid, b->events[tail & (ring_size - 1)]);
+        b->tail.store(tail, std::memory_order_release);
+      }
+      fflush(t.file);
+
+      boost::unique_lock<boost::mutex> lock(t.lock);
+      t.buffers.remove_if([](const std::shared_ptr<thread_buffer> &b) {
+        return b->exited && b->tail.load(std::memory_order_relaxed) == b->head.load(std::memory_order_acquire);
+      });
+    }
+
+    void flush_loop()
+    {
+      tracer &t = get_tracer();
+      while (true)
+      {
+        bool stopping;
+        {
+          boost::unique_lock<boost::mutex> lock(t.lock);
+          if (!t.stopping)
+            t.wakeup.timed_wait(lock, flush_period);
+          stopping = t.stopping;
+        }
+        drain(t);
+        if (stopping)
+          break;
+      }
+    }
+  }
+
+  bool start(const std::string &filename)
+  {
+    tracer &t = get_tracer();
+    boost::unique_lock<boost::mutex> lock(t.lock);
+    if (t.file)
+    {
+      MERROR("Already tracing to " << t.filename);
+      return false;
+    }
+    t.file = fopen(filename.c_str(), "w");
+    if (!t.file)
+    {
+      MERROR("Failed to open " << filename << " for writing");
+      return false;
+    }
+    fprintf(t.file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    t.filename = filename;
+    t.first_event = true;
+    t.stopping = false;
+    t.events = 0;
+    t.dropped = 0;
+    // events which were recorded too late to make it in the previous trace
+    for (const auto &b: t.buffers)
+      b->tail.store(b->head.load(std::memory_order_acquire), std::memory_order_release);
+    t.flusher = boost::thread(flush_loop);
+    g_enabled = true;
+    MINFO("Tracing to " << filename);
+    return true;
+  }
+
+  bool stop(status *final_status)
+  {
+    tracer &t = get_tracer();
+    {
+      boost::unique_lock<boost::mutex> lock(t.lock);
+      if (!t.file || t.stopping)
+        return false;
+      g_enabled = false;
+      t.stopping = true;
+    }
+    t.wakeup.notify_all();
+    t.flusher.join();
+
+    boost::unique_lock<boost::mutex> lock(t.lock);
+    fprintf(t.file, "\n]}\n");
+    fclose(t.file);
+    t.file = NULL;
+    MINFO("Stopped tracing to " << t.filename << ", " << t.events << " events, " << t.dropped << " dropped");
+    if (final_status)
+      *final_status = status{t.filename, t.events, t.dropped};
+    return true;
+  }
+
+  bool get_status(status &s)
+  {
+    tracer &t = get_tracer();
+    boost::unique_lock<boost::mutex> lock(t.lock);
+    if (!t.file)
+      return false;
+    s = status{t.filename, t.events, t.dropped};
+    return true;
+  }
+
+  void record(const event &e)
+  {
+    thread_buffer *b = get_thread_buffer();
+    const uint64_t head = b->head.load(std::memory_order_relaxed);
+    if (head - b->tail.load(std::memory_order_acquire) >= ring_size)
+    {
+      ++get_tracer().dropped;
+      return;
+    }
+    b->events[head & (ring_size - 1)] = e;
+    b->head.store(head + 1, std::memory_order_release);
+  }
+}
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include "crypto/hash.h"
+#include "misc_log_ex.h"
+
+namespace tools
+{
+namespace trace
+{
+  //! Checked by every trace scope, so a disabled trace costs a relaxed load
+  extern std::atomic<bool> g_enabled;
+
+  inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+  //! A timed span, written as a Chrome "complete" event
+  struct event
+  {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    const char *category; //!< must be a string literal, it is formatted later on another thread
+    const char *name; //!< ditto
+    uint64_t height;
+    crypto::hash id;
+    bool has_id;
+    bool has_height;
+  };
+
+  /*! Starts recording events and writing them to `filename`, in Chrome
+  trace event format (chrome://tracing, Perfetto). Events go to a ring
+  buffer per thread, which a background thread flushes to the file. */
+  bool start(const std::string &filename);
+
+  struct status
+  {
+    std::string filename;
+    uint64_t events; //!< written to the file so far
+    uint64_t dropped; //!< lost because a ring buffer was full
+  };
+
+  //! Stops recording and completes the file, \return false if not tracing
+  bool stop(status *final_status = NULL);
+
+  //! \return false if not tracing
+  bool get_status(status &s);
+
+  void record(const event &e);
+
+  //! Records the time between construction and destruction (or end()) if tracing is enabled at construction
+  class scope
+  {
+  public:
+    scope(const char *category, const char *name): m_active(enabled())
+    {
+      if (m_active)
+        init(category, name);
+    }
+
+    scope(const char *category, const char *name, const crypto::hash &id): m_active(enabled())
+    {
+      if (m_active)
+      {
+        init(category, name);
+        set_id(id);
+      }
+    }
+
+    ~scope() { end(); }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+    //! For ids only known once the span started
+    void set_id(const crypto::hash &id) { if (m_active) { m_event.id = id; m_event.has_id = true; } }
+    void set_height(uint64_t height) { if (m_active) { m_event.height = height; m_event.has_height = true; } }
+
+    void end()
+    {
+      if (!m_active)
+        return;
+      m_active = false;
+      m_event.duration_ns = epee::misc_utils::get_ns_count() - m_event.start_ns;
+      record(m_event);
+    }
+
+  private:
+    void init(const char *category, const char *name)
+    {
+      m_event.category = category;
+      m_event.name = name;
+      m_event.has_id = false;
+      m_event.has_height = false;
+      m_event.start_ns = epee::misc_utils::get_ns_count();
+    }
+
+    bool m_active;
+    event m_event;
+  };
+}
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(category, name) tools::trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define TRACE_SCOPE_ID(category, name, id) tools::trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(category, name, id)
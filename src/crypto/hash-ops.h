@@ -79,7 +79,14 @@ enum {
 };
 
 void cn_fast_hash(const void *data, size_t length, char *hash);
+/* cn_fast_hash of `count` consecutive 64 byte inputs, e.g. pairs of hashes; hash may overlap data if it doesn't start after it */
+void cn_fast_hash_64_batch(const void *data, size_t count, char *hash);
 void cn_slow_hash(const void *data, size_t length, char *hash, int variant);
+/* 2 and 4 independent cn_slow_hash, interleaved for throughput; each way needs its own scratchpad, see slow_hash_allocate_state_ways */
+void cn_slow_hash_x2(const void *const data[2], const size_t length[2], char *const hash[2], int variant);
+void cn_slow_hash_x4(const void *const data[4], const size_t length[4], char *const hash[4], int variant);
+void slow_hash_allocate_state_ways(size_t ways);
+size_t slow_hash_huge_page_states(void);
 
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
@@ -48,3 +48,7 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_64_batch(const void *data, size_t count, char *hash) {
+  keccak_64_batch(data, count, (uint8_t*)hash);
+}
@@ -67,10 +67,25 @@ namespace crypto {
     return h;
   }
 
+  inline void cn_fast_hash_64_batch(const void *data, std::size_t count, hash *hashes) {
+    cn_fast_hash_64_batch(data, count, reinterpret_cast<char *>(hashes));
+  }
+
   inline void cn_slow_hash(const void *data, std::size_t length, hash &hash, int variant = 0) {
     cn_slow_hash(data, length, reinterpret_cast<char *>(&hash), variant);
   }
 
+  inline void cn_slow_hash_x2(const void *const data[2], const std::size_t length[2], hash *hashes, int variant = 0) {
+    char *const out[2] = {reinterpret_cast<char *>(&hashes[0]), reinterpret_cast<char *>(&hashes[1])};
+    cn_slow_hash_x2(data, length, out, variant);
+  }
+
+  inline void cn_slow_hash_x4(const void *const data[4], const std::size_t length[4], hash *hashes, int variant = 0) {
+    char *const out[4] = {reinterpret_cast<char *>(&hashes[0]), reinterpret_cast<char *>(&hashes[1]),
+      reinterpret_cast<char *>(&hashes[2]), reinterpret_cast<char *>(&hashes[3])};
+    cn_slow_hash_x4(data, length, out, variant);
+  }
+
   inline void tree_hash(const hash *hashes, std::size_t count, hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
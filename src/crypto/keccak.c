@@ -110,3 +110,115 @@ void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md)
 {
     keccak(in, inlen, md, sizeof(state_t));
 }
+
+#if defined(__GNUC__)
+
+// 4 independent states, lane i of every state in one vector, so each
+// step of the permutation is done for all of them by one SIMD op
+typedef uint64_t keccak_x4_lanes __attribute__((vector_size(32)));
+
+static inline __attribute__((always_inline)) void keccakf_x4_rounds(keccak_x4_lanes st[25])
+{
+    int i, j, round;
+    keccak_x4_lanes t, bc[5];
+
+    for (round = 0; round < KECCAK_ROUNDS; round++) {
+
+        // Theta
+        for (i = 0; i < 5; i++)
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+
+        for (i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+            for (j = 0; j < 25; j += 5)
+                st[j + i] ^= t;
+        }
+
+        // Rho Pi
+        t = st[1];
+        for (i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            bc[0] = st[j];
+            st[j] = ROTL64(t, keccakf_rotc[i]);
+            t = bc[0];
+        }
+
+        //  Chi
+        for (j = 0; j < 25; j += 5) {
+            for (i = 0; i < 5; i++)
+                bc[i] = st[j + i];
+            for (i = 0; i < 5; i++)
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        //  Iota
+        const keccak_x4_lanes rc = {keccakf_rndc[round], keccakf_rndc[round], keccakf_rndc[round], keccakf_rndc[round]};
+        st[0] ^= rc;
+    }
+}
+
+static void keccakf_x4_generic(keccak_x4_lanes st[25])
+{
+    keccakf_x4_rounds(st);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) static void keccakf_x4_avx2(keccak_x4_lanes st[25])
+{
+    keccakf_x4_rounds(st);
+}
+#endif
+
+static void keccakf_x4(keccak_x4_lanes st[25])
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static int use_avx2 = -1;
+    if (use_avx2 < 0)
+        use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    if (use_avx2) {
+        keccakf_x4_avx2(st);
+        return;
+    }
+#endif
+    keccakf_x4_generic(st);
+}
+
+// hash 4 inputs of 64 bytes, each fits in one block with the padding
+static void keccak_64_x4(const uint8_t *in, uint8_t *md)
+{
+    keccak_x4_lanes st[25];
+    uint64_t lane;
+    int i, w;
+
+    memset(st, 0, sizeof(st));
+    for (w = 0; w < 4; w++) {
+        for (i = 0; i < 8; i++) {
+            memcpy(&lane, in + w * 64 + i * 8, sizeof(lane));
+            st[i][w] = lane;
+        }
+        st[8][w] = 0x01;
+        st[HASH_DATA_AREA / 8 - 1][w] = 0x8000000000000000ull;
+    }
+
+    keccakf_x4(st);
+
+    // all the inputs are read by now, md may overlap them
+    for (w = 0; w < 4; w++) {
+        for (i = 0; i < 4; i++) {
+            lane = st[i][w];
+            memcpy(md + w * 32 + i * 8, &lane, sizeof(lane));
+        }
+    }
+}
+
+#endif
+
+void keccak_64_batch(const uint8_t *in, size_t count, uint8_t *md)
+{
+#if defined(__GNUC__)
+    for ( ; count >= 4; count -= 4, in += 4 * 64, md += 4 * 32)
+        keccak_64_x4(in, md);
+#endif
+    for ( ; count > 0; --count, in += 64, md += 32)
+        keccak(in, 64, md, 32);
+}
@@ -23,4 +23,8 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
+// 32 byte hashes of `count` consecutive 64 byte inputs, several at once where SIMD allows
+// md may overlap in, as long as it doesn't start after it
+void keccak_64_batch(const uint8_t *in, size_t count, uint8_t *md);
+
 #endif
@@ -0,0 +1,191 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "merkle_tree.h"
+
+namespace crypto {
+
+  //! nodes in the level above the leaves, tree_hash_cnt() for 3 leaves or more
+  static std::size_t get_level_size(std::size_t count) {
+    std::size_t cnt = 1;
+    while (2 * cnt < count)
+      cnt <<= 1;
+    return cnt;
+  }
+
+  //! hash the consecutive runs of `nodes` (sorted) in `level` from the pairs in `below`
+  static void hash_runs(const std::vector<std::size_t> &nodes, const hash *below, hash *level) {
+    for (std::size_t i = 0; i < nodes.size(); ) {
+      std::size_t end = i + 1;
+      while (end < nodes.size() && nodes[end] == nodes[end - 1] + 1)
+        ++end;
+      cn_fast_hash_64_batch(below + 2 * nodes[i], end - i, level + nodes[i]);
+      i = end;
+    }
+  }
+
+  merkle_tree::merkle_tree(): m_split(0), m_moved_from(0) {
+  }
+
+  merkle_tree::merkle_tree(std::vector<hash> leaves): m_split(0), m_moved_from(0) {
+    assign(std::move(leaves));
+  }
+
+  void merkle_tree::assign(std::vector<hash> leaves) {
+    m_leaves = std::move(leaves);
+    m_levels.clear();
+    m_set.clear();
+    m_moved_from = 0;
+  }
+
+  void merkle_tree::append(const hash &leaf) {
+    m_leaves.push_back(leaf);
+    moved_from(m_leaves.size() - 1);
+  }
+
+  void merkle_tree::insert(std::size_t index, const hash &leaf) {
+    if (index > m_leaves.size())
+      throw std::out_of_range("merkle_tree::insert");
+    m_leaves.insert(m_leaves.begin() + index, leaf);
+    moved_from(index);
+  }
+
+  void merkle_tree::erase(std::size_t index) {
+    if (index >= m_leaves.size())
+      throw std::out_of_range("merkle_tree::erase");
+    m_leaves.erase(m_leaves.begin() + index);
+    moved_from(index);
+  }
+
+  void merkle_tree::set(std::size_t index, const hash &leaf) {
+    if (index >= m_leaves.size())
+      throw std::out_of_range("merkle_tree::set");
+    m_leaves[index] = leaf;
+    m_set.push_back(index);
+  }
+
+  void merkle_tree::moved_from(std::size_t index) {
+    m_moved_from = std::min(m_moved_from, index);
+  }
+
+  const hash &merkle_tree::root() {
+    if (m_leaves.empty())
+      throw std::logic_error("merkle_tree::root with no leaves");
+    update();
+    return m_levels.back()[0];
+  }
+
+  void merkle_tree::update() {
+    const std::size_t count = m_leaves.size();
+    const std::size_t cnt = get_level_size(count);
+    const std::size_t split = count == 1 ? 1 : 2 * cnt - count;
+
+    // the nodes of the first level to rehash, sorted
+    std::vector<std::size_t> nodes;
+    if (m_levels.empty() || m_levels[0].size() != cnt) {
+      m_levels.clear();
+      for (std::size_t size = cnt; ; size >>= 1) {
+        m_levels.push_back(std::vector<hash>(size));
+        if (size == 1)
+          break;
+      }
+      m_split = split;
+      nodes.resize(cnt);
+      for (std::size_t node = 0; node < cnt; ++node)
+        nodes[node] = node;
+    } else {
+      std::size_t first_moved = cnt;
+      if (m_moved_from < count || split != m_split) {
+        // the leaves after a move are paired differently if the split moved too
+        first_moved = std::min(m_moved_from, count);
+        first_moved = split != m_split ? std::min({first_moved, split, m_split}) : first_moved;
+        m_split = split;
+        first_moved = std::min(get_node(first_moved), cnt);
+      }
+      for (std::size_t leaf: m_set) {
+        const std::size_t node = get_node(leaf);
+        if (node < first_moved)
+          nodes.push_back(node);
+      }
+      std::sort(nodes.begin(), nodes.end());
+      nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+      for (std::size_t node = first_moved; node < cnt; ++node)
+        nodes.push_back(node);
+    }
+    m_set.clear();
+    m_moved_from = count;
+
+    // first level: copies below the split, pairs above
+    std::vector<hash> &first = m_levels[0];
+    std::vector<std::size_t> pairs;
+    for (std::size_t node: nodes) {
+      if (node < m_split)
+        first[node] = m_leaves[node];
+      else
+        pairs.push_back(node - m_split);
+    }
+    hash_runs(pairs, m_leaves.data() + m_split, first.data() + m_split);
+
+    // then each level from the pairs of nodes below
+    for (std::size_t level = 1; level < m_levels.size(); ++level) {
+      for (std::size_t &node: nodes)
+        node >>= 1;
+      nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+      hash_runs(nodes, m_levels[level - 1].data(), m_levels[level].data());
+    }
+  }
+
+  hash merkle_tree::root_with_leaf(std::size_t index, const hash &leaf) const {
+    if (index >= m_leaves.size())
+      throw std::out_of_range("merkle_tree::root_with_leaf");
+    assert(m_set.empty() && m_moved_from == m_leaves.size() && !m_levels.empty());
+
+    std::size_t node = get_node(index);
+    hash pair[2];
+    hash h = leaf;
+    if (index >= m_split) {
+      const std::size_t left = m_split + 2 * (node - m_split);
+      pair[0] = left == index ? leaf : m_leaves[left];
+      pair[1] = left == index ? m_leaves[left + 1] : leaf;
+      cn_fast_hash(pair, sizeof(pair), h);
+    }
+    for (std::size_t level = 0; level + 1 < m_levels.size(); ++level, node >>= 1) {
+      pair[node & 1] = h;
+      pair[~node & 1] = m_levels[level][node ^ 1];
+      cn_fast_hash(pair, sizeof(pair), h);
+    }
+    return h;
+  }
+
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "hash.h"
+
+namespace crypto {
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  //! The tree tree_hash() builds over a list of hashes, kept so changes only rehash their part
+  /*! The leaves above the split are hashed in pairs, the ones below are copied
+  up, so the level above has a power of two nodes and the rest is a full binary
+  tree. Setting a leaf rehashes its path to the root. Inserting or removing one
+  moves the leaves after it and the split, so the nodes from there on are
+  rehashed, the ones before are kept. */
+  class merkle_tree {
+  public:
+    merkle_tree();
+    explicit merkle_tree(std::vector<hash> leaves);
+
+    std::size_t size() const { return m_leaves.size(); }
+    const hash &operator[](std::size_t index) const { return m_leaves[index]; }
+
+    void assign(std::vector<hash> leaves);
+    void append(const hash &leaf);
+    void insert(std::size_t index, const hash &leaf);
+    void erase(std::size_t index);
+    void set(std::size_t index, const hash &leaf);
+
+    //! the same as tree_hash() over the leaves, needs at least one leaf
+    const hash &root();
+
+    //! the root if leaf `index` was `leaf`, without changing the tree; root() must have been called after the last change
+    hash root_with_leaf(std::size_t index, const hash &leaf) const;
+
+  private:
+    std::size_t get_node(std::size_t leaf) const { return leaf < m_split ? leaf : m_split + (leaf - m_split) / 2; }
+    void moved_from(std::size_t index);
+    void update();
+
+    std::vector<hash> m_leaves;
+    std::vector<std::vector<hash>> m_levels; //!< from the level above the leaves up to the root
+    std::size_t m_split;                     //!< leaves before it are copied up, the others hashed in pairs
+    std::vector<std::size_t> m_set;          //!< leaves set since the last update
+    std::size_t m_moved_from;                //!< leaves from there on moved since the last update, size() if none
+  };
+
+}
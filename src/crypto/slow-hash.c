@@ -45,6 +45,7 @@
 #define AES_KEY_SIZE    32
 #define INIT_SIZE_BLK   8
 #define INIT_SIZE_BYTE (INIT_SIZE_BLK * AES_BLOCK_SIZE)
+#define MAX_WAYS        4 // most hashes cn_slow_hash_ways interleaves
 
 extern int aesb_single_round(const uint8_t *in, uint8_t*out, const uint8_t *expandedKey);
 extern int aesb_pseudo_round(const uint8_t *in, uint8_t *out, const uint8_t *expandedKey);
@@ -203,6 +204,9 @@ union cn_slow_hash_state
 
 THREADV uint8_t *hp_state = NULL;
 THREADV int hp_allocated = 0;
+// scratchpads of the other ways of cn_slow_hash_x2/x4, hp_state being the first
+THREADV uint8_t *hp_extra_state[MAX_WAYS - 1];
+THREADV int hp_extra_allocated[MAX_WAYS - 1];
 
 #if defined(_MSC_VER)
 #define cpuid(info,x)    __cpuidex(info,x,0)
@@ -474,66 +478,142 @@ BOOL SetLockPagesPrivilege(HANDLE hProcess, BOOL bEnable)
 #endif
 
 /**
- * @brief allocate the 2MB scratch buffer using OS support for huge pages, if available
+ * @brief allocate a 2MB scratch buffer using OS support for huge pages, if available
  *
  * This function tries to allocate the 2MB scratch buffer using a single
  * 2MB "huge page" (instead of the usual 4KB page sizes) to reduce TLB misses
  * during the random accesses to the scratch buffer.  This is one of the
  * important speed optimizations needed to make CryptoNight faster.
  *
- * No parameters.  Updates a thread-local pointer, hp_state, to point to
- * the allocated buffer.
+ * @param allocated set to 1 if the buffer is a huge page, 0 if it comes from malloc
+ * @return the buffer
  */
 
-void slow_hash_allocate_state(void)
+static uint8_t *allocate_scratchpad(int *allocated)
 {
-    if(hp_state != NULL)
-        return;
+    uint8_t *state = NULL;
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
     SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
-    hp_state = (uint8_t *) VirtualAlloc(hp_state, MEMORY, MEM_LARGE_PAGES |
-                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    state = (uint8_t *) VirtualAlloc(NULL, MEMORY, MEM_LARGE_PAGES |
+                                     MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 #else
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
   defined(__DragonFly__)
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANON, 0, 0);
+    state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANON, 0, 0);
 #else
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 0, 0);
+    state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 0, 0);
 #endif
-    if(hp_state == MAP_FAILED)
-        hp_state = NULL;
+    if(state == MAP_FAILED)
+        state = NULL;
 #endif
-    hp_allocated = 1;
-    if(hp_state == NULL)
+    *allocated = 1;
+    if(state == NULL)
+    {
+        *allocated = 0;
+        state = (uint8_t *) malloc(MEMORY);
+    }
+    return state;
+}
+
+static void free_scratchpad(uint8_t *state, int allocated)
+{
+    if(!allocated)
+        free(state);
+    else
     {
-        hp_allocated = 0;
-        hp_state = (uint8_t *) malloc(MEMORY);
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        VirtualFree(state, MEMORY, MEM_RELEASE);
+#else
+        munmap(state, MEMORY);
+#endif
     }
 }
 
 /**
- *@brief frees the state allocated by slow_hash_allocate_state
+ * @brief allocate the 2MB scratch buffer of this thread, see allocate_scratchpad
+ *
+ * No parameters.  Updates a thread-local pointer, hp_state, to point to
+ * the allocated buffer.
  */
 
-void slow_hash_free_state(void)
+void slow_hash_allocate_state(void)
 {
-    if(hp_state == NULL)
+    if(hp_state != NULL)
         return;
 
-    if(!hp_allocated)
-        free(hp_state);
-    else
+    hp_state = allocate_scratchpad(&hp_allocated);
+}
+
+/**
+ * @brief allocate the scratch buffers used by cn_slow_hash_x2/x4
+ *
+ * Each way of an interleaved hash gets its own 2MB buffer, so a thread
+ * hashing with <ways> ways should call this once before its first hash.
+ *
+ * @param ways the number of scratch buffers needed, including hp_state
+ */
+
+void slow_hash_allocate_state_ways(size_t ways)
+{
+    size_t i;
+
+    slow_hash_allocate_state();
+    for(i = 1; i < ways && i < MAX_WAYS; i++)
     {
-#if defined(_MSC_VER) || defined(__MINGW32__)
-        VirtualFree(hp_state, MEMORY, MEM_RELEASE);
+        if(hp_extra_state[i - 1] == NULL)
+            hp_extra_state[i - 1] = allocate_scratchpad(&hp_extra_allocated[i - 1]);
+    }
+}
+
+/**
+ * @brief counts the scratch buffers of this thread which got huge pages
+ *
+ * allocate_scratchpad silently falls back to malloc, this lets callers
+ * report it.
+ *
+ * @return the number of huge page scratch buffers, including hp_state
+ */
+
+size_t slow_hash_huge_page_states(void)
+{
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+  defined(__DragonFly__)
+    // mapped without asking for huge pages, see allocate_scratchpad
+    return 0;
 #else
-        munmap(hp_state, MEMORY);
+    size_t i, count = hp_state != NULL && hp_allocated;
+
+    for(i = 0; i < MAX_WAYS - 1; i++)
+        count += hp_extra_state[i] != NULL && hp_extra_allocated[i];
+    return count;
 #endif
+}
+
+/**
+ *@brief frees the states allocated by slow_hash_allocate_state and slow_hash_allocate_state_ways
+ */
+
+void slow_hash_free_state(void)
+{
+    size_t i;
+
+    for(i = 0; i < MAX_WAYS - 1; i++)
+    {
+        if(hp_extra_state[i] == NULL)
+            continue;
+        free_scratchpad(hp_extra_state[i], hp_extra_allocated[i]);
+        hp_extra_state[i] = NULL;
+        hp_extra_allocated[i] = 0;
     }
 
+    if(hp_state == NULL)
+        return;
+
+    free_scratchpad(hp_state, hp_allocated);
+
     hp_state = NULL;
     hp_allocated = 0;
 }
@@ -700,6 +780,123 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant)
     extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
 }
 
+/**
+ * @brief CryptoNight of several independent inputs, with their step 3 interleaved
+ *
+ * The mixing loop of a single hash is bound by the latency of its random
+ * scratchpad reads and leaves the AES and multiply units mostly idle.  Running
+ * the loops of 2 to MAX_WAYS hashes side by side, each in its own scratchpad,
+ * lets those reads overlap.  The other steps are throughput bound and are run
+ * one way after the other.  Without AES-NI this is just cn_slow_hash per input.
+ *
+ * @param inputs the data to hash, one per way
+ * @param lengths the length in bytes of each input
+ * @param hashes buffers in which the 256 bit hashes will be stored
+ * @param ways the number of inputs, at most MAX_WAYS
+ */
+
+STATIC INLINE void cn_slow_hash_ways(const void *const *inputs, const size_t *lengths, char *const *hashes, size_t ways, int variant)
+{
+    RDATA_ALIGN16 uint8_t expandedKey[240];
+
+    uint8_t text[INIT_SIZE_BYTE];
+    RDATA_ALIGN16 uint64_t way_a[MAX_WAYS][2];
+    RDATA_ALIGN16 uint64_t way_c[MAX_WAYS][2];
+    __m128i way_b[MAX_WAYS];
+    uint64_t way_tweak1_2[MAX_WAYS];
+    uint8_t *way_state[MAX_WAYS];
+    union cn_slow_hash_state state[MAX_WAYS];
+
+    size_t i, w;
+
+    static void (*const extra_hashes[4])(const void *, size_t, char *) =
+    {
+        hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
+    };
+
+    if(force_software_aes() || !check_aes_hw())
+    {
+        for(w = 0; w < ways; w++)
+            cn_slow_hash(inputs[w], lengths[w], hashes[w], variant);
+        return;
+    }
+
+    slow_hash_allocate_state_ways(ways);
+    way_state[0] = hp_state;
+    for(w = 1; w < ways; w++)
+        way_state[w] = hp_extra_state[w - 1];
+
+    /* CryptoNight Steps 1 and 2, for each way */
+
+    for(w = 0; w < ways; w++)
+    {
+        const void *const data = inputs[w];
+        const size_t length = lengths[w];
+        RDATA_ALIGN16 uint64_t b[2];
+
+        hash_process(&state[w].hs, data, length);
+        memcpy(text, state[w].init, INIT_SIZE_BYTE);
+
+        if(variant > 0)
+        {
+            VARIANT1_CHECK();
+        }
+        way_tweak1_2[w] = variant > 0 ? (state[w].hs.w[24] ^ (*((const uint64_t*)NONCE_POINTER))) : 0;
+
+        aes_expand_key(state[w].hs.b, expandedKey);
+        for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+        {
+            aes_pseudo_round(text, text, expandedKey, INIT_SIZE_BLK);
+            memcpy(&way_state[w][i * INIT_SIZE_BYTE], text, INIT_SIZE_BYTE);
+        }
+
+        U64(way_a[w])[0] = U64(&state[w].k[0])[0] ^ U64(&state[w].k[32])[0];
+        U64(way_a[w])[1] = U64(&state[w].k[0])[1] ^ U64(&state[w].k[32])[1];
+        U64(b)[0] = U64(&state[w].k[16])[0] ^ U64(&state[w].k[48])[0];
+        U64(b)[1] = U64(&state[w].k[16])[1] ^ U64(&state[w].k[48])[1];
+        way_b[w] = _mm_load_si128(R128(b));
+    }
+
+    /* CryptoNight Step 3, one iteration of each way in turn.  The locals
+     * below are named after the ones pre_aes() and post_aes() work on.
+     */
+
+    for(i = 0; i < ITER / 2; i++)
+    {
+        for(w = 0; w < ways; w++)
+        {
+            uint8_t *const hp_state = way_state[w];
+            uint64_t *const a = way_a[w];
+            uint64_t *const c = way_c[w];
+            const uint64_t tweak1_2 = way_tweak1_2[w];
+            uint64_t b[2];
+            __m128i _a, _c, _b = way_b[w];
+            uint64_t hi, lo;
+            uint64_t *p;
+            size_t j;
+
+            pre_aes();
+            _c = _mm_aesenc_si128(_c, _a);
+            post_aes();
+            way_b[w] = _b;
+        }
+    }
+
+    /* CryptoNight Steps 4 and 5, for each way */
+
+    for(w = 0; w < ways; w++)
+    {
+        memcpy(text, state[w].init, INIT_SIZE_BYTE);
+        aes_expand_key(&state[w].hs.b[32], expandedKey);
+        for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+            aes_pseudo_round_xor(text, text, expandedKey, &way_state[w][i * INIT_SIZE_BYTE], INIT_SIZE_BLK);
+
+        memcpy(state[w].init, text, INIT_SIZE_BYTE);
+        hash_permutation(&state[w].hs);
+        extra_hashes[state[w].hs.b[0] & 3](&state[w], 200, hashes[w]);
+    }
+}
+
 #elif !defined NO_AES && (defined(__arm__) || defined(__aarch64__))
 void slow_hash_allocate_state(void)
 {
@@ -707,12 +904,32 @@ void slow_hash_allocate_state(void)
   return;
 }
 
+void slow_hash_allocate_state_ways(size_t ways)
+{
+  // As above
+  return;
+}
+
+size_t slow_hash_huge_page_states(void)
+{
+  // No huge pages here
+  return 0;
+}
+
 void slow_hash_free_state(void)
 {
   // As above
   return;
 }
 
+// No interleaving on ARM, each way is hashed on its own
+static void cn_slow_hash_ways(const void *const *inputs, const size_t *lengths, char *const *hashes, size_t ways, int variant)
+{
+  size_t w;
+  for(w = 0; w < ways; w++)
+    cn_slow_hash(inputs[w], lengths[w], hashes[w], variant);
+}
+
 #if defined(__GNUC__)
 #define RDATA_ALIGN16 __attribute__ ((aligned(16)))
 #define STATIC static
@@ -1208,12 +1425,32 @@ void slow_hash_allocate_state(void)
   return;
 }
 
+void slow_hash_allocate_state_ways(size_t ways)
+{
+  // As above
+  return;
+}
+
+size_t slow_hash_huge_page_states(void)
+{
+  // No huge pages here
+  return 0;
+}
+
 void slow_hash_free_state(void)
 {
   // As above
   return;
 }
 
+// No interleaving in the portable code, each way is hashed on its own
+static void cn_slow_hash_ways(const void *const *inputs, const size_t *lengths, char *const *hashes, size_t ways, int variant)
+{
+  size_t w;
+  for(w = 0; w < ways; w++)
+    cn_slow_hash(inputs[w], lengths[w], hashes[w], variant);
+}
+
 static void (*const extra_hashes[4])(const void *, size_t, char *) = {
   hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
 };
@@ -1365,3 +1602,13 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int variant) {
 }
 
 #endif
+
+void cn_slow_hash_x2(const void *const data[2], const size_t length[2], char *const hash[2], int variant)
+{
+  cn_slow_hash_ways(data, length, hash, 2, variant);
+}
+
+void cn_slow_hash_x4(const void *const data[4], const size_t length[4], char *const hash[4], int variant)
+{
+  cn_slow_hash_ways(data, length, hash, 4, variant);
+}
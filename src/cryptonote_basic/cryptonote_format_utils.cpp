@@ -620,9 +620,13 @@ namespace cryptonote
   }
   //---------------------------------------------------------------
   blobdata get_block_hashing_blob(const block& b)
+  {
+    return get_block_hashing_blob(b, get_tx_tree_hash(b));
+  }
+  //---------------------------------------------------------------
+  blobdata get_block_hashing_blob(const block& b, const crypto::hash& tree_root_hash)
   {
     blobdata blob = t_serializable_object_to_blob(static_cast<block_header>(b));
-    crypto::hash tree_root_hash = get_tx_tree_hash(b);
     blob.append(reinterpret_cast<const char*>(&tree_root_hash), sizeof(tree_root_hash));
     blob.append(tools::get_varint_data(b.tx_hashes.size()+1));
     return blob;
@@ -696,6 +700,28 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
+  bool get_block_longhashes(const block* blocks, size_t count, crypto::hash* res, uint64_t height, uint8_t hf_version)
+  {
+    CHECK_AND_ASSERT_MES(count <= 4, false, "Too many blocks to hash at once: " << count);
+    blobdata bd[4];
+    const void *data[4];
+    size_t length[4];
+    for (size_t n = 0; n < count; ++n)
+    {
+      bd[n] = get_block_hashing_blob(blocks[n]);
+      data[n] = bd[n].data();
+      length[n] = bd[n].size();
+    }
+    const int variant = hf_version >= 3 ? 1 : 0;
+    if (count == 4)
+      crypto::cn_slow_hash_x4(data, length, res, variant);
+    else if (count == 2)
+      crypto::cn_slow_hash_x2(data, length, res, variant);
+    else for (size_t n = 0; n < count; ++n)
+      crypto::cn_slow_hash(data[n], length[n], res[n], variant);
+    return true;
+  }
+  //---------------------------------------------------------------
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b)
   {
     std::stringstream ss;
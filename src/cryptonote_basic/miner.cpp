@@ -29,7 +29,10 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <sstream>
+#include <fstream>
 #include <numeric>
+#include <map>
+#include <algorithm>
 #include <boost/utility/value_init.hpp>
 #include <boost/interprocess/detail/atomic.hpp>
 #include <boost/limits.hpp>
@@ -43,6 +46,11 @@
 #include "storages/portable_storage_template_helper.h"
 #include "boost/logic/tribool.hpp"
 
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
 #ifdef __APPLE__
   #include <sys/times.h>
   #include <IOKit/IOKitLib.h>
@@ -61,7 +69,6 @@ using namespace epee;
 #include "miner.h"
 
 
-extern "C" void slow_hash_allocate_state();
 extern "C" void slow_hash_free_state();
 namespace cryptonote
 {
@@ -71,6 +78,7 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<bool>        arg_mining_pin_threads =  {"mining-pin-threads", "pin mining threads to cpus, spread over L3 caches and cores (Linux only)", true, true};
     const command_line::arg_descriptor<bool>        arg_bg_mining_enable =  {"bg-mining-enable", "enable/disable background mining", true, true};
     const command_line::arg_descriptor<bool>        arg_bg_mining_ignore_battery =  {"bg-mining-ignore-battery", "if true, assumes plugged in when unable to query system power status", false, true};
     const command_line::arg_descriptor<uint64_t>    arg_bg_mining_min_idle_interval_seconds =  {"bg-mining-min-idle-interval", "Specify min lookback interval in seconds for determining idle state", miner::BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS, true};
@@ -88,6 +96,9 @@ namespace cryptonote
     m_height(0),
     m_pausers_count(0),
     m_threads_total(0),
+    m_hash_ways(1),
+    m_pin_threads(true),
+    m_huge_pages_threads(0),
     m_starter_nonce(0),
     m_last_hr_merge_time(0),
     m_hashes(0),
@@ -173,8 +184,12 @@ namespace cryptonote
   {
     if(m_last_hr_merge_time && is_mining())
     {
-      m_current_hash_rate = m_hashes * 1000 / ((misc_utils::get_tick_count() - m_last_hr_merge_time + 1));
+      const uint64_t elapsed = misc_utils::get_tick_count() - m_last_hr_merge_time + 1;
+      m_current_hash_rate = m_hashes * 1000 / elapsed;
       CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+      m_threads_hash_rates.resize(m_threads_hashes.size());
+      for (size_t i = 0; i < m_threads_hashes.size(); ++i)
+        m_threads_hash_rates[i] = m_threads_hashes[i].exchange(0) * 1000 / elapsed;
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
         m_last_hash_rates.pop_front();
@@ -194,6 +209,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_mining_pin_threads);
     command_line::add_arg(desc, arg_bg_mining_enable);
     command_line::add_arg(desc, arg_bg_mining_ignore_battery);
     command_line::add_arg(desc, arg_bg_mining_min_idle_interval_seconds);
@@ -240,6 +256,8 @@ namespace cryptonote
         m_threads_total = command_line::get_arg(vm, arg_mining_threads);
       }
     }
+    if(command_line::has_arg(vm, arg_mining_pin_threads))
+      m_pin_threads = command_line::get_arg(vm, arg_mining_pin_threads);
 
     // Background mining parameters
     // Let init set all parameters even if background mining is not enabled, they can start later with params set
@@ -271,6 +289,18 @@ namespace cryptonote
     return m_threads_total;
   }
   //-----------------------------------------------------------------------------------------------------
+  uint32_t miner::get_huge_pages_threads_count() const {
+    return m_huge_pages_threads;
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> miner::get_threads_speed() const
+  {
+    if(!is_mining())
+      return std::vector<uint64_t>();
+    CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+    return m_threads_hash_rates;
+  }
+  //-----------------------------------------------------------------------------------------------------
   bool miner::start(const account_public_address& adr, size_t threads_count, const boost::thread::attributes& attrs, bool do_background, bool ignore_battery)
   {
     m_mine_address = adr;
@@ -289,9 +319,28 @@ namespace cryptonote
       return false;
     }
 
+    // only now that no worker thread is left to use them
+    m_hash_ways = get_hash_ways(threads_count);
+    m_mining_cpus = m_pin_threads ? get_mining_cpus() : std::vector<unsigned>();
+    m_huge_pages_threads = 0;
+    {
+      CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+      m_threads_hashes = std::vector<std::atomic<uint64_t>>(threads_count);
+      m_threads_hash_rates.clear();
+    }
+
     if(!m_template_no)
       request_block_template();//lets update block template
 
+    // the scratchpads silently fall back to normal pages, say so upfront
+    uint64_t free_huge_pages, total_huge_pages;
+    const uint64_t needed_huge_pages = threads_count * m_hash_ways;
+    if (get_free_huge_pages(free_huge_pages, total_huge_pages) && free_huge_pages < needed_huge_pages)
+    {
+      MWARNING("Only " << free_huge_pages << " free huge pages for " << needed_huge_pages << " mining scratchpads, mining will be slower."
+          << " Reserve more with: sysctl vm.nr_hugepages=" << total_huge_pages + needed_huge_pages - free_huge_pages);
+    }
+
     boost::interprocess::ipcdetail::atomic_write32(&m_stop, 0);
     boost::interprocess::ipcdetail::atomic_write32(&m_thread_index, 0);
     set_is_background_mining_enabled(do_background);
@@ -303,6 +352,7 @@ namespace cryptonote
     }
 
     LOG_PRINT_L0("Mining has started with " << threads_count << " threads, good luck!" );
+    MINFO("Each mining thread hashes " << m_hash_ways << " nonces at once");
 
     if( get_is_background_mining_enabled() )
     {
@@ -418,8 +468,23 @@ namespace cryptonote
     uint64_t height = 0;
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
-    block b;
-    slow_hash_allocate_state();
+    const uint32_t ways = m_hash_ways;
+    block b[4];
+    crypto::hash h[4];
+    // pin before allocating, so the scratchpads are first touched, hence allocated, on the local NUMA node
+    if (!m_mining_cpus.empty())
+    {
+      const unsigned cpu = m_mining_cpus[th_local_index % m_mining_cpus.size()];
+      if (pin_thread(cpu))
+        MINFO("Miner thread " << th_local_index << " pinned to cpu " << cpu);
+      else
+        MWARNING("Failed to pin miner thread " << th_local_index << " to cpu " << cpu);
+    }
+    slow_hash_allocate_state_ways(ways);
+    if (slow_hash_huge_page_states() >= ways)
+      ++m_huge_pages_threads;
+    else
+      MWARNING("Miner thread " << th_local_index << " could not get huge pages for its scratchpads, it will be slower");
     while(!m_stop)
     {
       if(m_pausers_count)//anti split workaround
@@ -444,7 +509,8 @@ namespace cryptonote
       if(local_template_ver != m_template_no)
       {
         CRITICAL_REGION_BEGIN(m_template_lock);
-        b = m_template;
+        for (uint32_t w = 0; w < ways; ++w)
+          b[w] = m_template;
         local_diff = m_diffic;
         height = m_height;
         CRITICAL_REGION_END();
@@ -459,16 +525,19 @@ namespace cryptonote
         continue;
       }
 
-      b.nonce = nonce;
-      crypto::hash h;
-      get_block_longhash(b, h, height);
+      // the ways of a thread take its next nonces, so threads never overlap
+      for (uint32_t w = 0; w < ways; ++w)
+        b[w].nonce = nonce + w * m_threads_total;
+      get_block_longhashes(b, ways, h, height);
 
-      if(check_hash(h, local_diff))
+      for (uint32_t w = 0; w < ways; ++w)
       {
+        if(!check_hash(h[w], local_diff))
+          continue;
         //we lucky!
         ++m_config.current_extra_message_index;
         MGINFO_GREEN("Found block for difficulty: " << local_diff);
-        if(!m_phandler->handle_block_found(b))
+        if(!m_phandler->handle_block_found(b[w]))
         {
           --m_config.current_extra_message_index;
         }else
@@ -477,9 +546,11 @@ namespace cryptonote
           if (!m_config_folder_path.empty())
             epee::serialization::store_t_to_json_file(m_config, m_config_folder_path + "/" + MINER_CONFIG_FILE_NAME);
         }
+        break;
       }
-      nonce+=m_threads_total;
-      ++m_hashes;
+      nonce+=m_threads_total * ways;
+      m_hashes += ways;
+      m_threads_hashes[th_local_index] += ways;
     }
     slow_hash_free_state();
     MGINFO("Miner thread stopped ["<< th_local_index << "]");
@@ -820,6 +891,146 @@ namespace cryptonote
     return false; // unsupported system..
   }
   //-----------------------------------------------------------------------------------------------------
+  uint64_t miner::get_l3_cache_size()
+  {
+    #if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+
+      const long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+      if (size > 0)
+        return size;
+
+    #endif
+
+    #if defined(__linux__)
+
+      // e.g. "8192K", for kernels/libcs where sysconf does not know
+      std::ifstream size_stream("/sys/devices/system/cpu/cpu0/cache/index3/size");
+      uint64_t size_kb = 0;
+      if (size_stream >> size_kb)
+        return size_kb * 1024;
+
+    #endif
+
+    return 0; // unknown
+  }
+  //-----------------------------------------------------------------------------------------------------
+  uint32_t miner::get_hash_ways(size_t threads_count)
+  {
+    // each way needs its own 2 MB scratchpad, and they only help while they all fit in L3
+    static const uint64_t scratchpad_size = 1 << 21;
+    const uint64_t l3_size = get_l3_cache_size();
+    if (threads_count == 0 || l3_size == 0)
+      return 1;
+    const uint64_t scratchpads = l3_size / (threads_count * scratchpad_size);
+    if (scratchpads >= 4)
+      return 4;
+    if (scratchpads >= 2)
+      return 2;
+    return 1;
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<unsigned> miner::order_mining_cpus(const std::vector<cpu_topology>& topology)
+  {
+    // the cpus grouped by L3 cache, each group ordered so its cores come
+    // before their hyperthread siblings
+    std::map<std::string, std::vector<std::pair<unsigned, unsigned>>> l3_groups; // L3 -> (sibling rank, cpu)
+    std::map<std::string, unsigned> core_siblings;
+    for (const auto &t: topology)
+      l3_groups[t.l3].push_back(std::make_pair(core_siblings[t.core]++, t.cpu));
+    for (auto &group: l3_groups)
+      std::sort(group.second.begin(), group.second.end());
+
+    // round robin over the L3 caches
+    std::vector<unsigned> cpus;
+    size_t rank = 0;
+    while (true)
+    {
+      bool any = false;
+      for (const auto &group: l3_groups)
+      {
+        if (rank < group.second.size())
+        {
+          cpus.push_back(group.second[rank].second);
+          any = true;
+        }
+      }
+      if (!any)
+        break;
+      ++rank;
+    }
+    return cpus;
+  }
+  //-----------------------------------------------------------------------------------------------------
+  std::vector<unsigned> miner::get_mining_cpus()
+  {
+    std::vector<cpu_topology> topology;
+
+    #if defined(__linux__)
+
+      // the cpus we may run on
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return std::vector<unsigned>();
+
+      auto read_line = [](const std::string &path) -> std::string {
+        std::ifstream stream(path);
+        std::string line;
+        std::getline(stream, line);
+        return line;
+      };
+      for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      {
+        if (!CPU_ISSET(cpu, &allowed))
+          continue;
+        const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        const std::string package = read_line(dir + "/topology/physical_package_id");
+        std::string l3 = read_line(dir + "/cache/index3/shared_cpu_list");
+        if (l3.empty())
+          l3 = "package " + package;
+        topology.push_back({cpu, package + ":" + read_line(dir + "/topology/core_id"), l3});
+      }
+
+    #endif
+
+    return order_mining_cpus(topology); // empty if unsupported
+  }
+  //-----------------------------------------------------------------------------------------------------
+  bool miner::pin_thread(unsigned cpu)
+  {
+    #if defined(__linux__)
+
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+
+    #endif
+
+    return false; // unsupported system..
+  }
+  //-----------------------------------------------------------------------------------------------------
+  bool miner::get_free_huge_pages(uint64_t& free_pages, uint64_t& total_pages)
+  {
+    #if defined(__linux__)
+
+      std::ifstream meminfo("/proc/meminfo");
+      std::string field;
+      bool has_free = false, has_total = false;
+      while (meminfo >> field)
+      {
+        if (field == "HugePages_Free:")
+          has_free = !!(meminfo >> free_pages);
+        else if (field == "HugePages_Total:")
+          has_total = !!(meminfo >> total_pages);
+      }
+      return has_free && has_total;
+
+    #endif
+
+    return false; // unsupported system..
+  }
+  //-----------------------------------------------------------------------------------------------------
   uint8_t miner::get_percent_of_total(uint64_t other, uint64_t total)
   {
     return (uint8_t)( ceil( (other * 1.f / total * 1.f) * 100) );
@@ -70,7 +70,9 @@ namespace cryptonote
     bool on_block_chain_update();
     bool start(const account_public_address& adr, size_t threads_count, const boost::thread::attributes& attrs, bool do_background = false, bool ignore_battery = false);
     uint64_t get_speed() const;
+    std::vector<uint64_t> get_threads_speed() const;
     uint32_t get_threads_count() const;
+    uint32_t get_huge_pages_threads_count() const;
     void send_stop_signal();
     bool stop();
     bool is_mining() const;
@@ -91,6 +93,15 @@ namespace cryptonote
     uint8_t get_mining_target() const;
     bool set_mining_target(uint8_t mining_target);
 
+    struct cpu_topology
+    {
+      unsigned cpu;
+      std::string core; // cpus on the same core are hyperthread siblings
+      std::string l3; // cpus sharing an L3 cache
+    };
+    // the order mining threads are pinned in: round robin over the L3 caches, cores before their siblings
+    static std::vector<unsigned> order_mining_cpus(const std::vector<cpu_topology>& topology);
+
     static constexpr uint8_t  BACKGROUND_MINING_DEFAULT_IDLE_THRESHOLD_PERCENTAGE       = 90;
     static constexpr uint8_t  BACKGROUND_MINING_MIN_IDLE_THRESHOLD_PERCENTAGE           = 50;
     static constexpr uint8_t  BACKGROUND_MINING_MAX_IDLE_THRESHOLD_PERCENTAGE           = 99;
@@ -128,6 +139,10 @@ namespace cryptonote
     uint64_t m_height;
     volatile uint32_t m_thread_index;
     volatile uint32_t m_threads_total;
+    uint32_t m_hash_ways; // nonces each thread hashes at once, see get_hash_ways()
+    bool m_pin_threads;
+    std::vector<unsigned> m_mining_cpus; // cpu of each thread index when pinning, see get_mining_cpus()
+    std::atomic<uint32_t> m_huge_pages_threads; // threads with all their scratchpads in huge pages
     std::atomic<int32_t> m_pausers_count;
     epee::critical_section m_miners_count_lock;
 
@@ -143,8 +158,10 @@ namespace cryptonote
     std::atomic<uint64_t> m_last_hr_merge_time;
     std::atomic<uint64_t> m_hashes;
     std::atomic<uint64_t> m_current_hash_rate;
-    epee::critical_section m_last_hash_rates_lock;
+    mutable epee::critical_section m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
+    std::vector<std::atomic<uint64_t>> m_threads_hashes; // per thread m_hashes, sized at start()
+    std::vector<uint64_t> m_threads_hash_rates; // under m_last_hash_rates_lock
     bool m_do_print_hashrate;
     bool m_do_mining;
 
@@ -169,5 +186,10 @@ namespace cryptonote
     static bool get_process_time(uint64_t& total_time);
     static uint8_t get_percent_of_total(uint64_t some_time, uint64_t total_time);
     static boost::logic::tribool on_battery_power();
+    static uint64_t get_l3_cache_size();
+    static uint32_t get_hash_ways(size_t threads_count);
+    static std::vector<unsigned> get_mining_cpus();
+    static bool pin_thread(unsigned cpu);
+    static bool get_free_huge_pages(uint64_t& free_pages, uint64_t& total_pages);
   };
 }
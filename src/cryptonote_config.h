@@ -72,6 +72,10 @@
 #define CRYPTONOTE_PROTOCOL_HOP_RELAX_COUNT                   3
 #define CRYPTONOTE_MEMPOOL_TX_LIVETIME                        86400
 #define CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME         604800
+#define CRYPTONOTE_PRUNING_TIP_BLOCKS                         5500 // blocks below the top which keep their signatures when pruning
+#define CRYPTONOTE_PRUNING_STEP                               1000 // blocks pruned at once
+#define CRYPTONOTE_POW_CACHE_DEPTH                            2000 // blocks below the top whose PoW hash is kept in the PoW cache
+#define CRYPTONOTE_POW_CACHE_PRUNE_STEP                       100 // blocks between two prunings of the PoW cache
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT                 1000
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                        1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                         5000
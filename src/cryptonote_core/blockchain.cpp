@@ -52,6 +52,8 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "metrics.h"
+#include "common/trace.h"
 #if defined(PER_BLOCK_CHECKPOINT)
 #include "blocks/blocks.h"
 #endif
@@ -81,6 +83,37 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+namespace
+{
+  epee::metrics::histogram &block_verify_stage(const char *stage)
+  {
+    return epee::metrics::registry::instance().get_histogram("block_verify_seconds", "Time spent in each stage of adding a block to the main chain", "stage", stage);
+  }
+
+  // the stage times are measured in nanoseconds by TIME_MEASURE_NS_*
+  void record_block_verify_metrics(uint64_t difficulty, uint64_t pow, uint64_t txs, uint64_t pool, uint64_t double_spend, uint64_t miner_tx, uint64_t db, uint64_t total)
+  {
+    static epee::metrics::histogram &difficulty_metric = block_verify_stage("difficulty");
+    static epee::metrics::histogram &pow_metric = block_verify_stage("pow");
+    static epee::metrics::histogram &txs_metric = block_verify_stage("txs");
+    static epee::metrics::histogram &pool_metric = block_verify_stage("pool");
+    static epee::metrics::histogram &double_spend_metric = block_verify_stage("double_spend");
+    static epee::metrics::histogram &miner_tx_metric = block_verify_stage("miner_tx");
+    static epee::metrics::histogram &db_metric = block_verify_stage("db");
+    static epee::metrics::histogram &total_metric = block_verify_stage("total");
+    static epee::metrics::counter &blocks_added = epee::metrics::registry::instance().get_counter("blocks_added_total", "Blocks added to the main chain");
+    difficulty_metric.record(difficulty);
+    pow_metric.record(pow);
+    txs_metric.record(txs);
+    pool_metric.record(pool);
+    double_spend_metric.record(double_spend);
+    miner_tx_metric.record(miner_tx);
+    db_metric.record(db);
+    total_metric.record(total);
+    blocks_added.inc();
+  }
+}
+
 static const struct {
   uint8_t version;
   uint64_t height;
@@ -106,7 +139,7 @@ static const struct {
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_sz_limit(0),
-  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_cancel(false)
+  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_events(NULL), m_sync_counter(0), m_db_sync_latency(100), m_db_sync([this]() { store_blockchain(); }), m_prune_depth(0), m_cancel(false)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -344,6 +377,13 @@ bool Blockchain::init(BlockchainDB* db, const bool testnet, const cryptonote::te
   // we only need 1
   m_async_pool.create_thread(boost::bind(&boost::asio::io_service::run, &m_async_service));
 
+  // in db_group mode, commits leave all the flushing to the sync thread
+  if (m_db_sync_mode == db_group)
+  {
+    m_db->safesyncmode(false);
+    m_db_sync.start(m_db_sync_latency);
+  }
+
 #if defined(PER_BLOCK_CHECKPOINT)
   if (!fakechain)
     load_compiled_in_block_hashes();
@@ -396,6 +436,16 @@ bool Blockchain::store_blockchain()
   return true;
 }
 //------------------------------------------------------------------
+db_sync_thread::durable_future Blockchain::request_db_sync()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (m_db_sync_mode == db_group)
+    return m_db_sync.request();
+  std::promise<bool> synced;
+  synced.set_value(true);
+  return synced.get_future().share();
+}
+//------------------------------------------------------------------
 bool Blockchain::deinit()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -406,6 +456,7 @@ bool Blockchain::deinit()
   m_async_work_idle.reset();
   m_async_pool.join_all();
   m_async_service.stop();
+  m_db_sync.stop();
 
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
@@ -464,6 +515,15 @@ block Blockchain::pop_block_from_blockchain()
     throw;
   }
 
+  if (m_rct_output_distribution.size() > m_db->height())
+  {
+    m_rct_output_distribution.resize(m_db->height());
+    m_rct_output_distribution_top = popped_block.prev_id;
+  }
+
+  if (m_events)
+    m_events->publish(chain_event::block_removed, get_block_hash(popped_block), m_db->height());
+
   // return transactions from popped block to the tx_pool
   for (transaction& tx : popped_txs)
   {
@@ -506,6 +566,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   m_timestamps_and_difficulties_height = 0;
   m_alternative_chains.clear();
   m_db->reset();
+  m_rct_output_distribution.clear();
   m_hardfork->init();
 
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -552,7 +613,7 @@ bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
   if(!sz)
     return true;
 
-  m_db->block_txn_start(true);
+  db_read_session read_session(*m_db);
   bool genesis_included = false;
   uint64_t current_back_offset = 1;
   while(current_back_offset < sz)
@@ -579,7 +640,6 @@ bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
   {
     ids.push_back(m_db->get_block_hash_from_height(0));
   }
-  m_db->block_txn_stop();
 
   return true;
 }
@@ -783,6 +843,13 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
     return false;
   }
 
+  // the txs of pruned blocks can be neither verified again nor returned to the pool
+  if (m_db->get_block_height(alt_chain.front()->second.bl.prev_id) + 1 < m_db->get_pruned_height())
+  {
+    LOG_ERROR("Attempting to move to an alternate chain which splits off below the pruned height " << m_db->get_pruned_height());
+    return false;
+  }
+
   // pop blocks from the blockchain until the top block is the parent
   // of the front block of the alt chain.
   std::list<block> disconnected_chain;
@@ -1187,6 +1254,7 @@ bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vect
 bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id, block_verification_context& bvc)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+  TRACE_SCOPE_ID("blockchain", "handle_alternative_block", id);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_timestamps_and_difficulties_height = 0;
   uint64_t block_height = get_block_height(b);
@@ -1290,13 +1358,19 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
     crypto::hash proof_of_work = null_hash;
-    get_block_longhash(bei.bl, proof_of_work, bei.height, m_hardfork->get_current_version());
+    // the fork heights are fixed, so this is the version for the block's height on any chain
+    const uint8_t hf_version = m_hardfork->get_ideal_version(bei.height);
+    const bool cached = get_cached_block_longhash(id, hf_version, proof_of_work);
+    if (!cached)
+      get_block_longhash(bei.bl, proof_of_work, bei.height, hf_version);
     if(!check_hash(proof_of_work, current_diff))
     {
       MERROR_VER("Block with id: " << id << std::endl << " for alternative chain, does not have enough proof of work: " << proof_of_work << std::endl << " expected difficulty: " << current_diff);
       bvc.m_verifivation_failed = true;
       return false;
     }
+    if (!cached)
+      cache_block_longhash(id, bei.height, hf_version, proof_of_work);
 
     if(!prevalidate_miner_transaction(b, bei.height))
     {
@@ -1373,6 +1447,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<std::
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
   if(start_offset > m_db->height())
     return false;
 
@@ -1395,6 +1470,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<std::
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
   if(start_offset > m_db->height())
     return false;
 
@@ -1421,7 +1497,7 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_db->block_txn_start(true);
+  db_read_session read_session(*m_db);
   rsp.current_blockchain_height = get_current_blockchain_height();
   std::list<std::pair<cryptonote::blobdata,block>> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
@@ -1446,7 +1522,6 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
       // as done below if any standalone transactions were requested
       // and missed.
       rsp.missed_ids.splice(rsp.missed_ids.end(), missed_tx_ids);
-	  m_db->block_txn_stop();
       return false;
     }
 
@@ -1465,7 +1540,6 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
   for (const auto& tx: txs)
     rsp.txs.push_back(tx);
 
-  m_db->block_txn_stop();
   return true;
 }
 //------------------------------------------------------------------
@@ -1509,6 +1583,7 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   // for each amount that we need to get mixins for, get <n> random outputs
   // from BlockchainDB where <n> is req.outs_count (number of mixins).
@@ -1616,20 +1691,16 @@ bool Blockchain::get_random_rct_outs(const COMMAND_RPC_GET_RANDOM_RCT_OUTPUTS::r
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   // for each amount that we need to get mixins for, get <n> random outputs
   // from BlockchainDB where <n> is req.outs_count (number of mixins).
-  auto num_outs = m_db->get_num_outputs(0);
-  // ensure we don't include outputs that aren't yet eligible to be used
-  // outpouts are sorted by height
-  while (num_outs > 0)
-  {
-    const tx_out_index toi = m_db->get_output_tx_and_index(0, num_outs - 1);
-    const uint64_t height = m_db->get_tx_block_height(toi.first);
-    if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= m_db->height())
-      break;
-    --num_outs;
-  }
+  // ensure we don't include outputs that aren't yet eligible to be used,
+  // those of the last CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE - 1 blocks
+  uint64_t num_outs = 0;
+  const uint64_t height = m_db->height();
+  if (height >= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE && update_rct_output_distribution())
+    num_outs = m_rct_output_distribution[height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE];
 
   std::unordered_set<uint64_t> seen_indices;
 
@@ -1700,6 +1771,7 @@ bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMA
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   res.outs.clear();
   res.outs.reserve(req.outputs.size());
@@ -1731,14 +1803,13 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     return false;
   }
 
-  m_db->block_txn_start(true);
+  db_read_session read_session(*m_db);
   // make sure that the last block in the request's block list matches
   // the genesis block
   auto gen_hash = m_db->get_block_hash_from_height(0);
   if(qblock_ids.back() != gen_hash)
   {
     MCERROR("net.p2p", "Client sent wrong NOTIFY_REQUEST_CHAIN: genesis block mismatch: " << std::endl << "id: " << qblock_ids.back() << ", " << std::endl << "expected: " << gen_hash << "," << std::endl << " dropping connection");
-	m_db->block_txn_abort();
     return false;
   }
 
@@ -1756,11 +1827,9 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     catch (const std::exception& e)
     {
       MWARNING("Non-critical error trying to find block by hash in BlockchainDB, hash: " << *bl_it);
-	  m_db->block_txn_abort();
       return false;
     }
   }
-  m_db->block_txn_stop();
 
   // this should be impossible, as we checked that we share the genesis block,
   // but just in case...
@@ -1797,6 +1866,7 @@ bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   for (const auto& block_hash : block_ids)
   {
@@ -1824,17 +1894,18 @@ bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container
 //TODO: return type should be void, throw on exception
 //       alternatively, return true only if no transactions missed
 template<class t_ids_container, class t_tx_container, class t_missed_container>
-bool Blockchain::get_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
+bool Blockchain::get_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   for (const auto& tx_hash : txs_ids)
   {
     try
     {
       cryptonote::blobdata tx;
-      if (m_db->get_tx_blob(tx_hash, tx))
+      if (pruned ? m_db->get_pruned_tx_blob(tx_hash, tx) : m_db->get_tx_blob(tx_hash, tx))
         txs.push_back(std::move(tx));
       else
         missed_txs.push_back(tx_hash);
@@ -1852,6 +1923,7 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   for (const auto& tx_hash : txs_ids)
   {
@@ -1928,6 +2000,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   // if we can't find the split point, return false
   if(!find_blockchain_supplement(qblock_ids, resp.start_height))
@@ -1935,7 +2008,6 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     return false;
   }
 
-  m_db->block_txn_start(true);
   resp.total_height = get_current_blockchain_height();
   size_t count = 0;
   for(size_t i = resp.start_height; i < resp.total_height && count < BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT; i++, count++)
@@ -1943,7 +2015,6 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     resp.m_block_ids.push_back(m_db->get_block_hash_from_height(i));
   }
   resp.cumulative_difficulty = m_db->get_block_cumulative_difficulty(m_db->height() - 1);
-  m_db->block_txn_stop();
   return true;
 }
 //------------------------------------------------------------------
@@ -1951,10 +2022,11 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 // find split point between ours and foreign blockchain (or start at
 // blockchain height <req_start_block>), and return up to max_count FULL
 // blocks by reference.
-bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
+bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
 
   // if a specific start height has been requested
   if(req_start_block > 0)
@@ -1974,7 +2046,13 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
     }
   }
 
-  m_db->block_txn_start(true);
+  // whole txs are only left above the pruned height
+  if (!pruned && start_height < m_db->get_pruned_height())
+  {
+    MDEBUG("Can't return whole txs from height " << start_height << ", blocks below " << m_db->get_pruned_height() << " are pruned");
+    return false;
+  }
+
   total_height = get_current_blockchain_height();
   size_t count = 0, size = 0;
   for(size_t i = start_height; i < total_height && count < max_count && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || count < 3); i++, count++)
@@ -1984,13 +2062,12 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
     block b;
     CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(blocks.back().first, b), false, "internal error, invalid block");
     std::list<crypto::hash> mis;
-    get_transactions_blobs(b.tx_hashes, blocks.back().second, mis);
+    get_transactions_blobs(b.tx_hashes, blocks.back().second, mis, pruned);
     CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
     size += blocks.back().first.size();
     for (const auto &t: blocks.back().second)
       size += t.size();
   }
-  m_db->block_txn_stop();
   return true;
 }
 //------------------------------------------------------------------
@@ -2838,10 +2915,11 @@ bool Blockchain::flush_txes_from_pool(const std::list<crypto::hash> &txids)
 bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+  tools::trace::scope trace("blockchain", "handle_block_to_main_chain", id);
 
-  TIME_MEASURE_START(block_processing_time);
+  TIME_MEASURE_NS_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  TIME_MEASURE_START(t1);
+  TIME_MEASURE_NS_START(t1);
 
   static bool seen_future_version = false;
 
@@ -2874,8 +2952,8 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(t1);
-  TIME_MEASURE_START(t2);
+  TIME_MEASURE_NS_FINISH(t1);
+  TIME_MEASURE_NS_START(t2);
 
   // make sure block timestamp is not less than the median timestamp
   // of a set number of the most recent blocks.
@@ -2886,9 +2964,9 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(t2);
+  TIME_MEASURE_NS_FINISH(t2);
   //check proof of work
-  TIME_MEASURE_START(target_calculating_time);
+  TIME_MEASURE_NS_START(target_calculating_time);
 
   // get the target difficulty for the block.
   // the calculation can overflow, among other failure cases,
@@ -2898,9 +2976,10 @@ leave:
   difficulty_type current_diffic = get_difficulty_for_next_block();
   CHECK_AND_ASSERT_MES(current_diffic, false, "!!!!!!!!! difficulty overhead !!!!!!!!!");
 
-  TIME_MEASURE_FINISH(target_calculating_time);
+  TIME_MEASURE_NS_FINISH(target_calculating_time);
 
-  TIME_MEASURE_START(longhash_calculating_time);
+  TIME_MEASURE_NS_START(longhash_calculating_time);
+  tools::trace::scope pow_trace("blockchain", "pow", id);
 
   crypto::hash proof_of_work = null_hash;
 
@@ -2914,7 +2993,10 @@ leave:
   // be a parameter?
   // validate proof_of_work versus difficulty target
   bool precomputed = false;
+  bool cached = false;
   bool fast_check = false;
+  // the block goes on top, at the current version's height
+  const uint8_t hf_version = m_hardfork->get_current_version();
 #if defined(PER_BLOCK_CHECKPOINT)
   if (m_db->height() < m_blocks_hash_check.size())
   {
@@ -2936,8 +3018,8 @@ leave:
       precomputed = true;
       proof_of_work = it->second;
     }
-    else
-      proof_of_work = get_block_longhash(bl, m_db->height(), m_hardfork->get_current_version());
+    else if (!(cached = get_cached_block_longhash(id, hf_version, proof_of_work)))
+      proof_of_work = get_block_longhash(bl, m_db->height(), hf_version);
 
     // validate proof_of_work versus difficulty target
     if(!check_hash(proof_of_work, current_diffic))
@@ -2960,11 +3042,12 @@ leave:
     }
   }
 
-  TIME_MEASURE_FINISH(longhash_calculating_time);
+  TIME_MEASURE_NS_FINISH(longhash_calculating_time);
+  pow_trace.end();
   if (precomputed)
-    longhash_calculating_time += m_fake_pow_calc_time;
+    longhash_calculating_time += m_fake_pow_calc_time * 1000000;
 
-  TIME_MEASURE_START(t3);
+  TIME_MEASURE_NS_START(t3);
 
   // sanity check basic miner tx properties;
   if(!prevalidate_miner_transaction(bl, m_db->height()))
@@ -2985,7 +3068,7 @@ leave:
   uint64_t t_exists = 0;
   uint64_t t_pool = 0;
   uint64_t t_dblspnd = 0;
-  TIME_MEASURE_FINISH(t3);
+  TIME_MEASURE_NS_FINISH(t3);
 
 // XXX old code adds miner tx here
 
@@ -2995,11 +3078,12 @@ leave:
   // to txs.  Keys spent in each are added to <keys> by the double spend check.
   for (const crypto::hash& tx_id : bl.tx_hashes)
   {
+    TRACE_SCOPE_ID("blockchain", "check_block_tx", tx_id);
     transaction tx;
     size_t blob_size = 0;
     uint64_t fee = 0;
     bool relayed = false, do_not_relay = false;
-    TIME_MEASURE_START(aa);
+    TIME_MEASURE_NS_START(aa);
 
 // XXX old code does not check whether tx exists
     if (m_db->tx_exists(tx_id))
@@ -3010,9 +3094,9 @@ leave:
       goto leave;
     }
 
-    TIME_MEASURE_FINISH(aa);
+    TIME_MEASURE_NS_FINISH(aa);
     t_exists += aa;
-    TIME_MEASURE_START(bb);
+    TIME_MEASURE_NS_START(bb);
 
     // get transaction with hash <tx_id> from tx_pool
     if(!m_tx_pool.take_tx(tx_id, tx, blob_size, fee, relayed, do_not_relay))
@@ -3023,13 +3107,13 @@ leave:
       goto leave;
     }
 
-    TIME_MEASURE_FINISH(bb);
+    TIME_MEASURE_NS_FINISH(bb);
     t_pool += bb;
     // add the transaction to the temp list of transactions, so we can either
     // store the list of transactions all at once or return the ones we've
     // taken from the tx_pool back to it if the block fails verification.
     txs.push_back(tx);
-    TIME_MEASURE_START(dd);
+    TIME_MEASURE_NS_START(dd);
 
     // FIXME: the storage should not be responsible for validation.
     //        If it does any, it is merely a sanity check.
@@ -3044,9 +3128,9 @@ leave:
     //     break;
     // }
 
-    TIME_MEASURE_FINISH(dd);
+    TIME_MEASURE_NS_FINISH(dd);
     t_dblspnd += dd;
-    TIME_MEASURE_START(cc);
+    TIME_MEASURE_NS_START(cc);
 
 #if defined(PER_BLOCK_CHECKPOINT)
     if (!fast_check)
@@ -3083,7 +3167,7 @@ leave:
       }
     }
 #endif
-    TIME_MEASURE_FINISH(cc);
+    TIME_MEASURE_NS_FINISH(cc);
     t_checktx += cc;
     fee_summary += fee;
     cumulative_block_size += blob_size;
@@ -3091,7 +3175,7 @@ leave:
 
   m_blocks_txs_check.clear();
 
-  TIME_MEASURE_START(vmt);
+  TIME_MEASURE_NS_START(vmt);
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = m_db->height() ? m_db->get_block_already_generated_coins(m_db->height() - 1) : 0;
   if(!validate_miner_transaction(bl, cumulative_block_size, fee_summary, base_reward, already_generated_coins, bvc.m_partial_block_reward, m_hardfork->get_current_version()))
@@ -3102,7 +3186,7 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(vmt);
+  TIME_MEASURE_NS_FINISH(vmt);
   size_t block_size;
   difficulty_type cumulative_difficulty;
 
@@ -3117,12 +3201,12 @@ leave:
   if(m_db->height())
     cumulative_difficulty += m_db->get_block_cumulative_difficulty(m_db->height() - 1);
 
-  TIME_MEASURE_FINISH(block_processing_time);
+  TIME_MEASURE_NS_FINISH(block_processing_time);
   if(precomputed)
-    block_processing_time += m_fake_pow_calc_time;
+    block_processing_time += m_fake_pow_calc_time * 1000000;
 
   m_db->block_txn_stop();
-  TIME_MEASURE_START(addblock);
+  TIME_MEASURE_NS_START(addblock);
   uint64_t new_height = 0;
   if (!bvc.m_verifivation_failed)
   {
@@ -3150,23 +3234,32 @@ leave:
     LOG_ERROR("Blocks that failed verification should not reach here");
   }
 
-  TIME_MEASURE_FINISH(addblock);
+  TIME_MEASURE_NS_FINISH(addblock);
+
+  // so the block need not be hashed again if a reorg pops it and puts it back
+  if (!fast_check && !cached)
+    cache_block_longhash(id, new_height - 1, hf_version, proof_of_work);
 
   // do this after updating the hard fork state since the size limit may change due to fork
   update_next_cumulative_size_limit();
 
-  MINFO("+++++ BLOCK SUCCESSFULLY ADDED" << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "HEIGHT " << new_height-1 << ", difficulty:\t" << current_diffic << std::endl << "block reward: " << print_money(fee_summary + base_reward) << "(" << print_money(base_reward) << " + " << print_money(fee_summary) << "), coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << ")ms");
+  MINFO("+++++ BLOCK SUCCESSFULLY ADDED" << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "HEIGHT " << new_height-1 << ", difficulty:\t" << current_diffic << std::endl << "block reward: " << print_money(fee_summary + base_reward) << "(" << print_money(base_reward) << " + " << print_money(fee_summary) << "), coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size << ", " << block_processing_time / 1000000 << "(" << target_calculating_time / 1000000 << "/" << longhash_calculating_time / 1000000 << ")ms");
   if(m_show_time_stats)
   {
     MINFO("Height: " << new_height << " blob: " << coinbase_blob_size << " cumm: "
-        << cumulative_block_size << " p/t: " << block_processing_time << " ("
-        << target_calculating_time << "/" << longhash_calculating_time << "/"
-        << t1 << "/" << t2 << "/" << t3 << "/" << t_exists << "/" << t_pool
-        << "/" << t_checktx << "/" << t_dblspnd << "/" << vmt << "/" << addblock << ")ms");
+        << cumulative_block_size << " p/t: " << block_processing_time / 1000000 << " ("
+        << target_calculating_time / 1000000 << "/" << longhash_calculating_time / 1000000 << "/"
+        << t1 / 1000000 << "/" << t2 / 1000000 << "/" << t3 / 1000000 << "/" << t_exists / 1000000 << "/" << t_pool / 1000000
+        << "/" << t_checktx / 1000000 << "/" << t_dblspnd / 1000000 << "/" << vmt / 1000000 << "/" << addblock / 1000000 << ")ms");
   }
+  record_block_verify_metrics(target_calculating_time, longhash_calculating_time, t_checktx, t_pool, t_dblspnd, vmt, addblock, block_processing_time);
 
   bvc.m_added_to_main_chain = true;
   ++m_sync_counter;
+  trace.set_height(new_height - 1);
+
+  if (m_events)
+    m_events->publish(chain_event::block_added, id, new_height - 1);
 
   // appears to be a NOP *and* is called elsewhere.  wat?
   m_tx_pool.on_blockchain_inc(new_height, id);
@@ -3311,7 +3404,11 @@ void Blockchain::block_longhash_worker(uint64_t height, const std::vector<block>
     if (m_cancel)
        break;
     crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash(block, height++, m_hardfork->get_current_version());
+    crypto::hash pow;
+    const uint8_t hf_version = m_hardfork->get_ideal_version(height);
+    if (!get_cached_block_longhash(id, hf_version, pow))
+      pow = get_block_longhash(block, height, hf_version);
+    ++height;
     map.emplace(id, pow);
   }
 
@@ -3323,8 +3420,10 @@ void Blockchain::block_longhash_worker(uint64_t height, const std::vector<block>
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
   bool success = false;
+  db_sync_thread::durable_future durable;
 
   MTRACE("Blockchain::" << __func__);
+  TRACE_SCOPE("blockchain", "cleanup_handle_incoming_blocks");
   CRITICAL_REGION_BEGIN(m_blockchain_lock);
   TIME_MEASURE_START(t1);
 
@@ -3338,9 +3437,20 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
     MERROR("Exception in cleanup_handle_incoming_blocks: " << e.what());
   }
 
+  if (success)
+    prune_blockchain();
+
   if (success && m_sync_counter > 0)
   {
-    if (force_sync)
+    if (m_db_sync_mode == db_group)
+    {
+      // blocks_per_sync is not used. Nothing else adding blocks can join the
+      // group while we wait, so don't wait out the latency: the sync thread
+      // syncs at once, along with the tx pool commits requested meanwhile
+      m_sync_counter = 0;
+      durable = m_db_sync.flush();
+    }
+    else if (force_sync)
     {
       if(m_db_sync_mode != db_nosync)
         store_blockchain();
@@ -3373,6 +3483,14 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   CRITICAL_REGION_END();
   m_tx_pool.unlock();
 
+  // in db_group mode the blocks are only on disk once the sync thread is done,
+  // wait for it without holding the locks
+  if (durable.valid() && !durable.get())
+  {
+    MERROR("Failed to sync the new blocks to disk");
+    success = false;
+  }
+
   return success;
 }
 
@@ -3404,6 +3522,7 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
 bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_entry> &blocks_entry)
 {
   MTRACE("Blockchain::" << __func__);
+  TRACE_SCOPE("blockchain", "prepare_handle_incoming_blocks");
   TIME_MEASURE_START(prepare);
   bool stop_batch;
 
@@ -3791,7 +3910,7 @@ bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, con
   return m_db->for_all_txpool_txes(f, include_blob);
 }
 
-void Blockchain::set_user_options(uint64_t maxthreads, uint64_t blocks_per_sync, blockchain_db_sync_mode sync_mode, bool fast_sync)
+void Blockchain::set_user_options(uint64_t maxthreads, uint64_t blocks_per_sync, blockchain_db_sync_mode sync_mode, bool fast_sync, uint64_t sync_latency_ms)
 {
   if (sync_mode == db_defaultsync)
   {
@@ -3801,9 +3920,76 @@ void Blockchain::set_user_options(uint64_t maxthreads, uint64_t blocks_per_sync,
   m_db_sync_mode = sync_mode;
   m_fast_sync = fast_sync;
   m_db_blocks_per_sync = blocks_per_sync;
+  m_db_sync_latency = sync_latency_ms;
   m_max_prepare_blocks_threads = maxthreads;
 }
 
+void Blockchain::set_prune_depth(uint64_t depth)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_prune_depth = depth;
+  prune_blockchain();
+}
+
+uint64_t Blockchain::get_pruned_height() const
+{
+  return m_db->get_pruned_height();
+}
+
+void Blockchain::prune_blockchain()
+{
+  if (!m_prune_depth)
+    return;
+  const uint64_t height = m_db->height();
+  if (height <= m_prune_depth)
+    return;
+  // pruning in steps keeps this cheap for most calls, it only runs every
+  // CRYPTONOTE_PRUNING_STEP blocks
+  const uint64_t prune_height = height - m_prune_depth;
+  if (prune_height < m_db->get_pruned_height() + CRYPTONOTE_PRUNING_STEP)
+    return;
+  try
+  {
+    m_db->prune(prune_height);
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to prune the blockchain: " << e.what());
+  }
+}
+
+bool Blockchain::get_cached_block_longhash(const crypto::hash &id, uint8_t hf_version, crypto::hash &pow) const
+{
+  try
+  {
+    return m_db->get_block_pow_hash(id, hf_version, pow);
+  }
+  catch (const std::exception &e)
+  {
+    MWARNING("Failed to read the PoW cache: " << e.what());
+    return false;
+  }
+}
+
+void Blockchain::cache_block_longhash(const crypto::hash &id, uint64_t height, uint8_t hf_version, const crypto::hash &pow)
+{
+  const uint64_t top_height = m_db->height();
+  if (height + CRYPTONOTE_POW_CACHE_DEPTH < top_height)
+    return;
+  try
+  {
+    if (m_db->is_read_only())
+      return;
+    m_db->add_block_pow_hash(id, height, hf_version, pow);
+    if (top_height > CRYPTONOTE_POW_CACHE_DEPTH && top_height % CRYPTONOTE_POW_CACHE_PRUNE_STEP == 0)
+      m_db->prune_block_pow_hashes(top_height - CRYPTONOTE_POW_CACHE_DEPTH);
+  }
+  catch (const std::exception &e)
+  {
+    MWARNING("Failed to update the PoW cache: " << e.what());
+  }
+}
+
 void Blockchain::safesyncmode(const bool onoff)
 {
   /* all of this is no-op'd if the user set a specific
@@ -3811,8 +3997,17 @@ void Blockchain::safesyncmode(const bool onoff)
    */
   if (m_db_default_sync)
   {
-    m_db->safesyncmode(onoff);
-    m_db_sync_mode = onoff ? db_nosync : db_async;
+    // the db stays in fast mode, db_group syncs it from the sync thread
+    if (onoff)
+    {
+      m_db_sync.start(m_db_sync_latency);
+      m_db_sync_mode = db_group;
+    }
+    else
+    {
+      m_db_sync_mode = db_async;
+      m_db_sync.stop();
+    }
   }
 }
 
@@ -3828,9 +4023,49 @@ bool Blockchain::get_hard_fork_voting_info(uint8_t version, uint32_t &window, ui
 
 std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> Blockchain:: get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff) const
 {
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
   return m_db->get_output_histogram(amounts, unlocked, recent_cutoff);
 }
 
+bool Blockchain::update_rct_output_distribution() const
+{
+  const uint64_t height = m_db->height();
+  // blocks popped by the db itself, as when it aborts a batch, may have been
+  // added again since, so only keep what still ends on the chain
+  if (m_rct_output_distribution.size() > height || (!m_rct_output_distribution.empty() &&
+      m_db->get_block_hash_from_height(m_rct_output_distribution.size() - 1) != m_rct_output_distribution_top))
+  {
+    m_rct_output_distribution.clear();
+  }
+  if (m_rct_output_distribution.size() < height)
+  {
+    std::vector<uint64_t> distribution;
+    if (!m_db->get_output_distribution(0, m_rct_output_distribution.size(), height - 1, distribution))
+    {
+      MERROR("Failed to get the RCT output distribution from height " << m_rct_output_distribution.size());
+      return false;
+    }
+    m_rct_output_distribution.insert(m_rct_output_distribution.end(), distribution.begin(), distribution.end());
+    m_rct_output_distribution_top = m_db->get_block_hash_from_height(height - 1);
+  }
+  return true;
+}
+
+bool Blockchain::get_rct_output_distribution(uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_read_session read_session(*m_db);
+
+  if (!update_rct_output_distribution())
+    return false;
+  if (from_height > to_height || to_height >= m_rct_output_distribution.size())
+    return false;
+  distribution.assign(m_rct_output_distribution.begin() + from_height, m_rct_output_distribution.begin() + to_height + 1);
+  return true;
+}
+
 std::list<std::pair<Blockchain::block_extended_info,uint64_t>> Blockchain::get_alternative_chains() const
 {
   std::list<std::pair<Blockchain::block_extended_info,uint64_t>> chains;
@@ -3951,6 +4186,14 @@ bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 #endif
 }
 
+bool Blockchain::get_compiled_block_hash(uint64_t height, crypto::hash &hash) const
+{
+  if (!is_within_compiled_block_hash_area(height))
+    return false;
+  hash = m_blocks_hash_check[height];
+  return true;
+}
+
 void Blockchain::lock()
 {
   m_blockchain_lock.lock();
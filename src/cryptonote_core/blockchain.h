@@ -54,6 +54,8 @@
 #include "cryptonote_basic/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "event_journal.h"
+#include "db_sync_thread.h"
 
 namespace cryptonote
 {
@@ -68,7 +70,8 @@ namespace cryptonote
     db_defaultsync, //!< user didn't specify, use db_async
     db_sync,  //!< handle syncing calls instead of the backing db, synchronously
     db_async, //!< handle syncing calls instead of the backing db, asynchronously
-    db_nosync //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_nosync, //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_group //!< backing db does not flush commits, a background thread syncs them in groups; new blocks wait for their sync, tx pool commits don't
   };
 
   /************************************************************************/
@@ -225,9 +228,11 @@ namespace cryptonote
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
      *
+     * In ::db_group mode, this returns once the blocks are on disk.
+     *
      * @param force_sync if true, and Blockchain is handling syncing to disk, always sync
      *
-     * @return true
+     * @return false if committing or syncing the blocks failed, else true
      */
     bool cleanup_handle_incoming_blocks(bool force_sync = false);
 
@@ -407,10 +412,11 @@ namespace cryptonote
      * @param total_height return-by-reference our current blockchain height
      * @param start_height return-by-reference the height of the first block returned
      * @param max_count the max number of blocks to get
+     * @param pruned whether to return the transactions without their prunable data
      *
      * @return true if a block found in common or req_start_block specified, else false
      */
-    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const;
+    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count, bool pruned = false) const;
 
     /**
      * @brief retrieves a set of blocks and their transactions, and possibly other transactions
@@ -497,6 +503,18 @@ namespace cryptonote
      */
     bool store_blockchain();
 
+    /**
+     * @brief requests a sync of everything committed to the db so far
+     *
+     * In ::db_group mode, the sync is done on the background sync thread,
+     * together with the other requests made within the sync latency. The
+     * other modes sync on their own schedule, so this does nothing.
+     *
+     * @return a future which is true once the commits made so far are on
+     * disk, false if the sync failed; ready at once outside ::db_group mode
+     */
+    db_sync_thread::durable_future request_db_sync();
+
     /**
      * @brief validates a transaction's inputs
      *
@@ -621,11 +639,12 @@ namespace cryptonote
      * @param txs_ids a container of hashes for which to get the corresponding transactions
      * @param txs return-by-reference a container to store result transactions in
      * @param missed_txs return-by-reference a container to store missed transactions in
+     * @param pruned whether to return the transactions without their prunable data
      *
      * @return false if an unexpected exception occurs, else true
      */
     template<class t_ids_container, class t_tx_container, class t_missed_container>
-    bool get_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const;
+    bool get_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned = false) const;
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     bool get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const;
 
@@ -697,15 +716,34 @@ namespace cryptonote
      * @param blocks_per_sync number of blocks to cache before syncing to database
      * @param sync_mode the ::blockchain_db_sync_mode to use
      * @param fast_sync sync using built-in block hashes as trusted
+     * @param sync_latency_ms how long a sync may be held back to be grouped with others, for ::db_group
      */
     void set_user_options(uint64_t maxthreads, uint64_t blocks_per_sync,
-        blockchain_db_sync_mode sync_mode, bool fast_sync);
+        blockchain_db_sync_mode sync_mode, bool fast_sync, uint64_t sync_latency_ms = 100);
 
     /**
      * @brief Put DB in safe sync mode
      */
     void safesyncmode(const bool onoff);
 
+    /**
+     * @brief sets how many blocks below the top keep their prunable tx data
+     *
+     * Older transactions lose their signatures and range proofs, see
+     * BlockchainDB::prune. This prunes right away if the chain is long
+     * enough. A pruned blockchain can't reorganize below its pruned height.
+     *
+     * @param depth the number of top blocks to keep whole, 0 to not prune
+     */
+    void set_prune_depth(uint64_t depth);
+
+    /**
+     * @brief gets the height below which transactions have been pruned
+     *
+     * @return the pruned height, 0 if the blockchain is not pruned
+     */
+    uint64_t get_pruned_height() const;
+
     /**
      * @brief set whether or not to show/print time statistics
      *
@@ -713,6 +751,13 @@ namespace cryptonote
      */
     void set_show_time_stats(bool stats) { m_show_time_stats = stats; }
 
+    /**
+     * @brief set the journal to publish added and removed blocks to
+     *
+     * @param events the journal, or NULL for none
+     */
+    void set_event_journal(event_journal* events) { m_events = events; }
+
     /**
      * @brief gets the hardfork voting state object
      *
@@ -794,6 +839,20 @@ namespace cryptonote
      */
     std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff) const;
 
+    /**
+     * @brief gets the cumulative number of RCT outputs per block
+     *
+     * The distribution is kept in memory, see BlockchainDB::get_output_distribution
+     * for its layout.
+     *
+     * @param from_height the first block height
+     * @param to_height the last block height, included
+     * @param distribution return-by-reference the cumulative RCT output counts
+     *
+     * @return false if the range is not in the blockchain, otherwise true
+     */
+    bool get_rct_output_distribution(uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution) const;
+
     /**
      * @brief perform a check on all key images in the blockchain
      *
@@ -893,9 +952,40 @@ namespace cryptonote
     bool is_within_compiled_block_hash_area(uint64_t height) const;
     bool is_within_compiled_block_hash_area() const { return is_within_compiled_block_hash_area(m_db->height()); }
 
+    /**
+     * @brief gets the compiled in hash of the block at a height
+     *
+     * @param height the height
+     * @param hash return-by-reference the block hash
+     *
+     * @return false if the height is not within the compiled block hash area
+     */
+    bool get_compiled_block_hash(uint64_t height, crypto::hash &hash) const;
+
     void lock();
     void unlock();
 
+    /**
+     * @brief holds the blockchain lock and a DB read session for its scope
+     *
+     * For callers outside Blockchain making several reads in a row, such as
+     * RPC handlers walking a range of blocks, so the reads share one read
+     * transaction and snapshot. The lock is taken first, as a map resize
+     * waits for open sessions with it held. Single reads don't need one.
+     *
+     * Don't take the tx pool lock inside one: the pool is locked before the
+     * blockchain elsewhere.
+     */
+    class read_session
+    {
+    public:
+      read_session(const Blockchain &blockchain): m_lock(blockchain.m_blockchain_lock), m_session(*blockchain.m_db) {}
+
+    private:
+      epee::critical_region_t<epee::critical_section> m_lock;
+      db_read_session m_session;
+    };
+
     void cancel();
 
   private:
@@ -938,6 +1028,7 @@ namespace cryptonote
     blockchain_db_sync_mode m_db_sync_mode;
     bool m_fast_sync;
     bool m_show_time_stats;
+    event_journal* m_events;
     bool m_db_default_sync;
     uint64_t m_db_blocks_per_sync;
     uint64_t m_max_prepare_blocks_threads;
@@ -952,6 +1043,15 @@ namespace cryptonote
     boost::thread_group m_async_pool;
     std::unique_ptr<boost::asio::io_service::work> m_async_work_idle;
 
+    uint64_t m_db_sync_latency;
+    db_sync_thread m_db_sync;
+
+    uint64_t m_prune_depth;
+
+    // cumulative number of RCT outputs per block, see update_rct_output_distribution
+    mutable std::vector<uint64_t> m_rct_output_distribution;
+    mutable crypto::hash m_rct_output_distribution_top; //!< the block the cache ends on
+
     // all alternative chains
     blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
 
@@ -1312,6 +1412,48 @@ namespace cryptonote
      */
     void load_compiled_in_block_hashes();
 
+    /**
+     * @brief prunes the blockchain if it grew a pruning step past the prune depth
+     *
+     * Requires m_blockchain_lock, and no batch transaction may be active.
+     */
+    void prune_blockchain();
+
+    /**
+     * @brief brings the in memory RCT output distribution up to the blockchain height
+     *
+     * Popped blocks are dropped from it as they are popped, new blocks are
+     * read from the db on the next use. Requires m_blockchain_lock.
+     *
+     * @return false if the db could not be read, otherwise true
+     */
+    bool update_rct_output_distribution() const;
+
+    /**
+     * @brief looks up the PoW hash of a block in the db's PoW cache
+     *
+     * @param id the block hash
+     * @param hf_version the hard fork version at the block's height
+     * @param pow return-by-reference the PoW hash
+     *
+     * @return true if found for that hard fork version, otherwise false
+     */
+    bool get_cached_block_longhash(const crypto::hash &id, uint8_t hf_version, crypto::hash &pow) const;
+
+    /**
+     * @brief adds the PoW hash of a block to the db's PoW cache
+     *
+     * Blocks more than CRYPTONOTE_POW_CACHE_DEPTH below the top are not
+     * cached, and the cache is pruned down to that depth as the chain grows.
+     * Failures are only logged, the cache is an optimization.
+     *
+     * @param id the block hash
+     * @param height the block height
+     * @param hf_version the hard fork version the PoW hash was computed for
+     * @param pow the PoW hash
+     */
+    void cache_block_longhash(const crypto::hash &id, uint64_t height, uint8_t hf_version, const crypto::hash &pow);
+
     /**
      * @brief expands v2 transaction data from blockchain
      *
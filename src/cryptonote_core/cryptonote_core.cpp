@@ -49,6 +49,8 @@ using namespace epee;
 #include "ringct/rctTypes.h"
 #include "blockchain_db/blockchain_db.h"
 #include "ringct/rctSigs.h"
+#include "metrics.h"
+#include "common/trace.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "cn"
@@ -79,6 +81,8 @@ namespace cryptonote
   {
     m_checkpoints_updating.clear();
     set_cryptonote_protocol(pprotocol);
+    m_blockchain_storage.set_event_journal(&m_events);
+    m_mempool.set_event_journal(&m_events);
   }
   void core::set_cryptonote_protocol(i_cryptonote_protocol* pprotocol)
   {
@@ -160,7 +164,9 @@ namespace cryptonote
     command_line::add_arg(desc, command_line::arg_prep_blocks_threads);
     command_line::add_arg(desc, command_line::arg_fast_block_sync);
     command_line::add_arg(desc, command_line::arg_db_sync_mode);
+    command_line::add_arg(desc, command_line::arg_db_sync_latency);
     command_line::add_arg(desc, command_line::arg_db_salvage);
+    command_line::add_arg(desc, command_line::arg_prune_blockchain);
     command_line::add_arg(desc, command_line::arg_show_time_stats);
     command_line::add_arg(desc, command_line::arg_block_sync_size);
     command_line::add_arg(desc, command_line::arg_check_updates);
@@ -211,6 +217,11 @@ namespace cryptonote
     return m_blockchain_storage.get_current_blockchain_height();
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pruned_height() const
+  {
+    return m_blockchain_storage.get_pruned_height();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_blockchain_top(uint64_t& height, crypto::hash& top_id) const
   {
     top_id = m_blockchain_storage.get_tail_id(height);
@@ -281,7 +292,9 @@ namespace cryptonote
 
     std::string db_type = command_line::get_arg(vm, command_line::arg_db_type);
     std::string db_sync_mode = command_line::get_arg(vm, command_line::arg_db_sync_mode);
+    uint64_t db_sync_latency = command_line::get_arg(vm, command_line::arg_db_sync_latency);
     bool db_salvage = command_line::get_arg(vm, command_line::arg_db_salvage) != 0;
+    bool prune_blockchain = command_line::get_arg(vm, command_line::arg_prune_blockchain);
     bool fast_sync = command_line::get_arg(vm, command_line::arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, command_line::arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, command_line::arg_check_updates);
@@ -352,7 +365,7 @@ namespace cryptonote
         {
           safemode = true;
           db_flags = DBF_SAFE;
-          sync_mode = db_nosync;
+          sync_mode = db_group;
         }
         else if(options[0] == "fast")
         {
@@ -399,10 +412,13 @@ namespace cryptonote
     }
 
     m_blockchain_storage.set_user_options(blocks_threads,
-        blocks_per_sync, sync_mode, fast_sync);
+        blocks_per_sync, sync_mode, fast_sync, db_sync_latency);
 
     r = m_blockchain_storage.init(db, m_testnet, test_options);
 
+    if (r && prune_blockchain)
+      m_blockchain_storage.set_prune_depth(CRYPTONOTE_PRUNING_TIP_BLOCKS);
+
     r = m_mempool.init();
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
@@ -458,6 +474,8 @@ namespace cryptonote
     m_miner.stop();
     m_mempool.deinit();
     m_blockchain_storage.deinit();
+    // finish the trace file and join its writer before static destruction
+    tools::trace::stop();
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -591,7 +609,11 @@ namespace cryptonote
       std::list<blobdata>::const_iterator it = tx_blobs.begin();
       for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
         region.run([&, i, it] {
+          METRICS_SCOPED_TIMER("tx_verify_seconds", "Time spent verifying incoming transactions", "stage", "pre");
+          tools::trace::scope trace("core", "handle_incoming_tx_pre");
           results[i].res = handle_incoming_tx_pre(*it, tvc[i], results[i].tx, results[i].hash, results[i].prefix_hash, keeped_by_block, relayed, do_not_relay);
+          if (results[i].res)
+            trace.set_id(results[i].hash);
         });
       }
     });
@@ -611,17 +633,22 @@ namespace cryptonote
         else
         {
           region.run([&, i, it] {
+            METRICS_SCOPED_TIMER("tx_verify_seconds", "Time spent verifying incoming transactions", "stage", "post");
+            TRACE_SCOPE_ID("core", "handle_incoming_tx_post", results[i].hash);
             results[i].res = handle_incoming_tx_post(*it, tvc[i], results[i].tx, results[i].hash, results[i].prefix_hash, keeped_by_block, relayed, do_not_relay);
           });
         }
       }
     });
 
+    static epee::metrics::counter &txs_accepted = epee::metrics::registry::instance().get_counter("txs_verified_total", "Incoming transactions by verification result", "result", "accepted");
+    static epee::metrics::counter &txs_rejected = epee::metrics::registry::instance().get_counter("txs_verified_total", "Incoming transactions by verification result", "result", "rejected");
     bool ok = true;
     std::list<blobdata>::const_iterator it = tx_blobs.begin();
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
       if (!results[i].res)
       {
+        txs_rejected.inc();
         ok = false;
         continue;
       }
@@ -632,6 +659,11 @@ namespace cryptonote
       else if(tvc[i].m_verifivation_impossible)
       {MERROR_VER("Transaction verification impossible: " << results[i].hash);}
 
+      if(tvc[i].m_verifivation_failed || tvc[i].m_verifivation_impossible)
+        txs_rejected.inc();
+      else
+        txs_accepted.inc();
+
       if(tvc[i].m_added_to_pool)
         MDEBUG("tx added: " << results[i].hash);
     }
@@ -755,6 +787,7 @@ namespace cryptonote
   bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
   {
     spent.clear();
+    Blockchain::read_session read_session(m_blockchain_storage);
     for(auto& ki: key_im)
     {
       spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
@@ -906,9 +939,9 @@ namespace cryptonote
     return m_blockchain_storage.find_blockchain_supplement(qblock_ids, resp);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
+  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count, bool pruned) const
   {
-    return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, max_count);
+    return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, max_count, pruned);
   }
   //-----------------------------------------------------------------------------------------------
   void core::print_blockchain(uint64_t start_index, uint64_t end_index) const
@@ -1111,6 +1144,11 @@ namespace cryptonote
     return m_mempool.get_transactions_count();
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pool_cookie() const
+  {
+    return m_mempool.cookie();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id) const
   {
     return m_blockchain_storage.have_block(id);
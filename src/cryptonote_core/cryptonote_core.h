@@ -294,6 +294,13 @@ namespace cryptonote
       */
      uint64_t get_current_blockchain_height() const;
 
+     /**
+      * @copydoc Blockchain::get_pruned_height
+      *
+      * @note see Blockchain::get_pruned_height()
+      */
+     uint64_t get_pruned_height() const;
+
      /**
       * @brief get the hash and height of the most recent block
       *
@@ -469,6 +476,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count() const;
 
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -498,11 +512,11 @@ namespace cryptonote
      bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const;
 
      /**
-      * @copydoc Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >&, uint64_t&, uint64_t&, size_t) const
+      * @copydoc Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >&, uint64_t&, uint64_t&, size_t, bool) const
       *
       * @note see Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, std::list<std::pair<cryptonote::blobdata, std::list<transaction> > >&, uint64_t&, uint64_t&, size_t) const
       */
-     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const;
+     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count, bool pruned = false) const;
 
      /**
       * @brief gets some stats about the daemon
@@ -585,6 +599,13 @@ namespace cryptonote
       */
      const Blockchain& get_blockchain_storage()const{return m_blockchain_storage;}
 
+     /**
+      * @brief gets the journal of recent chain tip and tx pool changes
+      *
+      * @return a reference to the event_journal instance
+      */
+     event_journal& get_event_journal(){return m_events;}
+
      /**
       * @copydoc Blockchain::print_blockchain
       *
@@ -891,6 +912,7 @@ namespace cryptonote
 
      uint64_t m_test_drop_download_height = 0; //!< height under which to drop incoming blocks, if doing so
 
+     event_journal m_events; //!< recent chain and pool changes, before the pool and the chain which publish to it
      tx_memory_pool m_mempool; //!< transaction pool instance
      Blockchain m_blockchain_storage; //!< Blockchain instance
 
@@ -0,0 +1,177 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "db_sync_thread.h"
+
+#include "misc_log_ex.h"
+
+#undef FONERO_DEFAULT_LOG_CATEGORY
+#define FONERO_DEFAULT_LOG_CATEGORY "blockchain.db.sync"
+
+namespace cryptonote
+{
+  db_sync_thread::db_sync_thread(std::function<void()> sync)
+    : m_sync(std::move(sync)), m_latency(0), m_max_pending(0), m_pending(0), m_requests(0), m_syncs(0), m_running(false), m_flush(false), m_stop(false)
+  {
+  }
+
+  db_sync_thread::~db_sync_thread()
+  {
+    stop();
+  }
+
+  void db_sync_thread::start(uint64_t latency_ms, size_t max_pending)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (m_running)
+      return;
+    m_latency = boost::chrono::milliseconds(latency_ms);
+    m_max_pending = max_pending;
+    m_stop = false;
+    m_running = true;
+    m_thread = boost::thread(&db_sync_thread::run, this);
+    MINFO("DB sync thread started, latency " << latency_ms << " ms");
+  }
+
+  void db_sync_thread::stop()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      if (!m_running)
+        return;
+      m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    m_running = false;
+  }
+
+  bool db_sync_thread::is_running() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_running;
+  }
+
+  db_sync_thread::durable_future db_sync_thread::request()
+  {
+    return request(false);
+  }
+
+  db_sync_thread::durable_future db_sync_thread::flush()
+  {
+    return request(true);
+  }
+
+  db_sync_thread::durable_future db_sync_thread::request(bool flush)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    ++m_requests;
+    if (!m_running || m_stop)
+    {
+      lock.unlock();
+      std::promise<bool> promise;
+      promise.set_value(sync());
+      lock.lock();
+      ++m_syncs;
+      return promise.get_future().share();
+    }
+
+    if (m_pending++ == 0)
+    {
+      m_promise = std::promise<bool>();
+      m_future = m_promise.get_future().share();
+      m_first_request = boost::chrono::steady_clock::now();
+    }
+    m_flush |= flush;
+    durable_future future = m_future;
+    if (m_pending == 1 || m_flush || m_pending >= m_max_pending)
+      m_cond.notify_all();
+    return future;
+  }
+
+  uint64_t db_sync_thread::get_request_count() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_requests;
+  }
+
+  uint64_t db_sync_thread::get_sync_count() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_syncs;
+  }
+
+  bool db_sync_thread::sync()
+  {
+    try
+    {
+      m_sync();
+      return true;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to sync the db: " << e.what());
+    }
+    catch (...)
+    {
+      MERROR("Failed to sync the db");
+    }
+    return false;
+  }
+
+  void db_sync_thread::run()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    while (true)
+    {
+      while (!m_stop && m_pending == 0)
+        m_cond.wait(lock);
+      if (m_pending == 0)
+        return;
+
+      // give other writers until the deadline to join this group
+      const boost::chrono::steady_clock::time_point deadline = m_first_request + m_latency;
+      while (!m_stop && !m_flush && m_pending < m_max_pending && boost::chrono::steady_clock::now() < deadline)
+        m_cond.wait_until(lock, deadline);
+
+      std::promise<bool> promise = std::move(m_promise);
+      const size_t group = m_pending;
+      m_pending = 0;
+      m_flush = false;
+      lock.unlock();
+
+      const bool r = sync();
+      MDEBUG("Synced the db for " << group << " requests");
+      promise.set_value(r);
+
+      lock.lock();
+      ++m_syncs;
+    }
+  }
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstdint>
+#include <functional>
+#include <future>
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  //! Syncs the db on a background thread, grouping the requests made within a latency budget
+  /*! Writers commit without waiting for the disk and request a sync afterwards.
+  All the requests made while a sync is pending share it, so one fsync makes a
+  whole group of commits durable. Each request gets a future for that. */
+  class db_sync_thread
+  {
+  public:
+    //! true once the commits made before the request are on disk, false if the sync failed
+    typedef std::shared_future<bool> durable_future;
+
+    db_sync_thread(std::function<void()> sync);
+    ~db_sync_thread();
+
+    /**
+     * @brief starts the sync thread
+     *
+     * @param latency_ms how long a request may wait for others to join its group
+     * @param max_pending sync at once when this many requests are waiting
+     */
+    void start(uint64_t latency_ms, size_t max_pending = 1000);
+
+    //! syncs what is pending, then joins the thread
+    void stop();
+
+    bool is_running() const;
+
+    //! requests a sync covering everything committed so far, syncs inline if not running
+    durable_future request();
+
+    //! ditto, without waiting for the latency budget
+    durable_future flush();
+
+    uint64_t get_request_count() const;
+    uint64_t get_sync_count() const;
+
+  private:
+    durable_future request(bool flush);
+    bool sync();
+    void run();
+
+    std::function<void()> m_sync;
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_cond;
+    boost::thread m_thread;
+    std::promise<bool> m_promise;
+    durable_future m_future;
+    boost::chrono::steady_clock::time_point m_first_request;
+    boost::chrono::milliseconds m_latency;
+    size_t m_max_pending;
+    size_t m_pending;
+    uint64_t m_requests;
+    uint64_t m_syncs;
+    bool m_running;
+    bool m_flush;
+    bool m_stop;
+  };
+}
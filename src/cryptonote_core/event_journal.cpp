@@ -0,0 +1,87 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "event_journal.h"
+
+#include <boost/chrono/duration.hpp>
+
+namespace cryptonote
+{
+  event_journal::event_journal(size_t max_events)
+    : m_next_seq(1), m_max_events(max_events), m_interrupted(false)
+  {
+  }
+
+  void event_journal::publish(chain_event::type_t type, const crypto::hash& id, uint64_t height)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      m_events.push_back(chain_event{m_next_seq++, type, id, height});
+      while (m_events.size() > m_max_events)
+        m_events.pop_front();
+    }
+    m_cond.notify_all();
+  }
+
+  uint64_t event_journal::get_cursor() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_next_seq;
+  }
+
+  bool event_journal::get_events(uint64_t cursor, std::vector<chain_event>& events, uint64_t& next_cursor, uint64_t timeout_ms, size_t max_count)
+  {
+    events.clear();
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (cursor > m_next_seq)
+      cursor = m_next_seq;
+    if (timeout_ms && !m_interrupted)
+      m_cond.wait_for(lock, boost::chrono::milliseconds(timeout_ms), [&]{ return m_interrupted || m_next_seq > cursor; });
+
+    bool complete = true;
+    const uint64_t first_seq = m_events.empty() ? m_next_seq : m_events.front().seq;
+    if (cursor < first_seq)
+    {
+      complete = false;
+      cursor = first_seq;
+    }
+    for (auto i = m_events.begin() + (cursor - first_seq); i != m_events.end() && events.size() < max_count; ++i)
+      events.push_back(*i);
+    next_cursor = cursor + events.size();
+    return complete;
+  }
+
+  void event_journal::interrupt()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      m_interrupted = true;
+    }
+    m_cond.notify_all();
+  }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  //! A change to the chain tip or the tx pool
+  struct chain_event
+  {
+    enum type_t
+    {
+      block_added,
+      block_removed,
+      tx_added,
+      tx_removed
+    };
+
+    uint64_t seq;       //!< position in the journal, starting at 1
+    type_t type;
+    crypto::hash id;    //!< block or transaction hash
+    uint64_t height;    //!< height of the block, 0 for transactions
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  //! Recent chain and pool changes, so clients can wait for deltas instead of polling
+  /*! Clients keep a cursor, the sequence number of the next event they want. Only
+  the most recent events are kept; a client whose cursor fell behind is told so
+  and has to resync. */
+  class event_journal
+  {
+  public:
+    event_journal(size_t max_events = 4096);
+
+    void publish(chain_event::type_t type, const crypto::hash& id, uint64_t height);
+
+    //! \return the cursor for the next event to be published
+    uint64_t get_cursor() const;
+
+    /**
+     * @brief get the events from `cursor` on, waiting for one if there are none yet
+     *
+     * @param cursor the sequence number of the first event wanted
+     * @param events return-by-reference the events, at most `max_count`
+     * @param next_cursor return-by-reference the cursor to use for the next call
+     * @param timeout_ms how long to wait if there is no event yet, 0 to return at once
+     * @param max_count max number of events to return
+     *
+     * @return false if events after `cursor` were dropped already, `events` then starts at the oldest one kept
+     */
+    bool get_events(uint64_t cursor, std::vector<chain_event>& events, uint64_t& next_cursor, uint64_t timeout_ms, size_t max_count);
+
+    //! wakes all waiting callers, and makes further calls return at once
+    void interrupt();
+
+  private:
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_cond;
+    std::deque<chain_event> m_events;
+    uint64_t m_next_seq;
+    size_t m_max_events;
+    bool m_interrupted;
+  };
+}
@@ -45,6 +45,8 @@
 #include "warnings.h"
 #include "common/perf_timer.h"
 #include "crypto/hash.h"
+#include "metrics.h"
+#include "common/trace.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "txpool"
@@ -73,6 +75,12 @@ namespace cryptonote
       return d;
     }
 
+    void update_pool_size_metric(size_t count)
+    {
+      static epee::metrics::gauge &pool_size = epee::metrics::registry::instance().get_gauge("txpool_transactions", "Transactions in the pool");
+      pool_size.set(count);
+    }
+
     uint64_t template_accept_threshold(uint64_t amount)
     {
       return amount * ACCEPT_THRESHOLD;
@@ -92,7 +100,8 @@ namespace cryptonote
       LockedTXN(Blockchain &b): m_blockchain(b), m_batch(false) {
         m_batch = m_blockchain.get_db().batch_start();
       }
-      ~LockedTXN() { try { if (m_batch) { m_blockchain.get_db().batch_stop(); } } catch (const std::exception &e) { MWARNING("LockedTXN dtor filtering exception: " << e.what()); } }
+      // the txpool lock is held here, so don't wait for the sync, it's done with the next group
+      ~LockedTXN() { try { if (m_batch) { m_blockchain.get_db().batch_stop(); m_blockchain.request_db_sync(); } } catch (const std::exception &e) { MWARNING("LockedTXN dtor filtering exception: " << e.what()); } }
     private:
       Blockchain &m_blockchain;
       bool m_batch;
@@ -100,13 +109,14 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_cookie(0), m_events(NULL), m_blockchain(bchs)
   {
 
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, size_t blob_size, tx_verification_context& tvc, bool kept_by_block, bool relayed, bool do_not_relay, uint8_t version)
   {
+    TRACE_SCOPE_ID("txpool", "add_tx", id);
     // this should already be called with that lock, but let's make it explicit for clarity
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
@@ -209,6 +219,10 @@ namespace cryptonote
           if (!insert_key_images(tx, kept_by_block))
             return false;
           m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)blob_size, receive_time), id);
+          ++m_cookie;
+          update_pool_size_metric(m_txs_by_fee_and_receive_time.size());
+          if (m_events)
+            m_events->publish(chain_event::tx_added, id, 0);
         }
         catch (const std::exception &e)
         {
@@ -248,6 +262,10 @@ namespace cryptonote
         if (!insert_key_images(tx, kept_by_block))
           return false;
         m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)blob_size, receive_time), id);
+        ++m_cookie;
+        update_pool_size_metric(m_txs_by_fee_and_receive_time.size());
+        if (m_events)
+          m_events->publish(chain_event::tx_added, id, 0);
       }
       catch (const std::exception &e)
       {
@@ -362,6 +380,10 @@ namespace cryptonote
     }
 
     m_txs_by_fee_and_receive_time.erase(sorted_it);
+    ++m_cookie;
+    update_pool_size_metric(m_txs_by_fee_and_receive_time.size());
+    if (m_events)
+      m_events->publish(chain_event::tx_removed, id, 0);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -426,6 +448,8 @@ namespace cryptonote
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
             remove_transaction_keyimages(tx);
+            if (m_events)
+              m_events->publish(chain_event::tx_removed, txid, 0);
           }
         }
         catch (const std::exception &e)
@@ -434,6 +458,7 @@ namespace cryptonote
           // ignore error
         }
       }
+      ++m_cookie;
     }
     return true;
   }
@@ -492,6 +517,7 @@ namespace cryptonote
         // continue
       }
     }
+    ++m_cookie;
   }
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_transactions_count() const
@@ -954,6 +980,10 @@ namespace cryptonote
             m_txs_by_fee_and_receive_time.erase(sorted_it);
           }
           ++n_removed;
+          ++m_cookie;
+          update_pool_size_metric(m_txs_by_fee_and_receive_time.size());
+          if (m_events)
+            m_events->publish(chain_event::tx_removed, txid, 0);
         }
         catch (const std::exception &e)
         {
@@ -972,7 +1002,7 @@ namespace cryptonote
 
     m_txs_by_fee_and_receive_time.clear();
     m_spent_key_images.clear();
-    return m_blockchain.for_all_txpool_txes([this](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+    const bool r = m_blockchain.for_all_txpool_txes([this](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
       cryptonote::transaction tx;
       if (!parse_and_validate_tx_from_blob(*bd, tx))
       {
@@ -987,6 +1017,8 @@ namespace cryptonote
       m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.blob_size, meta.receive_time), txid);
       return true;
     }, true);
+    update_pool_size_metric(m_txs_by_fee_and_receive_time.size());
+    return r;
   }
 
   //---------------------------------------------------------------------------------
@@ -31,6 +31,7 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <atomic>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -44,6 +45,7 @@
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/verification_context.h"
 #include "blockchain_db/blockchain_db.h"
+#include "event_journal.h"
 #include "crypto/hash.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 
@@ -306,6 +308,23 @@ namespace cryptonote
      */
     size_t get_transactions_count() const;
 
+    /**
+     * @brief get a counter which changes whenever the pool contents change
+     *
+     * Callers can compare it to a previous value to know whether
+     * anything derived from the pool is stale.
+     *
+     * @return the current counter value
+     */
+    uint64_t cookie() const { return m_cookie; }
+
+    /**
+     * @brief set the journal to publish added and removed transactions to
+     *
+     * @param events the journal, or NULL for none
+     */
+    void set_event_journal(event_journal* events) { m_events = events; }
+
     /**
      * @brief get a string containing human-readable pool information
      *
@@ -500,6 +519,9 @@ private:
      */
     std::unordered_set<crypto::hash> m_timed_out_transactions;
 
+    std::atomic<uint64_t> m_cookie; //!< incremented on every change to the pool contents
+    event_journal* m_events; //!< where additions and removals are published, if set
+
     Blockchain& m_blockchain;  //!< reference to the Blockchain object
   };
 }
@@ -38,6 +38,7 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "profile_tools.h"
 #include "p2p/network_throttle-detail.hpp"
+#include "common/trace.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "net.cn"
@@ -284,6 +285,14 @@ namespace cryptonote
       return true;
     }
 
+    // a pruned peer can't send the whole txs we need to verify its lower blocks
+    if (hshd.pruned_height > m_core.get_current_blockchain_height())
+    {
+      LOG_DEBUG_CC(context, "Peer is pruned up to height " << hshd.pruned_height << ", not syncing from it");
+      context.m_state = cryptonote_connection_context::state_normal;
+      return true;
+    }
+
     if (hshd.current_height > target)
     {
     /* As I don't know if accessing hshd from core could be a good practice,
@@ -314,6 +323,7 @@ namespace cryptonote
     hshd.top_version = m_core.get_ideal_hard_fork_version(hshd.current_height);
     hshd.cumulative_difficulty = m_core.get_block_cumulative_difficulty(hshd.current_height);
     hshd.current_height +=1;
+    hshd.pruned_height = m_core.get_pruned_height();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -330,6 +340,7 @@ namespace cryptonote
     int t_cryptonote_protocol_handler<t_core>::handle_notify_new_block(int command, NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_BLOCK (hop " << arg.hop << ", " << arg.b.txs.size() << " txes)");
+    TRACE_SCOPE("p2p", "notify_new_block");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
     if(!is_synchronized()) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
@@ -391,6 +402,7 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_FLUFFY_BLOCK (height " << arg.current_blockchain_height << ", hop " << arg.hop << ", " << arg.b.txs.size() << " txes)");
+    TRACE_SCOPE("p2p", "notify_new_fluffy_block");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
     if(!is_synchronized()) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
@@ -754,6 +766,7 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
+    TRACE_SCOPE("p2p", "notify_new_transactions");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
@@ -830,6 +843,7 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_GET_OBJECTS (" << arg.blocks.size() << " blocks, " << arg.txs.size() << " txes)");
+    TRACE_SCOPE("p2p", "response_get_objects");
 
     // calculate size of request
     size_t size = 0;
@@ -1029,6 +1043,8 @@ skip:
           const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
           context.m_last_request_time = start;
 
+          tools::trace::scope span_trace("p2p", "add_span");
+          span_trace.set_height(start_height);
           m_core.prepare_handle_incoming_blocks(blocks);
 
           uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
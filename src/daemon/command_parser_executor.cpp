@@ -586,4 +586,14 @@ bool t_command_parser_executor::sync_info(const std::vector<std::string>& args)
   return m_executor.sync_info();
 }
 
+bool t_command_parser_executor::trace(const std::vector<std::string>& args)
+{
+  if (args.empty())
+    return m_executor.trace("status");
+  if (args.size() == 1 && (args[0] == "start" || args[0] == "stop"))
+    return m_executor.trace(args[0]);
+  std::cout << "usage: trace [start|stop]" << std::endl;
+  return true;
+}
+
 } // namespace daemonize
@@ -128,6 +128,8 @@ public:
   bool relay_tx(const std::vector<std::string>& args);
 
   bool sync_info(const std::vector<std::string>& args);
+
+  bool trace(const std::vector<std::string>& args);
 };
 
 } // namespace daemonize
@@ -258,6 +258,11 @@ t_command_server::t_command_server(
     , std::bind(&t_command_parser_executor::sync_info, &m_parser, p::_1)
     , "Print information about blockchain sync state"
     );
+    m_command_lookup.set_handler(
+      "trace"
+    , std::bind(&t_command_parser_executor::trace, &m_parser, p::_1)
+    , "trace [start|stop] - Record the block and transaction processing stages to fonerod-trace.json in the data directory, a Chrome trace file, or print the trace status"
+    );
 }
 
 bool t_command_server::process_command_str(const std::string& cmd)
@@ -39,6 +39,7 @@
 #include "daemon/p2p.h"
 #include "daemon/protocol.h"
 #include "daemon/rpc.h"
+#include "daemon/stratum.h"
 #include "daemon/command_server.h"
 #include "version.h"
 #include "syncobj.h"
@@ -59,6 +60,7 @@ public:
   t_core core;
   t_p2p p2p;
   t_rpc rpc;
+  t_stratum stratum;
 
   t_internals(
       boost::program_options::variables_map const & vm
@@ -67,6 +69,7 @@ public:
     , protocol{vm, core}
     , p2p{vm, protocol}
     , rpc{vm, core, p2p}
+    , stratum{vm, core, p2p}
   {
     // Handle circular dependencies
     protocol.set_p2p_endpoint(p2p.get());
@@ -79,6 +82,7 @@ void t_daemon::init_options(boost::program_options::options_description & option
   t_core::init_options(option_spec);
   t_p2p::init_options(option_spec);
   t_rpc::init_options(option_spec);
+  t_stratum::init_options(option_spec);
 }
 
 t_daemon::t_daemon(
@@ -123,6 +127,7 @@ bool t_daemon::run(bool interactive)
     if (!mp_internals->core.run())
       return false;
     mp_internals->rpc.run();
+    mp_internals->stratum.run();
 
     std::unique_ptr<daemonize::t_command_server> rpc_commands;
 
@@ -140,6 +145,7 @@ bool t_daemon::run(bool interactive)
       rpc_commands->stop_handling();
     }
 
+    mp_internals->stratum.stop(); // before rpc, which interrupts the event journal it waits on
     mp_internals->rpc.stop();
     mp_internals->core.get().get_miner().stop();
     MGINFO("Node stopped.");
@@ -165,6 +171,7 @@ void t_daemon::stop()
   }
   mp_internals->core.get().get_miner().stop();
   mp_internals->p2p.stop();
+  mp_internals->stratum.stop();
   mp_internals->rpc.stop();
   mp_internals.reset(nullptr); // Ensure resources are cleaned up before we return
 }
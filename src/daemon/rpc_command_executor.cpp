@@ -724,6 +724,12 @@ bool t_rpc_command_executor::print_transaction(crypto::hash transaction_hash) {
         tools::success_msg_writer() << "Found in pool";
       else
         tools::success_msg_writer() << "Found in blockchain at height " << res.txs.front().block_height;
+      if (res.txs.front().pruned)
+      {
+        tools::success_msg_writer() << "Pruned, prunable hash " << res.txs.front().prunable_hash;
+        tools::success_msg_writer() << res.txs.front().pruned_as_hex;
+        return true;
+      }
     }
 
     // first as hex
@@ -1783,4 +1789,37 @@ bool t_rpc_command_executor::sync_info()
     return true;
 }
 
+bool t_rpc_command_executor::trace(const std::string &command)
+{
+    cryptonote::COMMAND_RPC_TRACE::request req;
+    cryptonote::COMMAND_RPC_TRACE::response res;
+    std::string fail_message = "Unsuccessful";
+
+    req.command = command;
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->rpc_request(req, res, "/trace", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_trace(req, res) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    if (res.tracing)
+        tools::success_msg_writer() << "Tracing to " << res.path << ", " << res.events << " events written, " << res.dropped << " dropped";
+    else if (command == "stop")
+        tools::success_msg_writer() << "Trace written to " << res.path << ", " << res.events << " events, " << res.dropped << " dropped";
+    else
+        tools::success_msg_writer() << "Not tracing";
+
+    return true;
+}
+
 }// namespace daemonize
@@ -146,6 +146,8 @@ public:
   bool relay_tx(const std::string &txid);
 
   bool sync_info();
+
+  bool trace(const std::string &command);
 };
 
 } // namespace daemonize
@@ -0,0 +1,86 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+#pragma once
+
+#include "rpc/stratum_server.h"
+
+#undef FONERO_DEFAULT_LOG_CATEGORY
+#define FONERO_DEFAULT_LOG_CATEGORY "daemon"
+
+namespace daemonize
+{
+
+class t_stratum final
+{
+public:
+  static void init_options(boost::program_options::options_description & option_spec)
+  {
+    cryptonote::stratum_server::init_options(option_spec);
+  }
+private:
+  cryptonote::stratum_server m_server;
+public:
+  t_stratum(
+      boost::program_options::variables_map const & vm
+    , t_core & core
+    , t_p2p & p2p
+    )
+    : m_server{core.get(), p2p.get()}
+  {
+    if (!m_server.init(vm))
+    {
+      throw std::runtime_error("Failed to initialize stratum server.");
+    }
+    if (m_server.is_enabled())
+      MGINFO("Stratum server initialized OK on port: " << m_server.get_binded_port());
+  }
+
+  void run()
+  {
+    if (!m_server.is_enabled())
+      return;
+    MGINFO("Starting stratum server...");
+    if (!m_server.run(2))
+    {
+      throw std::runtime_error("Failed to start stratum server.");
+    }
+    MGINFO("Stratum server started ok");
+  }
+
+  void stop()
+  {
+    if (!m_server.is_enabled())
+      return;
+    MGINFO("Stopping stratum server...");
+    m_server.stop();
+  }
+};
+
+}
@@ -109,10 +109,12 @@ class connection_basic_pimpl {
 
 		static int m_default_tos;
 
-		network_throttle_bw m_throttle; // per-perr
-    critical_section m_throttle_lock;
+		network_token_bucket m_bucket_in; // per-peer, chained to the global bucket
+		network_token_bucket m_bucket_out; // ditto
 
 		int m_peer_number; // e.g. for debug/stats
+
+		static void sync_rate(network_token_bucket &bucket, uint64_t rate); // follow a per-peer limit changed after the connection was made
 };
 
 
@@ -132,7 +134,17 @@ namespace net_utils
 // connection_basic_pimpl
 // ================================================================================================
 	
-connection_basic_pimpl::connection_basic_pimpl(const std::string &name) : m_throttle(name) { }
+connection_basic_pimpl::connection_basic_pimpl(const std::string &name)
+	: m_bucket_in(&network_throttle_manager::get_global_bucket_in()), m_bucket_out(&network_throttle_manager::get_global_bucket_out())
+{
+	m_bucket_in.set_rate(network_throttle_manager::get_peer_rate_in());
+	m_bucket_out.set_rate(network_throttle_manager::get_peer_rate_out());
+}
+
+void connection_basic_pimpl::sync_rate(network_token_bucket &bucket, uint64_t rate) {
+	if (bucket.get_rate() != rate)
+		bucket.set_rate(rate);
+}
 
 // ================================================================================================
 // connection_basic
@@ -169,105 +181,68 @@ connection_basic::~connection_basic() noexcept(false) {
 }
 
 void connection_basic::set_rate_up_limit(uint64_t limit) {
-	
-	// TODO remove __SCALING_FACTOR...
-	const double SCALING_FACTOR = 2.1; // to acheve the best performance
-	limit *= SCALING_FACTOR;
-	{
-		CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().set_target_speed(limit);
-		network_throttle_manager::get_global_throttle_out().set_real_target_speed(limit / SCALING_FACTOR);
-	}
+	network_throttle_manager::get_global_bucket_out().set_rate(limit);
 	save_limit_to_file(limit);
 }
 
 void connection_basic::set_rate_down_limit(uint64_t limit) {
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
-		network_throttle_manager::get_global_throttle_in().set_target_speed(limit);
-	}
-
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_inreq );
-		network_throttle_manager::get_global_throttle_inreq().set_target_speed(limit);
-	}
-    save_limit_to_file(limit);
+	network_throttle_manager::get_global_bucket_in().set_rate(limit);
+	save_limit_to_file(limit);
 }
 
 uint64_t connection_basic::get_rate_up_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_out );
-         limit = network_throttle_manager::get_global_throttle_out().get_target_speed();
-	}
-    return limit;
+	return network_throttle_manager::get_global_bucket_out().get_rate();
 }
 
 uint64_t connection_basic::get_rate_down_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_in );
-         limit = network_throttle_manager::get_global_throttle_in().get_target_speed();
-	}
-    return limit;
+	return network_throttle_manager::get_global_bucket_in().get_rate();
 }
 
-void connection_basic::save_limit_to_file(int limit) {
+void connection_basic::set_rate_up_limit_per_peer(uint64_t limit) {
+	network_throttle_manager::set_peer_rate_out(limit);
 }
 
-void connection_basic::set_tos_flag(int tos) {
-	connection_basic_pimpl::m_default_tos = tos;
+void connection_basic::set_rate_down_limit_per_peer(uint64_t limit) {
+	network_throttle_manager::set_peer_rate_in(limit);
 }
 
-int connection_basic::get_tos_flag() {
-	return connection_basic_pimpl::m_default_tos;
+uint64_t connection_basic::get_rate_up_limit_per_peer() {
+	return network_throttle_manager::get_peer_rate_out();
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) {
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size ); // decission from global
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
-
-// XXX LATER XXX
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size * 700); // increase counter - global
-	}
+uint64_t connection_basic::get_rate_down_limit_per_peer() {
+	return network_throttle_manager::get_peer_rate_in();
+}
 
+void connection_basic::save_limit_to_file(int limit) {
 }
-void connection_basic::set_start_time() {
-	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-	m_start_time = network_throttle_manager::get_global_throttle_out().get_time_seconds();
+
+void connection_basic::set_tos_flag(int tos) {
+	connection_basic_pimpl::m_default_tos = tos;
 }
 
-void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
-	sleep_before_packet(cb,1,-1);
-	MTRACE("handler_write (direct) - before ASIO write, for packet="<<cb<<" B (after sleep)");
-	set_start_time();
+int connection_basic::get_tos_flag() {
+	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::do_send_handler_write_from_queue( const boost::system::error_code& e, size_t cb, int q_len ) {
-	sleep_before_packet(cb,2,q_len);
-	MTRACE("handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B (after sleep)");
+double connection_basic::get_send_delay(size_t packet_size) {
+	if (m_was_shutdown)
+		return 0;
+	connection_basic_pimpl::sync_rate(mI->m_bucket_out, network_throttle_manager::get_peer_rate_out());
+	const double delay = mI->m_bucket_out.consume(packet_size);
+	if (delay > 0)
+		MTRACE("Deferring send of packet_size=" << packet_size << " by " << (long int)(delay * 1000) << " ms");
+	return delay;
+}
 
-	set_start_time();
+double connection_basic::get_recv_delay(size_t packet_size) {
+	if (m_was_shutdown)
+		return 0;
+	connection_basic_pimpl::sync_rate(mI->m_bucket_in, network_throttle_manager::get_peer_rate_in());
+	const double delay = mI->m_bucket_in.consume(packet_size);
+	if (delay > 0)
+		MTRACE("Deferring next read after packet_size=" << packet_size << " by " << (long int)(delay * 1000) << " ms");
+	return delay;
 }
 
 void connection_basic::logger_handle_net_read(size_t size) { // network data read
@@ -277,9 +252,7 @@ void connection_basic::logger_handle_net_write(size_t size) {
 }
 
 double connection_basic::get_sleep_time(size_t cb) {
-	CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_out);
-    auto t = network_throttle_manager::get_global_throttle_out().get_sleep_time(cb);
-    return t;
+	return network_throttle_manager::get_global_bucket_out().get_delay(cb);
 }
 
 void connection_basic::set_save_graph(bool save_graph) {
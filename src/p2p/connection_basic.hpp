@@ -82,7 +82,6 @@ class connection_basic { // not-templated base class for rapid developmet of som
     critical_section m_send_que_lock;
     std::list<std::string> m_send_que;
     volatile bool m_is_multithreaded;
-    double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
     /// Socket for the connection.
@@ -96,29 +95,29 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		virtual ~connection_basic() noexcept(false);
 
 		// various handlers to be called from connection class:
-		void do_send_handler_write(const void * ptr , size_t cb);
-		void do_send_handler_write_from_queue(const boost::system::error_code& e, size_t cb , int q_len); // from handle_write, sending next part
-
 		void logger_handle_net_write(size_t size); // network data written
 		void logger_handle_net_read(size_t size); // network data read
 
-		void set_start_time();
-
 		// config for rate limit
 		
 		static void set_rate_up_limit(uint64_t limit);
 		static void set_rate_down_limit(uint64_t limit);
 		static uint64_t get_rate_up_limit();
 		static uint64_t get_rate_down_limit();
+		static void set_rate_up_limit_per_peer(uint64_t limit); ///< bytes/s for each connection, on top of the global limit
+		static void set_rate_down_limit_per_peer(uint64_t limit); ///< ditto
+		static uint64_t get_rate_up_limit_per_peer();
+		static uint64_t get_rate_down_limit_per_peer();
 
 		// config misc
 		static void set_tos_flag(int tos); // ToS / QoS flag
 		static int get_tos_flag();
 
-		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		// rate limiting: the traffic is accounted, and the connection defers the transfer by a timer
+		double get_send_delay(size_t packet_size); ///< debit an outgoing packet, returns seconds to wait before writing it
+		double get_recv_delay(size_t packet_size); ///< debit an incoming packet, returns seconds to wait before reading more
 		static void save_limit_to_file(int limit); ///< for dr-fonero
-		static double get_sleep_time(size_t cb);
+		static double get_sleep_time(size_t cb); ///< delay a packet would get from the global upload limit now, without debiting it
 		
 		static void set_save_graph(bool save_graph);
 };
@@ -236,6 +236,7 @@ namespace nodetool
     bool set_rate_up_limit(const boost::program_options::variables_map& vm, int64_t limit);
     bool set_rate_down_limit(const boost::program_options::variables_map& vm, int64_t limit);
     bool set_rate_limit(const boost::program_options::variables_map& vm, int64_t limit);
+    bool set_rate_limit_per_peer(const boost::program_options::variables_map& vm, int64_t limit_up, int64_t limit_down);
 
     bool has_too_many_connections(const epee::net_utils::network_address &address);
 
@@ -101,6 +101,8 @@ namespace nodetool
     const command_line::arg_descriptor<int64_t> arg_limit_rate_up = {"limit-rate-up", "set limit-rate-up [kB/s]", -1};
     const command_line::arg_descriptor<int64_t> arg_limit_rate_down = {"limit-rate-down", "set limit-rate-down [kB/s]", -1};
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
+    const command_line::arg_descriptor<int64_t> arg_limit_rate_up_per_peer = {"limit-rate-up-per-peer", "set limit-rate-up for each peer [kB/s]", -1};
+    const command_line::arg_descriptor<int64_t> arg_limit_rate_down_per_peer = {"limit-rate-down-per-peer", "set limit-rate-down for each peer [kB/s]", -1};
 
     const command_line::arg_descriptor<bool> arg_save_graph = {"save-graph", "Save data for dr fonero", false};
   }
@@ -125,6 +127,8 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate_up);
     command_line::add_arg(desc, arg_limit_rate_down);
     command_line::add_arg(desc, arg_limit_rate);
+    command_line::add_arg(desc, arg_limit_rate_up_per_peer);
+    command_line::add_arg(desc, arg_limit_rate_down_per_peer);
     command_line::add_arg(desc, arg_save_graph);
   }
   //-----------------------------------------------------------------------------------
@@ -362,6 +366,9 @@ namespace nodetool
     if ( !set_rate_limit(vm, command_line::get_arg(vm, arg_limit_rate) ) )
       return false;
 
+    if ( !set_rate_limit_per_peer(vm, command_line::get_arg(vm, arg_limit_rate_up_per_peer), command_line::get_arg(vm, arg_limit_rate_down_per_peer) ) )
+      return false;
+
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -1925,6 +1932,21 @@ namespace nodetool
     return true;
   }
 
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::set_rate_limit_per_peer(const boost::program_options::variables_map& vm, int64_t limit_up, int64_t limit_down)
+  {
+    // -1 keeps the peers limited by the global limits only
+    limit_up = limit_up == -1 ? 0 : limit_up * 1024;
+    limit_down = limit_down == -1 ? 0 : limit_down * 1024;
+    epee::net_utils::connection<epee::levin::async_protocol_handler<p2p_connection_context> >::set_rate_up_limit_per_peer(limit_up);
+    epee::net_utils::connection<epee::levin::async_protocol_handler<p2p_connection_context> >::set_rate_down_limit_per_peer(limit_down);
+    if (limit_up)
+      MINFO("Set limit-up per peer to " << limit_up/1024 << " kB/s");
+    if (limit_down)
+      MINFO("Set limit-down per peer to " << limit_down/1024 << " kB/s");
+    return true;
+  }
+
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::has_too_many_connections(const epee::net_utils::network_address &address)
   {
@@ -366,6 +366,89 @@ double network_throttle::get_current_speed() const {
 	return bytes_transferred / ((m_history.size() - 1) * m_slot_size);
 }
 
+// ================================================================================================
+// network_token_bucket
+// ================================================================================================
+
+network_token_bucket::network_token_bucket(network_token_bucket *parent, time_source clock)
+	: m_parent(parent), m_clock(clock), m_rate(0), m_tokens(0), m_last_refill(clock())
+{
+}
+
+uint64_t network_token_bucket::get_time_microseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void network_token_bucket::set_rate(uint64_t bytes_per_second)
+{
+	// start with a full bucket, so a new limit does not penalize traffic done under the old one
+	m_rate = bytes_per_second;
+	m_tokens = get_burst(bytes_per_second);
+	m_last_refill = m_clock();
+}
+
+uint64_t network_token_bucket::get_rate() const
+{
+	return m_rate;
+}
+
+void network_token_bucket::refill(uint64_t now)
+{
+	const uint64_t rate = m_rate.load(std::memory_order_relaxed);
+	uint64_t last = m_last_refill.load(std::memory_order_relaxed);
+	if (rate == 0 || now <= last)
+		return;
+
+	const int64_t burst = get_burst(rate);
+	// anything older than a full bucket is irrelevant, and would overflow below
+	const uint64_t elapsed = std::min<uint64_t>(now - last, 1000000ull * burst / rate + 1);
+	const int64_t add = elapsed * rate / 1000000;
+	if (add <= 0)
+		return; // not even a byte yet, keep the time so fractions are not lost
+
+	// only one thread gets to credit a given time interval
+	const uint64_t credited_until = (now - last == elapsed) ? last + add * 1000000 / rate : now;
+	if (!m_last_refill.compare_exchange_strong(last, credited_until, std::memory_order_relaxed))
+		return;
+
+	int64_t tokens = m_tokens.load(std::memory_order_relaxed);
+	while (!m_tokens.compare_exchange_weak(tokens, std::min(tokens + add, burst), std::memory_order_relaxed))
+		;
+}
+
+network_time_seconds network_token_bucket::consume(size_t packet_size)
+{
+	network_time_seconds delay = m_parent ? m_parent->consume(packet_size) : 0;
+
+	const uint64_t rate = m_rate.load(std::memory_order_relaxed);
+	if (rate == 0)
+		return delay;
+
+	refill(m_clock());
+	const int64_t left = m_tokens.fetch_sub(packet_size, std::memory_order_relaxed) - (int64_t)packet_size;
+	if (left < 0)
+		delay = std::max(delay, -left / (double)rate);
+	return delay;
+}
+
+network_time_seconds network_token_bucket::get_delay(size_t packet_size) const
+{
+	network_time_seconds delay = m_parent ? m_parent->get_delay(packet_size) : 0;
+
+	const uint64_t rate = m_rate.load(std::memory_order_relaxed);
+	if (rate == 0)
+		return delay;
+
+	const uint64_t now = m_clock(), last = m_last_refill.load(std::memory_order_relaxed);
+	const int64_t elapsed = now > last ? std::min<uint64_t>(now - last, 1000000ull * get_burst(rate) / rate + 1) : 0;
+	const int64_t tokens = std::min<int64_t>(m_tokens.load(std::memory_order_relaxed) + elapsed * rate / 1000000, get_burst(rate));
+	const int64_t left = tokens - (int64_t)packet_size;
+	if (left < 0)
+		delay = std::max(delay, -left / (double)rate);
+	return delay;
+}
+
 } // namespace
 } // namespace
 
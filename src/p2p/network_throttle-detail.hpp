@@ -99,6 +99,38 @@ class network_throttle : public i_network_throttle {
         virtual void logger_handle_net(const std::string &filename, double time, size_t size);
 };
 
+/***
+@brief Token bucket rate limiter, chained to an optional parent bucket (e.g. global -> per-peer)
+
+All accounting is done with atomics, so it can be shared by all io threads without locks.
+Traffic is always debited (the bucket may go into debt); the returned delay tells the caller
+how long to defer the transfer, which it is expected to do with a timer instead of sleeping.
+*/
+class network_token_bucket {
+	public:
+		typedef uint64_t (*time_source)(); ///< returns monotonic microseconds
+
+		network_token_bucket(network_token_bucket *parent = nullptr, time_source clock = &get_time_microseconds);
+
+		void set_rate(uint64_t bytes_per_second); ///< 0 means unlimited
+		uint64_t get_rate() const;
+
+		network_time_seconds consume(size_t packet_size); ///< debit the traffic here and in all parents, return the delay before it may be transferred
+		network_time_seconds get_delay(size_t packet_size) const; ///< ditto, but without debiting anything
+
+		static uint64_t get_time_microseconds(); ///< monotonic timer used for refills
+
+	private:
+		void refill(uint64_t now);
+		static int64_t get_burst(uint64_t rate) { return std::max<int64_t>(rate, 16 * 1024); } ///< one second worth of traffic, but at least one levin chunk
+
+		network_token_bucket *m_parent;
+		time_source m_clock;
+		std::atomic<uint64_t> m_rate; ///< bytes per second
+		std::atomic<int64_t> m_tokens; ///< bytes we may transfer now, negative when in debt
+		std::atomic<uint64_t> m_last_refill; ///< microseconds, see get_time_microseconds()
+};
+
 /***
  * The complete set of traffic throttle for one typical connection
 */
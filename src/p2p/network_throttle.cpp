@@ -38,32 +38,35 @@ namespace net_utils
 // ================================================================================================
 
 // ================================================================================================
-// static:
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_in;
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_inreq;
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_out;
-
-int network_throttle_manager::xxx;
+// methods:
+network_token_bucket & network_throttle_manager::get_global_bucket_in() {
+	static network_token_bucket obj_get_global_bucket_in;
+	return obj_get_global_bucket_in;
+}
 
 
-// ================================================================================================
-// methods:
-i_network_throttle & network_throttle_manager::get_global_throttle_in() {
-	static network_throttle obj_get_global_throttle_in("in/all","<<< global-IN",10);
-	return obj_get_global_throttle_in;
+network_token_bucket & network_throttle_manager::get_global_bucket_out() {
+	static network_token_bucket obj_get_global_bucket_out;
+	return obj_get_global_bucket_out;
 }
 
+std::atomic<uint64_t> network_throttle_manager::m_peer_rate_in(0);
+std::atomic<uint64_t> network_throttle_manager::m_peer_rate_out(0);
 
+void network_throttle_manager::set_peer_rate_in(uint64_t bytes_per_second) {
+	m_peer_rate_in = bytes_per_second;
+}
 
-i_network_throttle & network_throttle_manager::get_global_throttle_inreq() {
-	static network_throttle obj_get_global_throttle_inreq("inreq/all", "<== global-IN-REQ",10);
-	return obj_get_global_throttle_inreq;
+void network_throttle_manager::set_peer_rate_out(uint64_t bytes_per_second) {
+	m_peer_rate_out = bytes_per_second;
 }
 
+uint64_t network_throttle_manager::get_peer_rate_in() {
+	return m_peer_rate_in;
+}
 
-i_network_throttle & network_throttle_manager::get_global_throttle_out() {
-	static network_throttle obj_get_global_throttle_out("out/all", ">>> global-OUT",10);
-	return obj_get_global_throttle_out;
+uint64_t network_throttle_manager::get_peer_rate_out() {
+	return m_peer_rate_out;
 }
 
 
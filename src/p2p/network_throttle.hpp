@@ -81,6 +81,7 @@ typedef double network_time_seconds;
 typedef double network_MB;
 
 class i_network_throttle;
+class network_token_bucket;
 
 /***
 @brief All information about given throttle - speed calculations
@@ -97,31 +98,24 @@ typedef calculate_times_struct calculate_times_struct;
 namespace cryptonote { class cryptonote_protocol_handler_base; } // a friend class // TODO friend not working
 
 /*** 
-@brief Access to simple throttles, with singlton to access global network limits
+@brief Access to the global token buckets (singletons) that limit the whole network traffic
 */
 class network_throttle_manager {
-	// provides global (singleton) in/inreq/out throttle access
+	// provides global (singleton) in/out token buckets; per-peer buckets chain to these
+	// the buckets are lock-free, so no locking is needed by the callers
 
-	// [[note1]] see also http://www.nuonsoft.com/blog/2012/10/21/implementing-a-thread-safe-singleton-with-c11/
-	// [[note2]] _inreq is the requested in traffic - we anticipate we will get in-bound traffic soon as result of what we do (e.g. that we sent network downloads requests)
-	
-	//protected:
-	public: // XXX
-
-    static boost::mutex m_lock_get_global_throttle_in;
-    static boost::mutex m_lock_get_global_throttle_inreq;
-    static boost::mutex m_lock_get_global_throttle_out;
-
-		friend class cryptonote::cryptonote_protocol_handler_base; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
-		friend class connection_basic; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
-		friend class connection_basic_pimpl; // ditto
+	public:
+		static network_token_bucket & get_global_bucket_in(); ///< singleton ; parent of the per-peer download buckets
+		static network_token_bucket & get_global_bucket_out(); ///< singleton ; parent of the per-peer upload buckets
 
-		static int xxx;
+		static void set_peer_rate_in(uint64_t bytes_per_second); ///< download limit of every single peer, 0 means unlimited
+		static void set_peer_rate_out(uint64_t bytes_per_second); ///< upload limit of every single peer, 0 means unlimited
+		static uint64_t get_peer_rate_in();
+		static uint64_t get_peer_rate_out();
 
-	public:
-		static i_network_throttle & get_global_throttle_in(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_in
-		static i_network_throttle & get_global_throttle_inreq(); ///< ditto ; use lock ... use m_lock_get_global_throttle_inreq obviously
-		static i_network_throttle & get_global_throttle_out(); ///< ditto ; use lock ... use m_lock_get_global_throttle_out obviously
+	private:
+		static std::atomic<uint64_t> m_peer_rate_in;
+		static std::atomic<uint64_t> m_peer_rate_out;
 };
 
 
@@ -28,6 +28,8 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <unordered_map>
+#include <unordered_set>
 #include "include_base_utils.h"
 using namespace epee;
 
@@ -42,13 +44,19 @@ using namespace epee;
 #include "misc_language.h"
 #include "crypto/hash.h"
 #include "rpc/rpc_args.h"
+#include "storages/portable_storage_to_json.h"
 #include "core_rpc_server_error_codes.h"
+#include "common/trace.h"
 
 #undef FONERO_DEFAULT_LOG_CATEGORY
 #define FONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
 
 #define MAX_RESTRICTED_FAKE_OUTS_COUNT 40
 #define MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT 500
+#define MAX_RESTRICTED_OUTPUT_DISTRIBUTION_BLOCKS 10000
+
+#define RESPONSE_CACHE_ID_PLACEHOLDER "@@rpc_response_cache_id@@"
+#define RESPONSE_CACHE_NETWORK_MAX_AGE_MS 1000
 
 namespace cryptonote
 {
@@ -59,6 +67,9 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_bind_port);
     command_line::add_arg(desc, arg_testnet_rpc_bind_port);
     command_line::add_arg(desc, arg_restricted_rpc);
+    command_line::add_arg(desc, arg_rpc_worker_threads);
+    command_line::add_arg(desc, arg_rpc_max_requests_per_client);
+    command_line::add_arg(desc, arg_rpc_response_cache_size);
     cryptonote::rpc_args::init_options(desc);
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -68,6 +79,8 @@ namespace cryptonote
     )
     : m_core(cr)
     , m_p2p(p2p)
+    , m_max_event_waiters(0)
+    , m_event_waiters(0)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::init(
@@ -84,15 +97,194 @@ namespace cryptonote
       return false;
 
     m_restricted = command_line::get_arg(vm, arg_restricted_rpc);
+    m_trace_path = (boost::filesystem::path(command_line::get_arg(vm, m_testnet ? command_line::arg_testnet_data_dir : command_line::arg_data_dir)) / "fonerod-trace.json").string();
+    m_response_cache.set_max_size(command_line::get_arg(vm, arg_rpc_response_cache_size) * 1024);
 
     boost::optional<epee::net_utils::http::login> http_login{};
     std::string port = command_line::get_arg(vm, p2p_bind_arg);
     if (rpc_config->login)
       http_login.emplace(std::move(rpc_config->login->username), std::move(rpc_config->login->password).password());
 
-    return epee::http_server_impl_base<core_rpc_server, connection_context>::init(
+    if (!epee::http_server_impl_base<core_rpc_server, connection_context>::init(
       std::move(port), std::move(rpc_config->bind_ip), std::move(http_login)
-    );
+    ))
+      return false;
+
+    // waiting requests hold a worker, keep at least half of them for the others
+    const size_t worker_threads = command_line::get_arg(vm, arg_rpc_worker_threads);
+    m_max_event_waiters = worker_threads / 2;
+    return run_workers(worker_threads, command_line::get_arg(vm, arg_rpc_max_requests_per_client));
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::send_stop_signal()
+  {
+    m_core.get_event_journal().interrupt();
+    return epee::http_server_impl_base<core_rpc_server, connection_context>::send_stop_signal();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  static bool get_json_rpc_method(const std::string &body, std::string &method)
+  {
+    // cheap lookup of "method": "name", the body is only parsed once the request runs
+    const std::string::size_type key = body.find("\"method\"");
+    if (key == std::string::npos)
+      return false;
+    const std::string::size_type start = body.find('"', body.find(':', key + 8));
+    if (start == std::string::npos)
+      return false;
+    const std::string::size_type end = body.find('"', start + 1);
+    if (end == std::string::npos)
+      return false;
+    method = body.substr(start + 1, end - start - 1);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  epee::net_utils::http::http_request_priority core_rpc_server::get_http_request_priority(const epee::net_utils::http::http_request_info& query_info)
+  {
+    using namespace epee::net_utils::http;
+    static const std::unordered_set<std::string> heavy_uris = {
+      "/getblocks.bin", "/getblocks_by_height.bin", "/gethashes.bin", "/get_o_indexes.bin", "/getrandom_outs.bin",
+      "/get_outs.bin", "/getrandom_rctouts.bin", "/get_output_distribution.bin", "/gettransactions", "/get_transaction_pool", "/get_outs",
+      "/is_key_image_spent"
+    };
+    static const std::unordered_set<std::string> light_uris = {
+      "/getheight", "/getinfo", "/get_transaction_pool_stats", "/mining_status", "/metrics"
+    };
+    static const std::unordered_set<std::string> heavy_methods = {
+      "get_output_histogram", "getblockheadersrange", "get_coinbase_tx_sum", "get_txpool_backlog", "get_alternate_chains"
+    };
+    static const std::unordered_set<std::string> light_methods = {
+      "getblockcount", "on_getblockhash", "getblocktemplate", "submitblock", "getlastblockheader", "get_info",
+      "hard_fork_info", "get_version", "get_fee_estimate", "sync_info", "get_metrics"
+    };
+
+    if (query_info.m_URI == "/json_rpc")
+    {
+      std::string method;
+      if (!get_json_rpc_method(query_info.m_body, method))
+        return http_request_priority_normal;
+      if (heavy_methods.find(method) != heavy_methods.end())
+        return http_request_priority_low;
+      if (light_methods.find(method) != light_methods.end())
+        return http_request_priority_high;
+      return http_request_priority_normal;
+    }
+    if (heavy_uris.find(query_info.m_URI) != heavy_uris.end())
+      return http_request_priority_low;
+    if (light_uris.find(query_info.m_URI) != light_uris.end())
+      return http_request_priority_high;
+    return http_request_priority_normal;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_response_cache_key(const epee::net_utils::http::http_request_info& query_info, std::string& key, epee::serialization::storage_entry& id, bool& json_rpc, uint64_t& max_age_ms)
+  {
+    // requests whose result only depends on the chain and the pool, 0 or a max age for
+    // those also reporting network state
+    static const std::unordered_map<std::string, uint64_t> uris = {
+      {"/getheight", 0}, {"/get_transaction_pool_hashes.bin", 0}, {"/getinfo", RESPONSE_CACHE_NETWORK_MAX_AGE_MS}
+    };
+    static const std::unordered_map<std::string, uint64_t> methods = {
+      {"getblockcount", 0}, {"getlastblockheader", 0}, {"getblockheadersrange", 0}, {"get_fee_estimate", 0},
+      {"get_info", RESPONSE_CACHE_NETWORK_MAX_AGE_MS}
+    };
+
+    json_rpc = query_info.m_URI == "/json_rpc";
+    if (json_rpc)
+    {
+      std::string method;
+      if (!get_json_rpc_method(query_info.m_body, method))
+        return false;
+      const auto i = methods.find(method);
+      if (i == methods.end())
+        return false;
+      max_age_ms = i->second;
+    }
+    else
+    {
+      const auto i = uris.find(query_info.m_URI);
+      if (i == uris.end())
+        return false;
+      max_age_ms = i->second;
+      if (query_info.m_body.empty())
+      {
+        key = query_info.m_URI;
+        return true;
+      }
+    }
+
+    // key on the parsed request, so formatting and field order don't matter
+    epee::serialization::portable_storage ps;
+    if (!ps.load_from_json(query_info.m_body) && (json_rpc || !ps.load_from_binary(query_info.m_body)))
+      return false;
+    if (json_rpc)
+    {
+      std::string method;
+      if (!ps.get_value("method", method, nullptr) || methods.find(method) == methods.end())
+        return false;
+      // requests without an id would all be answered with the same empty id,
+      // leave them to the handlers
+      if (!ps.get_value("id", id, nullptr))
+        return false;
+      // the id is put back in the response on the way out
+      ps.set_value("id", std::string(RESPONSE_CACHE_ID_PLACEHOLDER), nullptr);
+    }
+    std::string canonical;
+    if (!ps.dump_as_json(canonical, 0, false))
+      return false;
+    key = query_info.m_URI + "\n" + canonical;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    LOG_PRINT_L2("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+
+    std::string key;
+    epee::serialization::storage_entry id;
+    bool json_rpc = false;
+    uint64_t max_age_ms = 0;
+    if (!m_response_cache.enabled() || !get_response_cache_key(query_info, key, id, json_rpc, max_age_ms))
+    {
+      if (!handle_http_request_map(query_info, response, m_conn_context))
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+      return true;
+    }
+
+    const rpc_response_cache::tag tag{m_core.get_blockchain_storage().get_tail_id(), m_core.get_pool_cookie()};
+    // json rpc requests run with the placeholder id, so the response can be reused for any id
+    epee::net_utils::http::http_request_info canonical_query;
+    if (json_rpc)
+    {
+      canonical_query = query_info;
+      canonical_query.m_body = key.substr(key.find('\n') + 1);
+    }
+    const bool handled = m_response_cache.handle(key, tag, max_age_ms, json_rpc ? canonical_query : query_info, response,
+      [this, &m_conn_context](const epee::net_utils::http::http_request_info& query, epee::net_utils::http::http_response_info& res) {
+        return handle_http_request_map(query, res, m_conn_context);
+      });
+    if (!handled)
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+      return true;
+    }
+
+    if (json_rpc)
+    {
+      static const std::string placeholder = "\"" RESPONSE_CACHE_ID_PLACEHOLDER "\"";
+      const std::string::size_type pos = response.m_body.find(placeholder);
+      if (pos != std::string::npos)
+      {
+        std::stringstream ss;
+        epee::serialization::dump_as_json(ss, id, 0, false);
+        response.m_body.replace(pos, placeholder.size(), ss.str());
+      }
+    }
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::check_core_busy()
@@ -124,6 +316,55 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_events(const COMMAND_RPC_GET_EVENTS::request& req, COMMAND_RPC_GET_EVENTS::response& res)
+  {
+    static const uint64_t max_timeout = 60;
+    static const uint64_t max_count = 1000;
+    event_journal& journal = m_core.get_event_journal();
+
+    std::vector<chain_event> events;
+    if (req.cursor == 0)
+    {
+      // new subscriber, start from the current state
+      res.cursor = journal.get_cursor();
+      res.complete = true;
+    }
+    else
+    {
+      uint64_t timeout_ms = std::min(req.timeout, max_timeout) * 1000;
+      const bool waiter = timeout_ms > 0;
+      if (waiter && ++m_event_waiters > m_max_event_waiters)
+        timeout_ms = 0; // too many waiting already, the client polls again
+      res.complete = journal.get_events(req.cursor, events, res.cursor, timeout_ms, std::min(req.max_count, max_count));
+      if (waiter)
+        --m_event_waiters;
+    }
+
+    for (const chain_event& e: events)
+    {
+      res.events.push_back(COMMAND_RPC_GET_EVENTS::event());
+      COMMAND_RPC_GET_EVENTS::event& ev = res.events.back();
+      ev.seq = e.seq;
+      switch (e.type)
+      {
+        case chain_event::block_added: ev.type = "block_added"; break;
+        case chain_event::block_removed: ev.type = "block_removed"; break;
+        case chain_event::tx_added: ev.type = "tx_added"; break;
+        case chain_event::tx_removed: ev.type = "tx_removed"; break;
+      }
+      ev.id = epee::string_tools::pod_to_hex(e.id);
+      ev.height = e.height;
+    }
+
+    // read after the events, so the tip is at least as recent as them
+    crypto::hash top_hash;
+    m_core.get_blockchain_top(res.height, top_hash);
+    ++res.height; // turn top block height into blockchain height
+    res.top_hash = epee::string_tools::pod_to_hex(top_hash);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res)
   {
     CHECK_CORE_BUSY();
@@ -151,44 +392,29 @@ namespace cryptonote
     res.block_size_limit = m_core.get_blockchain_storage().get_current_cumulative_blocksize_limit();
     res.status = CORE_RPC_STATUS_OK;
     res.start_time = (uint64_t)m_core.get_start_time();
+    res.pruned_height = m_core.get_pruned_height();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  static cryptonote::blobdata get_pruned_tx_blob(const cryptonote::blobdata &blobdata)
-  {
-    cryptonote::transaction tx;
-
-    if (!cryptonote::parse_and_validate_tx_from_blob(blobdata, tx))
-    {
-      MERROR("Failed to parse and validate tx from blob");
-      return blobdata;
-    }
-
-    std::stringstream ss;
-    binary_archive<true> ba(ss);
-    bool r = tx.serialize_base(ba);
-    CHECK_AND_ASSERT_MES(r, blobdata, "Failed to serialize rct signatures base");
-    return ss.str();
-  }
-  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res)
   {
     CHECK_CORE_BUSY();
     std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata> > > bs;
 
-    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
+    // the output indices below are read per tx, keep them on the blocks' snapshot
+    Blockchain::read_session read_session(m_core.get_blockchain_storage());
+    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, req.prune))
     {
       res.status = "Failed";
       return false;
     }
 
-    size_t pruned_size = 0, unpruned_size = 0, ntxes = 0;
+    size_t size = 0, ntxes = 0;
     for(auto& bd: bs)
     {
       res.blocks.resize(res.blocks.size()+1);
       res.blocks.back().block = bd.first;
-      pruned_size += bd.first.size();
-      unpruned_size += bd.first.size();
+      size += bd.first.size();
       res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
       res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
       block b;
@@ -207,14 +433,10 @@ namespace cryptonote
       ntxes += bd.second.size();
       for (std::list<cryptonote::blobdata>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
       {
-        unpruned_size += i->size();
-        if (req.prune)
-          res.blocks.back().txs.push_back(get_pruned_tx_blob(std::move(*i)));
-        else
-          res.blocks.back().txs.push_back(std::move(*i));
+        size += i->size();
+        res.blocks.back().txs.push_back(std::move(*i));
         i->clear();
         i->shrink_to_fit();
-        pruned_size += res.blocks.back().txs.back().size();
 
         res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
         bool r = m_core.get_tx_outputs_gindexs(b.tx_hashes[txidx++], res.output_indices.back().indices.back().indices);
@@ -226,7 +448,7 @@ namespace cryptonote
       }
     }
 
-    MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, pruned size " << pruned_size << ", unpruned size " << unpruned_size);
+    MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, " << (req.prune ? "pruned" : "unpruned") << " size " << size);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -426,6 +648,49 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res)
+  {
+    CHECK_CORE_BUSY();
+    const uint64_t height = m_core.get_current_blockchain_height();
+    const uint64_t to_height = std::min(req.to_height, height - 1);
+    if (req.from_height > to_height)
+    {
+      res.status = "Invalid height range";
+      return true;
+    }
+    if (m_restricted)
+    {
+      if (to_height - req.from_height >= MAX_RESTRICTED_OUTPUT_DISTRIBUTION_BLOCKS)
+      {
+        res.status = "Too many blocks requested";
+        return true;
+      }
+    }
+    // one more block for the base
+    const uint64_t from_height = req.from_height ? req.from_height - 1 : 0;
+    std::vector<uint64_t> distribution;
+    if (!m_core.get_blockchain_storage().get_rct_output_distribution(from_height, to_height, distribution))
+    {
+      res.status = "Failed to get output distribution";
+      return true;
+    }
+
+    res.start_height = req.from_height;
+    res.base = req.from_height ? distribution.front() : 0;
+    if (req.from_height)
+      distribution.erase(distribution.begin());
+    if (!req.cumulative)
+    {
+      for (size_t n = distribution.size(); n-- > 1; )
+        distribution[n] -= distribution[n - 1];
+      if (!distribution.empty())
+        distribution[0] -= res.base;
+    }
+    res.distribution = std::move(distribution);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res)
   {
     CHECK_CORE_BUSY();
@@ -496,6 +761,8 @@ namespace cryptonote
 
     std::list<std::string>::const_iterator txhi = req.txs_hashes.begin();
     std::vector<crypto::hash>::const_iterator vhi = vh.begin();
+    // after the pool lookup, the pool must not be locked with this held
+    Blockchain::read_session read_session(m_core.get_blockchain_storage());
     for(auto& tx: txs)
     {
       res.txs.push_back(COMMAND_RPC_GET_TRANSACTIONS::entry());
@@ -507,6 +774,7 @@ namespace cryptonote
       e.as_hex = string_tools::buff_to_hex_nodelimer(blob);
       if (req.decode_as_json)
         e.as_json = obj_to_json_str(tx);
+      e.pruned = false;
       e.in_pool = pool_tx_hashes.find(tx_hash) != pool_tx_hashes.end();
       if (e.in_pool)
       {
@@ -534,6 +802,34 @@ namespace cryptonote
       }
     }
 
+    // txs below the pruned height can only be served pruned, along with the
+    // hash of their prunable data, from which the tx hash can be checked
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    for (std::list<crypto::hash>::iterator mi = missed_txs.begin(); mi != missed_txs.end(); )
+    {
+      blobdata pruned_blob;
+      crypto::hash prunable_hash;
+      if (!db.get_pruned_tx_blob(*mi, pruned_blob) || !db.get_prunable_tx_hash(*mi, prunable_hash))
+      {
+        ++mi;
+        continue;
+      }
+      res.txs.push_back(COMMAND_RPC_GET_TRANSACTIONS::entry());
+      COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs.back();
+      e.tx_hash = string_tools::pod_to_hex(*mi);
+      e.pruned = true;
+      e.pruned_as_hex = string_tools::buff_to_hex_nodelimer(pruned_blob);
+      e.prunable_hash = string_tools::pod_to_hex(prunable_hash);
+      e.in_pool = false;
+      e.block_height = db.get_tx_block_height(*mi);
+      if (!m_core.get_tx_outputs_gindexs(*mi, e.output_indices))
+      {
+        res.status = "Failed";
+        return false;
+      }
+      mi = missed_txs.erase(mi);
+    }
+
     for(const auto& miss_tx: missed_txs)
     {
       res.missed_tx.push_back(string_tools::pod_to_hex(miss_tx));
@@ -728,10 +1024,13 @@ namespace cryptonote
     const miner& lMiner = m_core.get_miner();
     res.active = lMiner.is_mining();
     res.is_background_mining_enabled = lMiner.get_is_background_mining_enabled();
+    res.threads_huge_pages = 0;
 
     if ( lMiner.is_mining() ) {
       res.speed = lMiner.get_speed();
       res.threads_count = lMiner.get_threads_count();
+      res.threads_speed = lMiner.get_threads_speed();
+      res.threads_huge_pages = lMiner.get_huge_pages_threads_count();
       const account_public_address& lMiningAdr = lMiner.get_mining_address();
       res.address = get_account_address_as_str(m_testnet, lMiningAdr);
     }
@@ -1046,6 +1345,7 @@ namespace cryptonote
       error_resp.message = "Core is busy.";
       return false;
     }
+    Blockchain::read_session read_session(m_core.get_blockchain_storage());
     uint64_t last_block_height;
     crypto::hash last_block_hash;
     bool have_last_block_hash = m_core.get_blockchain_top(last_block_height, last_block_hash);
@@ -1123,6 +1423,7 @@ namespace cryptonote
       error_resp.message = "Core is busy.";
       return false;
     }
+    Blockchain::read_session read_session(m_core.get_blockchain_storage());
     const uint64_t bc_height = m_core.get_current_blockchain_height();
     if (req.start_height >= bc_height || req.end_height >= bc_height || req.start_height > req.end_height)
     {
@@ -1310,6 +1611,7 @@ namespace cryptonote
     res.block_size_limit = m_core.get_blockchain_storage().get_current_cumulative_blocksize_limit();
     res.status = CORE_RPC_STATUS_OK;
     res.start_time = (uint64_t)m_core.get_start_time();
+    res.pruned_height = m_core.get_pruned_height();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -1748,6 +2050,68 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics(const COMMAND_RPC_GET_METRICS::request& req, COMMAND_RPC_GET_METRICS::response& res, epee::json_rpc::error& error_resp)
+  {
+    struct visitor: public epee::metrics::metrics_visitor
+    {
+      COMMAND_RPC_GET_METRICS::response &res;
+      visitor(COMMAND_RPC_GET_METRICS::response &res): res(res) {}
+      static std::string label(const epee::metrics::metric_info &info) { return info.label_name.empty() ? std::string() : info.label_name + "=" + info.label_value; }
+      void on_counter(const epee::metrics::metric_info &info, uint64_t value) { res.counters.push_back({info.name, label(info), value}); }
+      void on_gauge(const epee::metrics::metric_info &info, int64_t value) { res.gauges.push_back({info.name, label(info), value}); }
+      void on_histogram(const epee::metrics::metric_info &info, const epee::metrics::histogram::snapshot &value)
+      {
+        res.histograms.push_back({info.name, label(info), value.count, value.sum_ns / 1000,
+            value.quantile(0.5) / 1000, value.quantile(0.9) / 1000, value.quantile(0.99) / 1000});
+      }
+    } v(res);
+    epee::metrics::registry::instance().visit(v);
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics_text(std::string& body)
+  {
+    body = epee::metrics::registry::instance().get_prometheus_text();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_trace(const COMMAND_RPC_TRACE::request& req, COMMAND_RPC_TRACE::response& res)
+  {
+    tools::trace::status status{std::string(), 0, 0};
+    if (req.command == "start")
+    {
+      // clients don't get to pick the file the daemon writes to
+      if (!tools::trace::start(m_trace_path))
+      {
+        res.status = "Failed to start tracing to " + m_trace_path;
+        return true;
+      }
+    }
+    else if (req.command == "stop")
+    {
+      if (!tools::trace::stop(&status))
+      {
+        res.status = "Not tracing";
+        return true;
+      }
+    }
+    else if (req.command != "status")
+    {
+      res.status = std::string("unknown command: '") + req.command + "'";
+      return true;
+    }
+
+    // after a stop, this keeps the final status of the trace
+    res.tracing = tools::trace::get_status(status);
+    res.path = status.filename;
+    res.events = status.events;
+    res.dropped = status.dropped;
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 
   const command_line::arg_descriptor<std::string> core_rpc_server::arg_rpc_bind_port = {
       "rpc-bind-port"
@@ -1766,4 +2130,22 @@ namespace cryptonote
     , "Restrict RPC to view only commands"
     , false
     };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_worker_threads = {
+      "rpc-worker-threads"
+    , "Number of threads executing RPC requests, cheap requests first (0 to execute them on the network threads)"
+    , 4
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_max_requests_per_client = {
+      "rpc-max-requests-per-client"
+    , "Max number of RPC requests a single client may have executing at once (0 for no limit). Clients are told apart by host, so local and NATed clients share it"
+    , 0
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_response_cache_size = {
+      "rpc-response-cache-size"
+    , "Max size in kB of the cache for read-only RPC responses, kept until the chain or the pool changes (0 to disable)"
+    , 16384
+    };
 }  // namespace cryptonote
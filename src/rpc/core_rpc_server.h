@@ -38,6 +38,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "rpc_response_cache.h"
 
 // yes, epee doesn't properly use its full namespace when calling its
 // functions from macros.  *sigh*
@@ -55,6 +56,9 @@ namespace cryptonote
     static const command_line::arg_descriptor<std::string> arg_rpc_bind_port;
     static const command_line::arg_descriptor<std::string> arg_testnet_rpc_bind_port;
     static const command_line::arg_descriptor<bool> arg_restricted_rpc;
+    static const command_line::arg_descriptor<size_t> arg_rpc_worker_threads;
+    static const command_line::arg_descriptor<size_t> arg_rpc_max_requests_per_client;
+    static const command_line::arg_descriptor<size_t> arg_rpc_response_cache_size;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -69,7 +73,13 @@ namespace cryptonote
       );
     bool is_testnet() const { return m_testnet; }
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //! forwards http requests to the uri map, through the response cache for read-only requests
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
+
+    epee::net_utils::http::http_request_priority get_http_request_priority(const epee::net_utils::http::http_request_info& query_info);
+
+    //! also wakes the requests waiting for events, so the workers can be joined
+    bool send_stop_signal();
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -80,6 +90,7 @@ namespace cryptonote
       MAP_URI_AUTO_BIN2("/getrandom_outs.bin", on_get_random_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS)
       MAP_URI_AUTO_BIN2("/get_outs.bin", on_get_outs_bin, COMMAND_RPC_GET_OUTPUTS_BIN)
       MAP_URI_AUTO_BIN2("/getrandom_rctouts.bin", on_get_random_rct_outs, COMMAND_RPC_GET_RANDOM_RCT_OUTPUTS)
+      MAP_URI_AUTO_BIN2("/get_output_distribution.bin", on_get_output_distribution, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/get_alt_blocks_hashes", on_get_alt_blocks_hashes, COMMAND_RPC_GET_ALT_BLOCKS_HASHES)
       MAP_URI_AUTO_JON2("/is_key_image_spent", on_is_key_image_spent, COMMAND_RPC_IS_KEY_IMAGE_SPENT)
@@ -102,6 +113,9 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/stop_save_graph", on_stop_save_graph, COMMAND_RPC_STOP_SAVE_GRAPH, !m_restricted)
       MAP_URI_AUTO_JON2("/get_outs", on_get_outs, COMMAND_RPC_GET_OUTPUTS)
       MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
+      MAP_URI_AUTO_JON2("/get_events", on_get_events, COMMAND_RPC_GET_EVENTS)
+      MAP_URI_TEXT2_IF("/metrics", on_get_metrics_text, !m_restricted)
+      MAP_URI_AUTO_JON2_IF("/trace", on_trace, COMMAND_RPC_TRACE, !m_restricted)
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC_WE("on_getblockhash",        on_getblockhash,               COMMAND_RPC_GETBLOCKHASH)
@@ -126,6 +140,7 @@ namespace cryptonote
         MAP_JON_RPC_WE_IF("relay_tx",            on_relay_tx,                   COMMAND_RPC_RELAY_TX, !m_restricted)
         MAP_JON_RPC_WE_IF("sync_info",           on_sync_info,                  COMMAND_RPC_SYNC_INFO, !m_restricted)
         MAP_JON_RPC_WE_IF("get_txpool_backlog",  on_get_txpool_backlog,         COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG, !m_restricted)
+        MAP_JON_RPC_WE_IF("get_metrics",         on_get_metrics,                COMMAND_RPC_GET_METRICS, !m_restricted)
       END_JSON_RPC_MAP()
     END_URI_MAP2()
 
@@ -145,6 +160,7 @@ namespace cryptonote
     bool on_get_outs_bin(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMAND_RPC_GET_OUTPUTS_BIN::response& res);
     bool on_get_outs(const COMMAND_RPC_GET_OUTPUTS::request& req, COMMAND_RPC_GET_OUTPUTS::response& res);
     bool on_get_random_rct_outs(const COMMAND_RPC_GET_RANDOM_RCT_OUTPUTS::request& req, COMMAND_RPC_GET_RANDOM_RCT_OUTPUTS::response& res);
+    bool on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res);
     bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res);
     bool on_save_bc(const COMMAND_RPC_SAVE_BC::request& req, COMMAND_RPC_SAVE_BC::response& res);
     bool on_get_peer_list(const COMMAND_RPC_GET_PEER_LIST::request& req, COMMAND_RPC_GET_PEER_LIST::response& res);
@@ -159,6 +175,10 @@ namespace cryptonote
     bool on_start_save_graph(const COMMAND_RPC_START_SAVE_GRAPH::request& req, COMMAND_RPC_START_SAVE_GRAPH::response& res);
     bool on_stop_save_graph(const COMMAND_RPC_STOP_SAVE_GRAPH::request& req, COMMAND_RPC_STOP_SAVE_GRAPH::response& res);
     bool on_update(const COMMAND_RPC_UPDATE::request& req, COMMAND_RPC_UPDATE::response& res);
+    bool on_get_events(const COMMAND_RPC_GET_EVENTS::request& req, COMMAND_RPC_GET_EVENTS::response& res);
+    //! Prometheus text format
+    bool on_get_metrics_text(std::string& body);
+    bool on_trace(const COMMAND_RPC_TRACE::request& req, COMMAND_RPC_TRACE::response& res);
 
     //json_rpc
     bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res);
@@ -184,9 +204,11 @@ namespace cryptonote
     bool on_relay_tx(const COMMAND_RPC_RELAY_TX::request& req, COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& error_resp);
     bool on_sync_info(const COMMAND_RPC_SYNC_INFO::request& req, COMMAND_RPC_SYNC_INFO::response& res, epee::json_rpc::error& error_resp);
     bool on_get_txpool_backlog(const COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG::response& res, epee::json_rpc::error& error_resp);
+    bool on_get_metrics(const COMMAND_RPC_GET_METRICS::request& req, COMMAND_RPC_GET_METRICS::response& res, epee::json_rpc::error& error_resp);
     //-----------------------
 
 private:
+    bool get_response_cache_key(const epee::net_utils::http::http_request_info& query_info, std::string& key, epee::serialization::storage_entry& id, bool& json_rpc, uint64_t& max_age_ms);
     bool check_core_busy();
     bool check_core_ready();
 
@@ -198,6 +220,10 @@ private:
     nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
     bool m_testnet;
     bool m_restricted;
+    std::string m_trace_path;
+    rpc_response_cache m_response_cache;
+    size_t m_max_event_waiters;
+    std::atomic<size_t> m_event_waiters;
   };
 }
 
@@ -49,7 +49,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 1
-#define CORE_RPC_VERSION_MINOR 13
+#define CORE_RPC_VERSION_MINOR 20
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -216,6 +216,10 @@ namespace cryptonote
       bool in_pool;
       uint64_t block_height;
       std::vector<uint64_t> output_indices;
+      // for txs below the pruned height, as_hex is empty and these are set
+      bool pruned;
+      std::string pruned_as_hex;
+      std::string prunable_hash;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(tx_hash)
@@ -224,6 +228,9 @@ namespace cryptonote
         KV_SERIALIZE(in_pool)
         KV_SERIALIZE(block_height)
         KV_SERIALIZE(output_indices)
+        KV_SERIALIZE_OPT(pruned, false)
+        KV_SERIALIZE(pruned_as_hex)
+        KV_SERIALIZE(prunable_hash)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -468,6 +475,37 @@ namespace cryptonote
     };
   };
   //-----------------------------------------------
+  struct COMMAND_RPC_GET_OUTPUT_DISTRIBUTION
+  {
+    struct request
+    {
+      uint64_t from_height;
+      uint64_t to_height; // included, capped to the top block, which is the default
+      bool cumulative;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(from_height)
+        KV_SERIALIZE_OPT(to_height, std::numeric_limits<uint64_t>::max())
+        KV_SERIALIZE_OPT(cumulative, false)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t start_height;
+      uint64_t base; // RCT outputs in the blocks below start_height
+      std::vector<uint64_t> distribution; // RCT outputs per block from start_height, or up to each block if cumulative
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(base)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(distribution)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+  //-----------------------------------------------
   struct COMMAND_RPC_SEND_RAW_TX
   {
     struct request
@@ -570,6 +608,7 @@ namespace cryptonote
       uint64_t cumulative_difficulty;
       uint64_t block_size_limit;
       uint64_t start_time;
+      uint64_t pruned_height;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -589,6 +628,7 @@ namespace cryptonote
         KV_SERIALIZE(cumulative_difficulty)
         KV_SERIALIZE(block_size_limit)
         KV_SERIALIZE(start_time)
+        KV_SERIALIZE_OPT(pruned_height, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -634,6 +674,8 @@ namespace cryptonote
       uint32_t threads_count;
       std::string address;
       bool is_background_mining_enabled;
+      std::vector<uint64_t> threads_speed; // hashes per second of each mining thread
+      uint32_t threads_huge_pages; // mining threads with their scratchpads in huge pages
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -642,6 +684,8 @@ namespace cryptonote
         KV_SERIALIZE(threads_count)
         KV_SERIALIZE(address)
         KV_SERIALIZE(is_background_mining_enabled)
+        KV_SERIALIZE(threads_speed)
+        KV_SERIALIZE(threads_huge_pages)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -1689,4 +1733,154 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  struct COMMAND_RPC_GET_EVENTS
+  {
+    struct request
+    {
+      uint64_t cursor; // 0 to start from the current state
+      uint64_t timeout; // seconds to wait for an event if there is none yet
+      uint64_t max_count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(cursor)
+        KV_SERIALIZE_OPT(timeout, (uint64_t)0)
+        KV_SERIALIZE_OPT(max_count, (uint64_t)1000)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct event
+    {
+      uint64_t seq;
+      std::string type; // "block_added", "block_removed", "tx_added" or "tx_removed"
+      std::string id;
+      uint64_t height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(seq)
+        KV_SERIALIZE(type)
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(height)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t cursor; // to pass in the next request
+      bool complete; // false if events were missed, the client then has to resync
+      uint64_t height;
+      std::string top_hash;
+      std::list<event> events;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(cursor)
+        KV_SERIALIZE(complete)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(top_hash)
+        KV_SERIALIZE(events)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_TRACE
+  {
+    struct request
+    {
+      std::string command; // "start", "stop" or "status", "start" traces to fonerod-trace.json in the data dir
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(command)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      bool tracing;
+      std::string path;
+      uint64_t events; // written to the file so far
+      uint64_t dropped; // lost because a thread's ring buffer was full
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(tracing)
+        KV_SERIALIZE(path)
+        KV_SERIALIZE(events)
+        KV_SERIALIZE(dropped)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_METRICS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct counter
+    {
+      std::string name;
+      std::string label; // "name=value", empty if the metric has no label
+      uint64_t value;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(label)
+        KV_SERIALIZE(value)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct gauge
+    {
+      std::string name;
+      std::string label;
+      int64_t value;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(label)
+        KV_SERIALIZE(value)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct histogram
+    {
+      std::string name;
+      std::string label;
+      uint64_t count;
+      uint64_t total_us;
+      uint64_t p50_us; // quantiles are upper bounds of the bucket they fall in
+      uint64_t p90_us;
+      uint64_t p99_us;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(label)
+        KV_SERIALIZE(count)
+        KV_SERIALIZE(total_us)
+        KV_SERIALIZE(p50_us)
+        KV_SERIALIZE(p90_us)
+        KV_SERIALIZE(p99_us)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::list<counter> counters;
+      std::list<gauge> gauges;
+      std::list<histogram> histograms;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(counters)
+        KV_SERIALIZE(gauges)
+        KV_SERIALIZE(histograms)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
 }
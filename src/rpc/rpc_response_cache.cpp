@@ -0,0 +1,169 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "rpc_response_cache.h"
+
+#include "include_base_utils.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace cryptonote
+{
+  rpc_response_cache::rpc_response_cache(size_t max_size)
+    : m_tag{cryptonote::null_hash, 0}, m_size(0), m_max_size(max_size), m_hits(0), m_misses(0)
+  {
+  }
+
+  void rpc_response_cache::set_max_size(size_t max_size)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    m_max_size = max_size;
+    clear_entries();
+  }
+
+  bool rpc_response_cache::get(const std::string& key, const tag& t, std::string& body, std::string& mime_type)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    set_tag(t);
+    const auto i = m_entries.find(key);
+    if (i == m_entries.end())
+    {
+      ++m_misses;
+      return false;
+    }
+    if (i->second.expiry_ms && i->second.expiry_ms <= epee::misc_utils::get_tick_count())
+    {
+      erase(i);
+      ++m_misses;
+      return false;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, i->second.lru);
+    body = i->second.body;
+    mime_type = i->second.mime_type;
+    ++m_hits;
+    return true;
+  }
+
+  void rpc_response_cache::put(const std::string& key, const tag& t, const std::string& body, const std::string& mime_type, uint64_t max_age_ms)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    // the chain may have moved on while the response was computed
+    if (t != m_tag)
+      return;
+
+    const auto i = m_entries.find(key);
+    if (i != m_entries.end())
+      erase(i);
+    const size_t size = key.size() + body.size() + mime_type.size();
+    if (size > m_max_size)
+      return;
+
+    const uint64_t now = epee::misc_utils::get_tick_count();
+    if (m_size + size > m_max_size)
+    {
+      for (auto j = m_entries.begin(); j != m_entries.end(); )
+      {
+        auto next = std::next(j);
+        if (j->second.expiry_ms && j->second.expiry_ms <= now)
+          erase(j);
+        j = next;
+      }
+    }
+    while (m_size + size > m_max_size)
+      erase(m_entries.find(m_lru.back()));
+
+    m_lru.push_front(key);
+    m_entries.emplace(key, entry{body, mime_type, max_age_ms ? now + max_age_ms : 0, m_lru.begin()});
+    m_size += size;
+  }
+
+  bool rpc_response_cache::handle(const std::string& key, const tag& t, uint64_t max_age_ms, const epee::net_utils::http::http_request_info& query, epee::net_utils::http::http_response_info& response, const handler_t& handler)
+  {
+    if (get(key, t, response.m_body, response.m_mime_tipe))
+    {
+      response.m_header_info.m_content_type = response.m_mime_tipe;
+      return true;
+    }
+
+    if (!handler(query, response))
+      return false;
+    if (response.m_response_code != 200 || response.m_rpc_status != CORE_RPC_STATUS_OK)
+      return true;
+
+    if (response.m_body_stream)
+    {
+      std::string body;
+      if (!response.m_body_stream([&body](const void* data, size_t size){ body.append((const char*)data, size); return true; }))
+        return true; // let the stream fail again on its way out
+      response.m_body.swap(body);
+      response.m_body_stream = nullptr;
+    }
+    put(key, t, response.m_body, response.m_mime_tipe, max_age_ms);
+    return true;
+  }
+
+  uint64_t rpc_response_cache::get_hits() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_hits;
+  }
+
+  uint64_t rpc_response_cache::get_misses() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_misses;
+  }
+
+  void rpc_response_cache::clear()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    clear_entries();
+  }
+
+  void rpc_response_cache::set_tag(const tag& t)
+  {
+    if (t == m_tag)
+      return;
+    clear_entries();
+    m_tag = t;
+  }
+
+  void rpc_response_cache::erase(entries_t::iterator i)
+  {
+    m_size -= i->first.size() + i->second.body.size() + i->second.mime_type.size();
+    m_lru.erase(i->second.lru);
+    m_entries.erase(i);
+  }
+
+  void rpc_response_cache::clear_entries()
+  {
+    m_entries.clear();
+    m_lru.clear();
+    m_size = 0;
+  }
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "crypto/hash.h"
+#include "net/http_base.h"
+
+namespace cryptonote
+{
+  //! Serialized responses of read-only RPC requests, valid until the chain tip or the pool changes
+  /*! Entries are tagged with the chain state they were computed from. The first
+  lookup with a different tag drops every entry, so there is no need for explicit
+  invalidation from the core. When full, expired entries are dropped first, then
+  the least recently used ones. */
+  class rpc_response_cache
+  {
+  public:
+    struct tag
+    {
+      crypto::hash top_hash;
+      uint64_t pool_cookie;
+
+      bool operator==(const tag& other) const { return top_hash == other.top_hash && pool_cookie == other.pool_cookie; }
+      bool operator!=(const tag& other) const { return !(*this == other); }
+    };
+
+    //! 0 `max_size` disables the cache
+    rpc_response_cache(size_t max_size = 0);
+
+    void set_max_size(size_t max_size);
+    bool enabled() const { return m_max_size != 0; }
+
+    typedef std::function<bool(const epee::net_utils::http::http_request_info&, epee::net_utils::http::http_response_info&)> handler_t;
+
+    //! \return true and sets `body` and `mime_type` if a response for `key` was stored with the same `t`, and is younger than its max age
+    bool get(const std::string& key, const tag& t, std::string& body, std::string& mime_type);
+
+    //! Stores `body` if `t` is still the current tag, 0 `max_age_ms` keeps the entry until the tag changes
+    void put(const std::string& key, const tag& t, const std::string& body, const std::string& mime_type, uint64_t max_age_ms = 0);
+
+    //! Answers `query` from the cache, or with `handler`, storing its response if the RPC status is OK
+    /*! A streamed body is serialized before it is stored, so a hit is sent whole.
+    \return false if `handler` did not handle the request */
+    bool handle(const std::string& key, const tag& t, uint64_t max_age_ms, const epee::net_utils::http::http_request_info& query, epee::net_utils::http::http_response_info& response, const handler_t& handler);
+
+    void clear();
+
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+
+  private:
+    struct entry
+    {
+      std::string body;
+      std::string mime_type;
+      uint64_t expiry_ms; //!< 0 for none
+      std::list<std::string>::iterator lru;
+    };
+    typedef std::unordered_map<std::string, entry> entries_t;
+
+    //! Requires lock on `m_lock`.
+    void set_tag(const tag& t);
+    //! Requires lock on `m_lock`.
+    void erase(entries_t::iterator i);
+    //! Requires lock on `m_lock`.
+    void clear_entries();
+
+    mutable boost::mutex m_lock;
+    entries_t m_entries;
+    std::list<std::string> m_lru; //!< keys, most recently used first
+    tag m_tag;
+    size_t m_size;
+    size_t m_max_size;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
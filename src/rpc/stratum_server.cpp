@@ -0,0 +1,536 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "stratum_server.h"
+#include "common/command_line.h"
+#include "common/int-util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "misc_language.h"
+#include "string_tools.h"
+#include "storages/portable_storage_template_helper.h"
+
+#undef FONERO_DEFAULT_LOG_CATEGORY
+#define FONERO_DEFAULT_LOG_CATEGORY "daemon.stratum"
+
+#define STRATUM_EXTRA_NONCE_SIZE 4
+#define STRATUM_MAX_LINE_SIZE 16384
+#define STRATUM_MAX_JOBS_PER_CONNECTION 4
+#define STRATUM_EVENT_WAIT_MS 1000
+#define STRATUM_POOL_JOB_INTERVAL_MS 10000 // pool changes alone don't push jobs more often than this
+
+namespace cryptonote
+{
+  uint64_t slow_memmem(const void* start_buff, size_t buflen, const void* pat, size_t patlen); // core_rpc_server.cpp
+
+  const command_line::arg_descriptor<std::string> stratum_server::arg_stratum_bind_ip = {
+      "stratum-bind-ip"
+    , "IP for the stratum mining server to listen on"
+    , "127.0.0.1"
+    };
+
+  const command_line::arg_descriptor<std::string> stratum_server::arg_stratum_bind_port = {
+      "stratum-bind-port"
+    , "Port for the stratum mining server to listen on, disabled if not set"
+    , ""
+    };
+
+  const command_line::arg_descriptor<std::string> stratum_server::arg_stratum_address = {
+      "stratum-address"
+    , "Address the stratum miners mine to, instead of the address they log in with"
+    , ""
+    };
+
+  //-----------------------------------------------------------------------------------
+  stratum_protocol_handler::stratum_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+    : m_config(config)
+    , m_conn_context(conn_context)
+    , m_psnd_hndlr(psnd_hndlr)
+    , m_extra_nonce(0)
+  {}
+  //-----------------------------------------------------------------------------------
+  bool stratum_protocol_handler::after_init_connection()
+  {
+    m_config.m_pserver->add_connection(this);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_protocol_handler::release_protocol()
+  {
+    m_config.m_pserver->remove_connection(this);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_protocol_handler::handle_recv(const void* ptr, size_t cb)
+  {
+    m_buffer.append((const char*)ptr, cb);
+    std::string::size_type start = 0, end;
+    while ((end = m_buffer.find('\n', start)) != std::string::npos)
+    {
+      const std::string line = m_buffer.substr(start, end - start);
+      start = end + 1;
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+      std::string response;
+      if (!m_config.m_pserver->handle_request(*this, line, response))
+        return false;
+      if (!send(response))
+        return false;
+    }
+    m_buffer.erase(0, start);
+    if (m_buffer.size() > STRATUM_MAX_LINE_SIZE)
+    {
+      LOG_ERROR_CC(m_conn_context, "Too long stratum request");
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_protocol_handler::send(const std::string& data)
+  {
+    return m_psnd_hndlr->do_send(data.data(), data.size());
+  }
+  //-----------------------------------------------------------------------------------
+  stratum_server::stratum_server(
+      core& cr
+    , nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& p2p
+    )
+    : m_core(cr)
+    , m_p2p(p2p)
+    , m_net_server(epee::net_utils::e_connection_type_RPC)
+    , m_enabled(false)
+    , m_testnet(false)
+    , m_stop(true)
+    , m_next_extra_nonce(0)
+    , m_next_job_id(0)
+  {}
+  //-----------------------------------------------------------------------------------
+  stratum_server::~stratum_server()
+  {
+    stop();
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::init_options(boost::program_options::options_description& desc)
+  {
+    command_line::add_arg(desc, arg_stratum_bind_ip);
+    command_line::add_arg(desc, arg_stratum_bind_port);
+    command_line::add_arg(desc, arg_stratum_address);
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::init(const boost::program_options::variables_map& vm)
+  {
+    m_testnet = command_line::get_arg(vm, command_line::arg_testnet_on);
+    const std::string port = command_line::get_arg(vm, arg_stratum_bind_port);
+    if (port.empty())
+      return true;
+
+    m_address_str = command_line::get_arg(vm, arg_stratum_address);
+    if (!m_address_str.empty() && !get_account_address_from_str(m_address, m_testnet, m_address_str))
+    {
+      MERROR("Invalid stratum address: " << m_address_str);
+      return false;
+    }
+
+    // start the extra nonces somewhere else after each restart, the templates may be the same
+    m_next_extra_nonce = crypto::rand<uint32_t>();
+
+    m_net_server.get_config_object().m_pserver = this;
+    m_net_server.set_threads_prefix("STRATUM");
+    const std::string ip = command_line::get_arg(vm, arg_stratum_bind_ip);
+    MGINFO("Binding stratum server on " << ip << ":" << port);
+    if (!m_net_server.init_server(port, ip))
+    {
+      MERROR("Failed to bind stratum server");
+      return false;
+    }
+    m_enabled = true;
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::run(size_t threads_count)
+  {
+    CHECK_AND_ASSERT_MES(m_enabled, false, "stratum server is not enabled");
+    m_stop = false;
+    if (!m_net_server.run_server(threads_count, false))
+    {
+      MERROR("Failed to run stratum server");
+      return false;
+    }
+    m_job_thread = boost::thread(&stratum_server::job_loop, this);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::stop()
+  {
+    if (m_stop)
+      return;
+    m_stop = true;
+    m_job_thread.join();
+    m_net_server.send_stop_signal();
+    m_net_server.timed_wait_server_stop(5000);
+  }
+  //-----------------------------------------------------------------------------------
+  std::string stratum_server::get_target_hex(difficulty_type difficulty)
+  {
+    // check_hash() wants hash * difficulty < 2^256, so round the target up:
+    // the miners may submit a few hashes too many, never miss a block
+    uint64_t target = std::numeric_limits<uint64_t>::max();
+    if (difficulty > 1)
+      target = target / difficulty + 1;
+    target = SWAP64LE(target);
+    return epee::string_tools::buff_to_hex_nodelimer(std::string((const char*)&target, sizeof(target)));
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::find_extra_nonce(const block& b, const blobdata& blob, size_t& offset)
+  {
+    const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(b.miner_tx);
+    if (tx_pub_key == null_pkey)
+      return false;
+    offset = slow_memmem((void*)blob.data(), blob.size(), &tx_pub_key, sizeof(tx_pub_key));
+    if (!offset)
+      return false;
+    // the pubkey is followed by the TX_EXTRA_NONCE tag and the nonce size
+    offset += sizeof(tx_pub_key) + 2;
+    return offset + STRATUM_EXTRA_NONCE_SIZE <= blob.size();
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::add_connection(stratum_protocol_handler* conn)
+  {
+    boost::unique_lock<boost::mutex> lock(m_connections_lock);
+    m_connections.insert(conn);
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::remove_connection(stratum_protocol_handler* conn)
+  {
+    boost::unique_lock<boost::mutex> lock(m_connections_lock);
+    m_connections.erase(conn);
+  }
+  //-----------------------------------------------------------------------------------
+  template<typename t_result>
+  static void make_response(const epee::serialization::storage_entry& id, const t_result& result, std::string& response)
+  {
+    epee::json_rpc::response<t_result, epee::json_rpc::dummy_error> rsp;
+    rsp.jsonrpc = "2.0";
+    rsp.id = id;
+    rsp.result = result;
+    epee::serialization::store_t_to_json(rsp, response, 0, false);
+    response += "\n";
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::handle_request(stratum_protocol_handler& conn, const std::string& line, std::string& response)
+  {
+    stratum::request req;
+    if (!epee::serialization::load_t_from_json(req, line))
+    {
+      LOG_ERROR_CC(conn.m_conn_context, "Invalid stratum request");
+      return false;
+    }
+
+    std::string error;
+    if (req.method == "login")
+    {
+      stratum::login_result res;
+      if (on_login(conn, req.params, res, error))
+      {
+        make_response(req.id, res, response);
+        return true;
+      }
+    }
+    else if (req.method == "getjob")
+    {
+      stratum::job res;
+      if (on_getjob(conn, req.params, res, error))
+      {
+        make_response(req.id, res, response);
+        return true;
+      }
+    }
+    else if (req.method == "submit")
+    {
+      stratum::status_result res;
+      if (on_submit(conn, req.params, res, error))
+      {
+        make_response(req.id, res, response);
+        return true;
+      }
+    }
+    else if (req.method == "keepalived")
+    {
+      stratum::status_result res;
+      res.status = "KEEPALIVED";
+      make_response(req.id, res, response);
+      return true;
+    }
+    else
+    {
+      error = "Unknown method: " + req.method;
+    }
+    epee::net_utils::jsonrpc2::make_error_resp_json(-1, error, response, req.id);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::on_login(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::login_result& res, std::string& error)
+  {
+    std::string address_str = m_address_str;
+    account_public_address address = m_address;
+    if (address_str.empty())
+    {
+      // pools take address.worker or address+difficulty, keep the address only
+      address_str = params.login.substr(0, params.login.find_first_of(".+"));
+      if (!get_account_address_from_str(address, m_testnet, address_str))
+      {
+        error = "Invalid address used for login";
+        return false;
+      }
+    }
+
+    boost::unique_lock<boost::mutex> lock(conn.m_lock);
+    if (conn.m_session_id.empty())
+    {
+      conn.m_session_id = std::to_string(crypto::rand<uint64_t>());
+      conn.m_extra_nonce = m_next_extra_nonce++;
+    }
+    conn.m_address = address;
+    conn.m_address_str = address_str;
+    conn.m_jobs.clear();
+    MINFO("Stratum miner " << conn.m_conn_context << "logged in as " << params.login << ", agent " << params.agent);
+
+    res.id = conn.m_session_id;
+    res.status = "OK";
+    return make_job(conn, res.job, error);
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::on_getjob(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::job& res, std::string& error)
+  {
+    boost::unique_lock<boost::mutex> lock(conn.m_lock);
+    if (conn.m_session_id.empty() || params.id != conn.m_session_id)
+    {
+      error = "Unauthenticated";
+      return false;
+    }
+    return make_job(conn, res, error);
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::on_submit(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::status_result& res, std::string& error)
+  {
+    stratum_protocol_handler::job_entry job;
+    {
+      boost::unique_lock<boost::mutex> lock(conn.m_lock);
+      if (conn.m_session_id.empty() || params.id != conn.m_session_id)
+      {
+        error = "Unauthenticated";
+        return false;
+      }
+      auto i = std::find_if(conn.m_jobs.begin(), conn.m_jobs.end(), [&](const stratum_protocol_handler::job_entry& e) { return e.id == params.job_id; });
+      if (i == conn.m_jobs.end())
+      {
+        error = "Block expired";
+        return false;
+      }
+      job = *i;
+    }
+
+    blobdata nonce;
+    if (!epee::string_tools::parse_hexstr_to_binbuff(params.nonce, nonce) || nonce.size() != sizeof(job.b.nonce))
+    {
+      error = "Invalid nonce";
+      return false;
+    }
+    memcpy(&job.b.nonce, nonce.data(), sizeof(job.b.nonce));
+    job.b.nonce = SWAP32LE(job.b.nonce);
+
+    // the template was made with the version for its height, which may not be the current one anymore
+    const crypto::hash pow = get_block_longhash(job.b, job.tmpl->height, job.b.major_version);
+    if (!params.result.empty() && params.result != epee::string_tools::pod_to_hex(pow))
+    {
+      error = "Invalid result";
+      return false;
+    }
+    if (!check_hash(pow, job.tmpl->difficulty))
+    {
+      error = "Low difficulty share";
+      return false;
+    }
+    if (!m_core.handle_block_found(job.b))
+    {
+      error = "Block not accepted";
+      return false;
+    }
+    MGINFO_GREEN("Stratum miner " << conn.m_conn_context << "found block " << get_block_hash(job.b) << " at height " << job.tmpl->height);
+    res.status = "OK";
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  std::shared_ptr<const stratum_template> stratum_server::get_template(const account_public_address& address, const std::string& address_str, std::string& error)
+  {
+    // miners asking at once all wait for the one template
+    boost::unique_lock<boost::mutex> lock(m_templates_lock);
+    auto i = m_templates.find(address_str);
+    if (i != m_templates.end())
+      return i->second;
+
+    std::shared_ptr<stratum_template> tmpl = std::make_shared<stratum_template>();
+    const blobdata reserve(STRATUM_EXTRA_NONCE_SIZE, 0);
+    uint64_t expected_reward;
+    if (!m_core.get_block_template(tmpl->b, address, tmpl->difficulty, tmpl->height, expected_reward, reserve))
+    {
+      error = "Failed to create block template";
+      LOG_ERROR(error);
+      return nullptr;
+    }
+    tmpl->blob = t_serializable_object_to_blob(tmpl->b);
+    if (!find_extra_nonce(tmpl->b, tmpl->blob, tmpl->reserved_offset))
+    {
+      error = "Failed to find the extra nonce in the block template";
+      LOG_ERROR(error);
+      return nullptr;
+    }
+    std::vector<crypto::hash> tx_hashes(1 + tmpl->b.tx_hashes.size());
+    tx_hashes[0] = get_transaction_hash(tmpl->b.miner_tx);
+    std::copy(tmpl->b.tx_hashes.begin(), tmpl->b.tx_hashes.end(), tx_hashes.begin() + 1);
+    tmpl->tx_tree.assign(std::move(tx_hashes));
+    tmpl->tx_tree.root();
+
+    m_templates[address_str] = tmpl;
+    return tmpl;
+  }
+  //-----------------------------------------------------------------------------------
+  bool stratum_server::make_job(stratum_protocol_handler& conn, stratum::job& job, std::string& error)
+  {
+    if (!m_p2p.get_payload_object().is_synchronized())
+    {
+      error = "Daemon is not synchronized";
+      return false;
+    }
+    std::shared_ptr<const stratum_template> tmpl = get_template(conn.m_address, conn.m_address_str, error);
+    if (!tmpl)
+      return false;
+    if (!conn.m_jobs.empty() && conn.m_jobs.back().tmpl == tmpl)
+    {
+      job = conn.m_jobs.back().job;
+      return true;
+    }
+
+    stratum_protocol_handler::job_entry entry;
+    blobdata blob = tmpl->blob;
+    const uint32_t extra_nonce = SWAP32LE(conn.m_extra_nonce);
+    memcpy(&blob[tmpl->reserved_offset], &extra_nonce, sizeof(extra_nonce));
+    if (!parse_and_validate_block_from_blob(blob, entry.b))
+    {
+      error = "Failed to parse block template";
+      LOG_ERROR(error);
+      return false;
+    }
+    entry.tmpl = tmpl;
+    entry.id = std::to_string(m_next_job_id++);
+    // only the miner tx differs from the template, so only its path in the tx tree is rehashed
+    const crypto::hash tree_root_hash = tmpl->tx_tree.root_with_leaf(0, get_transaction_hash(entry.b.miner_tx));
+    entry.job.blob = epee::string_tools::buff_to_hex_nodelimer(get_block_hashing_blob(entry.b, tree_root_hash));
+    entry.job.job_id = entry.id;
+    entry.job.target = get_target_hex(tmpl->difficulty);
+    entry.job.height = tmpl->height;
+    job = entry.job;
+
+    conn.m_jobs.push_back(std::move(entry));
+    while (conn.m_jobs.size() > STRATUM_MAX_JOBS_PER_CONNECTION)
+      conn.m_jobs.pop_front();
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::push_jobs()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_templates_lock);
+      m_templates.clear();
+    }
+
+    // the references keep the connections alive while we send, without holding the lock
+    std::vector<stratum_protocol_handler*> connections;
+    {
+      boost::unique_lock<boost::mutex> lock(m_connections_lock);
+      for (stratum_protocol_handler* conn: m_connections)
+        if (conn->m_psnd_hndlr->add_ref())
+          connections.push_back(conn);
+    }
+
+    size_t pushed = 0;
+    for (stratum_protocol_handler* conn: connections)
+    {
+      stratum::job_notification notification;
+      std::string error;
+      bool has_job = false;
+      {
+        boost::unique_lock<boost::mutex> lock(conn->m_lock);
+        if (!conn->m_session_id.empty())
+          has_job = make_job(*conn, notification.params, error);
+      }
+      if (has_job)
+      {
+        notification.jsonrpc = "2.0";
+        notification.method = "job";
+        std::string data;
+        epee::serialization::store_t_to_json(notification, data, 0, false);
+        data += "\n";
+        if (conn->send(data))
+          ++pushed;
+      }
+      conn->m_psnd_hndlr->release();
+    }
+    MDEBUG("Pushed new stratum jobs to " << pushed << " miners");
+  }
+  //-----------------------------------------------------------------------------------
+  void stratum_server::job_loop()
+  {
+    // the journal is interrupted when the rpc server stops, so we must be stopped before it
+    event_journal& journal = m_core.get_event_journal();
+    uint64_t cursor = journal.get_cursor();
+    uint64_t last_push = epee::misc_utils::get_tick_count();
+    bool pool_changed = false;
+    std::vector<chain_event> events;
+    while (!m_stop)
+    {
+      bool tip_changed = !journal.get_events(cursor, events, cursor, STRATUM_EVENT_WAIT_MS, 1024);
+      for (const chain_event& e: events)
+      {
+        if (e.type == chain_event::block_added || e.type == chain_event::block_removed)
+          tip_changed = true;
+        else
+          pool_changed = true;
+      }
+
+      const uint64_t now = epee::misc_utils::get_tick_count();
+      if (tip_changed || (pool_changed && now - last_push >= STRATUM_POOL_JOB_INTERVAL_MS))
+      {
+        push_jobs();
+        last_push = now;
+        pool_changed = false;
+      }
+    }
+  }
+}
@@ -0,0 +1,271 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "net/abstract_tcp_server2.h"
+#include "net/jsonrpc_protocol_handler.h"
+#include "crypto/merkle_tree.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "p2p/net_node.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+
+namespace cryptonote
+{
+  namespace stratum
+  {
+    struct job
+    {
+      std::string blob;   //!< hashing blob, hex
+      std::string job_id;
+      std::string target; //!< see stratum_server::get_target_hex
+      uint64_t height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(blob)
+        KV_SERIALIZE(job_id)
+        KV_SERIALIZE(target)
+        KV_SERIALIZE(height)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    //! params of all the methods, the ones a method doesn't use are left empty
+    struct request_params
+    {
+      std::string login;  //!< login: address to mine to, optionally followed by .worker
+      std::string pass;
+      std::string agent;
+      std::string id;     //!< session id given at login
+      std::string job_id;
+      std::string nonce;  //!< submit: 4 bytes, hex
+      std::string result; //!< submit: PoW hash the miner found, hex
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(login)
+        KV_SERIALIZE(pass)
+        KV_SERIALIZE(agent)
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(job_id)
+        KV_SERIALIZE(nonce)
+        KV_SERIALIZE(result)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      std::string method;
+      epee::serialization::storage_entry id;
+      request_params params;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(method)
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(params)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct login_result
+    {
+      std::string id;
+      stratum::job job;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(job)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct status_result
+    {
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    //! pushed to the miners when there is new work
+    struct job_notification
+    {
+      std::string jsonrpc;
+      std::string method;
+      stratum::job params;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(jsonrpc)
+        KV_SERIALIZE(method)
+        KV_SERIALIZE(params)
+      END_KV_SERIALIZE_MAP()
+    };
+  }
+
+  //! A block template shared by all the miners mining to one address
+  struct stratum_template
+  {
+    block b;
+    blobdata blob;
+    size_t reserved_offset; //!< of the extra nonce in `blob`
+    crypto::merkle_tree tx_tree; //!< over the miner tx and `b.tx_hashes`, the miner tx differs in each job
+    difficulty_type difficulty;
+    uint64_t height;
+  };
+
+  class stratum_server;
+
+  struct stratum_handler_config
+  {
+    stratum_server* m_pserver;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  //! A miner connection, speaking newline delimited JSON-RPC like CryptoNote pools do
+  class stratum_protocol_handler
+  {
+  public:
+    typedef epee::net_utils::connection_context_base connection_context;
+    typedef stratum_handler_config config_type;
+
+    stratum_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context);
+
+    bool handle_recv(const void* ptr, size_t cb);
+    bool after_init_connection();
+    void handle_qued_callback() {}
+    bool release_protocol();
+
+  private:
+    friend class stratum_server;
+
+    struct job_entry
+    {
+      std::string id;
+      std::shared_ptr<const stratum_template> tmpl;
+      block b; //!< the template with our extra nonce
+      stratum::job job;
+    };
+
+    bool send(const std::string& data);
+
+    config_type& m_config;
+    connection_context& m_conn_context;
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+    std::string m_buffer;
+
+    // the job thread pushes jobs too, these are under m_lock
+    boost::mutex m_lock;
+    std::string m_session_id; //!< empty until login
+    account_public_address m_address;
+    std::string m_address_str;
+    uint32_t m_extra_nonce;
+    std::deque<job_entry> m_jobs; //!< most recent last
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  //! Hands out mining jobs to external miners and pushes new ones on tip or pool change
+  /*! Miners mining to the same address share one block template; each connection
+  gets its own extra nonce in the coinbase, hence its own nonce space. Submitted
+  nonces are checked against the block difficulty before the block is handed to
+  the core, so the miners only submit blocks, not pool shares. */
+  class stratum_server
+  {
+  public:
+    static const command_line::arg_descriptor<std::string> arg_stratum_bind_ip;
+    static const command_line::arg_descriptor<std::string> arg_stratum_bind_port;
+    static const command_line::arg_descriptor<std::string> arg_stratum_address;
+
+    stratum_server(
+        core& cr
+      , nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& p2p
+      );
+    ~stratum_server();
+
+    static void init_options(boost::program_options::options_description& desc);
+    bool init(const boost::program_options::variables_map& vm);
+    bool is_enabled() const { return m_enabled; }
+    bool run(size_t threads_count);
+    void stop();
+    int get_binded_port() { return m_net_server.get_binded_port(); }
+
+    //! the target miners compare the top 8 bytes of their hashes to, little endian hex
+    static std::string get_target_hex(difficulty_type difficulty);
+    //! `offset` gets where the extra nonce reserved in `b`'s miner tx extra starts in `blob`
+    static bool find_extra_nonce(const block& b, const blobdata& blob, size_t& offset);
+
+    //! `response` gets the newline terminated response, \return false if the connection should be dropped
+    bool handle_request(stratum_protocol_handler& conn, const std::string& line, std::string& response);
+    void add_connection(stratum_protocol_handler* conn);
+    void remove_connection(stratum_protocol_handler* conn);
+
+  private:
+    bool on_login(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::login_result& res, std::string& error);
+    bool on_getjob(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::job& res, std::string& error);
+    bool on_submit(stratum_protocol_handler& conn, const stratum::request_params& params, stratum::status_result& res, std::string& error);
+
+    std::shared_ptr<const stratum_template> get_template(const account_public_address& address, const std::string& address_str, std::string& error);
+    //! Requires lock on `conn.m_lock`.
+    bool make_job(stratum_protocol_handler& conn, stratum::job& job, std::string& error);
+    void push_jobs();
+    void job_loop();
+
+    core& m_core;
+    nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
+    epee::net_utils::boosted_tcp_server<stratum_protocol_handler> m_net_server;
+    bool m_enabled;
+    bool m_testnet;
+    std::string m_address_str; //!< if set, mine to this address whatever the miners log in with
+    account_public_address m_address;
+
+    boost::thread m_job_thread;
+    std::atomic<bool> m_stop;
+
+    boost::mutex m_connections_lock;
+    std::set<stratum_protocol_handler*> m_connections;
+
+    boost::mutex m_templates_lock;
+    std::unordered_map<std::string, std::shared_ptr<const stratum_template>> m_templates; //!< by address, dropped on new jobs
+
+    std::atomic<uint32_t> m_next_extra_nonce;
+    std::atomic<uint64_t> m_next_job_id;
+  };
+}
@@ -68,6 +68,7 @@ namespace tests
     void on_synchronized(){}
     void safesyncmode(const bool){}
     uint64_t get_current_blockchain_height(){return 1;}
+    uint64_t get_pruned_height() const {return 0;}
     void set_target_blockchain_height(uint64_t) {}
     bool init(const boost::program_options::variables_map& vm);
     bool deinit(){return true;}
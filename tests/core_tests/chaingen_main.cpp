@@ -31,6 +31,8 @@
 #include "chaingen.h"
 #include "chaingen_tests_list.h"
 #include "common/command_line.h"
+#include "profile_tools.h"
+#include "sync_bench.h"
 #include "transaction_tests.h"
 
 namespace po = boost::program_options;
@@ -42,6 +44,16 @@ namespace
   const command_line::arg_descriptor<bool>        arg_play_test_data              = {"play_test_data", ""};
   const command_line::arg_descriptor<bool>        arg_generate_and_play_test_data = {"generate_and_play_test_data", ""};
   const command_line::arg_descriptor<bool>        arg_test_transactions           = {"test_transactions", ""};
+  const command_line::arg_descriptor<std::string> arg_sync_bench_generate         = {"sync_bench_generate", "Generate a synthetic RingCT chain for the sync benchmark into this file", ""};
+  const command_line::arg_descriptor<std::string> arg_sync_bench_play             = {"sync_bench_play", "Time the import of a chain generated with --sync_bench_generate into a fresh database", ""};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_blocks           = {"sync_bench_blocks", "Number of blocks to generate", 20000};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_txs_per_block    = {"sync_bench_txs_per_block", "Transactions per block, as long as they fit in the full reward zone", 2};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_inputs           = {"sync_bench_inputs", "Inputs per transaction", 2};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_outputs          = {"sync_bench_outputs", "Outputs per transaction", 2};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_threads          = {"sync_bench_threads", "Threads used for block preparation and tx checks, 0 for the default", 0};
+  const command_line::arg_descriptor<size_t>      arg_sync_bench_span             = {"sync_bench_span", "Blocks handled per prepare/cleanup batch", BLOCKS_SYNCHRONIZING_DEFAULT_COUNT};
+  const command_line::arg_descriptor<std::string> arg_sync_bench_db_sync_mode     = {"sync_bench_db_sync_mode", "Database sync mode, as --db-sync-mode", ""};
+  const command_line::arg_descriptor<std::string> arg_sync_bench_data_dir         = {"sync_bench_data_dir", "Fresh data directory for the import, a temporary one if empty", ""};
 }
 
 int main(int argc, char* argv[])
@@ -60,6 +72,16 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_options, arg_play_test_data);
   command_line::add_arg(desc_options, arg_generate_and_play_test_data);
   command_line::add_arg(desc_options, arg_test_transactions);
+  command_line::add_arg(desc_options, arg_sync_bench_generate);
+  command_line::add_arg(desc_options, arg_sync_bench_play);
+  command_line::add_arg(desc_options, arg_sync_bench_blocks);
+  command_line::add_arg(desc_options, arg_sync_bench_txs_per_block);
+  command_line::add_arg(desc_options, arg_sync_bench_inputs);
+  command_line::add_arg(desc_options, arg_sync_bench_outputs);
+  command_line::add_arg(desc_options, arg_sync_bench_threads);
+  command_line::add_arg(desc_options, arg_sync_bench_span);
+  command_line::add_arg(desc_options, arg_sync_bench_db_sync_mode);
+  command_line::add_arg(desc_options, arg_sync_bench_data_dir);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -196,6 +218,59 @@ int main(int argc, char* argv[])
   {
     CALL_TEST("TRANSACTIONS TESTS", test_transactions);
   }
+  else if (!command_line::get_arg(vm, arg_sync_bench_generate).empty() || !command_line::get_arg(vm, arg_sync_bench_play).empty())
+  {
+    // keep per block logging out of the timings
+    mlog_set_log_level(0);
+
+    const std::string generate_file = command_line::get_arg(vm, arg_sync_bench_generate);
+    if (!generate_file.empty())
+    {
+      sync_bench_chain_params params;
+      params.blocks = command_line::get_arg(vm, arg_sync_bench_blocks);
+      params.txs_per_block = command_line::get_arg(vm, arg_sync_bench_txs_per_block);
+      params.inputs = command_line::get_arg(vm, arg_sync_bench_inputs);
+      params.outputs = command_line::get_arg(vm, arg_sync_bench_outputs);
+
+      std::vector<test_event_entry> events;
+      if (!generate_sync_bench_chain(params, events))
+      {
+        MERROR("Failed to generate sync benchmark chain");
+        return 1;
+      }
+      if (!tools::serialize_obj_to_file(events, generate_file))
+      {
+        MERROR("Failed to serialize data to file: " << generate_file);
+        return 1;
+      }
+    }
+
+    const std::string play_file = command_line::get_arg(vm, arg_sync_bench_play);
+    if (!play_file.empty())
+    {
+      sync_bench_play_params params;
+      params.data_dir = command_line::get_arg(vm, arg_sync_bench_data_dir);
+      params.db_sync_mode = command_line::get_arg(vm, arg_sync_bench_db_sync_mode);
+      params.threads = command_line::get_arg(vm, arg_sync_bench_threads);
+      params.span = command_line::get_arg(vm, arg_sync_bench_span);
+
+      std::vector<test_event_entry> events;
+      TIME_MEASURE_START(load_time);
+      if (!tools::unserialize_obj_from_file(events, play_file))
+      {
+        MERROR("Failed to deserialize data from file: " << play_file);
+        return 1;
+      }
+      TIME_MEASURE_FINISH(load_time);
+      MGINFO("Loaded " << events.size() << " events from " << play_file << " in " << load_time << " ms");
+
+      if (!play_sync_bench_chain(events, params))
+      {
+        MERROR("Sync benchmark failed");
+        return 1;
+      }
+    }
+  }
   else
   {
     MERROR("Wrong arguments");
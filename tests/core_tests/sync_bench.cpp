@@ -0,0 +1,398 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <iomanip>
+#include <list>
+
+#include <boost/filesystem.hpp>
+
+#include "common/util.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "ringct/rctSigs.h"
+
+#include "profile_tools.h"
+#include "sync_bench.h"
+
+using namespace epee;
+using namespace cryptonote;
+
+namespace
+{
+  // An output of the synthetic chain, at its global index. All outputs,
+  // coinbase ones included, live under amount 0.
+  struct chain_output
+  {
+    rct::ctkey key;
+    uint64_t unlock_height;
+  };
+
+  // An output owned by the generator's account, not spent yet
+  struct owned_output
+  {
+    uint64_t global_index;
+    crypto::public_key tx_pub_key;
+    size_t out_no;
+    uint64_t amount;
+    rct::key mask;
+    uint64_t unlock_height;
+  };
+
+  // Decoys are picked uniformly among the outputs spendable at this height.
+  // The ring size is the consensus one, DEFAULT_RINGSIZE.
+  bool fill_source(const std::vector<chain_output>& chain_outputs, const owned_output& real, uint64_t height, tx_source_entry& src)
+  {
+    std::vector<uint64_t> ring;
+    ring.push_back(real.global_index);
+    size_t attempts = 0;
+    while (ring.size() < DEFAULT_RINGSIZE)
+    {
+      CHECK_AND_ASSERT_MES(++attempts < 1000 * DEFAULT_RINGSIZE, false, "Not enough spendable outputs for a ring at height " << height);
+      const uint64_t idx = crypto::rand<uint64_t>() % chain_outputs.size();
+      if (chain_outputs[idx].unlock_height > height)
+        continue;
+      if (std::find(ring.begin(), ring.end(), idx) != ring.end())
+        continue;
+      ring.push_back(idx);
+    }
+    std::sort(ring.begin(), ring.end());
+
+    src.outputs.clear();
+    for (size_t n = 0; n < ring.size(); ++n)
+    {
+      if (ring[n] == real.global_index)
+        src.real_output = n;
+      src.outputs.push_back(std::make_pair(ring[n], chain_outputs[ring[n]].key));
+    }
+    src.real_out_tx_key = real.tx_pub_key;
+    src.real_output_in_tx_index = real.out_no;
+    src.amount = real.amount;
+    src.mask = real.mask;
+    return true;
+  }
+
+  double to_seconds(uint64_t ns)
+  {
+    return ns / 1e9;
+  }
+}
+
+bool generate_sync_bench_chain(const sync_bench_chain_params& params, std::vector<test_event_entry>& events)
+{
+  CHECK_AND_ASSERT_MES(params.inputs > 0 && params.outputs > 0, false, "Transactions need at least one input and one output");
+
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, 0);
+
+  std::vector<chain_output> chain_outputs;
+  std::list<owned_output> owned;
+
+  // Everything is paid to miner_account, so every output can be spent later
+  auto add_outputs = [&](const transaction& tx, uint64_t unlock_height)
+  {
+    const bool miner_tx = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+    const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+    for (size_t o = 0; o < tx.vout.size(); ++o)
+    {
+      const crypto::public_key& key = boost::get<txout_to_key>(tx.vout[o].target).key;
+      owned_output oo;
+      oo.global_index = chain_outputs.size();
+      oo.tx_pub_key = tx_pub_key;
+      oo.out_no = o;
+      oo.unlock_height = unlock_height;
+      if (miner_tx)
+      {
+        oo.amount = tx.vout[o].amount;
+        oo.mask = rct::identity();
+        chain_outputs.push_back({{rct::pk2rct(key), rct::zeroCommit(oo.amount)}, unlock_height});
+      }
+      else
+      {
+        oo.amount = get_tx_amount_and_mask(tx, miner_account, o, oo.mask);
+        chain_outputs.push_back({{rct::pk2rct(key), tx.rct_signatures.outPk[o].mask}, unlock_height});
+      }
+      owned.push_back(oo);
+    }
+  };
+
+  add_outputs(blk_0.miner_tx, CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+
+  // Stay in the full reward zone, or the generator and the chain would
+  // disagree on the penalized reward
+  const size_t max_txs_size = CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V1 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+  const uint64_t fee = TESTS_DEFAULT_FEE;
+
+  cryptonote::block blk_prev = blk_0;
+  size_t total_txs = 0;
+  for (uint64_t height = 1; height <= params.blocks; ++height)
+  {
+    std::vector<transaction> txs;
+    std::vector<crypto::hash> tx_hashes;
+    size_t txs_size = 0;
+    uint64_t fees = 0;
+    while (txs.size() < params.txs_per_block)
+    {
+      // oldest spendable outputs first
+      std::vector<std::list<owned_output>::iterator> picks;
+      uint64_t inputs_amount = 0;
+      for (auto it = owned.begin(); it != owned.end() && picks.size() < params.inputs; ++it)
+      {
+        if (it->unlock_height > height)
+          continue;
+        picks.push_back(it);
+        inputs_amount += it->amount;
+      }
+      if (picks.size() < params.inputs || inputs_amount <= fee + params.outputs)
+        break;
+
+      std::vector<tx_source_entry> sources(picks.size());
+      for (size_t n = 0; n < picks.size(); ++n)
+      {
+        if (!fill_source(chain_outputs, *picks[n], height, sources[n]))
+          return false;
+      }
+
+      std::vector<tx_destination_entry> destinations;
+      const uint64_t out_amount = (inputs_amount - fee) / params.outputs;
+      for (size_t o = 0; o < params.outputs; ++o)
+        destinations.push_back(tx_destination_entry(out_amount, miner_account.get_keys().m_account_address));
+      destinations[0].amount += inputs_amount - fee - out_amount * params.outputs;
+
+      transaction tx;
+      crypto::secret_key tx_key;
+      bool r = construct_tx_and_get_tx_key(miner_account.get_keys(), sources, destinations, std::vector<uint8_t>(), tx, 0, tx_key);
+      CHECK_AND_ASSERT_MES(r, false, "Failed to construct transaction at height " << height);
+
+      const size_t tx_size = get_object_blobsize(tx);
+      if (txs_size + tx_size > max_txs_size)
+      {
+        CHECK_AND_ASSERT_MES(!txs.empty(), false, "A single transaction does not fit in a block, use fewer inputs or outputs");
+        break;
+      }
+
+      for (const auto& it: picks)
+        owned.erase(it);
+      txs_size += tx_size;
+      fees += fee;
+      tx_hashes.push_back(get_transaction_hash(tx));
+      txs.push_back(tx);
+    }
+
+    cryptonote::block blk;
+    CHECK_AND_ASSERT_MES(generator.construct_block_manually_tx(blk, blk_prev, miner_account, tx_hashes, txs_size, fees), false,
+        "Failed to generate block " << height);
+
+    for (const transaction& tx: txs)
+      events.push_back(serialized_transaction(t_serializable_object_to_blob(tx)));
+    events.push_back(serialized_block(t_serializable_object_to_blob(blk)));
+
+    // global indices follow the order the db adds outputs in: miner tx first
+    add_outputs(blk.miner_tx, height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+    for (const transaction& tx: txs)
+      add_outputs(tx, height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE);
+
+    blk_prev = blk;
+    total_txs += txs.size();
+    if (height % 1000 == 0)
+      MGINFO("Generated " << height << "/" << params.blocks << " blocks, " << total_txs << " transactions");
+  }
+
+  MGINFO("Generated " << params.blocks << " blocks, " << total_txs << " transactions, " << chain_outputs.size() << " outputs");
+  return true;
+}
+
+bool play_sync_bench_chain(const std::vector<test_event_entry>& events, const sync_bench_play_params& params)
+{
+  CHECK_AND_ASSERT_MES(!events.empty() && typeid(cryptonote::block) == events[0].type(), false, "First event must be genesis block creation");
+
+  // group the txs with the block that follows them, as in a sync response
+  std::list<block_complete_entry> blocks;
+  std::list<blobdata> txs;
+  size_t total_blocks = 0, total_txs = 0;
+  for (size_t i = 1; i < events.size(); ++i)
+  {
+    if (typeid(serialized_transaction) == events[i].type())
+    {
+      txs.push_back(boost::get<serialized_transaction>(events[i]).data);
+    }
+    else if (typeid(serialized_block) == events[i].type())
+    {
+      blocks.push_back(block_complete_entry());
+      blocks.back().block = boost::get<serialized_block>(events[i]).data;
+      blocks.back().txs.swap(txs);
+      total_txs += blocks.back().txs.size();
+      ++total_blocks;
+    }
+    else
+    {
+      MERROR("Unexpected event " << i << " in sync benchmark data");
+      return false;
+    }
+  }
+
+  const bool temporary_data_dir = params.data_dir.empty();
+  const boost::filesystem::path data_dir = temporary_data_dir ?
+      boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("fonero-sync-bench-%%%%-%%%%-%%%%") :
+      boost::filesystem::path(params.data_dir);
+  CHECK_AND_ASSERT_MES(!boost::filesystem::exists(data_dir / "fake"), false,
+      "Data directory " << data_dir.string() << " already holds a chain, the import must start from a fresh database");
+  auto remove_data_dir = misc_utils::create_scope_leave_handler([&]() {
+    if (temporary_data_dir)
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(data_dir, ec);
+    }
+  });
+
+  std::vector<std::string> args;
+  args.push_back("--" + std::string(command_line::arg_data_dir.name));
+  args.push_back(data_dir.string());
+  if (!params.db_sync_mode.empty())
+  {
+    args.push_back("--" + std::string(command_line::arg_db_sync_mode.name));
+    args.push_back(params.db_sync_mode);
+  }
+  if (params.threads > 0)
+  {
+    args.push_back("--" + std::string(command_line::arg_prep_blocks_threads.name));
+    args.push_back(std::to_string(params.threads));
+    tools::set_max_concurrency(params.threads);
+  }
+
+  boost::program_options::options_description desc("Allowed options");
+  cryptonote::core::init_options(desc);
+  boost::program_options::variables_map vm;
+  bool r = command_line::handle_error_helper(desc, [&]()
+  {
+    boost::program_options::store(boost::program_options::command_line_parser(args).options(desc).run(), vm);
+    boost::program_options::notify(vm);
+    return true;
+  });
+  if (!r)
+    return false;
+
+  cryptonote::cryptonote_protocol_stub pr;
+  cryptonote::core c(&pr);
+  get_test_options<sync_bench_chain> gto;
+
+  TIME_MEASURE_NS_START(init_time);
+  if (!c.init(vm, &gto.test_options))
+  {
+    MERROR("Failed to init core");
+    return false;
+  }
+  if (!c.set_genesis_block(boost::get<cryptonote::block>(events[0])))
+  {
+    MERROR("Failed to set genesis block");
+    c.deinit();
+    return false;
+  }
+  TIME_MEASURE_NS_FINISH(init_time);
+
+  // same sequence of calls as the protocol handler uses for a downloaded span
+  uint64_t prepare_time = 0, txs_time = 0, blocks_time = 0, cleanup_time = 0;
+  const size_t span = std::max<size_t>(params.span, 1);
+  bool ok = true;
+  TIME_MEASURE_NS_START(import_time);
+  while (ok && !blocks.empty())
+  {
+    std::list<block_complete_entry> batch;
+    auto end = blocks.begin();
+    for (size_t n = 0; n < span && end != blocks.end(); ++n)
+      ++end;
+    batch.splice(batch.end(), blocks, blocks.begin(), end);
+
+    TIME_MEASURE_NS_START(batch_prepare_time);
+    c.prepare_handle_incoming_blocks(batch);
+    TIME_MEASURE_NS_FINISH(batch_prepare_time);
+    prepare_time += batch_prepare_time;
+
+    for (const block_complete_entry& entry: batch)
+    {
+      TIME_MEASURE_NS_START(block_txs_time);
+      std::vector<tx_verification_context> tvc;
+      c.handle_incoming_txs(entry.txs, tvc, true, true, false);
+      TIME_MEASURE_NS_FINISH(block_txs_time);
+      txs_time += block_txs_time;
+      for (const tx_verification_context& v: tvc)
+        ok &= !v.m_verifivation_failed;
+      if (!ok)
+      {
+        MERROR("Transaction verification failed at height " << c.get_current_blockchain_height());
+        break;
+      }
+
+      TIME_MEASURE_NS_START(block_time);
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
+      c.handle_incoming_block(entry.block, bvc, false);
+      TIME_MEASURE_NS_FINISH(block_time);
+      blocks_time += block_time;
+      if (bvc.m_verifivation_failed || bvc.m_marked_as_orphaned)
+      {
+        MERROR("Block verification failed at height " << c.get_current_blockchain_height());
+        ok = false;
+        break;
+      }
+    }
+
+    TIME_MEASURE_NS_START(batch_cleanup_time);
+    ok &= c.cleanup_handle_incoming_blocks();
+    TIME_MEASURE_NS_FINISH(batch_cleanup_time);
+    cleanup_time += batch_cleanup_time;
+
+    const uint64_t height = c.get_current_blockchain_height();
+    if (height / 1000 != (height - batch.size()) / 1000)
+      MGINFO("Imported " << height << "/" << total_blocks + 1 << " blocks");
+  }
+  TIME_MEASURE_NS_FINISH(import_time);
+
+  const uint64_t height = c.get_current_blockchain_height();
+
+  // deinit syncs whatever the db still holds back
+  TIME_MEASURE_NS_START(deinit_time);
+  c.deinit();
+  TIME_MEASURE_NS_FINISH(deinit_time);
+
+  if (!ok)
+    return false;
+  CHECK_AND_ASSERT_MES(height == total_blocks + 1, false, "Imported chain has height " << height << ", expected " << total_blocks + 1);
+
+  const double total = to_seconds(import_time + deinit_time);
+  std::cout << "Sync benchmark: " << total_blocks << " blocks, " << total_txs << " transactions, "
+            << tools::get_max_concurrency() << " threads, " << span << " blocks per span" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "  init:    " << to_seconds(init_time) << " s" << std::endl;
+  std::cout << "  prepare: " << to_seconds(prepare_time) << " s" << std::endl;
+  std::cout << "  txs:     " << to_seconds(txs_time) << " s" << std::endl;
+  std::cout << "  blocks:  " << to_seconds(blocks_time) << " s" << std::endl;
+  std::cout << "  cleanup: " << to_seconds(cleanup_time) << " s" << std::endl;
+  std::cout << "  deinit:  " << to_seconds(deinit_time) << " s" << std::endl;
+  std::cout << "  total:   " << total << " s, " << total_blocks / total << " blocks/s, " << total_txs / total << " txs/s" << std::endl;
+  return true;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "chaingen.h"
+
+/************************************************************************/
+/* Sync benchmark                                                       */
+/*                                                                      */
+/* Builds a long synthetic chain of RingCT transactions once, saves it  */
+/* with the usual event file format, and times importing it into a      */
+/* fresh database through the same core calls the p2p sync uses.        */
+/************************************************************************/
+
+struct sync_bench_chain_params
+{
+  size_t blocks;
+  size_t txs_per_block;
+  size_t inputs;
+  size_t outputs;
+
+  sync_bench_chain_params()
+    : blocks(20000)
+    , txs_per_block(2)
+    , inputs(2)
+    , outputs(2)
+  {
+  }
+};
+
+struct sync_bench_play_params
+{
+  std::string data_dir;     // fresh directory for the database, a temporary one if empty
+  std::string db_sync_mode;
+  size_t threads;           // 0 to keep the default concurrency
+  size_t span;              // blocks per prepare/cleanup batch, as in a sync span
+
+  sync_bench_play_params()
+    : threads(0)
+    , span(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+  {
+  }
+};
+
+// Tag for get_test_options: the chain runs on hard fork 1 from genesis
+struct sync_bench_chain {};
+
+bool generate_sync_bench_chain(const sync_bench_chain_params& params, std::vector<test_event_entry>& events);
+bool play_sync_bench_chain(const std::vector<test_event_entry>& events, const sync_bench_play_params& params);
@@ -28,7 +28,9 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <ios>
@@ -60,6 +62,38 @@ static void cn_slow_hash_1(const void *data, size_t length, char *hash) {
   return cn_slow_hash(data, length, hash, 1);
 }
 
+// hashes the input in the first way, and variations of it in the others,
+// which must match what cn_slow_hash gives for them on its own
+template<size_t ways, int variant>
+static void cn_slow_hash_ways(const void *data, size_t length, char *hash) {
+  vector<char> inputs[ways];
+  const void *in[ways];
+  size_t lengths[ways];
+  chash out[ways];
+  for (size_t w = 0; w < ways; ++w) {
+    inputs[w].assign((const char *) data, (const char *) data + length);
+    if (w > 0 && length > 0) {
+      rotate(inputs[w].begin(), inputs[w].begin() + w % length, inputs[w].end());
+      inputs[w][length - 1] ^= (char) w;
+    }
+    in[w] = inputs[w].data();
+    lengths[w] = length;
+  }
+  if (ways == 2) {
+    cn_slow_hash_x2(in, lengths, out, variant);
+  } else {
+    cn_slow_hash_x4(in, lengths, out, variant);
+  }
+  for (size_t w = 1; w < ways; ++w) {
+    chash expected;
+    cn_slow_hash(in[w], lengths[w], expected, variant);
+    if (expected != out[w]) {
+      throw ios_base::failure("Interleaved hash mismatch");
+    }
+  }
+  memcpy(hash, &out[0], sizeof(chash));
+}
+
 POP_WARNINGS
 
 extern "C" typedef void hash_f(const void *, size_t, char *);
@@ -69,7 +103,8 @@ struct hash_func {
 } hashes[] = {{"fast", cn_fast_hash}, {"slow", cn_slow_hash_0}, {"tree", hash_tree},
   {"extra-blake", hash_extra_blake}, {"extra-groestl", hash_extra_groestl},
   {"extra-jh", hash_extra_jh}, {"extra-skein", hash_extra_skein},
-  {"slow-1", cn_slow_hash_1}};
+  {"slow-1", cn_slow_hash_1}, {"slow-x2", cn_slow_hash_ways<2, 0>}, {"slow-x4", cn_slow_hash_ways<4, 0>},
+  {"slow-1-x2", cn_slow_hash_ways<2, 1>}, {"slow-1-x4", cn_slow_hash_ways<4, 1>}};
 
 int main(int argc, char *argv[]) {
   hash_f *f;
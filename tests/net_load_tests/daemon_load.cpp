@@ -0,0 +1,785 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/ip/address_v4.hpp>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "misc_language.h"
+#include "misc_log_ex.h"
+#include "string_tools.h"
+#include "net/abstract_tcp_server2.h"
+#include "net/http_client.h"
+#include "net/levin_protocol_handler_async.h"
+#include "storages/http_abstract_invoke.h"
+#include "storages/levin_abstract_invoke2.h"
+
+#include "common/command_line.h"
+#include "crypto/crypto.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "p2p/p2p_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+/************************************************************************/
+/* Daemon load generator                                                */
+/*                                                                      */
+/* Drives a running daemon with simulated peers (handshakes, timed      */
+/* syncs, chain and block requests, tx relay) and wallet style RPC      */
+/* clients (getblocks.bin, get_outs.bin, sendrawtransaction), then      */
+/* prints the throughput and latency percentiles of every request kind. */
+/************************************************************************/
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_daemon_address = {"daemon-address", "Address of the daemon under load", "127.0.0.1"};
+  const command_line::arg_descriptor<uint32_t> arg_p2p_port = {"p2p-port", "P2P port of the daemon, 0 for the network default", 0};
+  const command_line::arg_descriptor<uint32_t> arg_rpc_port = {"rpc-port", "RPC port of the daemon, 0 for the network default", 0};
+  const command_line::arg_descriptor<size_t> arg_peers = {"peers", "Number of simulated p2p peers", 8};
+  const command_line::arg_descriptor<size_t> arg_rpc_clients = {"rpc-clients", "Number of simulated wallet RPC clients", 4};
+  const command_line::arg_descriptor<size_t> arg_duration = {"duration", "Length of the run in seconds", 30};
+  const command_line::arg_descriptor<std::string> arg_bind_ip = {"bind-ip", "First local address peers connect from, the next peers use the following addresses", "127.0.0.1"};
+  const command_line::arg_descriptor<size_t> arg_peer_delay = {"peer-delay", "Pause between two requests of a peer, in milliseconds", 0};
+  const command_line::arg_descriptor<size_t> arg_blocks_per_request = {"blocks-per-request", "Blocks asked for in each NOTIFY_REQUEST_GET_OBJECTS", BLOCKS_SYNCHRONIZING_DEFAULT_COUNT};
+  const command_line::arg_descriptor<size_t> arg_outs_per_request = {"outs-per-request", "Outputs asked for in each get_outs.bin call", 2 * DEFAULT_RINGSIZE};
+  const command_line::arg_descriptor<size_t> arg_relay_txs = {"relay-txs", "Pool transactions fetched for tx relay and sendrawtransaction", 100};
+  const command_line::arg_descriptor<size_t> arg_timeout = {"timeout", "Timeout of a single request, in milliseconds", 30000};
+
+  typedef std::chrono::steady_clock clock_type;
+
+  struct load_params
+  {
+    std::string daemon_address;
+    std::string p2p_port;
+    std::string rpc_port;
+    boost::uuids::uuid network_id;
+    size_t peers;
+    size_t rpc_clients;
+    std::chrono::seconds duration;
+    boost::asio::ip::address_v4 bind_ip;
+    std::chrono::milliseconds peer_delay;
+    size_t blocks_per_request;
+    size_t outs_per_request;
+    size_t relay_txs;
+    std::chrono::milliseconds timeout;
+  };
+
+  // What the load generator knows about the daemon's chain, read over RPC before the run
+  struct chain_info
+  {
+    crypto::hash genesis_id;
+    uint64_t height;
+    uint64_t rct_outputs;
+    std::vector<cryptonote::blobdata> txs;
+  };
+
+  // Outcome of one kind of request for one worker, merged across workers at the end
+  struct op_stats
+  {
+    std::vector<uint64_t> latencies_us;
+    uint64_t errors;
+    uint64_t items;    // blocks or outputs returned, when the request returns any
+    bool answered;     // false if the daemon sends no answer, so latencies only time the local send
+
+    op_stats(): errors(0), items(0), answered(true) {}
+
+    void merge(const op_stats& other)
+    {
+      latencies_us.insert(latencies_us.end(), other.latencies_us.begin(), other.latencies_us.end());
+      errors += other.errors;
+      items += other.items;
+      answered = answered && other.answered;
+    }
+  };
+
+  typedef std::map<std::string, op_stats> stats_map;
+
+  // Runs f, and records its latency if it succeeds or an error if it does not
+  template<typename t_func>
+  bool measure(op_stats& stats, t_func f)
+  {
+    const clock_type::time_point start = clock_type::now();
+    if (!f())
+    {
+      ++stats.errors;
+      return false;
+    }
+    stats.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count());
+    return true;
+  }
+
+  //----------------------------------------------------------------------------------------------------
+  // P2P side
+  //----------------------------------------------------------------------------------------------------
+  struct peer_connection_context : epee::net_utils::connection_context_base
+  {
+  };
+
+  typedef epee::levin::async_protocol_handler<peer_connection_context> peer_protocol_handler;
+  typedef epee::levin::async_protocol_handler_config<peer_connection_context> peer_protocol_handler_config;
+  typedef epee::net_utils::boosted_tcp_server<peer_protocol_handler> peer_tcp_server;
+
+  typedef nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA> COMMAND_HANDSHAKE;
+  typedef nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA> COMMAND_TIMED_SYNC;
+
+  // The daemon answers chain and block requests with notifications on the same
+  // connection, which the commands handler hands over to the peer waiting for them
+  class simulated_peer
+  {
+  public:
+    simulated_peer(peer_protocol_handler_config& config, const load_params& params, const chain_info& chain)
+      : m_config(config)
+      , m_params(params)
+      , m_chain(chain)
+      , m_peer_id(crypto::rand<uint64_t>())
+      , m_closed(true)
+      , m_chain_entries(0)
+      , m_objects(0)
+      , m_last_blocks(0)
+      , m_block_ids(1, chain.genesis_id)
+      , m_chain_cursor(chain.genesis_id)
+    {
+    }
+
+    uint64_t peer_id() const { return m_peer_id; }
+
+    void run(peer_tcp_server& server, const std::string& bind_ip, clock_type::time_point deadline, stats_map& stats);
+
+    void on_chain_entry(const cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (!arg.m_block_ids.empty())
+      {
+        m_block_ids.assign(arg.m_block_ids.begin(), arg.m_block_ids.end());
+        // carry on from the end of the entry, and sync again from the start once it reaches the top
+        if (arg.start_height + m_block_ids.size() >= arg.total_height)
+          m_chain_cursor = m_chain.genesis_id;
+        else
+          m_chain_cursor = m_block_ids.back();
+      }
+      ++m_chain_entries;
+      m_cond.notify_all();
+    }
+
+    void on_objects(const cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& arg)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_last_blocks = arg.blocks.size();
+      ++m_objects;
+      m_cond.notify_all();
+    }
+
+    void on_close()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_cond.notify_all();
+    }
+
+  private:
+    bool handshake(stats_map& stats);
+    bool timed_sync(stats_map& stats);
+    bool request_chain(stats_map& stats);
+    bool request_objects(stats_map& stats, std::mt19937_64& rng);
+    bool relay_tx(stats_map& stats, std::mt19937_64& rng);
+
+    // Waits until the counter moves past seen, or the connection closes
+    bool wait_for(const uint64_t& counter, uint64_t seen)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait_for(lock, m_params.timeout, [&]() { return counter != seen || m_closed; });
+      return counter != seen;
+    }
+
+    cryptonote::CORE_SYNC_DATA sync_data() const
+    {
+      cryptonote::CORE_SYNC_DATA data = AUTO_VAL_INIT(data);
+      data.current_height = 1;
+      data.cumulative_difficulty = 1;
+      data.top_id = m_chain.genesis_id;
+      data.top_version = 1;
+      return data;
+    }
+
+    peer_protocol_handler_config& m_config;
+    const load_params& m_params;
+    const chain_info& m_chain;
+    const uint64_t m_peer_id;
+    boost::uuids::uuid m_connection_id;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_closed;
+    uint64_t m_chain_entries;
+    uint64_t m_objects;
+    size_t m_last_blocks;
+    std::vector<crypto::hash> m_block_ids;    // last chain entry the daemon sent
+    crypto::hash m_chain_cursor;              // block the next chain request starts from
+  };
+
+  class peer_commands_handler : public epee::levin::levin_commands_handler<peer_connection_context>
+  {
+  public:
+    void add_peer(const boost::uuids::uuid& connection_id, simulated_peer* peer)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_peers[connection_id] = peer;
+    }
+
+    void remove_peer(const boost::uuids::uuid& connection_id)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_peers.erase(connection_id);
+    }
+
+    virtual int invoke(int command, const std::string& in_buff, std::string& buff_out, peer_connection_context& context)
+    {
+      bool handled;
+      return handle_invoke_map(false, command, in_buff, buff_out, context, handled);
+    }
+
+    virtual int notify(int command, const std::string& in_buff, peer_connection_context& context)
+    {
+      bool handled;
+      std::string fake_str;
+      return handle_invoke_map(true, command, in_buff, fake_str, context, handled);
+    }
+
+    virtual void on_connection_close(peer_connection_context& context)
+    {
+      simulated_peer* peer = find_peer(context.m_connection_id);
+      if (peer)
+        peer->on_close();
+    }
+
+    BEGIN_INVOKE_MAP2(peer_commands_handler)
+      HANDLE_INVOKE_T2(COMMAND_TIMED_SYNC, &peer_commands_handler::handle_timed_sync)
+      HANDLE_INVOKE_T2(nodetool::COMMAND_PING, &peer_commands_handler::handle_ping)
+      HANDLE_INVOKE_T2(nodetool::COMMAND_REQUEST_SUPPORT_FLAGS, &peer_commands_handler::handle_get_support_flags)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY, &peer_commands_handler::handle_response_chain_entry)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_RESPONSE_GET_OBJECTS, &peer_commands_handler::handle_response_get_objects)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_NEW_TRANSACTIONS, &peer_commands_handler::handle_ignored_notify<cryptonote::NOTIFY_NEW_TRANSACTIONS>)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_NEW_BLOCK, &peer_commands_handler::handle_ignored_notify<cryptonote::NOTIFY_NEW_BLOCK>)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_NEW_FLUFFY_BLOCK, &peer_commands_handler::handle_ignored_notify<cryptonote::NOTIFY_NEW_FLUFFY_BLOCK>)
+    END_INVOKE_MAP2()
+
+  private:
+    simulated_peer* find_peer(const boost::uuids::uuid& connection_id)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      std::map<boost::uuids::uuid, simulated_peer*>::const_iterator it = m_peers.find(connection_id);
+      return it == m_peers.end() ? NULL : it->second;
+    }
+
+    int handle_timed_sync(int command, COMMAND_TIMED_SYNC::request& arg, COMMAND_TIMED_SYNC::response& rsp, peer_connection_context& context)
+    {
+      rsp.local_time = time(NULL);
+      rsp.payload_data = arg.payload_data;
+      rsp.payload_data.current_height = 1;
+      rsp.payload_data.cumulative_difficulty = 1;
+      return 1;
+    }
+
+    int handle_ping(int command, nodetool::COMMAND_PING::request& arg, nodetool::COMMAND_PING::response& rsp, peer_connection_context& context)
+    {
+      simulated_peer* peer = find_peer(context.m_connection_id);
+      rsp.status = PING_OK_RESPONSE_STATUS_TEXT;
+      rsp.peer_id = peer ? peer->peer_id() : 0;
+      return 1;
+    }
+
+    int handle_get_support_flags(int command, nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::request& arg, nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::response& rsp, peer_connection_context& context)
+    {
+      rsp.support_flags = P2P_SUPPORT_FLAGS;
+      return 1;
+    }
+
+    int handle_response_chain_entry(int command, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, peer_connection_context& context)
+    {
+      simulated_peer* peer = find_peer(context.m_connection_id);
+      if (peer)
+        peer->on_chain_entry(arg);
+      return 1;
+    }
+
+    int handle_response_get_objects(int command, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& arg, peer_connection_context& context)
+    {
+      simulated_peer* peer = find_peer(context.m_connection_id);
+      if (peer)
+        peer->on_objects(arg);
+      return 1;
+    }
+
+    // Blocks and transactions the daemon relays are of no interest to the load
+    template<typename t_notify>
+    int handle_ignored_notify(int command, typename t_notify::request& arg, peer_connection_context& context)
+    {
+      return 1;
+    }
+
+    std::mutex m_mutex;
+    std::map<boost::uuids::uuid, simulated_peer*> m_peers;
+  };
+
+  bool simulated_peer::handshake(stats_map& stats)
+  {
+    COMMAND_HANDSHAKE::request arg = AUTO_VAL_INIT(arg);
+    COMMAND_HANDSHAKE::response rsp = AUTO_VAL_INIT(rsp);
+    arg.node_data.network_id = m_params.network_id;
+    arg.node_data.local_time = time(NULL);
+    arg.node_data.my_port = 0;    // not reachable, so the daemon does not ping back
+    arg.node_data.peer_id = m_peer_id;
+    arg.payload_data = sync_data();
+    return measure(stats["p2p handshake"], [&]() {
+      return epee::net_utils::invoke_remote_command2(m_connection_id, COMMAND_HANDSHAKE::ID, arg, rsp, m_config) &&
+          rsp.node_data.network_id == m_params.network_id;
+    });
+  }
+
+  bool simulated_peer::timed_sync(stats_map& stats)
+  {
+    COMMAND_TIMED_SYNC::request arg = AUTO_VAL_INIT(arg);
+    COMMAND_TIMED_SYNC::response rsp = AUTO_VAL_INIT(rsp);
+    arg.payload_data = sync_data();
+    return measure(stats["p2p timed sync"], [&]() {
+      return epee::net_utils::invoke_remote_command2(m_connection_id, COMMAND_TIMED_SYNC::ID, arg, rsp, m_config);
+    });
+  }
+
+  bool simulated_peer::request_chain(stats_map& stats)
+  {
+    cryptonote::NOTIFY_REQUEST_CHAIN::request arg = AUTO_VAL_INIT(arg);
+    uint64_t seen;
+    {
+      // walk the chain entry by entry, as a syncing peer would
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (m_chain_cursor != m_chain.genesis_id)
+        arg.block_ids.push_back(m_chain_cursor);
+      arg.block_ids.push_back(m_chain.genesis_id);
+      seen = m_chain_entries;
+    }
+    op_stats& op = stats["p2p request chain"];
+    return measure(op, [&]() {
+      return epee::net_utils::notify_remote_command2(m_connection_id, cryptonote::NOTIFY_REQUEST_CHAIN::ID, arg, m_config) &&
+          wait_for(m_chain_entries, seen);
+    });
+  }
+
+  bool simulated_peer::request_objects(stats_map& stats, std::mt19937_64& rng)
+  {
+    cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request arg = AUTO_VAL_INIT(arg);
+    uint64_t seen;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      const size_t count = std::min(m_params.blocks_per_request, m_block_ids.size());
+      const size_t start = std::uniform_int_distribution<size_t>(0, m_block_ids.size() - count)(rng);
+      arg.blocks.assign(m_block_ids.begin() + start, m_block_ids.begin() + start + count);
+      seen = m_objects;
+    }
+    op_stats& op = stats["p2p get objects"];
+    if (!measure(op, [&]() {
+      return epee::net_utils::notify_remote_command2(m_connection_id, cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID, arg, m_config) &&
+          wait_for(m_objects, seen);
+    }))
+      return false;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    op.items += m_last_blocks;
+    return true;
+  }
+
+  bool simulated_peer::relay_tx(stats_map& stats, std::mt19937_64& rng)
+  {
+    if (m_chain.txs.empty())
+      return true;
+    cryptonote::NOTIFY_NEW_TRANSACTIONS::request arg = AUTO_VAL_INIT(arg);
+    arg.txs.push_back(m_chain.txs[std::uniform_int_distribution<size_t>(0, m_chain.txs.size() - 1)(rng)]);
+    // a notification gets no answer, so this only times handing it to the connection
+    op_stats& op = stats["p2p relay tx"];
+    op.answered = false;
+    return measure(op, [&]() {
+      return epee::net_utils::notify_remote_command2(m_connection_id, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID, arg, m_config);
+    });
+  }
+
+  void simulated_peer::run(peer_tcp_server& server, const std::string& bind_ip, clock_type::time_point deadline, stats_map& stats)
+  {
+    peer_commands_handler& handler = static_cast<peer_commands_handler&>(*m_config.m_pcommands_handler);
+    std::mt19937_64 rng(m_peer_id);
+
+    while (clock_type::now() < deadline)
+    {
+      peer_connection_context context = AUTO_VAL_INIT(context);
+      if (!measure(stats["p2p connect"], [&]() {
+        return server.connect(m_params.daemon_address, m_params.p2p_port, m_params.timeout.count(), context, bind_ip);
+      }))
+      {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        continue;
+      }
+
+      m_connection_id = context.m_connection_id;
+      {
+        // a new connection syncs from scratch
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_closed = false;
+        m_block_ids.assign(1, m_chain.genesis_id);
+        m_chain_cursor = m_chain.genesis_id;
+      }
+      handler.add_peer(m_connection_id, this);
+
+      bool ok = handshake(stats);
+      for (size_t step = 0; ok && clock_type::now() < deadline; ++step)
+      {
+        switch (step % 4)
+        {
+          case 0: ok = timed_sync(stats); break;
+          case 1: ok = request_chain(stats); break;
+          case 2: ok = request_objects(stats, rng); break;
+          case 3: ok = relay_tx(stats, rng); break;
+        }
+        if (m_params.peer_delay.count())
+          std::this_thread::sleep_for(m_params.peer_delay);
+      }
+
+      m_config.close(m_connection_id);
+      handler.remove_peer(m_connection_id);
+    }
+  }
+
+  //----------------------------------------------------------------------------------------------------
+  // RPC side
+  //----------------------------------------------------------------------------------------------------
+  class rpc_client
+  {
+  public:
+    rpc_client(const load_params& params, const chain_info& chain, uint64_t seed)
+      : m_params(params)
+      , m_chain(chain)
+      , m_rng(seed)
+    {
+      m_http_client.set_server(params.daemon_address, params.rpc_port, boost::none);
+    }
+
+    void run(clock_type::time_point deadline, stats_map& stats)
+    {
+      // back off while requests fail, so a daemon which is down is not hammered
+      std::chrono::milliseconds backoff(0);
+      for (size_t step = 0; clock_type::now() < deadline; ++step)
+      {
+        bool ok = true;
+        switch (step % 3)
+        {
+          case 0: ok = get_blocks(stats); break;
+          case 1: ok = get_outs(stats); break;
+          case 2: ok = send_raw_tx(stats); break;
+        }
+        if (ok)
+        {
+          backoff = std::chrono::milliseconds(0);
+          continue;
+        }
+        backoff = std::min(std::max(backoff * 2, std::chrono::milliseconds(100)), std::chrono::milliseconds(5000));
+        std::this_thread::sleep_for(std::min(backoff, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now())));
+      }
+      m_http_client.disconnect();
+    }
+
+  private:
+    // A wallet refreshing from a random height
+    bool get_blocks(stats_map& stats)
+    {
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+      req.block_ids.push_back(m_chain.genesis_id);
+      req.start_height = std::uniform_int_distribution<uint64_t>(0, m_chain.height - 1)(m_rng);
+      req.prune = false;
+      op_stats& op = stats["rpc getblocks.bin"];
+      if (!measure(op, [&]() {
+        return epee::net_utils::invoke_http_bin("/getblocks.bin", req, res, m_http_client, m_params.timeout) && res.status == CORE_RPC_STATUS_OK;
+      }))
+        return false;
+      op.items += res.blocks.size();
+      return true;
+    }
+
+    // A wallet picking ring members for a new transaction
+    bool get_outs(stats_map& stats)
+    {
+      if (m_chain.rct_outputs == 0)
+        return true;
+      cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request req = AUTO_VAL_INIT(req);
+      cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::response res = AUTO_VAL_INIT(res);
+      std::uniform_int_distribution<uint64_t> index(0, m_chain.rct_outputs - 1);
+      for (size_t i = 0; i < m_params.outs_per_request; ++i)
+        req.outputs.push_back({0, index(m_rng)});
+      op_stats& op = stats["rpc get_outs.bin"];
+      if (!measure(op, [&]() {
+        return epee::net_utils::invoke_http_bin("/get_outs.bin", req, res, m_http_client, m_params.timeout) && res.status == CORE_RPC_STATUS_OK;
+      }))
+        return false;
+      op.items += res.outs.size();
+      return true;
+    }
+
+    // Resubmits a pool transaction, so the daemon parses and looks it up without relaying it
+    bool send_raw_tx(stats_map& stats)
+    {
+      if (m_chain.txs.empty())
+        return true;
+      cryptonote::COMMAND_RPC_SEND_RAW_TX::request req = AUTO_VAL_INIT(req);
+      cryptonote::COMMAND_RPC_SEND_RAW_TX::response res = AUTO_VAL_INIT(res);
+      req.tx_as_hex = epee::string_tools::buff_to_hex_nodelimer(m_chain.txs[std::uniform_int_distribution<size_t>(0, m_chain.txs.size() - 1)(m_rng)]);
+      req.do_not_relay = true;
+      return measure(stats["rpc sendrawtransaction"], [&]() {
+        return epee::net_utils::invoke_http_json("/sendrawtransaction", req, res, m_http_client, m_params.timeout, "POST") && res.status == CORE_RPC_STATUS_OK;
+      });
+    }
+
+    const load_params& m_params;
+    const chain_info& m_chain;
+    std::mt19937_64 m_rng;
+    epee::net_utils::http::http_simple_client m_http_client;
+  };
+
+  bool get_chain_info(const load_params& params, chain_info& chain)
+  {
+    epee::net_utils::http::http_simple_client http_client;
+    http_client.set_server(params.daemon_address, params.rpc_port, boost::none);
+
+    cryptonote::COMMAND_RPC_GET_INFO::request info_req = AUTO_VAL_INIT(info_req);
+    cryptonote::COMMAND_RPC_GET_INFO::response info_res = AUTO_VAL_INIT(info_res);
+    bool r = epee::net_utils::invoke_http_json("/getinfo", info_req, info_res, http_client, params.timeout);
+    CHECK_AND_ASSERT_MES(r && info_res.status == CORE_RPC_STATUS_OK, false, "Failed to get info from the daemon at " << params.daemon_address << ":" << params.rpc_port);
+    chain.height = info_res.height;
+
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request header_req = AUTO_VAL_INIT(header_req);
+    cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response header_res = AUTO_VAL_INIT(header_res);
+    header_req.height = 0;
+    r = epee::net_utils::invoke_http_json_rpc("/json_rpc", "getblockheaderbyheight", header_req, header_res, http_client, params.timeout);
+    CHECK_AND_ASSERT_MES(r && header_res.status == CORE_RPC_STATUS_OK, false, "Failed to get the genesis block header");
+    CHECK_AND_ASSERT_MES(epee::string_tools::hex_to_pod(header_res.block_header.hash, chain.genesis_id), false, "Invalid genesis block hash");
+
+    cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request histogram_req = AUTO_VAL_INIT(histogram_req);
+    cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response histogram_res = AUTO_VAL_INIT(histogram_res);
+    histogram_req.amounts.push_back(0);
+    r = epee::net_utils::invoke_http_json_rpc("/json_rpc", "get_output_histogram", histogram_req, histogram_res, http_client, params.timeout);
+    chain.rct_outputs = 0;
+    if (r && histogram_res.status == CORE_RPC_STATUS_OK && !histogram_res.histogram.empty())
+      chain.rct_outputs = histogram_res.histogram.front().total_instances;
+    else
+      MWARNING("Failed to get the output count, get_outs.bin will not be exercised");
+
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::request pool_req = AUTO_VAL_INIT(pool_req);
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response pool_res = AUTO_VAL_INIT(pool_res);
+    r = epee::net_utils::invoke_http_json("/get_transaction_pool", pool_req, pool_res, http_client, params.timeout);
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request txs_req = AUTO_VAL_INIT(txs_req);
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response txs_res = AUTO_VAL_INIT(txs_res);
+    if (r && pool_res.status == CORE_RPC_STATUS_OK)
+    {
+      for (size_t i = 0; i < pool_res.transactions.size() && i < params.relay_txs; ++i)
+        txs_req.txs_hashes.push_back(pool_res.transactions[i].id_hash);
+    }
+    txs_req.decode_as_json = false;
+    if (!txs_req.txs_hashes.empty() &&
+        epee::net_utils::invoke_http_json("/gettransactions", txs_req, txs_res, http_client, params.timeout) &&
+        txs_res.status == CORE_RPC_STATUS_OK)
+    {
+      for (const std::string& tx_hex: txs_res.txs_as_hex)
+      {
+        cryptonote::blobdata tx_blob;
+        if (epee::string_tools::parse_hexstr_to_binbuff(tx_hex, tx_blob))
+          chain.txs.push_back(tx_blob);
+      }
+    }
+    if (chain.txs.empty())
+      MWARNING("No pool transactions, tx relay and sendrawtransaction will not be exercised");
+
+    return chain.height > 0;
+  }
+
+  void print_stats(const stats_map& stats, std::chrono::seconds duration)
+  {
+    std::cout << std::left << std::setw(26) << "request" << std::right
+              << std::setw(10) << "count" << std::setw(8) << "errors"
+              << std::setw(10) << "ops/s" << std::setw(11) << "items/s"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+              << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::endl;
+
+    for (const auto& entry: stats)
+    {
+      std::vector<uint64_t> latencies = entry.second.latencies_us;
+      std::sort(latencies.begin(), latencies.end());
+      auto percentile = [&](size_t p) {
+        return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, latencies.size() * p / 100)] / 1000.0;
+      };
+      std::cout << std::left << std::setw(26) << entry.first << std::right << std::fixed << std::setprecision(1)
+                << std::setw(10) << latencies.size() << std::setw(8) << entry.second.errors
+                << std::setw(10) << latencies.size() / (double)duration.count()
+                << std::setw(11) << entry.second.items / (double)duration.count()
+                << std::setprecision(2);
+      // the time to queue a request is no latency
+      if (entry.second.answered)
+        std::cout << std::setw(10) << percentile(50) << std::setw(10) << percentile(90)
+                  << std::setw(10) << percentile(99) << std::setw(10) << (latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+      else
+        std::cout << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(10) << "-";
+      std::cout << std::endl;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  TRY_ENTRY();
+  po::options_description desc_options("Command line options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, command_line::arg_testnet_on);
+  command_line::add_arg(desc_options, arg_daemon_address);
+  command_line::add_arg(desc_options, arg_p2p_port);
+  command_line::add_arg(desc_options, arg_rpc_port);
+  command_line::add_arg(desc_options, arg_peers);
+  command_line::add_arg(desc_options, arg_rpc_clients);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_bind_ip);
+  command_line::add_arg(desc_options, arg_peer_delay);
+  command_line::add_arg(desc_options, arg_blocks_per_request);
+  command_line::add_arg(desc_options, arg_outs_per_request);
+  command_line::add_arg(desc_options, arg_relay_txs);
+  command_line::add_arg(desc_options, arg_timeout);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Puts a running daemon under p2p and RPC load and reports latencies." << std::endl;
+    std::cout << "Each peer connects from its own local address, as the daemon takes a single" << std::endl;
+    std::cout << "incoming connection per host: on Linux, all of 127.0.0.0/8 is loopback." << std::endl << std::endl;
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  mlog_configure(mlog_get_default_log_path("net_load_tests_daemon.log"), true);
+  mlog_set_log_level(0);
+
+  const bool testnet = command_line::get_arg(vm, command_line::arg_testnet_on);
+  const uint32_t p2p_port = command_line::get_arg(vm, arg_p2p_port);
+  const uint32_t rpc_port = command_line::get_arg(vm, arg_rpc_port);
+
+  load_params params;
+  params.daemon_address = command_line::get_arg(vm, arg_daemon_address);
+  params.p2p_port = std::to_string(p2p_port ? p2p_port : testnet ? config::testnet::P2P_DEFAULT_PORT : config::P2P_DEFAULT_PORT);
+  params.rpc_port = std::to_string(rpc_port ? rpc_port : testnet ? config::testnet::RPC_DEFAULT_PORT : config::RPC_DEFAULT_PORT);
+  params.network_id = testnet ? config::testnet::NETWORK_ID : config::NETWORK_ID;
+  params.peers = command_line::get_arg(vm, arg_peers);
+  params.rpc_clients = command_line::get_arg(vm, arg_rpc_clients);
+  params.duration = std::chrono::seconds(command_line::get_arg(vm, arg_duration));
+  params.peer_delay = std::chrono::milliseconds(command_line::get_arg(vm, arg_peer_delay));
+  params.blocks_per_request = std::max<size_t>(1, command_line::get_arg(vm, arg_blocks_per_request));
+  params.outs_per_request = command_line::get_arg(vm, arg_outs_per_request);
+  params.relay_txs = command_line::get_arg(vm, arg_relay_txs);
+  params.timeout = std::chrono::milliseconds(command_line::get_arg(vm, arg_timeout));
+  boost::system::error_code ec;
+  params.bind_ip = boost::asio::ip::address_v4::from_string(command_line::get_arg(vm, arg_bind_ip), ec);
+  if (ec)
+  {
+    std::cout << "Invalid bind address: " << command_line::get_arg(vm, arg_bind_ip) << std::endl;
+    return 1;
+  }
+
+  chain_info chain;
+  if (!get_chain_info(params, chain))
+    return 1;
+  std::cout << "Daemon height " << chain.height << ", " << chain.rct_outputs << " outputs, "
+            << chain.txs.size() << " transactions to relay" << std::endl;
+
+  peer_commands_handler commands_handler;
+  peer_tcp_server tcp_server(epee::net_utils::e_connection_type_RPC);    // not subject to the p2p rate limits
+  tcp_server.get_config_object().m_pcommands_handler = &commands_handler;
+  tcp_server.get_config_object().m_invoke_timeout = params.timeout.count();
+  if (params.peers > 0)
+  {
+    CHECK_AND_ASSERT_MES(tcp_server.init_server(0, "127.0.0.1"), 1, "Failed to initialize the peers' network");
+    CHECK_AND_ASSERT_MES(tcp_server.run_server(std::max<size_t>(2, params.peers / 4), false), 1, "Failed to start the peers' network");
+  }
+
+  std::vector<std::unique_ptr<simulated_peer>> peers;
+  std::vector<std::unique_ptr<rpc_client>> rpc_clients;
+  std::vector<stats_map> stats(params.peers + params.rpc_clients);
+  std::vector<std::thread> threads;
+
+  const clock_type::time_point deadline = clock_type::now() + params.duration;
+  for (size_t i = 0; i < params.peers; ++i)
+  {
+    peers.emplace_back(new simulated_peer(tcp_server.get_config_object(), params, chain));
+    const std::string bind_ip = boost::asio::ip::address_v4(params.bind_ip.to_ulong() + i).to_string();
+    threads.emplace_back(&simulated_peer::run, peers.back().get(), std::ref(tcp_server), bind_ip, deadline, std::ref(stats[i]));
+  }
+  for (size_t i = 0; i < params.rpc_clients; ++i)
+  {
+    rpc_clients.emplace_back(new rpc_client(params, chain, crypto::rand<uint64_t>()));
+    threads.emplace_back(&rpc_client::run, rpc_clients.back().get(), deadline, std::ref(stats[params.peers + i]));
+  }
+  for (std::thread& thread: threads)
+    thread.join();
+
+  if (params.peers > 0)
+  {
+    tcp_server.send_stop_signal();
+    tcp_server.timed_wait_server_stop(params.timeout.count());
+  }
+
+  stats_map total;
+  for (const stats_map& worker_stats: stats)
+    for (const auto& entry: worker_stats)
+      total[entry.first].merge(entry.second);
+  print_stats(total, params.duration);
+
+  return 0;
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "ringct/rctOps.h"
+
+//! Builds a block template from a pool of `a_pool_size` transactions on a fake chain.
+//! The pool transactions have the size and shape of two output ringct
+//! transactions, but spend outputs which are not on the chain: every one of
+//! them goes through the size and reward checks, the blob lookup, parsing and
+//! the input checks, then is left out, so this measures the pool walk and not
+//! signature verification (see test_ver_rct_simple for that).
+template<size_t a_pool_size>
+class test_fill_block_template
+{
+public:
+  static const size_t loop_count = 20;
+
+  test_fill_block_template(): m_pool(m_blockchain), m_blockchain(m_pool), m_initialized(false) {}
+
+  ~test_fill_block_template()
+  {
+    if (m_initialized)
+      m_blockchain.deinit();
+    if (!m_path.empty())
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_path, ec);
+    }
+  }
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    static const std::pair<uint8_t, uint64_t> hard_forks[] = { std::make_pair((uint8_t)1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0) };
+    static const test_options options = { hard_forks };
+
+    m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    BlockchainDB *db = new BlockchainLMDB();
+    try
+    {
+      db->open(m_path, DBF_FASTEST);
+    }
+    catch (const std::exception &e)
+    {
+      std::cout << "Failed to create the test database: " << e.what() << std::endl;
+      delete db;
+      return false;
+    }
+    if (!m_blockchain.init(db, false, &options))
+    {
+      delete db;
+      return false;
+    }
+    m_initialized = true;
+    if (!m_pool.init())
+      return false;
+
+    for (size_t n = 0; n < a_pool_size; ++n)
+    {
+      transaction tx = make_pool_tx(n);
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!m_pool.add_tx(tx, tvc, true, false, true, 1) || !tvc.m_added_to_pool)
+        return false;
+    }
+    return m_pool.get_transactions_count() == a_pool_size;
+  }
+
+  bool test()
+  {
+    cryptonote::block bl;
+    size_t total_size;
+    uint64_t fee, expected_reward;
+    return m_pool.fill_block_template(bl, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2, 0, total_size, fee, expected_reward, 1, 1);
+  }
+
+private:
+  static cryptonote::transaction make_pool_tx(size_t n)
+  {
+    using namespace cryptonote;
+
+    transaction tx;
+    tx.version = 1;
+    tx.unlock_time = 0;
+    txin_to_key txin;
+    txin.amount = 0;
+    for (size_t i = 0; i < DEFAULT_RINGSIZE; ++i)
+      txin.key_offsets.push_back(1000 + i);
+    txin.k_image = rct::rct2ki(rct::pkGen());
+    tx.vin.push_back(txin);
+    for (size_t i = 0; i < 2; ++i)
+      tx.vout.push_back(tx_out{0, txout_to_key(rct::rct2pk(rct::pkGen()))});
+    tx.rct_signatures.type = rct::RCTTypeSimple;
+    // spread the fees so the pool is not in insertion order
+    tx.rct_signatures.txnFee = 100000000 + (n * 7919) % 1000 * 1000000;
+    tx.rct_signatures.pseudoOuts.resize(1);
+    tx.rct_signatures.ecdhInfo.resize(2);
+    tx.rct_signatures.outPk.resize(2);
+    tx.rct_signatures.p.rangeSigs.resize(2);
+    tx.rct_signatures.p.MGs.resize(1);
+    tx.rct_signatures.p.MGs[0].ss.resize(DEFAULT_RINGSIZE, rct::keyV(2));
+    return tx;
+  }
+
+  cryptonote::tx_memory_pool m_pool;
+  cryptonote::Blockchain m_blockchain;
+  bool m_initialized;
+  std::string m_path;
+};
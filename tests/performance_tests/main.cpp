@@ -28,6 +28,13 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "version.h"
+
 #include "performance_tests.h"
 #include "performance_utils.h"
 
@@ -45,49 +52,137 @@
 #include "is_out_to_acc.h"
 #include "sc_reduce32.h"
 #include "cn_fast_hash.h"
+#include "rct_sig.h"
+#include "range_proof.h"
+#include "parse_tx.h"
+#include "portable_storage.h"
+#include "output_key.h"
+#include "wallet_scan.h"
+#include "block_template.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_filter = { "filter", "Regular expression filter for which tests to run", ".*" };
+  const command_line::arg_descriptor<std::string> arg_json = { "json", "Write the results to this file as json", "" };
+}
 
 int main(int argc, char** argv)
 {
+  TRY_ENTRY();
+  po::options_description desc_options("Command line options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_filter);
+  command_line::add_arg(desc_options, arg_json);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
   set_process_affinity(1);
   set_thread_high_priority();
 
   mlog_configure(mlog_get_default_log_path("performance_tests.log"), true);
   mlog_set_log_level(0);
 
+  performance_test_params p;
+  try
+  {
+    p.filter = boost::regex(command_line::get_arg(vm, arg_filter));
+  }
+  catch (const boost::regex_error &e)
+  {
+    std::cout << "Invalid filter: " << e.what() << std::endl;
+    return 1;
+  }
+  p.report.version = FONERO_VERSION_FULL;
+  p.report.timestamp = time(NULL);
+
   performance_timer timer;
   timer.start();
 
-  TEST_PERFORMANCE2(test_construct_tx, 2, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 10);
+  TEST_PERFORMANCE2(p, test_construct_tx, 2, 1);
+  TEST_PERFORMANCE2(p, test_construct_tx, 2, 2);
+  TEST_PERFORMANCE2(p, test_construct_tx, 2, 10);
+
+  TEST_PERFORMANCE2(p, test_construct_tx, 10, 1);
+  TEST_PERFORMANCE2(p, test_construct_tx, 10, 2);
+  TEST_PERFORMANCE2(p, test_construct_tx, 10, 10);
+
+  TEST_PERFORMANCE2(p, test_construct_tx, 100, 1);
+  TEST_PERFORMANCE2(p, test_construct_tx, 100, 2);
+  TEST_PERFORMANCE2(p, test_construct_tx, 100, 10);
+
+  TEST_PERFORMANCE1(p, test_check_tx_signature, 2);
+  TEST_PERFORMANCE1(p, test_check_tx_signature, 10);
+  TEST_PERFORMANCE1(p, test_check_tx_signature, 100);
+
+  TEST_PERFORMANCE0(p, test_is_out_to_acc);
+  TEST_PERFORMANCE0(p, test_generate_key_image_helper);
+  TEST_PERFORMANCE0(p, test_generate_key_derivation);
+  TEST_PERFORMANCE0(p, test_generate_key_image);
+  TEST_PERFORMANCE0(p, test_derive_public_key);
+  TEST_PERFORMANCE0(p, test_derive_secret_key);
+  TEST_PERFORMANCE0(p, test_ge_frombytes_vartime);
+  TEST_PERFORMANCE0(p, test_generate_keypair);
+  TEST_PERFORMANCE0(p, test_sc_reduce32);
 
-  TEST_PERFORMANCE2(test_construct_tx, 10, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 10);
+  TEST_PERFORMANCE0(p, test_cn_slow_hash);
+  TEST_PERFORMANCE1(p, test_cn_fast_hash, 32);
+  TEST_PERFORMANCE1(p, test_cn_fast_hash, 16384);
 
-  TEST_PERFORMANCE2(test_construct_tx, 100, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 10);
+  TEST_PERFORMANCE3(p, test_gen_rct_simple, 2, 2, 13);
+  TEST_PERFORMANCE3(p, test_ver_rct_simple, 1, 2, 5);
+  TEST_PERFORMANCE3(p, test_ver_rct_simple, 1, 2, 13);
+  TEST_PERFORMANCE3(p, test_ver_rct_simple, 2, 2, 13);
+  TEST_PERFORMANCE3(p, test_ver_rct_simple, 1, 2, 32);
+  TEST_PERFORMANCE3(p, test_ver_rct, 1, 2, 5);
+  TEST_PERFORMANCE3(p, test_ver_rct, 1, 2, 13);
+  TEST_PERFORMANCE3(p, test_ver_rct, 1, 2, 32);
 
-  TEST_PERFORMANCE1(test_check_tx_signature, 2);
-  TEST_PERFORMANCE1(test_check_tx_signature, 10);
-  TEST_PERFORMANCE1(test_check_tx_signature, 100);
+  TEST_PERFORMANCE1(p, test_range_proof, false);
+  TEST_PERFORMANCE1(p, test_range_proof, true);
 
-  TEST_PERFORMANCE0(test_is_out_to_acc);
-  TEST_PERFORMANCE0(test_generate_key_image_helper);
-  TEST_PERFORMANCE0(test_generate_key_derivation);
-  TEST_PERFORMANCE0(test_generate_key_image);
-  TEST_PERFORMANCE0(test_derive_public_key);
-  TEST_PERFORMANCE0(test_derive_secret_key);
-  TEST_PERFORMANCE0(test_ge_frombytes_vartime);
-  TEST_PERFORMANCE0(test_generate_keypair);
-  TEST_PERFORMANCE0(test_sc_reduce32);
+  TEST_PERFORMANCE2(p, test_parse_tx, 13, 2);
+  TEST_PERFORMANCE2(p, test_parse_tx, 13, 10);
 
-  TEST_PERFORMANCE0(test_cn_slow_hash);
-  TEST_PERFORMANCE1(test_cn_fast_hash, 32);
-  TEST_PERFORMANCE1(test_cn_fast_hash, 16384);
+  TEST_PERFORMANCE2(p, test_portable_storage_store, 20, 10);
+  TEST_PERFORMANCE2(p, test_portable_storage_load, 20, 10);
+
+  TEST_PERFORMANCE1(p, test_get_output_key, 13);
+  TEST_PERFORMANCE1(p, test_get_output_key, 1000);
+
+  TEST_PERFORMANCE1(p, test_wallet_scan, 2);
+  TEST_PERFORMANCE1(p, test_wallet_scan, 16);
+
+  TEST_PERFORMANCE1(p, test_fill_block_template, 1000);
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
+  const std::string json_path = command_line::get_arg(vm, arg_json);
+  if (!json_path.empty())
+  {
+    std::string json;
+    if (!epee::serialization::store_t_to_json(p.report, json) || !epee::file_io_utils::save_string_to_file(json_path, json))
+    {
+      std::cout << "Failed to write results to " << json_path << std::endl;
+      return 1;
+    }
+  }
+
   return 0;
+  CATCH_ENTRY_L0("main", 1);
 }
@@ -0,0 +1,158 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/hardfork.h"
+#include "ringct/rctOps.h"
+
+//! A throwaway LMDB chain whose coinbases pay `a_outputs_per_block` outputs each
+template<size_t a_block_count, size_t a_outputs_per_block>
+class lmdb_test_base
+{
+public:
+  // coinbase outputs are stored as ringct outputs, so they are all indexed under amount 0
+  static const uint64_t output_amount = 0;
+  static const size_t output_count = a_block_count * a_outputs_per_block;
+
+  ~lmdb_test_base()
+  {
+    if (m_db)
+    {
+      m_db->close();
+      m_db.reset();
+    }
+    if (!m_path.empty())
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_path, ec);
+    }
+  }
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    m_db.reset(new BlockchainLMDB());
+    try
+    {
+      m_db->open(m_path, DBF_FASTEST);
+      m_hardfork.reset(new HardFork(*m_db, 1, 0));
+      m_hardfork->init();
+      m_db->set_hard_fork(m_hardfork.get());
+
+      crypto::hash prev_id = null_hash;
+      for (size_t height = 0; height < a_block_count; ++height)
+      {
+        block blk;
+        blk.major_version = 1;
+        blk.minor_version = 0;
+        blk.timestamp = height;
+        blk.prev_id = prev_id;
+        blk.nonce = 0;
+        blk.miner_tx.version = 1;
+        blk.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+        txin_gen txin;
+        txin.height = height;
+        blk.miner_tx.vin.push_back(txin);
+        for (size_t n = 0; n < a_outputs_per_block; ++n)
+          blk.miner_tx.vout.push_back(tx_out{1000, txout_to_key(rct::rct2pk(rct::pkGen()))});
+        m_db->add_block(blk, get_object_blobsize(blk), height + 1, 1000 * a_outputs_per_block * (height + 1), std::vector<transaction>());
+        prev_id = get_block_hash(blk);
+      }
+    }
+    catch (const std::exception &e)
+    {
+      std::cout << "Failed to create the test database: " << e.what() << std::endl;
+      return false;
+    }
+    return m_db->get_num_outputs(output_amount) == output_count;
+  }
+
+protected:
+  std::string m_path;
+  std::unique_ptr<cryptonote::BlockchainDB> m_db;
+  std::unique_ptr<cryptonote::HardFork> m_hardfork;
+};
+
+template<size_t a_block_count, size_t a_outputs_per_block>
+const uint64_t lmdb_test_base<a_block_count, a_outputs_per_block>::output_amount;
+template<size_t a_block_count, size_t a_outputs_per_block>
+const size_t lmdb_test_base<a_block_count, a_outputs_per_block>::output_count;
+
+//! Looks up `a_batch_size` random outputs at once, as done for the rings of a tx being built or checked
+template<size_t a_batch_size>
+class test_get_output_key : private lmdb_test_base<200, 100>
+{
+  static_assert(0 < a_batch_size, "batch_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 1000;
+  static const size_t batch_count = 64;
+
+  typedef lmdb_test_base<200, 100> base_class;
+
+  test_get_output_key(): m_batch(0) {}
+
+  bool init()
+  {
+    if (!base_class::init())
+      return false;
+
+    m_offsets.resize(batch_count);
+    for (auto &offsets: m_offsets)
+    {
+      for (size_t n = 0; n < a_batch_size; ++n)
+        offsets.push_back(crypto::rand<uint64_t>() % output_count);
+      std::sort(offsets.begin(), offsets.end());
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<cryptonote::output_data_t> outputs;
+    m_db->get_output_key(output_amount, m_offsets[m_batch++ % batch_count], outputs);
+    return outputs.size() == a_batch_size;
+  }
+
+private:
+  std::vector<std::vector<uint64_t>> m_offsets;
+  size_t m_batch;
+};
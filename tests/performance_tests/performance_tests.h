@@ -30,10 +30,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <list>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <boost/chrono.hpp>
+#include <boost/regex.hpp>
+
+#include "serialization/keyvalue_serialization.h"
 
 class performance_timer
 {
@@ -56,11 +64,59 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  uint64_t elapsed_ns()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return static_cast<uint64_t>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(elapsed).count());
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
 };
 
+struct performance_test_result
+{
+  std::string name;
+  uint64_t loop_count;
+  uint64_t elapsed_ms;
+  uint64_t mean_ns;
+  uint64_t median_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t stddev_ns;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(loop_count)
+    KV_SERIALIZE(elapsed_ms)
+    KV_SERIALIZE(mean_ns)
+    KV_SERIALIZE(median_ns)
+    KV_SERIALIZE(min_ns)
+    KV_SERIALIZE(max_ns)
+    KV_SERIALIZE(stddev_ns)
+  END_KV_SERIALIZE_MAP()
+};
+
+//! What a run produces, stored as json so results can be compared between releases
+struct performance_test_report
+{
+  std::string version;
+  uint64_t timestamp;
+  std::list<performance_test_result> results;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(version)
+    KV_SERIALIZE(timestamp)
+    KV_SERIALIZE(results)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct performance_test_params
+{
+  boost::regex filter;
+  performance_test_report report;
+};
 
 template <typename T>
 class test_runner
@@ -82,11 +138,26 @@ public:
     warm_up();
     std::cout << "Warm up: " << timer.elapsed_ms() << " ms" << std::endl;
 
+    // calls are timed in batches, so the spread is known and one slow batch
+    // (page faults, preemption) does not skew the median, while the clock
+    // reads stay out of the time per call of sub-microsecond tests
+    const size_t loop_count = T::loop_count;
+    const size_t batch_size = std::max<size_t>(1, loop_count / max_batches);
+    m_per_call_ns.clear();
+    m_per_call_ns.reserve(loop_count / batch_size + 1);
+    performance_timer batch_timer;
     timer.start();
-    for (size_t i = 0; i < T::loop_count; ++i)
+    for (size_t i = 0; i < loop_count; )
     {
-      if (!test.test())
-        return false;
+      const size_t n = std::min(batch_size, loop_count - i);
+      batch_timer.start();
+      for (size_t j = 0; j < n; ++j)
+      {
+        if (!test.test())
+          return false;
+      }
+      m_per_call_ns.push_back(batch_timer.elapsed_ns() / n);
+      i += n;
     }
     m_elapsed = timer.elapsed_ms();
 
@@ -101,6 +172,32 @@ public:
     return m_elapsed * scale / T::loop_count;
   }
 
+  performance_test_result get_result(const char* test_name) const
+  {
+    performance_test_result res;
+    res.name = test_name;
+    res.loop_count = T::loop_count;
+    res.elapsed_ms = m_elapsed;
+
+    std::vector<uint64_t> sorted = m_per_call_ns;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (uint64_t ns: sorted)
+      sum += ns;
+    const double mean = sum / sorted.size();
+    double variance = 0;
+    for (uint64_t ns: sorted)
+      variance += (ns - mean) * (ns - mean);
+    variance /= sorted.size();
+
+    res.mean_ns = static_cast<uint64_t>(mean);
+    res.median_ns = sorted.size() % 2 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+    res.min_ns = sorted.front();
+    res.max_ns = sorted.back();
+    res.stddev_ns = static_cast<uint64_t>(std::sqrt(variance));
+    return res;
+  }
+
 private:
   /**
    * Warm up processor core, enabling turbo boost, etc.
@@ -117,16 +214,25 @@ private:
   }
 
 private:
+  static const size_t max_batches = 100;
+
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
   int m_elapsed;
+  std::vector<uint64_t> m_per_call_ns; ///<! mean time per call of each batch
 };
 
 template <typename T>
-void run_test(const char* test_name)
+void run_test(performance_test_params &params, const char* test_name)
 {
+  if (!boost::regex_search(test_name, params.filter))
+    return;
+
   test_runner<T> runner;
   if (runner.run())
   {
+    const performance_test_result res = runner.get_result(test_name);
+    params.report.results.push_back(res);
+
     std::cout << test_name << " - OK:\n";
     std::cout << "  loop count:    " << T::loop_count << '\n';
     std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
@@ -140,7 +246,8 @@ void run_test(const char* test_name)
      unit = "µs";
 #endif
     }
-    std::cout << "  time per call: " << time_per_call << " " << unit << "/call\n" << std::endl;
+    std::cout << "  time per call: " << time_per_call << " " << unit << "/call\n";
+    std::cout << "  median:        " << res.median_ns << " ns, min " << res.min_ns << " ns, stddev " << res.stddev_ns << " ns\n" << std::endl;
   }
   else
   {
@@ -149,7 +256,7 @@ void run_test(const char* test_name)
 }
 
 #define QUOTEME(x) #x
-#define TEST_PERFORMANCE0(test_class)         run_test< test_class >(QUOTEME(test_class))
-#define TEST_PERFORMANCE1(test_class, a0)     run_test< test_class<a0> >(QUOTEME(test_class<a0>))
-#define TEST_PERFORMANCE2(test_class, a0, a1) run_test< test_class<a0, a1> >(QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
-#define TEST_PERFORMANCE3(test_class, a0, a1, a2) run_test< test_class<a0, a1, a2> >(QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ", " QUOTEME(a2) ">")
+#define TEST_PERFORMANCE0(params, test_class)         run_test< test_class >(params, QUOTEME(test_class))
+#define TEST_PERFORMANCE1(params, test_class, a0)     run_test< test_class<a0> >(params, QUOTEME(test_class<a0>))
+#define TEST_PERFORMANCE2(params, test_class, a0, a1) run_test< test_class<a0, a1> >(params, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
+#define TEST_PERFORMANCE3(params, test_class, a0, a1, a2) run_test< test_class<a0, a1, a2> >(params, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ", " QUOTEME(a2) ">")
@@ -0,0 +1,107 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <list>
+
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+//! A NOTIFY_RESPONSE_GET_OBJECTS as sent while syncing, with blocks of `a_txs_per_block` transactions
+template<size_t a_block_count, size_t a_txs_per_block>
+class portable_storage_test_base
+{
+public:
+  bool init()
+  {
+    for (size_t n = 0; n < a_block_count; ++n)
+    {
+      cryptonote::block_complete_entry entry;
+      entry.block = random_blob(400);
+      for (size_t t = 0; t < a_txs_per_block; ++t)
+        entry.txs.push_back(random_blob(13000));
+      m_request.blocks.push_back(entry);
+    }
+    m_request.current_blockchain_height = 1000000;
+    return epee::serialization::store_t_to_binary(m_request, m_blob);
+  }
+
+protected:
+  static cryptonote::blobdata random_blob(size_t size)
+  {
+    cryptonote::blobdata blob(size, '\0');
+    crypto::rand(size, reinterpret_cast<uint8_t*>(&blob[0]));
+    return blob;
+  }
+
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request m_request;
+  std::string m_blob;
+};
+
+template<size_t a_block_count, size_t a_txs_per_block>
+class test_portable_storage_store : private portable_storage_test_base<a_block_count, a_txs_per_block>
+{
+public:
+  static const size_t loop_count = 100;
+
+  typedef portable_storage_test_base<a_block_count, a_txs_per_block> base_class;
+
+  bool init()
+  {
+    return base_class::init();
+  }
+
+  bool test()
+  {
+    std::string blob;
+    return epee::serialization::store_t_to_binary(this->m_request, blob);
+  }
+};
+
+template<size_t a_block_count, size_t a_txs_per_block>
+class test_portable_storage_load : private portable_storage_test_base<a_block_count, a_txs_per_block>
+{
+public:
+  static const size_t loop_count = 100;
+
+  typedef portable_storage_test_base<a_block_count, a_txs_per_block> base_class;
+
+  bool init()
+  {
+    return base_class::init();
+  }
+
+  bool test()
+  {
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request request;
+    return epee::serialization::load_t_from_binary(request, this->m_blob);
+  }
+};
@@ -0,0 +1,161 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "ringct/rctSigs.h"
+
+//! Random inputs and outputs of the given sizes, the way the ringct unit tests build them
+template<size_t a_in_count, size_t a_out_count>
+class rct_sig_test_base
+{
+  static_assert(0 < a_in_count, "in_count must be greater than 0");
+  static_assert(0 < a_out_count, "out_count must be greater than 0");
+
+public:
+  static const size_t in_count = a_in_count;
+  static const size_t out_count = a_out_count;
+
+  bool init()
+  {
+    const rct::fno_amount amount = 1000;
+    for (size_t n = 0; n < in_count; ++n)
+    {
+      rct::ctkey sk, pk;
+      std::tie(sk, pk) = rct::ctskpkGen(amount);
+      m_sc.push_back(sk);
+      m_pc.push_back(pk);
+      m_inamounts.push_back(amount);
+    }
+
+    // the outputs take everything but the fee, and the full rct variant
+    // has no fee so it gets all of it
+    const rct::fno_amount fee = 10;
+    const rct::fno_amount total = amount * in_count;
+    for (size_t n = 0; n < out_count; ++n)
+    {
+      rct::key sk, pk;
+      rct::skpkGen(sk, pk);
+      m_destinations.push_back(pk);
+      m_amount_keys.push_back(rct::hash_to_scalar(sk));
+      m_outamounts.push_back((total - fee) / out_count);
+      m_full_outamounts.push_back(total / out_count);
+    }
+    m_fee = total - m_outamounts[0] * out_count;
+    m_full_outamounts.back() += total - m_full_outamounts[0] * out_count;
+    return true;
+  }
+
+protected:
+  rct::ctkeyV m_sc, m_pc;
+  rct::keyV m_destinations, m_amount_keys;
+  std::vector<rct::fno_amount> m_inamounts, m_outamounts, m_full_outamounts;
+  rct::fno_amount m_fee;
+};
+
+template<size_t a_in_count, size_t a_out_count, size_t a_ring_size>
+class test_gen_rct_simple : private rct_sig_test_base<a_in_count, a_out_count>
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 10;
+
+  typedef rct_sig_test_base<a_in_count, a_out_count> base_class;
+
+  bool init()
+  {
+    return base_class::init();
+  }
+
+  bool test()
+  {
+    m_rv = rct::genRctSimple(rct::zero(), this->m_sc, this->m_pc, this->m_destinations, this->m_inamounts, this->m_outamounts, this->m_amount_keys, this->m_fee, a_ring_size - 1);
+    return true;
+  }
+
+private:
+  rct::rctSig m_rv;
+};
+
+template<size_t a_in_count, size_t a_out_count, size_t a_ring_size>
+class test_ver_rct_simple : private rct_sig_test_base<a_in_count, a_out_count>
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 10;
+
+  typedef rct_sig_test_base<a_in_count, a_out_count> base_class;
+
+  bool init()
+  {
+    if (!base_class::init())
+      return false;
+    m_rv = rct::genRctSimple(rct::zero(), this->m_sc, this->m_pc, this->m_destinations, this->m_inamounts, this->m_outamounts, this->m_amount_keys, this->m_fee, a_ring_size - 1);
+    return rct::verRctSimple(m_rv);
+  }
+
+  bool test()
+  {
+    return rct::verRctSimple(m_rv);
+  }
+
+private:
+  rct::rctSig m_rv;
+};
+
+template<size_t a_in_count, size_t a_out_count, size_t a_ring_size>
+class test_ver_rct : private rct_sig_test_base<a_in_count, a_out_count>
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 10;
+
+  typedef rct_sig_test_base<a_in_count, a_out_count> base_class;
+
+  bool init()
+  {
+    if (!base_class::init())
+      return false;
+    m_rv = rct::genRct(rct::zero(), this->m_sc, this->m_pc, this->m_destinations, this->m_full_outamounts, this->m_amount_keys, a_ring_size - 1);
+    return rct::verRct(m_rv);
+  }
+
+  bool test()
+  {
+    return rct::verRct(m_rv);
+  }
+
+private:
+  rct::rctSig m_rv;
+};
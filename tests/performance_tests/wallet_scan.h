@@ -0,0 +1,116 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctSigs.h"
+
+#include "multi_tx_test_base.h"
+
+//! Scans a tx of `a_out_count` outputs the way the wallet does on refresh:
+//! one derivation, an ownership check per output, then the amount and
+//! key image of every output that is ours (every other one here).
+template<size_t a_out_count>
+class test_wallet_scan : private multi_tx_test_base<2>
+{
+  static_assert(1 < a_out_count, "out_count must be greater than 1");
+
+public:
+  static const size_t loop_count = 100;
+  static const size_t out_count = a_out_count;
+
+  typedef multi_tx_test_base<2> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+    m_bob.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    for (size_t i = 0; i < out_count; ++i)
+    {
+      const account_base &to = i % 2 ? m_bob : m_alice;
+      destinations.push_back(tx_destination_entry(this->m_source_amount / out_count, to.get_keys().m_account_address));
+    }
+
+    crypto::secret_key tx_key;
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, std::vector<uint8_t>(), m_tx, 0, tx_key))
+      return false;
+
+    m_tx_pub_key = get_tx_pub_key_from_extra(m_tx);
+    return true;
+  }
+
+  bool test()
+  {
+    const cryptonote::account_keys &keys = m_alice.get_keys();
+    crypto::key_derivation derivation;
+    if (!crypto::generate_key_derivation(m_tx_pub_key, keys.m_view_secret_key, derivation))
+      return false;
+
+    size_t received = 0;
+    for (size_t i = 0; i < m_tx.vout.size(); ++i)
+    {
+      const cryptonote::txout_to_key &out_key = boost::get<cryptonote::txout_to_key>(m_tx.vout[i].target);
+      if (!cryptonote::is_out_to_acc_precomp(keys.m_account_address.m_spend_public_key, out_key, derivation, i))
+        continue;
+
+      crypto::secret_key scalar;
+      crypto::derivation_to_scalar(derivation, i, scalar);
+      rct::key mask;
+      const rct::fno_amount amount = m_tx.rct_signatures.type == rct::RCTTypeSimple ?
+          rct::decodeRctSimple(m_tx.rct_signatures, rct::sk2rct(scalar), i, mask) :
+          rct::decodeRct(m_tx.rct_signatures, rct::sk2rct(scalar), i, mask);
+
+      cryptonote::keypair in_ephemeral;
+      crypto::key_image ki;
+      if (!cryptonote::generate_key_image_helper(keys, m_tx_pub_key, i, in_ephemeral, ki))
+        return false;
+      received += amount != 0;
+    }
+    return received == (out_count + 1) / 2;
+  }
+
+private:
+  cryptonote::account_base m_alice;
+  cryptonote::account_base m_bob;
+  cryptonote::transaction m_tx;
+  crypto::public_key m_tx_pub_key;
+};
@@ -45,6 +45,7 @@ public:
   void on_synchronized(){}
   void safesyncmode(const bool){}
   uint64_t get_current_blockchain_height() const {return 1;}
+  uint64_t get_pruned_height() const {return 0;}
   void set_target_blockchain_height(uint64_t) {}
   bool init(const boost::program_options::variables_map& vm) {return true ;}
   bool deinit(){return true;}
@@ -41,6 +41,7 @@
 #include "blockchain_db/berkeleydb/db_bdb.h"
 #endif
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
 
 using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
@@ -151,6 +152,48 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+// a structurally valid rct tx (its signatures don't verify), so it has prunable data
+transaction make_rct_tx()
+{
+  transaction tx;
+  tx.version = 1;
+  tx.unlock_time = 0;
+  txin_to_key txin;
+  txin.amount = 0;
+  txin.key_offsets.push_back(1);
+  txin.k_image = rct::rct2ki(rct::skGen());
+  tx.vin.push_back(txin);
+  tx.vout.push_back(tx_out{0, txout_to_key(rct::rct2pk(rct::pkGen()))});
+  tx.rct_signatures.type = rct::RCTTypeSimple;
+  tx.rct_signatures.txnFee = 1;
+  tx.rct_signatures.pseudoOuts.resize(1);
+  tx.rct_signatures.ecdhInfo.resize(1);
+  tx.rct_signatures.outPk.resize(1);
+  tx.rct_signatures.p.rangeSigs.resize(1);
+  tx.rct_signatures.p.MGs.resize(1);
+  tx.rct_signatures.p.MGs[0].ss.resize(1, rct::keyV(2));
+  return tx;
+}
+
+block make_block(uint64_t height, const crypto::hash &prev_id, const std::vector<transaction> &txs)
+{
+  block blk;
+  blk.major_version = 1;
+  blk.minor_version = 0;
+  blk.timestamp = height;
+  blk.prev_id = prev_id;
+  blk.nonce = 0;
+  blk.miner_tx.version = 1;
+  blk.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+  txin_gen txin;
+  txin.height = height;
+  blk.miner_tx.vin.push_back(txin);
+  blk.miner_tx.vout.push_back(tx_out{1000, txout_to_key(rct::rct2pk(rct::pkGen()))});
+  for (const auto &tx: txs)
+    blk.tx_hashes.push_back(get_transaction_hash(tx));
+  return blk;
+}
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -343,4 +386,387 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RetrievePrunedTxData)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  const std::vector<transaction> txs(1, make_rct_tx());
+  const crypto::hash h = get_transaction_hash(txs[0]);
+  ASSERT_NO_THROW(this->m_db->add_block(make_block(0, null_hash, txs), t_sizes[0], t_diffs[0], t_coins[0], txs));
+
+  cryptonote::blobdata full, pruned, prunable;
+  ASSERT_TRUE(this->m_db->get_tx_blob(h, full));
+  ASSERT_TRUE(this->m_db->get_pruned_tx_blob(h, pruned));
+  ASSERT_TRUE(this->m_db->get_prunable_tx_blob(h, prunable));
+  ASSERT_EQ(tx_to_blob(txs[0]), full);
+  ASSERT_FALSE(prunable.empty());
+  ASSERT_EQ(full, pruned + prunable);
+
+  transaction tx;
+  ASSERT_TRUE(this->m_db->get_pruned_tx(h, tx));
+  ASSERT_HASH_EQ(get_transaction_prefix_hash(txs[0]), get_transaction_prefix_hash(tx));
+  ASSERT_EQ(1, tx.rct_signatures.txnFee);
+
+  cryptonote::blobdata bd;
+  ASSERT_FALSE(this->m_db->get_pruned_tx_blob(null_hash, bd));
+  ASSERT_FALSE(this->m_db->get_prunable_tx_blob(null_hash, bd));
+}
+
+TYPED_TEST(BlockchainDBTest, PruneTxData)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  std::vector<crypto::hash> tx_hashes, prunable_hashes;
+  crypto::hash prev_id = null_hash;
+  for (uint64_t height = 0; height < 3; ++height)
+  {
+    const std::vector<transaction> txs(1, make_rct_tx());
+    const block b = make_block(height, prev_id, txs);
+    ASSERT_NO_THROW(this->m_db->add_block(b, t_sizes[0], t_diffs[0], t_coins[0], txs));
+    prev_id = get_block_hash(b);
+
+    cryptonote::blobdata prunable;
+    ASSERT_TRUE(this->m_db->get_prunable_tx_blob(get_transaction_hash(txs[0]), prunable));
+    tx_hashes.push_back(get_transaction_hash(txs[0]));
+    prunable_hashes.push_back(crypto::cn_fast_hash(prunable.data(), prunable.size()));
+  }
+
+  ASSERT_EQ(0, this->m_db->get_pruned_height());
+  ASSERT_THROW(this->m_db->prune(3), DB_ERROR);
+  ASSERT_EQ(4, this->m_db->prune(2)); // miner txs included
+  ASSERT_EQ(2, this->m_db->get_pruned_height());
+  ASSERT_EQ(0, this->m_db->prune(1));
+
+  cryptonote::blobdata bd;
+  crypto::hash prunable_hash;
+  for (size_t i = 0; i < tx_hashes.size(); ++i)
+  {
+    const bool pruned = i < 2;
+    ASSERT_EQ(!pruned, this->m_db->get_prunable_tx_blob(tx_hashes[i], bd));
+    ASSERT_EQ(!pruned, this->m_db->get_tx_blob(tx_hashes[i], bd));
+    ASSERT_TRUE(this->m_db->get_pruned_tx_blob(tx_hashes[i], bd));
+    ASSERT_TRUE(this->m_db->get_prunable_tx_hash(tx_hashes[i], prunable_hash));
+    ASSERT_HASH_EQ(prunable_hashes[i], prunable_hash);
+  }
+
+  // the top block is whole and can still be popped
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_EQ(2, this->m_db->height());
+}
+
+TYPED_TEST(BlockchainDBTest, OutputHistogram)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // a miner output in each block (timestamp == height), an RCT output in even
+  // blocks; both are stored as amount 0
+  crypto::hash prev_id = null_hash;
+  for (uint64_t height = 0; height < 14; ++height)
+  {
+    const std::vector<transaction> txs(height % 2 ? 0 : 1, make_rct_tx());
+    const block b = make_block(height, prev_id, txs);
+    ASSERT_NO_THROW(this->m_db->add_block(b, t_sizes[0], t_diffs[0], t_coins[0], txs));
+    prev_id = get_block_hash(b);
+  }
+
+  // unlocked outputs are in blocks 0-4, recent ones in blocks 3-4
+  auto histogram = this->m_db->get_output_histogram(std::vector<uint64_t>(), true, 3);
+  ASSERT_EQ(1, histogram.size());
+  ASSERT_TRUE(histogram[0] == std::make_tuple(21, 8, 3));
+
+  histogram = this->m_db->get_output_histogram({0, 5}, true, 0);
+  ASSERT_EQ(2, histogram.size());
+  ASSERT_TRUE(histogram[0] == std::make_tuple(21, 8, 0));
+  ASSERT_TRUE(histogram[5] == std::make_tuple(0, 0, 0));
+
+  // counts follow popped blocks
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  histogram = this->m_db->get_output_histogram(std::vector<uint64_t>(), true, 0);
+  ASSERT_TRUE(histogram[0] == std::make_tuple(18, 5, 0));
+}
+
+TYPED_TEST(BlockchainDBTest, OutputDistribution)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // a miner output in each block, two RCT outputs in every third block
+  crypto::hash prev_id = null_hash;
+  for (uint64_t height = 0; height < 7; ++height)
+  {
+    std::vector<transaction> txs;
+    if (height % 3 == 0)
+      txs = {make_rct_tx(), make_rct_tx()};
+    const block b = make_block(height, prev_id, txs);
+    ASSERT_NO_THROW(this->m_db->add_block(b, t_sizes[0], t_diffs[0], t_coins[0], txs));
+    prev_id = get_block_hash(b);
+  }
+
+  std::vector<uint64_t> distribution;
+  ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 6, distribution));
+  ASSERT_EQ(std::vector<uint64_t>({3, 4, 5, 8, 9, 10, 13}), distribution);
+  ASSERT_TRUE(this->m_db->get_output_distribution(0, 4, 5, distribution));
+  ASSERT_EQ(std::vector<uint64_t>({9, 10}), distribution);
+  ASSERT_TRUE(this->m_db->get_output_distribution(1, 0, 6, distribution));
+  ASSERT_EQ(std::vector<uint64_t>(7, 0), distribution);
+  ASSERT_FALSE(this->m_db->get_output_distribution(0, 5, 7, distribution));
+  ASSERT_FALSE(this->m_db->get_output_distribution(0, 5, 4, distribution));
+}
+
+TYPED_TEST(BlockchainDBTest, ReadSession)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  const block b0 = make_block(0, null_hash, {});
+  ASSERT_NO_THROW(this->m_db->add_block(b0, t_sizes[0], t_diffs[0], t_coins[0], std::vector<transaction>()));
+
+  {
+    db_read_session session(*this->m_db);
+    ASSERT_EQ(1, this->m_db->height());
+
+    // nested sessions and read txns started inside a session must not end it
+    {
+      db_read_session inner(*this->m_db);
+      ASSERT_HASH_EQ(get_block_hash(b0), this->m_db->get_block_hash_from_height(0));
+    }
+    this->m_db->block_txn_start(true);
+    ASSERT_EQ(t_sizes[0], this->m_db->get_block_size(0));
+    this->m_db->block_txn_stop();
+    ASSERT_EQ(t_diffs[0], this->m_db->get_block_cumulative_difficulty(0));
+  }
+
+  const block b1 = make_block(1, get_block_hash(b0), {});
+  ASSERT_NO_THROW(this->m_db->add_block(b1, t_sizes[1], t_diffs[1], t_coins[1], std::vector<transaction>()));
+
+  {
+    db_read_session session(*this->m_db);
+    ASSERT_EQ(2, this->m_db->height());
+    ASSERT_HASH_EQ(get_block_hash(b1), this->m_db->get_block_hash_from_height(1));
+  }
+
+  // an open session counts as an active txn until it ends, so a map resize
+  // waits for it
+  if (!dynamic_cast<BlockchainLMDB*>(this->m_db))
+    return;
+  const uint64_t active = mdb_txn_safe::num_active_txns;
+  {
+    db_read_session session(*this->m_db);
+    ASSERT_EQ(active + 1, mdb_txn_safe::num_active_txns.load());
+    {
+      db_read_session inner(*this->m_db);
+      ASSERT_EQ(active + 1, mdb_txn_safe::num_active_txns.load());
+    }
+    ASSERT_EQ(2, this->m_db->height());
+    ASSERT_EQ(active + 1, mdb_txn_safe::num_active_txns.load());
+  }
+  ASSERT_EQ(active, mdb_txn_safe::num_active_txns.load());
+
+  // a session inside a read txn leaves that txn to its owner
+  this->m_db->block_txn_start(true);
+  {
+    db_read_session session(*this->m_db);
+    ASSERT_EQ(active + 1, mdb_txn_safe::num_active_txns.load());
+  }
+  ASSERT_EQ(active, mdb_txn_safe::num_active_txns.load());
+  ASSERT_HASH_EQ(get_block_hash(b1), this->m_db->get_block_hash_from_height(1));
+  this->m_db->block_txn_stop();
+}
+
+TYPED_TEST(BlockchainDBTest, BlobCodec)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  BlockchainLMDB *db = dynamic_cast<BlockchainLMDB*>(this->m_db);
+  if (!db)
+    return;
+
+  std::vector<crypto::hash> tx_hashes;
+  std::vector<cryptonote::blobdata> block_blobs, tx_blobs;
+  crypto::hash prev_id = null_hash;
+  auto add_block = [&](uint64_t height) {
+    const std::vector<transaction> txs(1, make_rct_tx());
+    const block b = make_block(height, prev_id, txs);
+    this->m_db->add_block(b, t_sizes[0], t_diffs[0], t_coins[0], txs);
+    prev_id = get_block_hash(b);
+    block_blobs.push_back(block_to_blob(b));
+    tx_hashes.push_back(get_transaction_hash(txs[0]));
+    tx_blobs.push_back(tx_to_blob(txs[0]));
+  };
+  auto check_blobs = [&]() {
+    cryptonote::blobdata bd, pruned, prunable;
+    for (size_t i = 0; i < block_blobs.size(); ++i)
+    {
+      ASSERT_EQ(block_blobs[i], this->m_db->get_block_blob_from_height(i));
+      ASSERT_TRUE(this->m_db->get_tx_blob(tx_hashes[i], bd));
+      ASSERT_EQ(tx_blobs[i], bd);
+      ASSERT_TRUE(this->m_db->get_pruned_tx_blob(tx_hashes[i], pruned));
+      ASSERT_TRUE(this->m_db->get_prunable_tx_blob(tx_hashes[i], prunable));
+      ASSERT_EQ(tx_blobs[i], pruned + prunable);
+    }
+  };
+
+  for (uint64_t height = 0; height < 3; ++height)
+    ASSERT_NO_THROW(add_block(height));
+
+  if (!blob_codec_supported(blob_codec_lz4))
+  {
+    ASSERT_THROW(db->set_blob_codec(blob_codec_lz4), DB_ERROR);
+    check_blobs();
+    return;
+  }
+
+  ASSERT_NO_THROW(db->set_blob_codec(blob_codec_lz4));
+  ASSERT_EQ(blob_codec_lz4, db->get_blob_codec());
+  check_blobs();
+  ASSERT_NO_THROW(add_block(3));
+  check_blobs();
+
+  // the codec is kept in the db
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_EQ(blob_codec_lz4, db->get_blob_codec());
+  check_blobs();
+
+  ASSERT_NO_THROW(db->set_blob_codec(blob_codec_none));
+  ASSERT_EQ(blob_codec_none, db->get_blob_codec());
+  check_blobs();
+  ASSERT_NO_THROW(add_block(4));
+  check_blobs();
+}
+
+TYPED_TEST(BlockchainDBTest, PowCache)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  crypto::hash ids[3], pows[3], pow;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    ids[i] = crypto::rand<crypto::hash>();
+    pows[i] = crypto::rand<crypto::hash>();
+    ASSERT_NO_THROW(this->m_db->add_block_pow_hash(ids[i], 10 * i, 3, pows[i]));
+  }
+
+  ASSERT_TRUE(this->m_db->get_block_pow_hash(ids[1], 3, pow));
+  ASSERT_EQ(pows[1], pow);
+  // computed for another hard fork version
+  ASSERT_FALSE(this->m_db->get_block_pow_hash(ids[1], 2, pow));
+  ASSERT_FALSE(this->m_db->get_block_pow_hash(crypto::rand<crypto::hash>(), 3, pow));
+
+  // replaced, and kept across a reopen
+  ASSERT_NO_THROW(this->m_db->add_block_pow_hash(ids[1], 10, 3, pows[0]));
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_TRUE(this->m_db->get_block_pow_hash(ids[1], 3, pow));
+  ASSERT_EQ(pows[0], pow);
+
+  ASSERT_EQ(2, this->m_db->prune_block_pow_hashes(20));
+  ASSERT_FALSE(this->m_db->get_block_pow_hash(ids[0], 3, pow));
+  ASSERT_FALSE(this->m_db->get_block_pow_hash(ids[1], 3, pow));
+  ASSERT_TRUE(this->m_db->get_block_pow_hash(ids[2], 3, pow));
+  ASSERT_EQ(pows[2], pow);
+}
+
+TYPED_TEST(BlockchainDBTest, BatchResize)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  BlockchainLMDB *db = dynamic_cast<BlockchainLMDB*>(this->m_db);
+  if (!db)
+    return;
+  db->set_batch_transactions(true);
+
+  const block b0 = make_block(0, null_hash, {});
+  ASSERT_NO_THROW(db->add_block(b0, t_sizes[0], t_diffs[0], t_coins[0], std::vector<transaction>()));
+  std::vector<block> blocks;
+  crypto::hash prev_id = get_block_hash(b0);
+  for (uint64_t height = 1; height < 4; ++height)
+  {
+    blocks.push_back(make_block(height, prev_id, {}));
+    prev_id = get_block_hash(blocks.back());
+  }
+
+  // the last block takes the batch's estimate over the default map size,
+  // which makes the batch commit what it has and grow the map before adding it
+  const size_t sizes[] = {t_sizes[1], 1 << 26, 1 << 26};
+  auto add_blocks = [&]() {
+    ASSERT_TRUE(db->batch_start(blocks.size()));
+    for (size_t i = 0; i < blocks.size(); ++i)
+      ASSERT_NO_THROW(db->add_block(blocks[i], sizes[i], t_diffs[1], t_coins[1], std::vector<transaction>()));
+    ASSERT_EQ(4, db->height());
+  };
+
+  // aborting takes off the blocks committed for the resizes too
+  add_blocks();
+  ASSERT_NO_THROW(db->batch_abort());
+  ASSERT_EQ(1, db->height());
+  for (const block &b: blocks)
+    ASSERT_FALSE(db->block_exists(get_block_hash(b)));
+
+  add_blocks();
+  ASSERT_NO_THROW(db->batch_stop());
+  ASSERT_EQ(4, db->height());
+  for (const block &b: blocks)
+    ASSERT_TRUE(db->block_exists(get_block_hash(b)));
+}
+
 }  // anonymous namespace
@@ -0,0 +1,91 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Fonero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include "cryptonote_core/db_sync_thread.h"
+
+TEST(db_sync_thread, not_running)
+{
+  std::atomic<int> syncs(0);
+  cryptonote::db_sync_thread sync_thread([&]() { ++syncs; });
+  cryptonote::db_sync_thread::durable_future future = sync_thread.request();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(0)));
+  EXPECT_TRUE(future.get());
+  EXPECT_EQ(1, syncs);
+}
+
+TEST(db_sync_thread, group)
+{
+  std::atomic<int> syncs(0);
+  cryptonote::db_sync_thread sync_thread([&]() { ++syncs; });
+  sync_thread.start(60000);
+  cryptonote::db_sync_thread::durable_future f1 = sync_thread.request();
+  cryptonote::db_sync_thread::durable_future f2 = sync_thread.request();
+  EXPECT_EQ(std::future_status::timeout, f1.wait_for(std::chrono::milliseconds(50)));
+  cryptonote::db_sync_thread::durable_future f3 = sync_thread.flush();
+  ASSERT_TRUE(f1.get());
+  ASSERT_TRUE(f2.get());
+  ASSERT_TRUE(f3.get());
+  EXPECT_EQ(1, syncs);
+  EXPECT_EQ(3, sync_thread.get_request_count());
+  EXPECT_EQ(1, sync_thread.get_sync_count());
+}
+
+TEST(db_sync_thread, latency)
+{
+  std::atomic<int> syncs(0);
+  cryptonote::db_sync_thread sync_thread([&]() { ++syncs; });
+  sync_thread.start(10);
+  ASSERT_EQ(std::future_status::ready, sync_thread.request().wait_for(std::chrono::seconds(10)));
+  ASSERT_EQ(std::future_status::ready, sync_thread.request().wait_for(std::chrono::seconds(10)));
+  EXPECT_EQ(2, syncs);
+}
+
+TEST(db_sync_thread, stop_syncs_pending)
+{
+  std::atomic<int> syncs(0);
+  cryptonote::db_sync_thread sync_thread([&]() { ++syncs; });
+  sync_thread.start(60000);
+  cryptonote::db_sync_thread::durable_future future = sync_thread.request();
+  sync_thread.stop();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(0)));
+  EXPECT_TRUE(future.get());
+  EXPECT_EQ(1, syncs);
+  EXPECT_FALSE(sync_thread.is_running());
+}
+
+TEST(db_sync_thread, failure)
+{
+  cryptonote::db_sync_thread sync_thread([]() { throw std::runtime_error("disk full"); });
+  sync_thread.start(0);
+  EXPECT_FALSE(sync_thread.flush().get());
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Fonero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+#include "cryptonote_core/event_journal.h"
+
+namespace
+{
+  crypto::hash make_hash(char c)
+  {
+    crypto::hash h;
+    memset(&h, c, sizeof(h));
+    return h;
+  }
+}
+
+TEST(event_journal, get_events)
+{
+  cryptonote::event_journal journal;
+  const uint64_t cursor = journal.get_cursor();
+  journal.publish(cryptonote::chain_event::tx_added, make_hash(1), 0);
+  journal.publish(cryptonote::chain_event::block_added, make_hash(2), 5);
+
+  std::vector<cryptonote::chain_event> events;
+  uint64_t next = 0;
+  ASSERT_TRUE(journal.get_events(cursor, events, next, 0, 10));
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(cryptonote::chain_event::tx_added, events[0].type);
+  EXPECT_EQ(make_hash(2), events[1].id);
+  EXPECT_EQ(5, events[1].height);
+  EXPECT_EQ(journal.get_cursor(), next);
+
+  ASSERT_TRUE(journal.get_events(cursor, events, next, 0, 1));
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(cursor + 1, next);
+
+  ASSERT_TRUE(journal.get_events(journal.get_cursor(), events, next, 0, 10));
+  EXPECT_TRUE(events.empty());
+}
+
+TEST(event_journal, overflow)
+{
+  cryptonote::event_journal journal(2);
+  const uint64_t cursor = journal.get_cursor();
+  for (char c = 0; c < 3; ++c)
+    journal.publish(cryptonote::chain_event::tx_added, make_hash(c), 0);
+
+  std::vector<cryptonote::chain_event> events;
+  uint64_t next = 0;
+  EXPECT_FALSE(journal.get_events(cursor, events, next, 0, 10));
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(make_hash(1), events[0].id);
+}
+
+TEST(event_journal, wait)
+{
+  cryptonote::event_journal journal;
+  const uint64_t cursor = journal.get_cursor();
+  boost::thread publisher([&]{
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+    journal.publish(cryptonote::chain_event::block_added, make_hash(1), 1);
+  });
+
+  std::vector<cryptonote::chain_event> events;
+  uint64_t next = 0;
+  ASSERT_TRUE(journal.get_events(cursor, events, next, 10000, 10));
+  publisher.join();
+  ASSERT_EQ(1, events.size());
+
+  journal.interrupt();
+  ASSERT_TRUE(journal.get_events(next, events, next, 10000, 10));
+  EXPECT_TRUE(events.empty());
+}
@@ -27,8 +27,12 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gtest/gtest.h"
+#include "misc_log_ex.h"
 #include "net/http_auth.h"
+#include "net/http_request_parser.h"
+#include "net/http_server_worker_pool.h"
 
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/fusion/adapted/std_pair.hpp>
 #include <boost/range/algorithm/find_if.hpp>
@@ -736,3 +740,169 @@ TEST(HTTP, Add_Field)
 
   EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+TEST(HTTP_Worker_Pool, NotStarted)
+{
+  epee::net_utils::http::http_worker_pool pool;
+  EXPECT_FALSE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "a", [](bool){}));
+}
+
+TEST(HTTP_Worker_Pool, Priority)
+{
+  epee::net_utils::http::http_worker_pool pool;
+  ASSERT_TRUE(pool.start(1, 0));
+
+  std::atomic<bool> started{false}, release{false};
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "a", [&](bool){ started = true; while (!release) boost::this_thread::yield(); }));
+  while (!started)
+    boost::this_thread::yield();
+
+  // the single worker is busy, so these get queued and reordered
+  std::vector<int> order;
+  unsigned cancelled = 0;
+  boost::mutex order_lock;
+  boost::condition_variable order_cond;
+  const auto add = [&](int n){ return [&, n](bool c){
+    boost::unique_lock<boost::mutex> l(order_lock);
+    if (c)
+      ++cancelled;
+    else
+      order.push_back(n);
+    order_cond.notify_all();
+  }; };
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_low, "a", add(2)));
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "a", add(1)));
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_high, "a", add(0)));
+  release = true;
+
+  // all jobs must have run before stop(), which would cancel the ones still queued
+  {
+    boost::unique_lock<boost::mutex> l(order_lock);
+    ASSERT_TRUE(order_cond.wait_for(l, boost::chrono::seconds(10), [&]{ return order.size() + cancelled == 3; }));
+  }
+  pool.stop();
+
+  EXPECT_EQ(0, cancelled);
+  ASSERT_EQ(3, order.size());
+  EXPECT_EQ(0, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(2, order[2]);
+}
+
+TEST(HTTP_Worker_Pool, Cancel)
+{
+  epee::net_utils::http::http_worker_pool pool;
+  ASSERT_TRUE(pool.start(1, 1));
+
+  std::atomic<bool> started{false}, release{false};
+  std::atomic<unsigned> cancelled{0};
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "a", [&](bool){ started = true; while (!release) boost::this_thread::yield(); }));
+  while (!started)
+    boost::this_thread::yield();
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_high, "a", [&](bool c){ cancelled += c; }));
+
+  // the second job is held back by the per client limit, then dropped by stop()
+  boost::thread releaser([&]{ boost::this_thread::sleep_for(boost::chrono::milliseconds(50)); release = true; });
+  pool.stop();
+  releaser.join();
+  EXPECT_EQ(1, cancelled);
+  EXPECT_FALSE(pool.dispatch(epee::net_utils::http::http_request_priority_high, "a", [](bool){}));
+}
+
+TEST(HTTP_Worker_Pool, QueueFull)
+{
+  epee::net_utils::http::http_worker_pool pool;
+  ASSERT_TRUE(pool.start(1, 0, 1));
+
+  std::atomic<bool> started{false}, release{false};
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "a", [&](bool){ started = true; while (!release) boost::this_thread::yield(); }));
+  while (!started)
+    boost::this_thread::yield();
+
+  // one job may wait for the busy worker, the next one is left to the caller
+  std::atomic<unsigned> ran{0};
+  ASSERT_TRUE(pool.dispatch(epee::net_utils::http::http_request_priority_normal, "b", [&](bool c){ ran += !c; }));
+  EXPECT_FALSE(pool.dispatch(epee::net_utils::http::http_request_priority_high, "c", [&](bool c){ ran += !c; }));
+
+  release = true;
+  while (ran == 0)
+    boost::this_thread::yield();
+  pool.stop();
+  EXPECT_EQ(1, ran);
+}
+
+TEST(HTTP_Parser, RequestLine)
+{
+  epee::net_utils::http::http_request_info info;
+  ASSERT_TRUE(epee::net_utils::http::parse_request_line("POST /getblocks.bin HTTP/1.1\r", info));
+  EXPECT_EQ(epee::net_utils::http::http_method_post, info.m_http_method);
+  EXPECT_EQ("POST", info.m_http_method_str);
+  EXPECT_EQ("/getblocks.bin", info.m_URI);
+  EXPECT_EQ(1, info.m_http_ver_hi);
+  EXPECT_EQ(1, info.m_http_ver_lo);
+
+  ASSERT_TRUE(epee::net_utils::http::parse_request_line("get /?a=b HTTP/1.0", info));
+  EXPECT_EQ(epee::net_utils::http::http_method_get, info.m_http_method);
+  EXPECT_EQ("/?a=b", info.m_URI);
+  EXPECT_EQ(0, info.m_http_ver_lo);
+
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("GET /", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("GET  / HTTP/1.1", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("GET / HTTP/1", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("GET / HTTP/1.x", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("GET / FTP/1.1", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_request_line("FOO / HTTP/1.1", info));
+}
+
+TEST(HTTP_Parser, HeaderFields)
+{
+  epee::net_utils::http::http_header_info info;
+  ASSERT_TRUE(epee::net_utils::http::parse_header_fields(
+    "Host: localhost:18081\r\n"
+    "content-length:  12 \r\n"
+    "CONNECTION: keep-alive\r\n"
+    "X-Folded: a\r\n"
+    "  b\r\n"
+    "\r\n"
+    "Ignored: body", info));
+  EXPECT_EQ("localhost:18081", info.m_host);
+  EXPECT_EQ("12", info.m_content_length);
+  EXPECT_EQ("keep-alive", info.m_connection);
+  ASSERT_EQ(1, info.m_etc_fields.size());
+  EXPECT_EQ("X-Folded", info.m_etc_fields.front().first);
+  EXPECT_EQ("a b", info.m_etc_fields.front().second);
+
+  EXPECT_FALSE(epee::net_utils::http::parse_header_fields("no colon\r\n\r\n", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_header_fields(": value\r\n\r\n", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_header_fields(" folded first\r\n\r\n", info));
+  EXPECT_FALSE(epee::net_utils::http::parse_header_fields("Content-Length: 1\r\nContent-Length: 2\r\n\r\n", info));
+  EXPECT_TRUE(epee::net_utils::http::parse_header_fields("Content-Length: 1\r\nContent-Length: 1\r\n\r\n", info));
+}
+
+TEST(HTTP_Parser, ContentLength)
+{
+  size_t len = 0;
+  ASSERT_TRUE(epee::net_utils::http::parse_content_length(" 1234", len));
+  EXPECT_EQ(1234, len);
+  EXPECT_FALSE(epee::net_utils::http::parse_content_length("", len));
+  EXPECT_FALSE(epee::net_utils::http::parse_content_length("-1", len));
+  EXPECT_FALSE(epee::net_utils::http::parse_content_length("12a", len));
+  EXPECT_FALSE(epee::net_utils::http::parse_content_length("99999999999999999999999", len));
+}
+
+TEST(HTTP_Parser, KeepAlive)
+{
+  epee::net_utils::http::http_request_info info;
+  info.m_http_ver_hi = 1;
+  info.m_http_ver_lo = 1;
+  EXPECT_TRUE(epee::net_utils::http::is_keep_alive(info));
+  info.m_header_info.m_connection = "Close";
+  EXPECT_FALSE(epee::net_utils::http::is_keep_alive(info));
+
+  info.m_http_ver_lo = 0;
+  info.m_header_info.m_connection.clear();
+  EXPECT_FALSE(epee::net_utils::http::is_keep_alive(info));
+  info.m_header_info.m_connection = "Upgrade, Keep-Alive";
+  EXPECT_TRUE(epee::net_utils::http::is_keep_alive(info));
+}
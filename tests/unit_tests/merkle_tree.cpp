@@ -0,0 +1,143 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "crypto/merkle_tree.h"
+
+namespace
+{
+  crypto::hash make_hash()
+  {
+    return crypto::rand<crypto::hash>();
+  }
+
+  std::vector<crypto::hash> make_hashes(size_t count)
+  {
+    std::vector<crypto::hash> hashes;
+    for (size_t n = 0; n < count; ++n)
+      hashes.push_back(make_hash());
+    return hashes;
+  }
+
+  crypto::hash reference_root(const std::vector<crypto::hash> &hashes)
+  {
+    crypto::hash root;
+    crypto::tree_hash(hashes.data(), hashes.size(), root);
+    return root;
+  }
+}
+
+TEST(merkle_tree, fast_hash_batch)
+{
+  const std::vector<crypto::hash> in = make_hashes(2 * 11);
+  std::vector<crypto::hash> out(11);
+  crypto::cn_fast_hash_64_batch(in.data(), out.size(), out.data());
+  for (size_t n = 0; n < out.size(); ++n)
+    EXPECT_EQ(crypto::cn_fast_hash(&in[2 * n], 64), out[n]);
+
+  // in place, as tree_hash does
+  std::vector<crypto::hash> inplace = in;
+  crypto::cn_fast_hash_64_batch(inplace.data(), out.size(), inplace.data());
+  for (size_t n = 0; n < out.size(); ++n)
+    EXPECT_EQ(out[n], inplace[n]);
+}
+
+TEST(merkle_tree, same_as_tree_hash)
+{
+  for (size_t count = 1; count < 70; ++count)
+  {
+    const std::vector<crypto::hash> hashes = make_hashes(count);
+    crypto::merkle_tree tree(hashes);
+    ASSERT_EQ(reference_root(hashes), tree.root()) << count;
+  }
+}
+
+TEST(merkle_tree, append_insert_erase)
+{
+  std::vector<crypto::hash> hashes = make_hashes(1);
+  crypto::merkle_tree tree(hashes);
+  for (size_t n = 0; n < 300; ++n)
+  {
+    const crypto::hash h = make_hash();
+    const size_t op = crypto::rand<size_t>() % 4;
+    if (op == 0 || hashes.size() < 2)
+    {
+      hashes.push_back(h);
+      tree.append(h);
+    }
+    else if (op == 1)
+    {
+      const size_t index = crypto::rand<size_t>() % (hashes.size() + 1);
+      hashes.insert(hashes.begin() + index, h);
+      tree.insert(index, h);
+    }
+    else if (op == 2)
+    {
+      const size_t index = crypto::rand<size_t>() % hashes.size();
+      hashes.erase(hashes.begin() + index);
+      tree.erase(index);
+    }
+    else
+    {
+      const size_t index = crypto::rand<size_t>() % hashes.size();
+      hashes[index] = h;
+      tree.set(index, h);
+    }
+    // not always up to date, so several changes add up
+    if (n % 3 == 0)
+      ASSERT_EQ(reference_root(hashes), tree.root()) << n;
+  }
+  ASSERT_EQ(reference_root(hashes), tree.root());
+}
+
+TEST(merkle_tree, root_with_leaf)
+{
+  for (size_t count: {1, 2, 3, 4, 5, 8, 9, 33})
+  {
+    std::vector<crypto::hash> hashes = make_hashes(count);
+    crypto::merkle_tree tree(hashes);
+    tree.root();
+    for (size_t index = 0; index < count; ++index)
+    {
+      std::vector<crypto::hash> changed = hashes;
+      changed[index] = make_hash();
+      EXPECT_EQ(reference_root(changed), tree.root_with_leaf(index, changed[index])) << count << " " << index;
+    }
+    EXPECT_EQ(reference_root(hashes), tree.root());
+  }
+}
+
+TEST(merkle_tree, empty)
+{
+  crypto::merkle_tree tree;
+  EXPECT_THROW(tree.root(), std::logic_error);
+  EXPECT_THROW(tree.erase(0), std::out_of_range);
+}
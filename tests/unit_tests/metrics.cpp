@@ -0,0 +1,107 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "metrics.h"
+
+using epee::metrics::histogram;
+
+TEST(metrics, histogram_buckets)
+{
+  EXPECT_EQ(0, histogram::get_bucket(0));
+  EXPECT_EQ(0, histogram::get_bucket(1023));
+  EXPECT_EQ(1, histogram::get_bucket(1024));
+  EXPECT_EQ(histogram::bucket_count - 1, histogram::get_bucket((uint64_t)-1));
+  for (uint64_t ns: {1024ull, 1279ull, 1280ull, 5000ull, 1000000ull, 123456789ull, 60000000000ull})
+  {
+    const size_t bucket = histogram::get_bucket(ns);
+    EXPECT_LT(ns, histogram::get_bucket_upper_bound(bucket));
+    EXPECT_GE(ns, histogram::get_bucket_upper_bound(bucket - 1));
+    // bucket bounds are within 25% of the value
+    EXPECT_LE(histogram::get_bucket_upper_bound(bucket) - histogram::get_bucket_upper_bound(bucket - 1), ns / 4);
+  }
+}
+
+TEST(metrics, histogram_quantiles)
+{
+  histogram h;
+  EXPECT_EQ(0, h.get().quantile(0.5));
+  for (int n = 0; n < 90; ++n)
+    h.record(2000);
+  for (int n = 0; n < 10; ++n)
+    h.record(1000000);
+  const histogram::snapshot s = h.get();
+  EXPECT_EQ(100, s.count);
+  EXPECT_EQ(90 * 2000 + 10 * 1000000, s.sum_ns);
+  EXPECT_EQ(histogram::get_bucket_upper_bound(histogram::get_bucket(2000)), s.quantile(0.5));
+  EXPECT_EQ(histogram::get_bucket_upper_bound(histogram::get_bucket(2000)), s.quantile(0.9));
+  EXPECT_EQ(histogram::get_bucket_upper_bound(histogram::get_bucket(1000000)), s.quantile(0.99));
+}
+
+TEST(metrics, concurrent_updates)
+{
+  epee::metrics::counter c;
+  histogram h;
+  std::vector<boost::thread> threads;
+  for (int t = 0; t < 16; ++t)
+    threads.push_back(boost::thread([&]{ for (int n = 0; n < 10000; ++n) { c.inc(); h.record(n); } }));
+  for (auto &t: threads)
+    t.join();
+  EXPECT_EQ(160000, c.get());
+  EXPECT_EQ(160000, h.get().count);
+}
+
+TEST(metrics, registry)
+{
+  epee::metrics::registry &r = epee::metrics::registry::instance();
+  epee::metrics::counter &c = r.get_counter("test_requests_total", "Test requests", "command", "a");
+  EXPECT_EQ(&c, &r.get_counter("test_requests_total", "Test requests", "command", "a"));
+  EXPECT_NE(&c, &r.get_counter("test_requests_total", "Test requests", "command", "b"));
+  EXPECT_THROW(r.get_gauge("test_requests_total", "Test requests", "command", "a"), std::exception);
+}
+
+TEST(metrics, prometheus_text)
+{
+  epee::metrics::registry &r = epee::metrics::registry::instance();
+  r.get_counter("test_text_total", "Test counter", "command", "a\"b").inc(3);
+  r.get_gauge("test_text_size", "Test gauge").set(-2);
+  r.get_histogram("test_text_seconds", "Test histogram").record(1500);
+  const std::string text = r.get_prometheus_text();
+  EXPECT_NE(std::string::npos, text.find("# TYPE fonero_test_text_total counter\nfonero_test_text_total{command=\"a\\\"b\"} 3\n"));
+  EXPECT_NE(std::string::npos, text.find("# TYPE fonero_test_text_size gauge\nfonero_test_text_size -2\n"));
+  EXPECT_NE(std::string::npos, text.find("fonero_test_text_seconds_bucket{le=\"1.024e-06\"} 0\n"));
+  EXPECT_NE(std::string::npos, text.find("fonero_test_text_seconds_bucket{le=\"2.048e-06\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("fonero_test_text_seconds_bucket{le=\"+Inf\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("fonero_test_text_seconds_sum 1.5e-06\n"));
+  EXPECT_NE(std::string::npos, text.find("fonero_test_text_seconds_count 1\n"));
+}
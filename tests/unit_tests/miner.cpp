@@ -0,0 +1,61 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Fonero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/miner.h"
+
+TEST(miner, mining_cpus_order)
+{
+  // two L3 caches, each with two cores of two hyperthreads
+  const std::vector<cryptonote::miner::cpu_topology> topology = {
+    {0, "0:0", "0-3"}, {1, "0:0", "0-3"}, {2, "0:1", "0-3"}, {3, "0:1", "0-3"},
+    {4, "1:0", "4-7"}, {5, "1:0", "4-7"}, {6, "1:1", "4-7"}, {7, "1:1", "4-7"},
+  };
+  const std::vector<unsigned> cpus = cryptonote::miner::order_mining_cpus(topology);
+  // cores first, alternating L3 caches, then their siblings
+  const std::vector<unsigned> expected = {0, 4, 2, 6, 1, 5, 3, 7};
+  EXPECT_EQ(expected, cpus);
+}
+
+TEST(miner, mining_cpus_uneven)
+{
+  // one L3 cache has a single core, another has two without hyperthreading
+  const std::vector<cryptonote::miner::cpu_topology> topology = {
+    {0, "0:0", "a"}, {1, "1:0", "b"}, {2, "1:1", "b"},
+  };
+  const std::vector<unsigned> cpus = cryptonote::miner::order_mining_cpus(topology);
+  const std::vector<unsigned> expected = {0, 1, 2};
+  EXPECT_EQ(expected, cpus);
+}
+
+TEST(miner, mining_cpus_empty)
+{
+  EXPECT_TRUE(cryptonote::miner::order_mining_cpus({}).empty());
+}
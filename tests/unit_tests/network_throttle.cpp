@@ -0,0 +1,105 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "p2p/network_throttle-detail.hpp"
+#include "p2p/connection_basic.hpp"
+
+using epee::net_utils::network_token_bucket;
+using epee::net_utils::connection_basic;
+
+namespace
+{
+  // the buckets run on this clock, so the tests don't depend on timing
+  uint64_t now_us = 0;
+  uint64_t test_clock() { return now_us; }
+}
+
+TEST(network_token_bucket, unlimited)
+{
+  network_token_bucket bucket(nullptr, &test_clock);
+  ASSERT_EQ(bucket.get_rate(), 0);
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(bucket.consume(1024 * 1024), 0);
+}
+
+TEST(network_token_bucket, burst_then_delay)
+{
+  network_token_bucket bucket(nullptr, &test_clock);
+  bucket.set_rate(100 * 1024);
+  ASSERT_EQ(bucket.get_rate(), 100 * 1024);
+  ASSERT_EQ(bucket.consume(100 * 1024), 0);
+  ASSERT_DOUBLE_EQ(bucket.consume(50 * 1024), 0.5);
+  ASSERT_DOUBLE_EQ(bucket.get_delay(50 * 1024), 1.0);
+}
+
+TEST(network_token_bucket, refill)
+{
+  network_token_bucket bucket(nullptr, &test_clock);
+  bucket.set_rate(1000 * 1024);
+  ASSERT_EQ(bucket.consume(1000 * 1024), 0);
+  ASSERT_GT(bucket.get_delay(100 * 1024), 0);
+  now_us += 100000;
+  ASSERT_DOUBLE_EQ(bucket.get_delay(100 * 1024), 0);
+  ASSERT_EQ(bucket.consume(100 * 1024), 0);
+  ASSERT_GT(bucket.get_delay(1), 0);
+  // never more than a full bucket, however long it was idle
+  now_us += 10000000;
+  ASSERT_EQ(bucket.consume(1000 * 1024), 0);
+  ASSERT_GT(bucket.get_delay(1), 0);
+}
+
+TEST(network_token_bucket, parent)
+{
+  network_token_bucket global(nullptr, &test_clock);
+  network_token_bucket peer1(&global, &test_clock), peer2(&global, &test_clock);
+  global.set_rate(100 * 1024);
+  ASSERT_EQ(peer1.consume(60 * 1024), 0);
+  ASSERT_EQ(peer2.consume(40 * 1024), 0);
+  ASSERT_GT(peer1.consume(10 * 1024), 0);
+  ASSERT_GT(peer2.get_delay(1), 0);
+}
+
+TEST(network_token_bucket, per_peer_limit)
+{
+  boost::asio::io_service io_service;
+  std::atomic<long> sock_count(0), sock_number(0);
+  connection_basic::set_rate_up_limit_per_peer(100 * 1024);
+  connection_basic peer1(io_service, sock_count, sock_number);
+  connection_basic peer2(io_service, sock_count, sock_number);
+  ASSERT_EQ(peer1.get_send_delay(100 * 1024), 0);
+  const double delay = peer1.get_send_delay(50 * 1024);
+  ASSERT_GT(delay, 0.4);
+  ASSERT_LE(delay, 0.5);
+  // the other peer has its own bucket
+  ASSERT_EQ(peer2.get_send_delay(50 * 1024), 0);
+
+  // a changed limit applies to existing connections too
+  connection_basic::set_rate_up_limit_per_peer(0);
+  ASSERT_EQ(peer1.get_send_delay(1024 * 1024), 0);
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Fonero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "rpc/rpc_response_cache.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  cryptonote::rpc_response_cache::tag make_tag(char c, uint64_t cookie)
+  {
+    cryptonote::rpc_response_cache::tag t;
+    memset(&t.top_hash, c, sizeof(t.top_hash));
+    t.pool_cookie = cookie;
+    return t;
+  }
+}
+
+TEST(rpc_response_cache, disabled)
+{
+  cryptonote::rpc_response_cache cache;
+  std::string body, mime_type;
+  EXPECT_FALSE(cache.enabled());
+  cache.put("a", make_tag(0, 0), "x", "");
+  EXPECT_FALSE(cache.get("a", make_tag(0, 0), body, mime_type));
+}
+
+TEST(rpc_response_cache, hit_and_miss)
+{
+  cryptonote::rpc_response_cache cache(1024);
+  std::string body, mime_type;
+  EXPECT_FALSE(cache.get("a", make_tag(1, 0), body, mime_type));
+  cache.put("a", make_tag(1, 0), "x", "");
+  ASSERT_TRUE(cache.get("a", make_tag(1, 0), body, mime_type));
+  EXPECT_EQ("x", body);
+  EXPECT_FALSE(cache.get("b", make_tag(1, 0), body, mime_type));
+  EXPECT_EQ(1, cache.get_hits());
+  EXPECT_EQ(2, cache.get_misses());
+}
+
+TEST(rpc_response_cache, tag_change)
+{
+  cryptonote::rpc_response_cache cache(1024);
+  std::string body, mime_type;
+  cache.get("a", make_tag(1, 0), body, mime_type);
+  cache.put("a", make_tag(1, 0), "x", "");
+  EXPECT_FALSE(cache.get("a", make_tag(1, 1), body, mime_type));
+  EXPECT_FALSE(cache.get("a", make_tag(1, 0), body, mime_type));
+
+  // computed from a tag which is not current anymore
+  cache.put("a", make_tag(2, 0), "y", "");
+  EXPECT_FALSE(cache.get("a", make_tag(1, 0), body, mime_type));
+}
+
+TEST(rpc_response_cache, size_limit)
+{
+  cryptonote::rpc_response_cache cache(8);
+  std::string body, mime_type;
+  cache.get("a", make_tag(1, 0), body, mime_type);
+  cache.put("a", make_tag(1, 0), "123", "");
+  cache.put("b", make_tag(1, 0), "123", "");
+  EXPECT_TRUE(cache.get("a", make_tag(1, 0), body, mime_type));
+
+  // evicts b, the least recently used
+  cache.put("c", make_tag(1, 0), "123", "");
+  EXPECT_TRUE(cache.get("a", make_tag(1, 0), body, mime_type));
+  EXPECT_FALSE(cache.get("b", make_tag(1, 0), body, mime_type));
+  EXPECT_TRUE(cache.get("c", make_tag(1, 0), body, mime_type));
+
+  // too large for the whole cache
+  cache.put("d", make_tag(1, 0), "12345678", "");
+  EXPECT_FALSE(cache.get("d", make_tag(1, 0), body, mime_type));
+  EXPECT_TRUE(cache.get("a", make_tag(1, 0), body, mime_type));
+}
+
+TEST(rpc_response_cache, binary_stream)
+{
+  cryptonote::rpc_response_cache cache(1024);
+  epee::net_utils::http::http_request_info query;
+  query.m_URI = "/get_transaction_pool_hashes.bin";
+  unsigned calls = 0;
+  const auto handler = [&calls](const epee::net_utils::http::http_request_info&, epee::net_utils::http::http_response_info& res) {
+    ++calls;
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::response resp;
+    resp.tx_hashes.resize(2);
+    resp.status = CORE_RPC_STATUS_OK;
+    res.m_rpc_status = resp.status;
+    std::string body;
+    EXPECT_TRUE(epee::serialization::store_t_to_binary(resp, body));
+    res.m_body_stream = [body](const std::function<bool(const void*, size_t)>& sink) { return sink(body.data(), body.size()); };
+    res.m_response_code = 200;
+    res.m_mime_tipe = " application/octet-stream";
+    return true;
+  };
+
+  epee::net_utils::http::http_response_info first, second;
+  ASSERT_TRUE(cache.handle(query.m_URI, make_tag(1, 0), 0, query, first, handler));
+  ASSERT_TRUE(cache.handle(query.m_URI, make_tag(1, 0), 0, query, second, handler));
+  EXPECT_EQ(1, calls);
+  EXPECT_FALSE(bool(second.m_body_stream));
+  EXPECT_FALSE(second.m_body.empty());
+  EXPECT_EQ(first.m_body, second.m_body);
+  EXPECT_EQ(" application/octet-stream", second.m_mime_tipe);
+  EXPECT_EQ(1, cache.get_hits());
+}
+
+TEST(rpc_response_cache, status_not_ok)
+{
+  cryptonote::rpc_response_cache cache(1024);
+  epee::net_utils::http::http_request_info query;
+  unsigned calls = 0;
+  const auto handler = [&calls](const epee::net_utils::http::http_request_info&, epee::net_utils::http::http_response_info& res) {
+    ++calls;
+    res.m_rpc_status = CORE_RPC_STATUS_BUSY;
+    res.m_body = "{}";
+    res.m_response_code = 200;
+    return true;
+  };
+
+  epee::net_utils::http::http_response_info res;
+  ASSERT_TRUE(cache.handle("/getheight", make_tag(1, 0), 0, query, res, handler));
+  ASSERT_TRUE(cache.handle("/getheight", make_tag(1, 0), 0, query, res, handler));
+  EXPECT_EQ(2, calls);
+}
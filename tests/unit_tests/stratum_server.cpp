@@ -0,0 +1,133 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Fonero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "common/int-util.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "rpc/stratum_server.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+
+namespace
+{
+  uint64_t parse_target(const std::string &hex)
+  {
+    std::string bin;
+    EXPECT_TRUE(epee::string_tools::parse_hexstr_to_binbuff(hex, bin));
+    EXPECT_EQ(sizeof(uint64_t), bin.size());
+    uint64_t target;
+    memcpy(&target, bin.data(), sizeof(target));
+    return SWAP64LE(target);
+  }
+
+  crypto::hash make_hash(uint64_t top)
+  {
+    crypto::hash h = cryptonote::null_hash;
+    top = SWAP64LE(top);
+    memcpy(h.data + 24, &top, sizeof(top));
+    return h;
+  }
+}
+
+TEST(stratum_server, target_unit_difficulty)
+{
+  EXPECT_EQ("ffffffffffffffff", cryptonote::stratum_server::get_target_hex(0));
+  EXPECT_EQ("ffffffffffffffff", cryptonote::stratum_server::get_target_hex(1));
+}
+
+TEST(stratum_server, target_never_misses_a_block)
+{
+  for (cryptonote::difficulty_type difficulty: {2ull, 3ull, 1000ull, 123456789ull, 0x100000000ull, 0x123456789abcull})
+  {
+    const uint64_t target = parse_target(cryptonote::stratum_server::get_target_hex(difficulty));
+    // the highest hash the miners submit passes, the next one doesn't
+    EXPECT_TRUE(cryptonote::check_hash(make_hash(target - 1), difficulty));
+    EXPECT_FALSE(cryptonote::check_hash(make_hash(target), difficulty));
+  }
+}
+
+TEST(stratum_server, parse_request)
+{
+  cryptonote::stratum::request req;
+  ASSERT_TRUE(epee::serialization::load_t_from_json(req, "{\"id\":1,\"jsonrpc\":\"2.0\",\"method\":\"login\",\"params\":{\"login\":\"addr.rig1\",\"pass\":\"x\",\"agent\":\"test/1.0\"}}"));
+  EXPECT_EQ("login", req.method);
+  EXPECT_EQ("addr.rig1", req.params.login);
+  EXPECT_EQ("test/1.0", req.params.agent);
+  EXPECT_TRUE(req.params.job_id.empty());
+  EXPECT_TRUE(req.params.nonce.empty());
+
+  ASSERT_TRUE(epee::serialization::load_t_from_json(req, "{\"id\":2,\"method\":\"submit\",\"params\":{\"id\":\"42\",\"job_id\":\"7\",\"nonce\":\"0a0b0c0d\",\"result\":\"00\"}}"));
+  EXPECT_EQ("submit", req.method);
+  EXPECT_EQ("42", req.params.id);
+  EXPECT_EQ("7", req.params.job_id);
+  EXPECT_EQ("0a0b0c0d", req.params.nonce);
+}
+
+TEST(stratum_server, job_notification_is_one_line)
+{
+  cryptonote::stratum::job_notification notification;
+  notification.jsonrpc = "2.0";
+  notification.method = "job";
+  notification.params.blob = "0101";
+  notification.params.job_id = "1";
+  notification.params.target = cryptonote::stratum_server::get_target_hex(1000);
+  notification.params.height = 10;
+  std::string data;
+  epee::serialization::store_t_to_json(notification, data, 0, false);
+  EXPECT_EQ(std::string::npos, data.find('\n'));
+  EXPECT_NE(std::string::npos, data.find("\"method\":\"job\""));
+}
+
+TEST(stratum_server, extra_nonce_round_trip)
+{
+  cryptonote::account_base acc;
+  acc.generate();
+  cryptonote::block b = AUTO_VAL_INIT(b);
+  ASSERT_TRUE(cryptonote::construct_miner_tx(10, 0, 10000000000000, 1000, 0, acc.get_keys().m_account_address, b.miner_tx, cryptonote::blobdata(4, 0), 1));
+  const cryptonote::blobdata blob = cryptonote::t_serializable_object_to_blob(b);
+  size_t offset;
+  ASSERT_TRUE(cryptonote::stratum_server::find_extra_nonce(b, blob, offset));
+
+  for (uint32_t extra_nonce: {0x01020304u, 0xffffffffu})
+  {
+    cryptonote::blobdata stamped = blob;
+    const uint32_t le_extra_nonce = SWAP32LE(extra_nonce);
+    memcpy(&stamped[offset], &le_extra_nonce, sizeof(le_extra_nonce));
+    cryptonote::block parsed;
+    ASSERT_TRUE(cryptonote::parse_and_validate_block_from_blob(stamped, parsed));
+    EXPECT_EQ(b.miner_tx.vout.size(), parsed.miner_tx.vout.size());
+    EXPECT_EQ(b.miner_tx.rct_signatures.type, parsed.miner_tx.rct_signatures.type);
+
+    std::vector<cryptonote::tx_extra_field> fields;
+    ASSERT_TRUE(cryptonote::parse_tx_extra(parsed.miner_tx.extra, fields));
+    cryptonote::tx_extra_nonce nonce;
+    ASSERT_TRUE(cryptonote::find_tx_extra_field_by_type(fields, nonce));
+    EXPECT_EQ(std::string((const char*)&le_extra_nonce, sizeof(le_extra_nonce)), nonce.nonce);
+  }
+}
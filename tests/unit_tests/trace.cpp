@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2018, The Fonero Project.
+// Copyright (c) 2014-2017 The Monero Project.
+// Portions Copyright (c) 2012-2013 The Cryptonote developers.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "rapidjson/document.h"
+
+#include "common/trace.h"
+
+namespace
+{
+  class trace: public ::testing::Test
+  {
+  protected:
+    trace(): path((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string()) {}
+    ~trace() { tools::trace::stop(); boost::filesystem::remove(path); }
+
+    bool load(rapidjson::Document &doc)
+    {
+      std::ifstream file(path);
+      std::stringstream contents;
+      contents << file.rdbuf();
+      return !doc.Parse(contents.str().c_str()).HasParseError() && doc.HasMember("traceEvents") && doc["traceEvents"].IsArray();
+    }
+
+    const std::string path;
+  };
+}
+
+TEST_F(trace, disabled)
+{
+  EXPECT_FALSE(tools::trace::enabled());
+  tools::trace::status status;
+  EXPECT_FALSE(tools::trace::get_status(status));
+  EXPECT_FALSE(tools::trace::stop());
+  TRACE_SCOPE("test", "not recorded");
+}
+
+TEST_F(trace, events)
+{
+  crypto::hash id;
+  memset(&id, 0x42, sizeof(id));
+
+  ASSERT_TRUE(tools::trace::start(path));
+  EXPECT_TRUE(tools::trace::enabled());
+  EXPECT_FALSE(tools::trace::start(path));
+  {
+    TRACE_SCOPE_ID("test", "with_id", id);
+    tools::trace::scope s("test", "with_height");
+    s.set_height(7);
+  }
+  std::vector<boost::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.push_back(boost::thread([]{ for (int n = 0; n < 100; ++n) { TRACE_SCOPE("test", "thread"); } }));
+  for (auto &t: threads)
+    t.join();
+
+  tools::trace::status status;
+  ASSERT_TRUE(tools::trace::stop(&status));
+  EXPECT_FALSE(tools::trace::enabled());
+  EXPECT_EQ(path, status.filename);
+  EXPECT_EQ(402, status.events);
+  EXPECT_EQ(0, status.dropped);
+
+  rapidjson::Document doc;
+  ASSERT_TRUE(load(doc));
+  const rapidjson::Value &events = doc["traceEvents"];
+  ASSERT_EQ(402, events.Size());
+  // scopes are recorded when they end
+  EXPECT_STREQ("with_height", events[0]["name"].GetString());
+  EXPECT_STREQ("X", events[0]["ph"].GetString());
+  EXPECT_EQ(7, events[0]["args"]["height"].GetUint64());
+  EXPECT_STREQ("with_id", events[1]["name"].GetString());
+  EXPECT_STREQ("test", events[1]["cat"].GetString());
+  EXPECT_STREQ("4242424242424242424242424242424242424242424242424242424242424242", events[1]["args"]["id"].GetString());
+  EXPECT_LE(events[1]["ts"].GetDouble(), events[0]["ts"].GetDouble());
+}
+
+TEST_F(trace, full_ring_drops)
+{
+  ASSERT_TRUE(tools::trace::start(path));
+  // the flusher is not fast enough to keep up with this
+  for (int n = 0; n < 1000000; ++n)
+  {
+    TRACE_SCOPE("test", "spam");
+  }
+  tools::trace::status status;
+  ASSERT_TRUE(tools::trace::stop(&status));
+  EXPECT_EQ(1000000, status.events + status.dropped);
+  rapidjson::Document doc;
+  ASSERT_TRUE(load(doc));
+  EXPECT_EQ(status.events, doc["traceEvents"].Size());
+}